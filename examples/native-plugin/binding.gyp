@@ -1,21 +1,66 @@
 {
+  "target_defaults": {
+    "sources": [
+      "native-plugin-demo.c"
+    ],
+    "include_dirs": [
+      "<!@(node -p \"require('node-addon-api').include\")"
+    ],
+    "cflags!": ["-fno-exceptions"],
+    "cflags_cc!": ["-fno-exceptions"],
+    "cflags": ["-fvisibility=hidden"],
+    "defines": ["NAPI_DISABLE_CPP_EXCEPTIONS"],
+    "xcode_settings": {
+      "GCC_SYMBOLS_PRIVATE_EXTERN": "YES"
+    },
+    "configurations": {
+      "Release": {
+        "cflags": ["-O3", "-flto"],
+        "ldflags": ["-flto", "-O3"],
+        "xcode_settings": {
+          "GCC_OPTIMIZATION_LEVEL": "3",
+          "LLVM_LTO": "YES"
+        },
+        "msvs_settings": {
+          "VCCLCompilerTool": {
+            "Optimization": 2,
+            "WholeProgramOptimization": "true"
+          },
+          "VCLinkerTool": {
+            "LinkTimeCodeGeneration": 1
+          }
+        }
+      }
+    },
+    "conditions": [
+      ["OS=='win'", {
+        "defines": ["_HAS_EXCEPTIONS=0"]
+      }]
+    ]
+  },
   "targets": [
     {
-      "target_name": "native-plugin-demo",
-      "sources": [
-        "examples/native-plugin/native-plugin-demo.c"
-      ],
-      "include_dirs": [
-        "<!@(node -p \"require('node-addon-api').include\")"
-      ],
-      "cflags!": ["-fno-exceptions"],
-      "cflags_cc!": ["-fno-exceptions"],
-      "defines": ["NAPI_DISABLE_CPP_EXCEPTIONS"],
-      "conditions": [
-        ["OS=='win'", {
-          "defines": ["_HAS_EXCEPTIONS=0"]
-        }]
-      ]
+      # Baseline: SSE2 on x64, NEON on arm64. Always built, and the loader's
+      # fallback when no variant matches the host CPU.
+      "target_name": "native-plugin-demo"
     }
+  ],
+  "conditions": [
+    # -march variants as separate .node files; native-plugin-loader.ts picks
+    # the best one the CPU supports. MSVC has no per-level equivalent.
+    ["target_arch=='x64' and OS!='win'", {
+      "targets": [
+        {
+          "target_name": "native-plugin-demo-x86-64-v2",
+          "cflags": ["-march=x86-64-v2"],
+          "xcode_settings": { "OTHER_CFLAGS": ["-march=x86-64-v2"] }
+        },
+        {
+          "target_name": "native-plugin-demo-x86-64-v3",
+          "cflags": ["-march=x86-64-v3"],
+          "xcode_settings": { "OTHER_CFLAGS": ["-march=x86-64-v3"] }
+        }
+      ]
+    }]
   ]
 }
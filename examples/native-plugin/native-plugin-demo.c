@@ -1,84 +1,2613 @@
 // native-plugin-demo.c - Native Bun Plugin Example
+//
+// onBeforeParse is exported through Bun's native bundler plugin C ABI, so
+// Bun calls it directly on a bundler thread and hands it the file contents
+// as a UTF-8 byte buffer. Nothing is copied or converted to a JS string:
+//
+//   build.onBeforeParse(
+//     { namespace: "file", filter: "**/*.{ts,tsx,js,jsx}" },
+//     { napiModule: loadNativePlugin().module, symbol: "onBeforeParse" },
+//   );
+//
+// loadNativePlugin() (native-plugin-loader.ts) picks the best -march build
+// binding.gyp produced for the host CPU.
+//
+// Register symbol "onBeforeParseTransform" instead to also rewrite sources.
+// NATIVE_PLUGIN_LOG=off|info|debug sets how much it prints, and
+// NATIVE_PLUGIN_TRACE=trace.json records each hook call per file and writes
+// a Chrome trace (Perfetto, chrome://tracing) at exit. The module exports
+// getStats(), setLogLevel(), setTrace() and prescan() for the JS side.
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <time.h>
 #include <node_api.h>
 
-// Global counter for tracking files
-static int file_count = 0;
+#ifndef _WIN32
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <process.h>
+#endif
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#if defined(__has_include)
+#if __has_include(<bun-native-bundler-plugin-api/bundler_plugin.h>)
+#include <bun-native-bundler-plugin-api/bundler_plugin.h>
+#define HAVE_BUN_PLUGIN_API 1
+#endif
+#endif
+
+#ifndef HAVE_BUN_PLUGIN_API
+// Bun native bundler plugin ABI (same layout as bundler_plugin.h)
+typedef enum {
+    BUN_LOADER_JSX = 0,
+    BUN_LOADER_JS = 1,
+    BUN_LOADER_TS = 2,
+    BUN_LOADER_TSX = 3,
+    BUN_LOADER_CSS = 4,
+    BUN_LOADER_FILE = 5,
+    BUN_LOADER_JSON = 6,
+    BUN_LOADER_TOML = 7,
+    BUN_LOADER_WASM = 8,
+    BUN_LOADER_NAPI = 9,
+    BUN_LOADER_BASE64 = 10,
+    BUN_LOADER_DATAURL = 11,
+    BUN_LOADER_TEXT = 12,
+} BunLoader;
+
+typedef enum {
+    BUN_LOG_LEVEL_VERBOSE = 0,
+    BUN_LOG_LEVEL_DEBUG = 1,
+    BUN_LOG_LEVEL_INFO = 2,
+    BUN_LOG_LEVEL_WARN = 3,
+    BUN_LOG_LEVEL_ERROR = 4,
+} BunLogLevel;
+
+typedef struct BunLogOptions {
+    size_t __struct_size;
+    const uint8_t* message_ptr;
+    size_t message_len;
+    const uint8_t* path_ptr;
+    size_t path_len;
+    const uint8_t* source_line_text_ptr;
+    size_t source_line_text_len;
+    int8_t level;
+    int line;
+    int lineEnd;
+    int column;
+    int columnEnd;
+} BunLogOptions;
+
+typedef struct {
+    size_t __struct_size;
+    void* bun;
+    const uint8_t* path_ptr;
+    size_t path_len;
+    const uint8_t* namespace_ptr;
+    size_t namespace_len;
+    uint8_t default_loader;
+    void* external;
+} OnBeforeParseArguments;
+
+typedef struct OnBeforeParseResult {
+    size_t __struct_size;
+    uint8_t* source_ptr;
+    size_t source_len;
+    uint8_t loader;
+    int (*fetchSourceCode)(const OnBeforeParseArguments* args, struct OnBeforeParseResult* result);
+    void* plugin_source_code_context;
+    void (*free_plugin_source_code_context)(void* ctx);
+    void (*log)(const OnBeforeParseArguments* args, BunLogOptions* options);
+} OnBeforeParseResult;
+#endif
+
+#ifndef BUN_PLUGIN_EXPORT
+#ifdef _WIN32
+#define BUN_PLUGIN_EXPORT __declspec(dllexport)
+#else
+#define BUN_PLUGIN_EXPORT __attribute__((visibility("default")))
+#endif
+#endif
+
+BUN_PLUGIN_EXPORT const char* BUN_PLUGIN_NAME = "native-plugin-demo";
+
+// ---------------------------------------------------------------------------
+// Statistics
+//
+// Bun calls onBeforeParse from several bundler threads at once. Each thread
+// claims its own cache-line-sized slot on first use and is the only writer
+// to it, so recording is a plain load/store with no shared line bouncing
+// between cores. getStats() sums the slots. Threads beyond
+// STATS_MAX_THREADS share the last slot with atomic adds.
+// ---------------------------------------------------------------------------
+
+#define STATS_MAX_THREADS 64
+
+typedef struct {
+    _Alignas(64) _Atomic uint64_t files;
+    _Atomic uint64_t bytes;
+    _Atomic uint64_t imports;
+    _Atomic uint64_t ns;
+    _Atomic uint64_t cache_hits;
+} StatSlot;
+
+static StatSlot g_stats[STATS_MAX_THREADS + 1];
+static _Atomic uint32_t g_stats_threads;
+static _Thread_local StatSlot* t_stats;
+
+static StatSlot* stats_slot(void) {
+    if (!t_stats) {
+        uint32_t i = atomic_fetch_add_explicit(&g_stats_threads, 1, memory_order_relaxed);
+        t_stats = &g_stats[i < STATS_MAX_THREADS ? i : STATS_MAX_THREADS];
+    }
+    return t_stats;
+}
+
+static void stat_add(StatSlot* slot, _Atomic uint64_t* field, uint64_t v) {
+    if (slot == &g_stats[STATS_MAX_THREADS]) {
+        atomic_fetch_add_explicit(field, v, memory_order_relaxed);
+    } else {
+        uint64_t cur = atomic_load_explicit(field, memory_order_relaxed);
+        atomic_store_explicit(field, cur + v, memory_order_relaxed);
+    }
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+#ifdef _WIN32
+    timespec_get(&ts, TIME_UTC);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Bounded substring search: Bun's buffers are not NUL-terminated
+static const uint8_t* find_bytes(const uint8_t* s, size_t len, const char* needle, size_t n) {
+    const uint8_t* end = s + len;
+    while (len >= n) {
+        const uint8_t* p = memchr(s, needle[0], len - n + 1);
+        if (!p) return NULL;
+        if (memcmp(p, needle, n) == 0) return p;
+        s = p + 1;
+        len = (size_t)(end - s);
+    }
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------
+// Tracing
+//
+// Opt-in per-file timeline of every hook call, written at process exit as
+// Chrome trace-event JSON for Perfetto / chrome://tracing. Each slice is
+// one file through one hook: wall and thread CPU time, the bytes it
+// processed, the imports or edits it produced and the heap calls it made.
+// Like the statistics, every thread appends to its own buffer (a chain of
+// fixed-size chunks it alone writes), publishing each event with a release
+// store of the chunk's count, so recording takes no lock and never touches
+// another thread's lines. The exit writer only reads published events.
+// While tracing is off the hooks pay one relaxed load.
+//
+// NATIVE_PLUGIN_TRACE=file enables it on first use; setTrace() changes it
+// at runtime. Events stay in memory until exit (TRACE_EVENT_BYTES each).
+// ---------------------------------------------------------------------------
+
+typedef enum {
+    TRACE_ON_BEFORE_PARSE,
+    TRACE_ON_BEFORE_PARSE_TRANSFORM,
+    TRACE_PRESCAN,
+} TraceHook;
+
+#define TRACE_CHUNK_EVENTS 256
+#define TRACE_EVENT_BYTES 256
+#define TRACE_PATH_MAX 192  // longer paths keep their tail
+
+typedef struct {
+    uint64_t begin;       // now_ns()
+    uint64_t end;
+    uint64_t cpu_begin;   // thread CPU clock, 0 if unknown
+    uint64_t cpu_ns;
+    uint64_t bytes;
+    uint32_t allocs;
+    uint32_t count;       // imports found, or edits applied
+    uint64_t alloc_bytes;
+    uint8_t hook;         // TraceHook
+    uint8_t cached;
+    uint16_t path_len;
+    char path[TRACE_PATH_MAX];
+} TraceEvent;
+
+_Static_assert(sizeof(TraceEvent) == TRACE_EVENT_BYTES, "keep trace events one size");
+
+typedef struct TraceChunk {
+    _Atomic(struct TraceChunk*) next;
+    _Atomic uint32_t count;  // events published in this chunk
+    TraceEvent events[TRACE_CHUNK_EVENTS];
+} TraceChunk;
+
+typedef struct TraceThread {
+    struct TraceThread* next;  // immutable once pushed
+    uint64_t tid;
+    uint32_t index;            // registration order, for the thread name
+    TraceChunk* head;
+    TraceChunk* tail;          // owner only
+} TraceThread;
+
+static _Atomic int g_trace_state = -1;       // -1: not yet read from NATIVE_PLUGIN_TRACE
+static _Atomic(char*) g_trace_path;          // NULL: no file to write
+static _Atomic(TraceThread*) g_trace_threads;
+static _Atomic uint32_t g_trace_thread_count;
+static _Atomic uint64_t g_trace_origin;      // ts 0 in the trace
+static atomic_flag g_trace_atexit = ATOMIC_FLAG_INIT;
+static _Thread_local TraceThread* t_trace;
+
+// Heap calls made through counted_realloc() on this thread; a hook's
+// allocations are the difference across its call
+static _Thread_local uint64_t t_allocs;
+static _Thread_local uint64_t t_alloc_bytes;
+
+static void* counted_realloc(void* p, size_t size) {
+    t_allocs++;
+    t_alloc_bytes += size;
+    return realloc(p, size);
+}
+
+static void trace_write_at_exit(void);
+
+// Start (path) or stop (NULL) recording. Replaced path strings are never
+// freed: the exit writer may be reading one.
+static void trace_configure(const char* path) {
+    char* copy = NULL;
+    if (path && *path) {
+        size_t len = strlen(path);
+        copy = malloc(len + 1);
+        if (copy) memcpy(copy, path, len + 1);
+    }
+    if (copy) {
+        uint64_t origin = 0;
+        atomic_compare_exchange_strong(&g_trace_origin, &origin, now_ns());
+        if (!atomic_flag_test_and_set(&g_trace_atexit)) atexit(trace_write_at_exit);
+    }
+    atomic_store_explicit(&g_trace_path, copy, memory_order_release);
+    atomic_store_explicit(&g_trace_state, copy != NULL, memory_order_relaxed);
+}
+
+// Like log_level(): the hooks may run without the napi Init
+static int trace_enabled(void) {
+    int state = atomic_load_explicit(&g_trace_state, memory_order_relaxed);
+    if (state < 0) {
+        trace_configure(getenv("NATIVE_PLUGIN_TRACE"));
+        state = atomic_load_explicit(&g_trace_state, memory_order_relaxed);
+    }
+    return state;
+}
+
+static uint64_t thread_cpu_ns(void) {
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) return 0;
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+static TraceThread* trace_thread(void) {
+    if (t_trace) return t_trace;
+    TraceThread* t = calloc(1, sizeof(TraceThread));
+    TraceChunk* c = calloc(1, sizeof(TraceChunk));
+    if (!t || !c) {
+        free(t);
+        free(c);
+        return NULL;
+    }
+    t->index = atomic_fetch_add_explicit(&g_trace_thread_count, 1, memory_order_relaxed);
+#if defined(__linux__)
+    t->tid = (uint64_t)syscall(SYS_gettid);
+#else
+    t->tid = t->index + 1;
+#endif
+    t->head = t->tail = c;
+    t->next = atomic_load_explicit(&g_trace_threads, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&g_trace_threads, &t->next, t, memory_order_release,
+                                                  memory_order_relaxed)) {
+    }
+    t_trace = t;
+    return t;
+}
+
+typedef struct {
+    int on;
+    uint64_t begin;
+    uint64_t cpu;
+    uint64_t allocs;
+    uint64_t alloc_bytes;
+} TraceSpan;
+
+static void trace_begin(TraceSpan* span) {
+    span->on = trace_enabled();
+    if (!span->on) return;
+    span->begin = now_ns();
+    span->cpu = thread_cpu_ns();
+    span->allocs = t_allocs;
+    span->alloc_bytes = t_alloc_bytes;
+}
+
+static void trace_end(const TraceSpan* span, TraceHook hook, const uint8_t* path, size_t path_len,
+                      uint64_t bytes, uint32_t count, int cached) {
+    if (!span->on) return;
+    uint64_t end = now_ns();
+    uint64_t cpu = thread_cpu_ns();
+    TraceThread* t = trace_thread();
+    if (!t) return;
+    TraceChunk* c = t->tail;
+    uint32_t n = atomic_load_explicit(&c->count, memory_order_relaxed);
+    if (n == TRACE_CHUNK_EVENTS) {
+        TraceChunk* next = calloc(1, sizeof(TraceChunk));
+        if (!next) return;
+        atomic_store_explicit(&c->next, next, memory_order_release);
+        t->tail = c = next;
+        n = 0;
+    }
+
+    TraceEvent* e = &c->events[n];
+    e->begin = span->begin;
+    e->end = end;
+    e->cpu_begin = span->cpu;
+    e->cpu_ns = span->cpu && cpu >= span->cpu ? cpu - span->cpu : 0;
+    e->bytes = bytes;
+    e->allocs = (uint32_t)(t_allocs - span->allocs);
+    e->alloc_bytes = t_alloc_bytes - span->alloc_bytes;
+    e->count = count;
+    e->hook = (uint8_t)hook;
+    e->cached = (uint8_t)cached;
+    // Keep the file name end; never start inside a UTF-8 sequence
+    size_t skip = path_len > TRACE_PATH_MAX ? path_len - TRACE_PATH_MAX : 0;
+    while (skip < path_len && (path[skip] & 0xC0) == 0x80) skip++;
+    e->path_len = (uint16_t)(path_len - skip);
+    if (e->path_len) memcpy(e->path, path + skip, e->path_len);
+    atomic_store_explicit(&c->count, n + 1, memory_order_release);
+}
+
+static void trace_json_string(FILE* f, const char* s, size_t len) {
+    fputc('"', f);
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '"' || c == '\\') {
+            fputc('\\', f);
+            fputc(c, f);
+        } else if (c < 0x20) {
+            fprintf(f, "\\u%04x", c);
+        } else {
+            fputc(c, f);
+        }
+    }
+    fputc('"', f);
+}
+
+/**
+ * Write every published event to `path` as Chrome trace-event JSON
+ *
+ * @returns number of events written, or -1 if the file cannot be written
+ */
+static int64_t trace_write(const char* path) {
+    static const char* const k_hook_names[] = { "onBeforeParse", "onBeforeParseTransform", "prescan" };
+    FILE* f = fopen(path, "w");
+    if (!f) return -1;
+#ifdef _WIN32
+    unsigned long pid = (unsigned long)_getpid();
+#else
+    unsigned long pid = (unsigned long)getpid();
+#endif
+    uint64_t origin = atomic_load_explicit(&g_trace_origin, memory_order_relaxed);
+    int64_t events = 0;
+    const char* sep = "";
+
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", f);
+    fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%lu,\"tid\":0,\"args\":{\"name\":\"%s\"}}",
+            pid, BUN_PLUGIN_NAME);
+    sep = ",\n";
+    for (TraceThread* t = atomic_load_explicit(&g_trace_threads, memory_order_acquire); t; t = t->next) {
+        fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%lu,\"tid\":%llu,"
+                   "\"args\":{\"name\":\"plugin thread %u\"}}",
+                sep, pid, (unsigned long long)t->tid, (unsigned)t->index);
+        for (TraceChunk* c = t->head; c; c = atomic_load_explicit(&c->next, memory_order_acquire)) {
+            uint32_t n = atomic_load_explicit(&c->count, memory_order_acquire);
+            for (uint32_t i = 0; i < n; i++) {
+                const TraceEvent* e = &c->events[i];
+                uint64_t ts = e->begin > origin ? e->begin - origin : 0;
+                fputs(",\n{\"name\":", f);
+                trace_json_string(f, e->path, e->path_len);
+                fprintf(f, ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":%lu,\"tid\":%llu,\"ts\":%.3f,\"dur\":%.3f",
+                        k_hook_names[e->hook], pid, (unsigned long long)t->tid, ts / 1e3,
+                        (e->end - e->begin) / 1e3);
+                if (e->cpu_begin) fprintf(f, ",\"tts\":%.3f,\"tdur\":%.3f", e->cpu_begin / 1e3, e->cpu_ns / 1e3);
+                fprintf(f, ",\"args\":{\"bytes\":%llu,\"%s\":%u,\"allocs\":%u,\"allocBytes\":%llu,\"cached\":%s}}",
+                        (unsigned long long)e->bytes, e->hook == TRACE_ON_BEFORE_PARSE_TRANSFORM ? "edits" : "imports",
+                        (unsigned)e->count, (unsigned)e->allocs, (unsigned long long)e->alloc_bytes,
+                        e->cached ? "true" : "false");
+                events++;
+            }
+        }
+    }
+    fputs("\n]}\n", f);
+    return fclose(f) == 0 ? events : -1;
+}
+
+static void trace_write_at_exit(void) {
+    const char* path = atomic_load_explicit(&g_trace_path, memory_order_acquire);
+    if (path && trace_write(path) < 0) fprintf(stderr, "native-plugin-demo: cannot write trace to %s\n", path);
+}
+
+// ---------------------------------------------------------------------------
+// File kinds
+//
+// Only the final extension counts, so "a.ts.map", "a.tsx" and "/foo.ts/x"
+// are told apart without scanning the path. Up to four extension bytes are
+// packed little-endian into a key (lowercased) and looked up in a 16-slot
+// table indexed by a multiplicative hash; EXT_SLOT places all ten kinds
+// without collisions, and a collision added later shows up as an
+// override-init warning on the table below.
+// ---------------------------------------------------------------------------
+
+typedef enum {
+    FILE_KIND_OTHER,
+    FILE_KIND_TS,
+    FILE_KIND_TSX,
+    FILE_KIND_MTS,
+    FILE_KIND_CTS,
+    FILE_KIND_JS,
+    FILE_KIND_JSX,
+    FILE_KIND_MJS,
+    FILE_KIND_CJS,
+    FILE_KIND_JSON,
+    FILE_KIND_CSS,
+} FileKind;
+
+#define EXT_KEY(a, b, c, d) \
+    ((uint32_t)(uint8_t)(a) | (uint32_t)(uint8_t)(b) << 8 | (uint32_t)(uint8_t)(c) << 16 | (uint32_t)(uint8_t)(d) << 24)
+#define EXT_SLOT(key) ((uint32_t)((key) * 0x9E3779B1u) >> 28)
+#define EXT_ENTRY(a, b, c, d, kind) [EXT_SLOT(EXT_KEY(a, b, c, d))] = { EXT_KEY(a, b, c, d), kind }
+
+static const struct {
+    uint32_t key;
+    uint8_t kind;
+} k_ext_table[16] = {
+    EXT_ENTRY('t', 's', 0, 0, FILE_KIND_TS),
+    EXT_ENTRY('t', 's', 'x', 0, FILE_KIND_TSX),
+    EXT_ENTRY('m', 't', 's', 0, FILE_KIND_MTS),
+    EXT_ENTRY('c', 't', 's', 0, FILE_KIND_CTS),
+    EXT_ENTRY('j', 's', 0, 0, FILE_KIND_JS),
+    EXT_ENTRY('j', 's', 'x', 0, FILE_KIND_JSX),
+    EXT_ENTRY('m', 'j', 's', 0, FILE_KIND_MJS),
+    EXT_ENTRY('c', 'j', 's', 0, FILE_KIND_CJS),
+    EXT_ENTRY('j', 's', 'o', 'n', FILE_KIND_JSON),
+    EXT_ENTRY('c', 's', 's', 0, FILE_KIND_CSS),
+};
+
+static FileKind classify_path(const uint8_t* path, size_t len) {
+    // Walk back at most five bytes: ".json" is the longest extension
+    size_t dot = len;
+    for (size_t i = len; i > 0 && len - i < 5; i--) {
+        uint8_t c = path[i - 1];
+        if (c == '.') {
+            dot = i - 1;
+            break;
+        }
+        if (c == '/' || c == '\\') break;
+    }
+    size_t ext_len = len - dot;
+    if (ext_len < 2 || dot == 0 || path[dot - 1] == '/' || path[dot - 1] == '\\') return FILE_KIND_OTHER;
+
+    uint32_t key = 0;
+    for (size_t i = 1; i < ext_len; i++) {
+        uint8_t c = path[dot + i];
+        if (c >= 'A' && c <= 'Z') c |= 0x20;
+        key |= (uint32_t)c << (8 * (i - 1));
+    }
+    uint32_t slot = EXT_SLOT(key);
+    return k_ext_table[slot].key == key ? (FileKind)k_ext_table[slot].kind : FILE_KIND_OTHER;
+}
+
+static int kind_is_typescript(FileKind kind) {
+    return kind >= FILE_KIND_TS && kind <= FILE_KIND_CTS;
+}
+
+static int kind_is_javascript(FileKind kind) {
+    return kind >= FILE_KIND_JS && kind <= FILE_KIND_CJS;
+}
+
+// ---------------------------------------------------------------------------
+// Import scanner
+//
+// A single forward pass over the UTF-8 source that skips comments, string
+// literals, template literals (with nested ${} expressions) and regex
+// literals, so "import" inside any of them never counts. Plain code is
+// skipped 16 bytes at a time up to the next byte that can start one of
+// those or an import/export/require keyword.
+// ---------------------------------------------------------------------------
+
+typedef enum {
+    IMPORT_STATIC,   // import x from "x", import "x"
+    IMPORT_DYNAMIC,  // import("x")
+    EXPORT_FROM,     // export { x } from "x", export * from "x"
+    REQUIRE_CALL,    // require("x")
+} ImportKind;
+
+typedef struct {
+    uint32_t off;     // specifier bytes without quotes, escapes left as-is
+    uint32_t len;
+    uint8_t kind;     // ImportKind
+    uint8_t escaped;  // specifier contains a backslash escape
+} ImportSpec;
+
+typedef struct {
+    ImportSpec* items;
+    uint32_t count;
+    uint32_t cap;
+} ImportList;
+
+#define TEMPLATE_MAX_DEPTH 32
+
+typedef struct {
+    const uint8_t* s;
+    size_t len;
+    size_t code_start;    // first byte after the last literal or comment
+    int prev_value;       // that literal ended an expression
+    uint32_t depth;       // brace depth
+    uint32_t tmpl[TEMPLATE_MAX_DEPTH];  // brace depth at each open ${
+    uint32_t tmpl_count;
+    ImportList* out;
+    int oom;
+} Lexer;
+
+static void import_list_free(ImportList* list) {
+    free(list->items);
+    list->items = NULL;
+    list->count = list->cap = 0;
+}
+
+static void import_list_push(Lexer* lx, ImportKind kind, size_t off, size_t len, int escaped) {
+    ImportList* list = lx->out;
+    if (list->count == list->cap) {
+        uint32_t cap = list->cap ? list->cap * 2 : 16;
+        ImportSpec* items = counted_realloc(list->items, cap * sizeof(ImportSpec));
+        if (!items) {
+            lx->oom = 1;
+            return;
+        }
+        list->items = items;
+        list->cap = cap;
+    }
+    ImportSpec* spec = &list->items[list->count++];
+    spec->off = (uint32_t)off;
+    spec->len = (uint32_t)len;
+    spec->kind = (uint8_t)kind;
+    spec->escaped = (uint8_t)escaped;
+}
+
+static int is_ident(uint8_t c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+           c == '_' || c == '$' || c >= 0x80;
+}
+
+static int is_space(uint8_t c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Bytes that may start a literal, a comment, a brace or a keyword we want
+static const uint8_t k_special[256] = {
+    ['\''] = 1, ['"'] = 1, ['`'] = 1, ['/'] = 1, ['{'] = 1, ['}'] = 1,
+    ['i'] = 1, ['e'] = 1, ['r'] = 1,
+};
+
+static size_t next_special(const uint8_t* s, size_t i, size_t len) {
+#if defined(__AVX2__)
+    // The x86-64-v3 build: 32 bytes per step, then the SSE2 loop below
+    // finishes a 16-byte remainder
+    const __m256i w_q1 = _mm256_set1_epi8('\''), w_q2 = _mm256_set1_epi8('"'), w_q3 = _mm256_set1_epi8('`');
+    const __m256i w_sl = _mm256_set1_epi8('/'), w_lb = _mm256_set1_epi8('{'), w_rb = _mm256_set1_epi8('}');
+    const __m256i w_ki = _mm256_set1_epi8('i'), w_ke = _mm256_set1_epi8('e'), w_kr = _mm256_set1_epi8('r');
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(s + i));
+        __m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, w_q1), _mm256_cmpeq_epi8(v, w_q2)),
+                                    _mm256_or_si256(_mm256_cmpeq_epi8(v, w_q3), _mm256_cmpeq_epi8(v, w_sl)));
+        m = _mm256_or_si256(m, _mm256_or_si256(_mm256_cmpeq_epi8(v, w_lb), _mm256_cmpeq_epi8(v, w_rb)));
+        m = _mm256_or_si256(m, _mm256_or_si256(_mm256_cmpeq_epi8(v, w_ki),
+                                               _mm256_or_si256(_mm256_cmpeq_epi8(v, w_ke), _mm256_cmpeq_epi8(v, w_kr))));
+        uint32_t bits = (uint32_t)_mm256_movemask_epi8(m);
+        if (bits) return i + (size_t)__builtin_ctz(bits);
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i q1 = _mm_set1_epi8('\''), q2 = _mm_set1_epi8('"'), q3 = _mm_set1_epi8('`');
+    const __m128i sl = _mm_set1_epi8('/'), lb = _mm_set1_epi8('{'), rb = _mm_set1_epi8('}');
+    const __m128i ki = _mm_set1_epi8('i'), ke = _mm_set1_epi8('e'), kr = _mm_set1_epi8('r');
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+        __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, q1), _mm_cmpeq_epi8(v, q2)),
+                                 _mm_or_si128(_mm_cmpeq_epi8(v, q3), _mm_cmpeq_epi8(v, sl)));
+        m = _mm_or_si128(m, _mm_or_si128(_mm_cmpeq_epi8(v, lb), _mm_cmpeq_epi8(v, rb)));
+        m = _mm_or_si128(m, _mm_or_si128(_mm_cmpeq_epi8(v, ki),
+                                         _mm_or_si128(_mm_cmpeq_epi8(v, ke), _mm_cmpeq_epi8(v, kr))));
+        int bits = _mm_movemask_epi8(m);
+        if (bits) return i + (size_t)__builtin_ctz((unsigned)bits);
+    }
+#elif defined(__ARM_NEON)
+    static const char k_set[9] = { '\'', '"', '`', '/', '{', '}', 'i', 'e', 'r' };
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t v = vld1q_u8(s + i);
+        uint8x16_t m = vceqq_u8(v, vdupq_n_u8((uint8_t)k_set[0]));
+        for (int k = 1; k < 9; k++) m = vorrq_u8(m, vceqq_u8(v, vdupq_n_u8((uint8_t)k_set[k])));
+        if (vmaxvq_u8(m)) break;  // the scalar loop below pins the byte
+    }
+#endif
+    while (i < len && !k_special[s[i]]) i++;
+    return i;
+}
+
+// Skip whitespace and comments; returns the next significant byte or len
+static size_t skip_trivia(const Lexer* lx, size_t i) {
+    const uint8_t* s = lx->s;
+    while (i < lx->len) {
+        if (is_space(s[i])) {
+            i++;
+        } else if (s[i] == '/' && i + 1 < lx->len && s[i + 1] == '/') {
+            const uint8_t* nl = memchr(s + i, '\n', lx->len - i);
+            i = nl ? (size_t)(nl - s) + 1 : lx->len;
+        } else if (s[i] == '/' && i + 1 < lx->len && s[i + 1] == '*') {
+            const uint8_t* end = find_bytes(s + i + 2, lx->len - i - 2, "*/", 2);
+            i = end ? (size_t)(end - s) + 2 : lx->len;
+        } else {
+            break;
+        }
+    }
+    return i;
+}
+
+// String literal at s[i] (a quote). Returns the index after the closing
+// quote, or 0 if the literal is unterminated on its line.
+static size_t read_string(const Lexer* lx, size_t i, size_t* body, size_t* body_len, int* escaped) {
+    const uint8_t* s = lx->s;
+    uint8_t quote = s[i++];
+    *body = i;
+    *escaped = 0;
+    while (i < lx->len) {
+        uint8_t c = s[i];
+        if (c == quote) {
+            *body_len = i - *body;
+            return i + 1;
+        }
+        if (c == '\\') {
+            *escaped = 1;
+            i += 2;
+        } else if (c == '\n' && quote != '`') {
+            return 0;
+        } else if (c == '$' && quote == '`' && i + 1 < lx->len && s[i + 1] == '{') {
+            return 0;  // not a plain specifier
+        } else {
+            i++;
+        }
+    }
+    return 0;
+}
+
+static size_t read_word(const Lexer* lx, size_t i) {
+    while (i < lx->len && is_ident(lx->s[i])) i++;
+    return i;
+}
+
+static int word_is(const Lexer* lx, size_t i, size_t end, const char* w) {
+    size_t n = strlen(w);
+    return end - i == n && memcmp(lx->s + i, w, n) == 0;
+}
+
+// Template body from i (just after ` or after the } closing a ${...}).
+// Returns where code resumes.
+static size_t skip_template(Lexer* lx, size_t i) {
+    const uint8_t* s = lx->s;
+    while (i < lx->len) {
+        uint8_t c = s[i];
+        if (c == '\\') {
+            i += 2;
+        } else if (c == '`') {
+            lx->prev_value = 1;
+            return i + 1;
+        } else if (c == '$' && i + 1 < lx->len && s[i + 1] == '{' && lx->tmpl_count < TEMPLATE_MAX_DEPTH) {
+            lx->tmpl[lx->tmpl_count++] = lx->depth;
+            lx->prev_value = 0;
+            return i + 2;
+        } else {
+            i++;
+        }
+    }
+    return lx->len;
+}
+
+// Regex literal at s[i]; returns the index after its flags, or 0 if the
+// line ends first (then it was a division after all)
+static size_t skip_regex(const Lexer* lx, size_t i) {
+    const uint8_t* s = lx->s;
+    int in_class = 0;
+    for (i++; i < lx->len; i++) {
+        uint8_t c = s[i];
+        if (c == '\\') {
+            i++;
+        } else if (c == '\n') {
+            return 0;
+        } else if (c == '[') {
+            in_class = 1;
+        } else if (c == ']') {
+            in_class = 0;
+        } else if (c == '/' && !in_class) {
+            return read_word(lx, i + 1);
+        }
+    }
+    return 0;
+}
+
+// A '/' starts a regex unless it follows something that ends an expression
+static int regex_allowed(const Lexer* lx, size_t slash) {
+    static const char* const k_before_regex[] = {
+        "return", "typeof", "instanceof", "in", "of", "new", "delete", "void",
+        "throw", "case", "do", "else", "yield", "await",
+    };
+    const uint8_t* s = lx->s;
+    size_t i = slash;
+    while (i > lx->code_start && is_space(s[i - 1])) i--;
+    if (i == lx->code_start) return !lx->prev_value;
+    uint8_t c = s[i - 1];
+    if (c == ')' || c == ']' || c == '}') return 0;
+    if (!is_ident(c)) return 1;
+    size_t end = i;
+    while (i > lx->code_start && is_ident(s[i - 1])) i--;
+    for (size_t k = 0; k < sizeof(k_before_regex) / sizeof(k_before_regex[0]); k++) {
+        if (word_is(lx, i, end, k_before_regex[k])) return 1;
+    }
+    return 0;
+}
+
+// import/export clause up to `from "x"`: identifiers, braces, commas, *.
+// Returns the index after the specifier, or 0 if this is no such clause.
+static size_t read_from_clause(Lexer* lx, size_t i, ImportKind kind) {
+    for (;;) {
+        i = skip_trivia(lx, i);
+        if (i >= lx->len) return 0;
+        uint8_t c = lx->s[i];
+        if (c == '{' || c == '}' || c == ',' || c == '*') {
+            i++;
+        } else if (is_ident(c)) {
+            size_t end = read_word(lx, i);
+            if (word_is(lx, i, end, "from")) {
+                size_t q = skip_trivia(lx, end);
+                if (q < lx->len && (lx->s[q] == '"' || lx->s[q] == '\'')) {
+                    size_t body, body_len;
+                    int escaped;
+                    size_t after = read_string(lx, q, &body, &body_len, &escaped);
+                    if (!after) return 0;
+                    import_list_push(lx, kind, body, body_len, escaped);
+                    return after;
+                }
+            }
+            i = end;
+        } else {
+            return 0;
+        }
+    }
+}
+
+// ( "x" ) after import / require. Returns the index after the specifier.
+static size_t read_call_specifier(Lexer* lx, size_t i, ImportKind kind) {
+    i = skip_trivia(lx, i);
+    if (i >= lx->len || lx->s[i] != '(') return 0;
+    i = skip_trivia(lx, i + 1);
+    if (i >= lx->len || (lx->s[i] != '"' && lx->s[i] != '\'' && lx->s[i] != '`')) return 0;
+    size_t body, body_len;
+    int escaped;
+    size_t after = read_string(lx, i, &body, &body_len, &escaped);
+    if (!after) return 0;
+    size_t close = skip_trivia(lx, after);
+    if (close >= lx->len || (lx->s[close] != ')' && lx->s[close] != ',')) return 0;
+    import_list_push(lx, kind, body, body_len, escaped);
+    return after;
+}
+
+// Word starting at i (already known not to continue an identifier)
+static size_t scan_keyword(Lexer* lx, size_t i) {
+    size_t end = read_word(lx, i);
+    if (i > 0 && lx->s[i - 1] == '.') return end;  // obj.import / obj.require
+    size_t after = 0;
+    if (word_is(lx, i, end, "import")) {
+        size_t next = skip_trivia(lx, end);
+        if (next < lx->len && lx->s[next] == '(') {
+            after = read_call_specifier(lx, next, IMPORT_DYNAMIC);
+        } else if (next < lx->len && (lx->s[next] == '"' || lx->s[next] == '\'')) {
+            size_t body, body_len;
+            int escaped;
+            after = read_string(lx, next, &body, &body_len, &escaped);
+            if (after) import_list_push(lx, IMPORT_STATIC, body, body_len, escaped);
+        } else if (next < lx->len && lx->s[next] != '.') {
+            after = read_from_clause(lx, next, IMPORT_STATIC);
+        }
+    } else if (word_is(lx, i, end, "export")) {
+        size_t next = skip_trivia(lx, end);
+        size_t word_end = read_word(lx, next);
+        if (next < lx->len && (lx->s[next] == '*' || lx->s[next] == '{' || word_is(lx, next, word_end, "type"))) {
+            after = read_from_clause(lx, next, EXPORT_FROM);
+        }
+    } else if (word_is(lx, i, end, "require")) {
+        after = read_call_specifier(lx, end, REQUIRE_CALL);
+    }
+    if (!after) return end;
+    lx->code_start = after;
+    lx->prev_value = 1;
+    return after;
+}
+
+/**
+ * Collect every module specifier in `src` with its byte span
+ *
+ * @returns 0, or -1 if the list could not grow (it holds what was found)
+ */
+static int scan_imports(const uint8_t* src, size_t len, ImportList* out) {
+    Lexer lx = { 0 };
+    lx.s = src;
+    lx.len = len;
+    lx.out = out;
+
+    size_t i = 0;
+    if (len >= 2 && src[0] == '#' && src[1] == '!') {  // shebang
+        const uint8_t* nl = memchr(src, '\n', len);
+        i = nl ? (size_t)(nl - src) : len;
+    }
+
+    while (i < len && !lx.oom) {
+        i = next_special(src, i, len);
+        if (i >= len) break;
+        uint8_t c = src[i];
+        size_t end;
+        switch (c) {
+        case '\'':
+        case '"': {
+            size_t body, body_len;
+            int escaped;
+            end = read_string(&lx, i, &body, &body_len, &escaped);
+            if (!end) {
+                // Unterminated: resume on the next line
+                const uint8_t* nl = memchr(src + i + 1, '\n', len - i - 1);
+                end = nl ? (size_t)(nl - src) : len;
+            }
+            i = lx.code_start = end;
+            lx.prev_value = 1;
+            break;
+        }
+        case '`':
+            i = lx.code_start = skip_template(&lx, i + 1);
+            break;
+        case '/':
+            if (i + 1 < len && (src[i + 1] == '/' || src[i + 1] == '*')) {
+                i = lx.code_start = skip_trivia(&lx, i);
+            } else if (regex_allowed(&lx, i) && (end = skip_regex(&lx, i)) != 0) {
+                i = lx.code_start = end;
+                lx.prev_value = 1;
+            } else {
+                i++;
+            }
+            break;
+        case '{':
+            lx.depth++;
+            i++;
+            break;
+        case '}':
+            if (lx.tmpl_count && lx.tmpl[lx.tmpl_count - 1] == lx.depth) {
+                lx.tmpl_count--;
+                i = lx.code_start = skip_template(&lx, i + 1);
+            } else {
+                if (lx.depth) lx.depth--;
+                i++;
+            }
+            break;
+        default:  // i, e, r
+            if (i > 0 && is_ident(src[i - 1])) {
+                i = read_word(&lx, i);  // inside an identifier
+            } else {
+                i = scan_keyword(&lx, i);
+            }
+            break;
+        }
+    }
+    return lx.oom ? -1 : 0;
+}
+
+// CSS only has @import "x" / @import url(x); comments and strings are
+// skipped the same way as in JS
+static int scan_css_imports(const uint8_t* src, size_t len, ImportList* out) {
+    Lexer lx = { 0 };
+    lx.s = src;
+    lx.len = len;
+    lx.out = out;
+
+    size_t i = 0;
+    while (i < len && !lx.oom) {
+        uint8_t c = src[i];
+        size_t body, body_len;
+        int escaped;
+        if (c == '/' && i + 1 < len && src[i + 1] == '*') {
+            i = skip_trivia(&lx, i);
+        } else if (c == '"' || c == '\'') {
+            size_t end = read_string(&lx, i, &body, &body_len, &escaped);
+            i = end ? end : i + 1;
+        } else if (c == '@' && len - i >= 7 && memcmp(src + i, "@import", 7) == 0) {
+            i = skip_trivia(&lx, i + 7);
+            if (i < len && (src[i] == '"' || src[i] == '\'')) {
+                size_t end = read_string(&lx, i, &body, &body_len, &escaped);
+                if (end) import_list_push(&lx, IMPORT_STATIC, body, body_len, escaped);
+                i = end ? end : i + 1;
+            } else if (len - i >= 4 && memcmp(src + i, "url(", 4) == 0) {
+                i = skip_trivia(&lx, i + 4);
+                if (i < len && (src[i] == '"' || src[i] == '\'')) {
+                    size_t end = read_string(&lx, i, &body, &body_len, &escaped);
+                    if (end) import_list_push(&lx, IMPORT_STATIC, body, body_len, escaped);
+                    i = end ? end : i + 1;
+                } else {
+                    size_t start = i;
+                    while (i < len && src[i] != ')' && !is_space(src[i])) i++;
+                    if (i > start) import_list_push(&lx, IMPORT_STATIC, start, i - start, 0);
+                }
+            }
+        } else {
+            i++;
+        }
+    }
+    return lx.oom ? -1 : 0;
+}
+
+// Pick the scanner for the file kind: JSON has no imports, and unknown
+// extensions get the JS lexer since Bun may route them through a JS loader
+static int scan_file(FileKind kind, const uint8_t* src, size_t len, ImportList* out) {
+    switch (kind) {
+    case FILE_KIND_JSON:
+        return 0;
+    case FILE_KIND_CSS:
+        return scan_css_imports(src, len, out);
+    default:
+        return scan_imports(src, len, out);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Scan cache
+//
+// Scan results survive across builds in a memory-mapped file shared by every
+// process that loads the plugin. Keys are a hash of path + content, and
+// since the content is identical on a hit the cached spans still point at
+// the right bytes. The table is open-addressed and insert-only: a writer
+// reserves blob space and an empty slot, fills the entry, then publishes
+// the key with a release store. When the file fills up, the next process
+// to open it writes a fresh one and renames it into place; processes still
+// mapping the old inode keep using it undisturbed.
+//
+// NATIVE_PLUGIN_CACHE overrides the file path; an empty value disables it.
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    const ImportSpec* items;
+    uint32_t count;
+    uint32_t kind;  // FileKind
+} ScanResult;
+
+// 4-lane multiply-rotate hash (xxh64 structure): lanes are independent so
+// large files hash at memory speed rather than one multiply per 8 bytes
+static uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t load64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint64_t hash_content(const uint8_t* p, size_t len, uint64_t seed) {
+    const uint64_t p1 = 0x9E3779B185EBCA87ull, p2 = 0xC2B2AE3D27D4EB4Full;
+    const uint64_t p3 = 0x165667B19E3779F9ull, p4 = 0x85EBCA77C2B2AE63ull;
+    uint64_t h;
+    size_t i = 0;
+    if (len >= 32) {
+        uint64_t a = seed + p1 + p2, b = seed + p2, c = seed, d = seed - p1;
+        for (; i + 32 <= len; i += 32) {
+            a = rotl64(a + load64(p + i) * p2, 31) * p1;
+            b = rotl64(b + load64(p + i + 8) * p2, 31) * p1;
+            c = rotl64(c + load64(p + i + 16) * p2, 31) * p1;
+            d = rotl64(d + load64(p + i + 24) * p2, 31) * p1;
+        }
+        h = rotl64(a, 1) + rotl64(b, 7) + rotl64(c, 12) + rotl64(d, 18);
+        h = (h ^ rotl64(a * p2, 31) * p1) * p1 + p4;
+        h = (h ^ rotl64(b * p2, 31) * p1) * p1 + p4;
+        h = (h ^ rotl64(c * p2, 31) * p1) * p1 + p4;
+        h = (h ^ rotl64(d * p2, 31) * p1) * p1 + p4;
+    } else {
+        h = seed + p3;
+    }
+    h += (uint64_t)len;
+    for (; i + 8 <= len; i += 8) {
+        h ^= rotl64(load64(p + i) * p2, 31) * p1;
+        h = rotl64(h, 27) * p1 + p4;
+    }
+    if (i < len) {
+        uint64_t t = 0;
+        memcpy(&t, p + i, len - i);
+        h ^= t * p3;
+        h = rotl64(h, 23) * p2;
+    }
+    h ^= h >> 33;
+    h *= p2;
+    h ^= h >> 29;
+    h *= p3;
+    h ^= h >> 32;
+    return h;
+}
+
+#define CACHE_VERSION 2
+#define CACHE_SLOTS (1u << 16)             // power of two
+#define CACHE_BLOB_BYTES (16u << 20)
+#define CACHE_MAX_PROBES 16
+#define CACHE_KEY_EMPTY 0
+#define CACHE_KEY_BUSY 1
+
+typedef struct {
+    char magic[8];                 // "BUNNPC1"
+    uint32_t version;
+    uint32_t slot_count;
+    uint64_t blob_cap;
+    _Atomic uint64_t blob_used;
+    _Atomic uint32_t slots_used;
+    uint8_t reserved[28];
+} CacheHeader;                     // 64 bytes; entries follow, then the blob
+
+typedef struct {
+    _Atomic uint64_t key;          // CACHE_KEY_EMPTY, CACHE_KEY_BUSY or a hash
+    uint32_t content_len;          // low 32 bits, a second check on hits
+    uint32_t blob_off;             // ImportSpec array, 4-byte aligned
+    uint32_t count;
+    uint32_t kind;
+} CacheEntry;
+
+typedef struct {
+    CacheHeader* header;
+    CacheEntry* entries;
+    uint8_t* blob;
+} ScanCache;
+
+static ScanCache g_cache;
+
+static uint64_t cache_key(const uint8_t* path, size_t path_len, const uint8_t* content, size_t content_len) {
+    uint64_t h = hash_content(content, content_len, hash_content(path, path_len, 0));
+    return h <= CACHE_KEY_BUSY ? h + 2 : h;
+}
+
+#ifndef _WIN32
+static size_t cache_file_size(void) {
+    return sizeof(CacheHeader) + (size_t)CACHE_SLOTS * sizeof(CacheEntry) + CACHE_BLOB_BYTES;
+}
+
+static int cache_header_ok(const CacheHeader* h) {
+    return memcmp(h->magic, "BUNNPC1", 8) == 0 && h->version == CACHE_VERSION &&
+           h->slot_count == CACHE_SLOTS && h->blob_cap == CACHE_BLOB_BYTES &&
+           atomic_load_explicit(&h->slots_used, memory_order_relaxed) < CACHE_SLOTS / 4 * 3 &&
+           atomic_load_explicit(&h->blob_used, memory_order_relaxed) < CACHE_BLOB_BYTES / 8 * 7;
+}
+
+// Write an empty table next to `path` and rename it over the old one
+static int cache_create(const char* path) {
+    char tmp[4096];
+    if (snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", path, (long)getpid()) >= (int)sizeof(tmp)) return -1;
+    int fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+    CacheHeader h = { .magic = "BUNNPC1", .version = CACHE_VERSION,
+                      .slot_count = CACHE_SLOTS, .blob_cap = CACHE_BLOB_BYTES };
+    // Sparse file: only the header is written, the rest reads as zeroes
+    int ok = ftruncate(fd, (off_t)cache_file_size()) == 0 &&
+             pwrite(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h);
+    close(fd);
+    if (!ok || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+static void* cache_map(const char* path) {
+    int fd = open(path, O_RDWR);
+    if (fd < 0) return NULL;
+    struct stat st;
+    void* base = NULL;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size == cache_file_size()) {
+        base = mmap(NULL, cache_file_size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED) base = NULL;
+    }
+    close(fd);
+    if (base && !cache_header_ok(base)) {
+        munmap(base, cache_file_size());
+        base = NULL;
+    }
+    return base;
+}
+
+static void cache_open(void) {
+    const char* path = getenv("NATIVE_PLUGIN_CACHE");
+    if (!path) {
+        path = "node_modules/.cache/native-plugin-demo.bin";
+        mkdir("node_modules/.cache", 0755);  // fails harmlessly without node_modules
+    }
+    if (!*path) return;
+
+    void* base = cache_map(path);
+    if (!base && cache_create(path) == 0) base = cache_map(path);
+    if (!base) return;  // run uncached
+
+    g_cache.header = base;
+    g_cache.entries = (CacheEntry*)((uint8_t*)base + sizeof(CacheHeader));
+    g_cache.blob = (uint8_t*)(g_cache.entries + CACHE_SLOTS);
+}
+#endif
+
+static int cache_ready(void) {
+#ifndef _WIN32
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, cache_open);
+#endif
+    return g_cache.header != NULL;
+}
+
+// The file is shared with every build process that can write the project
+// tree, so a hit is only trusted once everything the callers read through
+// it (content + off for len bytes, the kind tables) is inside its bounds.
+// Published entries are never rewritten, so the check holds afterwards.
+static int cache_entry_valid(const CacheEntry* e, size_t content_len) {
+    if (e->kind > FILE_KIND_CSS || e->blob_off % 4) return 0;
+    if ((uint64_t)e->blob_off + (uint64_t)e->count * sizeof(ImportSpec) > CACHE_BLOB_BYTES) return 0;
+    const ImportSpec* items = (const ImportSpec*)(g_cache.blob + e->blob_off);
+    for (uint32_t i = 0; i < e->count; i++) {
+        if (items[i].kind > REQUIRE_CALL || (uint64_t)items[i].off + items[i].len > content_len) return 0;
+    }
+    return 1;
+}
+
+static int cache_lookup(uint64_t key, size_t content_len, ScanResult* out) {
+    if (!cache_ready()) return 0;
+    for (uint32_t probe = 0; probe < CACHE_MAX_PROBES; probe++) {
+        const CacheEntry* e = &g_cache.entries[(key + probe) & (CACHE_SLOTS - 1)];
+        uint64_t k = atomic_load_explicit(&e->key, memory_order_acquire);
+        if (k == CACHE_KEY_EMPTY) return 0;
+        if (k != key || e->content_len != (uint32_t)content_len) continue;
+        if (!cache_entry_valid(e, content_len)) return 0;  // stale or corrupted: rescan
+        out->items = (const ImportSpec*)(g_cache.blob + e->blob_off);
+        out->count = e->count;
+        out->kind = e->kind;
+        return 1;
+    }
+    return 0;
+}
+
+static void cache_insert(uint64_t key, size_t content_len, const ScanResult* r) {
+    if (!cache_ready()) return;
+    CacheHeader* h = g_cache.header;
+    uint64_t bytes = ((uint64_t)r->count * sizeof(ImportSpec) + 3) & ~(uint64_t)3;
+    uint64_t off = atomic_fetch_add_explicit(&h->blob_used, bytes, memory_order_relaxed);
+    if (off + bytes > CACHE_BLOB_BYTES) return;  // full until the next process rotates it
+
+    for (uint32_t probe = 0; probe < CACHE_MAX_PROBES; probe++) {
+        CacheEntry* e = &g_cache.entries[(key + probe) & (CACHE_SLOTS - 1)];
+        uint64_t expected = CACHE_KEY_EMPTY;
+        if (!atomic_compare_exchange_strong_explicit(&e->key, &expected, CACHE_KEY_BUSY,
+                                                     memory_order_acquire, memory_order_relaxed)) {
+            if (expected == key) return;  // another thread or process got there first
+            continue;
+        }
+        if (r->count) memcpy(g_cache.blob + off, r->items, r->count * sizeof(ImportSpec));
+        e->content_len = (uint32_t)content_len;
+        e->blob_off = (uint32_t)off;
+        e->count = r->count;
+        e->kind = r->kind;
+        atomic_fetch_add_explicit(&h->slots_used, 1, memory_order_relaxed);
+        atomic_store_explicit(&e->key, key, memory_order_release);
+        return;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Logging
+//
+// Bundler threads never write to stdout themselves. They push fixed-size
+// structured records into a bounded lock-free MPSC ring (per-cell sequence
+// numbers, Vyukov style) and one background flusher formats them in
+// batches. A full ring drops the record rather than stall the bundler. At
+// LOG_OFF the whole path is one relaxed load.
+//
+// The level comes from NATIVE_PLUGIN_LOG (off, info, debug) at load time
+// and can be changed with setLogLevel().
+// ---------------------------------------------------------------------------
+
+typedef enum {
+    LOG_OFF = 0,
+    LOG_INFO = 1,   // one record per file
+    LOG_DEBUG = 2,  // plus one per import
+} LogLevel;
+
+typedef enum {
+    LOG_EV_LOADED,
+    LOG_EV_FILE,
+    LOG_EV_IMPORT,
+} LogEvent;
+
+#define LOG_RING_CELLS 1024u  // power of two
+#define LOG_TEXT_MAX 192
+
+typedef struct {
+    // Stored relative to the cell index so the zeroed array is already a
+    // valid empty ring: the cell's sequence number is seq + index
+    _Atomic uint32_t seq;
+    uint8_t event;      // LogEvent
+    uint8_t kind;       // FileKind
+    uint8_t cached;
+    uint8_t text_len;
+    uint32_t thread;
+    uint32_t count;
+    uint64_t file_no;
+    uint64_t bytes;
+    char text[LOG_TEXT_MAX];  // path or specifier, truncated
+} LogRecord;
+
+static LogRecord g_log_ring[LOG_RING_CELLS];
+static _Atomic uint32_t g_log_tail;
+static _Atomic uint32_t g_log_head;       // written only under g_log_draining
+static atomic_flag g_log_draining = ATOMIC_FLAG_INIT;
+#ifndef _WIN32
+static pthread_mutex_t g_log_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_log_wake = PTHREAD_COND_INITIALIZER;
+static _Atomic int g_log_parked;          // flusher is (about to be) waiting on g_log_wake
+static _Atomic int g_log_closed;          // exit drain done; flusher stops
+#endif
+static _Atomic uint64_t g_log_dropped;
+static _Atomic int g_log_level = -1;      // -1: not yet read from NATIVE_PLUGIN_LOG
+
+static int parse_log_level(const char* s, int fallback);
+
+// The hooks can run without the napi Init (e.g. from native-bench), so the
+// environment is consulted on first use rather than only at load
+static int log_level(void) {
+    int level = atomic_load_explicit(&g_log_level, memory_order_relaxed);
+    if (level < 0) {
+        level = parse_log_level(getenv("NATIVE_PLUGIN_LOG"), LOG_INFO);
+        atomic_store_explicit(&g_log_level, level, memory_order_relaxed);
+    }
+    return level;
+}
+
+static int log_enabled(LogLevel level) {
+    return log_level() >= (int)level;
+}
+
+static void log_start(void);
+static uint32_t log_drain(void);
+
+// Reserve a cell; returns NULL (and counts a drop) when the ring is full
+static LogRecord* log_claim(uint32_t* pos_out) {
+    log_start();
+    uint32_t pos = atomic_load_explicit(&g_log_tail, memory_order_relaxed);
+    for (;;) {
+        uint32_t idx = pos & (LOG_RING_CELLS - 1);
+        LogRecord* r = &g_log_ring[idx];
+        uint32_t seq = atomic_load_explicit(&r->seq, memory_order_acquire) + idx;
+        int32_t dif = (int32_t)(seq - pos);
+        if (dif == 0) {
+            if (atomic_compare_exchange_weak_explicit(&g_log_tail, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                *pos_out = pos;
+                return r;
+            }
+        } else if (dif < 0) {
+            atomic_fetch_add_explicit(&g_log_dropped, 1, memory_order_relaxed);
+            return NULL;
+        } else {
+            pos = atomic_load_explicit(&g_log_tail, memory_order_relaxed);
+        }
+    }
+}
+
+static void log_commit(LogRecord* r, uint32_t pos) {
+    uint32_t idx = pos & (LOG_RING_CELLS - 1);
+    atomic_store_explicit(&r->seq, pos + 1 - idx, memory_order_release);
+#ifdef _WIN32
+    log_drain();  // no flusher thread here: drain inline
+#else
+    // Pairs with the fence in log_flusher(): either the flusher sees this
+    // record before parking, or we see it parked and wake it. The lock is
+    // only taken when it is actually asleep.
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&g_log_parked, memory_order_relaxed)) {
+        pthread_mutex_lock(&g_log_lock);
+        pthread_cond_signal(&g_log_wake);
+        pthread_mutex_unlock(&g_log_lock);
+    }
+#endif
+}
+
+static void log_push(LogEvent event, uint32_t thread, uint8_t kind, uint8_t cached, uint32_t count,
+                     uint64_t file_no, uint64_t bytes, const uint8_t* text, size_t text_len) {
+    uint32_t pos;
+    LogRecord* r = log_claim(&pos);
+    if (!r) return;
+    r->event = (uint8_t)event;
+    r->kind = kind;
+    r->cached = cached;
+    r->thread = thread;
+    r->count = count;
+    r->file_no = file_no;
+    r->bytes = bytes;
+    r->text_len = (uint8_t)(text_len < LOG_TEXT_MAX ? text_len : LOG_TEXT_MAX);
+    if (r->text_len) memcpy(r->text, text, r->text_len);
+    log_commit(r, pos);
+}
+
+static size_t log_format(char* out, size_t cap, const LogRecord* r) {
+    int n = 0;
+    switch ((LogEvent)r->event) {
+    case LOG_EV_LOADED:
+        n = snprintf(out, cap, "🚀 Native plugin loaded successfully!\n"
+                               "⚡ Running on native threads - no UTF-8 conversion overhead!\n");
+        break;
+    case LOG_EV_FILE:
+        n = snprintf(out, cap, "🔍 Native Plugin - File #%llu on thread %u: %.*s (%llu bytes)%s\n%s",
+                     (unsigned long long)r->file_no, (unsigned)r->thread, (int)r->text_len, r->text,
+                     (unsigned long long)r->bytes, r->cached ? " [cached]" : "",
+                     kind_is_typescript(r->kind) ? "   📝 TypeScript file detected\n" :
+                     kind_is_javascript(r->kind) ? "   📜 JavaScript file detected\n" :
+                     r->kind == FILE_KIND_JSON ? "   🗂️  JSON file detected\n" :
+                     r->kind == FILE_KIND_CSS ? "   🎨 CSS file detected\n" : "");
+        if (n >= 0 && (size_t)n < cap && r->count > 0) {
+            int m = snprintf(out + n, cap - (size_t)n, "   📦 Found %u import(s)\n", (unsigned)r->count);
+            n = m < 0 ? m : n + m;
+        }
+        break;
+    case LOG_EV_IMPORT:
+        n = snprintf(out, cap, "      %.*s\n", (int)r->text_len, r->text);
+        break;
+    }
+    return n < 0 ? 0 : (size_t)n < cap ? (size_t)n : cap - 1;
+}
+
+// Format every committed record and write them in one go; the caller
+// holds g_log_draining. Returns the number drained.
+static uint32_t log_drain_locked(void) {
+    static char buf[64 * 1024];
+    uint32_t head = atomic_load_explicit(&g_log_head, memory_order_relaxed);
+    size_t used = 0;
+    uint32_t drained = 0;
+    for (;;) {
+        uint32_t idx = head & (LOG_RING_CELLS - 1);
+        LogRecord* r = &g_log_ring[idx];
+        uint32_t seq = atomic_load_explicit(&r->seq, memory_order_acquire) + idx;
+        if (seq != head + 1) break;
+        if (sizeof(buf) - used < 1024) {
+            fwrite(buf, 1, used, stdout);
+            used = 0;
+        }
+        used += log_format(buf + used, sizeof(buf) - used, r);
+        atomic_store_explicit(&r->seq, head + LOG_RING_CELLS - idx, memory_order_release);
+        head++;
+        drained++;
+    }
+    atomic_store_explicit(&g_log_head, head, memory_order_relaxed);
+    uint64_t dropped = atomic_exchange_explicit(&g_log_dropped, 0, memory_order_relaxed);
+    if (dropped) {
+        used += (size_t)snprintf(buf + used, sizeof(buf) - used, "⚠️  %llu log record(s) dropped\n",
+                                 (unsigned long long)dropped);
+    }
+    if (used) {
+        fwrite(buf, 1, used, stdout);
+        fflush(stdout);
+    }
+    return drained;
+}
+
+// Returns 0 when another thread is already draining
+static uint32_t log_drain(void) {
+    if (atomic_flag_test_and_set_explicit(&g_log_draining, memory_order_acquire)) return 0;
+    uint32_t drained = log_drain_locked();
+    atomic_flag_clear_explicit(&g_log_draining, memory_order_release);
+    return drained;
+}
+
+#ifndef _WIN32
+// Whether the next record is committed; a hint for parking only
+static int log_pending(void) {
+    uint32_t head = atomic_load_explicit(&g_log_head, memory_order_relaxed);
+    uint32_t idx = head & (LOG_RING_CELLS - 1);
+    return atomic_load_explicit(&g_log_ring[idx].seq, memory_order_relaxed) + idx == head + 1;
+}
+
+static void log_drain_at_exit(void) {
+    // Wait out a drain the flusher has in progress rather than skipping
+    // it, then keep the flag so the flusher cannot write behind us
+    while (atomic_flag_test_and_set_explicit(&g_log_draining, memory_order_acquire)) sched_yield();
+    log_drain_locked();
+    atomic_store_explicit(&g_log_closed, 1, memory_order_relaxed);
+}
+
+// Drains while there is work and parks on g_log_wake otherwise, so an
+// idle host pays nothing for the logger
+static void* log_flusher(void* arg) {
+    (void)arg;
+    while (!atomic_load_explicit(&g_log_closed, memory_order_relaxed)) {
+        if (log_drain() != 0) continue;
+        pthread_mutex_lock(&g_log_lock);
+        atomic_store_explicit(&g_log_parked, 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);  // see log_commit()
+        if (!log_pending() && !atomic_load_explicit(&g_log_closed, memory_order_relaxed)) {
+            pthread_cond_wait(&g_log_wake, &g_log_lock);
+        }
+        atomic_store_explicit(&g_log_parked, 0, memory_order_relaxed);
+        pthread_mutex_unlock(&g_log_lock);
+    }
+    return NULL;
+}
+
+static void log_spawn(void) {
+    pthread_t t;
+    if (pthread_create(&t, NULL, log_flusher, NULL) == 0) pthread_detach(t);
+    atexit(log_drain_at_exit);
+}
+#endif
+
+static void log_start(void) {
+#ifndef _WIN32
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, log_spawn);
+#endif
+}
+
+static void log_file(uint32_t thread, uint64_t file_no, const uint8_t* path, size_t path_len,
+                     size_t content_len, const ScanResult* scan, int cached, const uint8_t* content) {
+    if (!log_enabled(LOG_INFO)) return;
+    log_push(LOG_EV_FILE, thread, (uint8_t)scan->kind, (uint8_t)cached, scan->count, file_no,
+             content_len, path, path_len);
+    if (!log_enabled(LOG_DEBUG)) return;
+    for (uint32_t i = 0; i < scan->count; i++) {
+        const ImportSpec* spec = &scan->items[i];
+        log_push(LOG_EV_IMPORT, thread, 0, 0, 0, 0, 0, content + spec->off, spec->len);
+    }
+}
+
+static int parse_log_level(const char* s, int fallback) {
+    if (!s) return fallback;
+    if (strcmp(s, "off") == 0 || strcmp(s, "0") == 0) return LOG_OFF;
+    if (strcmp(s, "info") == 0 || strcmp(s, "1") == 0) return LOG_INFO;
+    if (strcmp(s, "debug") == 0 || strcmp(s, "2") == 0) return LOG_DEBUG;
+    return fallback;
+}
+
+// ---------------------------------------------------------------------------
+// Source transforms
+//
+// Rewrites are collected as (offset, delete_len, insert) edits against the
+// original bytes and applied in one pass into a single buffer, so any
+// number of small edits costs one allocation and one copy of the file.
+// The buffer goes back to Bun as the new source together with a free
+// callback, still UTF-8 the whole way. Insert bytes are copied by
+// patch_apply(); they only need to live until then.
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    uint32_t offset;      // in the original source
+    uint32_t delete_len;
+    const uint8_t* insert;
+    uint32_t insert_len;
+    uint32_t order;       // edits at one offset apply in the order added
+} SourceEdit;
+
+typedef struct {
+    SourceEdit* edits;
+    uint32_t count;
+    uint32_t cap;
+    int oom;
+} PatchList;
+
+static void patch_add(PatchList* list, size_t offset, size_t delete_len, const void* insert, size_t insert_len) {
+    if (list->count == list->cap) {
+        uint32_t cap = list->cap ? list->cap * 2 : 8;
+        SourceEdit* edits = counted_realloc(list->edits, cap * sizeof(SourceEdit));
+        if (!edits) {
+            list->oom = 1;
+            return;
+        }
+        list->edits = edits;
+        list->cap = cap;
+    }
+    list->edits[list->count] = (SourceEdit){ (uint32_t)offset, (uint32_t)delete_len, insert,
+                                             (uint32_t)insert_len, list->count };
+    list->count++;
+}
+
+static void patch_free(PatchList* list) {
+    free(list->edits);
+    memset(list, 0, sizeof(*list));
+}
+
+static int cmp_edit(const void* a, const void* b) {
+    const SourceEdit* x = a;
+    const SourceEdit* y = b;
+    if (x->offset != y->offset) return x->offset < y->offset ? -1 : 1;
+    return x->order < y->order ? -1 : x->order > y->order;
+}
+
+static void free_source(void* ctx) {
+    free(ctx);
+}
+
+/**
+ * Apply every edit to `src` and hand the result to Bun
+ *
+ * @returns 0 when the result now points at the rewritten source (or
+ *          nothing needed rewriting), -1 for overlapping or out-of-range
+ *          edits or out of memory; the result is untouched then
+ */
+static int patch_apply(PatchList* list, const uint8_t* src, size_t len, OnBeforeParseResult* result) {
+    if (list->oom) return -1;
+    if (list->count == 0) return 0;
+    qsort(list->edits, list->count, sizeof(SourceEdit), cmp_edit);
+
+    size_t out_len = len, end = 0;
+    for (uint32_t i = 0; i < list->count; i++) {
+        const SourceEdit* e = &list->edits[i];
+        if (e->offset < end || (size_t)e->offset + e->delete_len > len) return -1;
+        end = (size_t)e->offset + e->delete_len;
+        out_len = out_len - e->delete_len + e->insert_len;
+    }
+
+    uint8_t* out = counted_realloc(NULL, out_len ? out_len : 1);
+    if (!out) return -1;
+    uint8_t* w = out;
+    size_t at = 0;
+    for (uint32_t i = 0; i < list->count; i++) {
+        const SourceEdit* e = &list->edits[i];
+        memcpy(w, src + at, e->offset - at);
+        w += e->offset - at;
+        if (e->insert_len) memcpy(w, e->insert, e->insert_len);
+        w += e->insert_len;
+        at = (size_t)e->offset + e->delete_len;
+    }
+    memcpy(w, src + at, len - at);
+
+    // Bun calls free_source once it is done with the buffer
+    result->source_ptr = out;
+    result->source_len = out_len;
+    result->plugin_source_code_context = out;
+    result->free_plugin_source_code_context = free_source;
+    return 0;
+}
+
+// Queue "use strict" ahead of the first statement unless the file is an
+// ES module (strict already) or starts with the directive
+static void add_strict_mode(PatchList* list, FileKind kind, const uint8_t* src, size_t len) {
+    static const char k_directive[] = "\"use strict\";\n";
+    if (kind == FILE_KIND_MJS || kind == FILE_KIND_MTS || kind == FILE_KIND_JSON || kind == FILE_KIND_CSS) return;
+
+    Lexer lx = { 0 };
+    lx.s = src;
+    lx.len = len;
+    size_t at = 0;
+    if (len >= 2 && src[0] == '#' && src[1] == '!') {
+        const uint8_t* nl = memchr(src, '\n', len);
+        at = nl ? (size_t)(nl - src) + 1 : len;
+    }
+    size_t first = skip_trivia(&lx, at);
+    if (len - first >= 12 && (src[first] == '"' || src[first] == '\'') &&
+        memcmp(src + first + 1, "use strict", 10) == 0 && src[first + 11] == src[first]) {
+        return;
+    }
+    patch_add(list, at, 0, k_directive, sizeof(k_directive) - 1);
+}
+
+// Replace `name` with `value` wherever it appears as a whole expression in
+// code, including ${} expressions inside templates. Strings, comments,
+// template text and regex literals are left alone; the walk keeps the same
+// lexer state as scan_imports() to tell them apart.
+static void replace_define(PatchList* list, const uint8_t* src, size_t len, const char* name, const char* value) {
+    size_t name_len = strlen(name), value_len = strlen(value);
+    Lexer lx = { 0 };
+    lx.s = src;
+    lx.len = len;
+
+    size_t i = 0;
+    if (len >= 2 && src[0] == '#' && src[1] == '!') {  // shebang
+        const uint8_t* nl = memchr(src, '\n', len);
+        i = nl ? (size_t)(nl - src) : len;
+    }
+
+    while (i < len) {
+        uint8_t c = src[i];
+        size_t end;
+        switch (c) {
+        case '\'':
+        case '"': {
+            size_t body, body_len;
+            int escaped;
+            end = read_string(&lx, i, &body, &body_len, &escaped);
+            if (!end) {
+                // Unterminated: resume on the next line
+                const uint8_t* nl = memchr(src + i + 1, '\n', len - i - 1);
+                end = nl ? (size_t)(nl - src) : len;
+            }
+            i = lx.code_start = end;
+            lx.prev_value = 1;
+            break;
+        }
+        case '`':
+            i = lx.code_start = skip_template(&lx, i + 1);
+            break;
+        case '/':
+            if (i + 1 < len && (src[i + 1] == '/' || src[i + 1] == '*')) {
+                i = lx.code_start = skip_trivia(&lx, i);
+            } else if (regex_allowed(&lx, i) && (end = skip_regex(&lx, i)) != 0) {
+                i = lx.code_start = end;
+                lx.prev_value = 1;
+            } else {
+                i++;
+            }
+            break;
+        case '{':
+            lx.depth++;
+            i++;
+            break;
+        case '}':
+            if (lx.tmpl_count && lx.tmpl[lx.tmpl_count - 1] == lx.depth) {
+                lx.tmpl_count--;
+                i = lx.code_start = skip_template(&lx, i + 1);
+            } else {
+                if (lx.depth) lx.depth--;
+                i++;
+            }
+            break;
+        default:
+            if (!is_ident(c)) {
+                i++;
+            } else if (c == (uint8_t)name[0] && len - i >= name_len && memcmp(src + i, name, name_len) == 0 &&
+                       (i == 0 || src[i - 1] != '.') && (i + name_len == len || !is_ident(src[i + name_len]))) {
+                patch_add(list, i, name_len, value, value_len);
+                i += name_len;
+            } else {
+                i = read_word(&lx, i);  // never match inside an identifier
+            }
+            break;
+        }
+    }
+}
+
+// NODE_ENV as a JS string literal, computed once; restricted to a safe
+// character set so it can be spliced in without escaping
+static const char* node_env_literal(void) {
+    static char literal[64];
+    static _Atomic int ready;
+    if (!atomic_load_explicit(&ready, memory_order_acquire)) {
+        const char* env = getenv("NODE_ENV");
+        size_t n = env ? strlen(env) : 0;
+        int ok = n > 0 && n < sizeof(literal) - 2;
+        for (size_t i = 0; ok && i < n; i++) ok = is_ident((uint8_t)env[i]) || env[i] == '-' || env[i] == '.';
+        snprintf(literal, sizeof(literal), "\"%s\"", ok ? env : "production");
+        atomic_store_explicit(&ready, 1, memory_order_release);
+    }
+    return literal;
+}
 
 // Native plugin lifecycle hook: onBeforeParse
 // This runs on any thread before a file is parsed by Bun's bundler
-static napi_value onBeforeParse(napi_env env, napi_callback_info info) {
-    size_t argc = 2;
-    napi_value args[2];
-    napi_status status;
-    
-    // Get arguments: path and content
-    status = napi_get_cb_info(env, info, &argc, args, NULL, NULL);
-    if (status != napi_ok) return NULL;
-    
-    // Get file path
-    size_t path_len;
-    status = napi_get_value_string_utf8(env, args[0], NULL, 0, &path_len);
-    if (status != napi_ok) return NULL;
-    
-    char* path = malloc(path_len + 1);
-    status = napi_get_value_string_utf8(env, args[0], path, path_len + 1, &path_len);
-    
-    // Get file content length
-    size_t content_len;
-    status = napi_get_value_string_utf8(env, args[1], NULL, 0, &content_len);
-    
-    file_count++;
-    
-    printf("🔍 Native Plugin - File #%d: %.*s (%zu bytes)\n", 
-           file_count, (int)path_len, path, content_len);
-    
-    // Quick analysis without UTF-8 -> UTF-16 conversion
-    if (strstr(path, ".ts") != NULL) {
-        printf("   📝 TypeScript file detected\n");
-    } else if (strstr(path, ".js") != NULL) {
-        printf("   📜 JavaScript file detected\n");
-    }
-    
-    // Look for import patterns directly in UTF-8
-    char* content = malloc(content_len + 1);
-    status = napi_get_value_string_utf8(env, args[1], content, content_len + 1, &content_len);
-    
-    int import_count = 0;
-    char* pos = content;
-    while ((pos = strstr(pos, "import ")) != NULL) {
-        import_count++;
-        pos += 7; // Skip "import "
-    }
-    
-    if (import_count > 0) {
-        printf("   📦 Found %d import(s)\n", import_count);
-    }
-    
+BUN_PLUGIN_EXPORT void onBeforeParse(const OnBeforeParseArguments* args, OnBeforeParseResult* result) {
+    TraceSpan span;
+    trace_begin(&span);
+    // Bun fills source_ptr/source_len with its own copy of the file; the
+    // plugin reads it in place
+    if (result->fetchSourceCode(args, result) != 0) return;
+
+    uint64_t start = now_ns();
+    StatSlot* stats = stats_slot();
+    const uint8_t* path = args->path_ptr;
+    size_t path_len = args->path_len;
+    const uint8_t* content = result->source_ptr;
+    size_t content_len = result->source_len;
+
+    stat_add(stats, &stats->files, 1);
+    stat_add(stats, &stats->bytes, content_len);
+
+    // Unchanged files since an earlier build skip the scan entirely
+    uint64_t key = cache_key(path, path_len, content, content_len);
+    ImportList imports = { 0 };
+    ScanResult scan;
+    int cached = cache_lookup(key, content_len, &scan);
+    if (cached) {
+        stat_add(stats, &stats->cache_hits, 1);
+    } else {
+        // Quick analysis without UTF-8 -> UTF-16 conversion
+        FileKind kind = classify_path(path, path_len);
+        scan.kind = kind;
+        // Module specifiers straight from the UTF-8 buffer; a partial list
+        // (out of memory) is not worth caching
+        int ok = scan_file(kind, content, content_len, &imports) == 0;
+        scan.items = imports.items;
+        scan.count = imports.count;
+        if (ok) cache_insert(key, content_len, &scan);
+    }
+
+    log_file((uint32_t)(stats - g_stats), atomic_load_explicit(&stats->files, memory_order_relaxed),
+             path, path_len, content_len, &scan, cached, content);
+    stat_add(stats, &stats->imports, scan.count);
+    import_list_free(&imports);
+
+    // Leave source_ptr as fetched: no modification to the file
+    result->loader = args->default_loader;
+    stat_add(stats, &stats->ns, now_ns() - start);
+    trace_end(&span, TRACE_ON_BEFORE_PARSE, path, path_len, content_len, scan.count, cached);
+}
+
+// Rewriting hook, registered alongside onBeforeParse:
+//   { napiModule, symbol: "onBeforeParseTransform" }
+// Mirrors the Rust example's transforms: strict-mode injection for
+// scripts and process.env.NODE_ENV replaced with NODE_ENV (default
+// "production"), all applied as one patch list
+BUN_PLUGIN_EXPORT void onBeforeParseTransform(const OnBeforeParseArguments* args, OnBeforeParseResult* result) {
+    TraceSpan span;
+    trace_begin(&span);
+    if (result->fetchSourceCode(args, result) != 0) return;
+
+    const uint8_t* content = result->source_ptr;
+    size_t content_len = result->source_len;
+    FileKind kind = classify_path(args->path_ptr, args->path_len);
+    result->loader = args->default_loader;
+    uint32_t edits = 0;
+    if (kind != FILE_KIND_JSON && kind != FILE_KIND_CSS && content_len <= UINT32_MAX) {
+        PatchList patches = { 0 };
+        add_strict_mode(&patches, kind, content, content_len);
+        replace_define(&patches, content, content_len, "process.env.NODE_ENV", node_env_literal());
+        // on failure Bun keeps the original
+        if (patch_apply(&patches, content, content_len, result) == 0) edits = patches.count;
+        patch_free(&patches);
+    }
+    trace_end(&span, TRACE_ON_BEFORE_PARSE_TRANSFORM, args->path_ptr, args->path_len, content_len, edits, 0);
+}
+
+static napi_status set_u64(napi_env env, napi_value obj, const char* name, uint64_t v) {
+    napi_value value;
+    napi_status status = napi_create_double(env, (double)v, &value);
+    if (status != napi_ok) return status;
+    return napi_set_named_property(env, obj, name, value);
+}
+
+// getStats(): { files, bytes, imports, nanoseconds, cacheHits, threads,
+// logDropped } summed over every thread that has run onBeforeParse
+static napi_value GetStats(napi_env env, napi_callback_info info) {
+    (void)info;
+    uint64_t files = 0, bytes = 0, imports = 0, ns = 0, hits = 0;
+    for (size_t i = 0; i <= STATS_MAX_THREADS; i++) {
+        files += atomic_load_explicit(&g_stats[i].files, memory_order_relaxed);
+        bytes += atomic_load_explicit(&g_stats[i].bytes, memory_order_relaxed);
+        imports += atomic_load_explicit(&g_stats[i].imports, memory_order_relaxed);
+        ns += atomic_load_explicit(&g_stats[i].ns, memory_order_relaxed);
+        hits += atomic_load_explicit(&g_stats[i].cache_hits, memory_order_relaxed);
+    }
+    uint32_t threads = atomic_load_explicit(&g_stats_threads, memory_order_relaxed);
+    uint64_t dropped = atomic_load_explicit(&g_log_dropped, memory_order_relaxed);
+
+    napi_value obj;
+    if (napi_create_object(env, &obj) != napi_ok) return NULL;
+    if (set_u64(env, obj, "files", files) != napi_ok ||
+        set_u64(env, obj, "bytes", bytes) != napi_ok ||
+        set_u64(env, obj, "imports", imports) != napi_ok ||
+        set_u64(env, obj, "nanoseconds", ns) != napi_ok ||
+        set_u64(env, obj, "cacheHits", hits) != napi_ok ||
+        set_u64(env, obj, "threads", threads) != napi_ok ||
+        set_u64(env, obj, "logDropped", dropped) != napi_ok) {
+        return NULL;
+    }
+    return obj;
+}
+
+// setLogLevel(level): "off" | "info" | "debug" or 0..2; returns the level in effect
+static napi_value SetLogLevel(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value argv[1];
+    if (napi_get_cb_info(env, info, &argc, argv, NULL, NULL) != napi_ok) return NULL;
+
+    int level = log_level();
+    napi_valuetype type = napi_undefined;
+    if (argc > 0) napi_typeof(env, argv[0], &type);
+    if (type == napi_number) {
+        int32_t n;
+        if (napi_get_value_int32(env, argv[0], &n) == napi_ok && n >= LOG_OFF && n <= LOG_DEBUG) level = n;
+    } else if (type == napi_string) {
+        char name[16];
+        size_t len;
+        if (napi_get_value_string_utf8(env, argv[0], name, sizeof(name), &len) == napi_ok) {
+            level = parse_log_level(name, level);
+        }
+    }
+    atomic_store_explicit(&g_log_level, level, memory_order_relaxed);
+
+    napi_value out;
+    if (napi_create_int32(env, level, &out) != napi_ok) return NULL;
+    return out;
+}
+
+// setTrace(path?): record hook timings to `path` as Chrome trace JSON,
+// written at exit; no path (or "") stops recording. Returns whether it is on.
+static napi_value SetTrace(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value argv[1];
+    if (napi_get_cb_info(env, info, &argc, argv, NULL, NULL) != napi_ok) return NULL;
+
+    napi_valuetype type = napi_undefined;
+    if (argc > 0) napi_typeof(env, argv[0], &type);
+    char* path = NULL;
+    if (type == napi_string) {
+        size_t len;
+        if (napi_get_value_string_utf8(env, argv[0], NULL, 0, &len) != napi_ok) return NULL;
+        path = malloc(len + 1);
+        if (!path || napi_get_value_string_utf8(env, argv[0], path, len + 1, &len) != napi_ok) {
+            free(path);
+            napi_throw_error(env, NULL, "setTrace: cannot read path");
+            return NULL;
+        }
+    } else if (type != napi_undefined && type != napi_null) {
+        napi_throw_type_error(env, NULL, "setTrace: path must be a string");
+        return NULL;
+    }
+    trace_configure(path);
     free(path);
-    free(content);
-    
-    // Return undefined (no modification to the file)
+
+    napi_value out;
+    if (napi_get_boolean(env, trace_enabled(), &out) != napi_ok) return NULL;
+    return out;
+}
+
+// ---------------------------------------------------------------------------
+// Directory pre-scan
+//
+// prescan(rootDir, globs?) walks rootDir off the JS thread and resolves to
+// { files, kinds, specifiers, edges, edgeKinds }: edges holds
+// (file index, specifier index) pairs, and specifiers are deduplicated
+// across the tree. Specifiers are left unresolved; resolution is the
+// bundler's job. Every scan also lands in the scan cache, so the
+// onBeforeParse calls that follow mostly hit it.
+//
+// Directories and files are tasks on per-worker deques: a worker pops its
+// own newest task and steals the oldest from the others when it runs dry,
+// so deep subtrees spread across cores. Hidden entries, node_modules and
+// symlinks are skipped. Without globs every JS, TS and CSS file counts.
+// ---------------------------------------------------------------------------
+
+#ifndef _WIN32
+#define PRESCAN_MAX_WORKERS 64
+
+typedef struct {
+    char* path;  // absolute, owned by the task
+    int is_dir;
+} PrescanTask;
+
+typedef struct {
+    pthread_mutex_t lock;
+    PrescanTask* items;  // live tasks in [head, tail)
+    size_t head;
+    size_t tail;
+    size_t cap;
+} TaskDeque;
+
+typedef struct {
+    size_t path_off;  // into the output pool
+    uint32_t path_len;
+    uint32_t kind;    // FileKind
+    size_t import_begin;
+    uint32_t import_count;
+} PrescanFile;
+
+typedef struct {
+    size_t off;  // into the output pool
+    uint32_t len;
+    uint8_t kind;  // ImportKind
+} PrescanImport;
+
+typedef struct {
+    char* pool;
+    size_t pool_len, pool_cap;
+    PrescanFile* files;
+    size_t file_count, file_cap;
+    PrescanImport* imports;
+    size_t import_count, import_cap;
+} PrescanOut;
+
+struct PrescanWalk;
+
+typedef struct {
+    TaskDeque deque;
+    PrescanOut out;
+    uint8_t* buf;  // file contents, reused across files
+    size_t buf_cap;
+    struct PrescanWalk* ps;
+    uint32_t id;
+    pthread_t thread;
+} PrescanWorker;
+
+typedef struct PrescanWalk {
+    const char* root;
+    size_t root_len;
+    char** globs;  // brace-expanded, relative to root
+    size_t glob_count;
+    PrescanWorker workers[PRESCAN_MAX_WORKERS];
+    uint32_t worker_count;
+    _Atomic size_t pending;  // tasks pushed and not yet finished
+    _Atomic int oom;
+    pthread_mutex_t lock;    // guards parking on `wake`
+    pthread_cond_t wake;     // a task was pushed or the walk is done
+    _Atomic uint32_t parked; // workers waiting on `wake`
+} PrescanWalk;
+
+static int grow(void** items, size_t* cap, size_t need, size_t elem) {
+    if (need <= *cap) return 0;
+    size_t n = *cap ? *cap : 16;
+    while (n < need) n *= 2;
+    void* p = counted_realloc(*items, n * elem);
+    if (!p) return -1;
+    *items = p;
+    *cap = n;
+    return 0;
+}
+
+static int deque_push(TaskDeque* dq, PrescanTask task) {
+    pthread_mutex_lock(&dq->lock);
+    if (dq->tail == dq->cap && dq->head > 0) {
+        memmove(dq->items, dq->items + dq->head, (dq->tail - dq->head) * sizeof(PrescanTask));
+        dq->tail -= dq->head;
+        dq->head = 0;
+    }
+    int rc = grow((void**)&dq->items, &dq->cap, dq->tail + 1, sizeof(PrescanTask));
+    if (rc == 0) dq->items[dq->tail++] = task;
+    pthread_mutex_unlock(&dq->lock);
+    return rc;
+}
+
+// Owner end: newest first, keeps the walk depth-first and cache-warm
+static int deque_pop(TaskDeque* dq, PrescanTask* out) {
+    pthread_mutex_lock(&dq->lock);
+    int ok = dq->tail > dq->head;
+    if (ok) *out = dq->items[--dq->tail];
+    pthread_mutex_unlock(&dq->lock);
+    return ok;
+}
+
+// Thief end: oldest first, which near the root means the largest subtrees
+static int deque_steal(TaskDeque* dq, PrescanTask* out) {
+    if (pthread_mutex_trylock(&dq->lock) != 0) return 0;
+    int ok = dq->tail > dq->head;
+    if (ok) *out = dq->items[dq->head++];
+    pthread_mutex_unlock(&dq->lock);
+    return ok;
+}
+
+// Glob over a path relative to the root: `*` and `?` stay within one
+// segment, `**` spans segments and `**/` may match none
+static int glob_match(const char* p, const char* pe, const char* s, const char* se) {
+    while (p < pe) {
+        if (*p == '*' && p + 1 < pe && p[1] == '*') {
+            p += 2;
+            int dirs = p < pe && *p == '/';
+            if (dirs) p++;
+            for (const char* t = s;; t++) {
+                if ((!dirs || t == s || t[-1] == '/') && glob_match(p, pe, t, se)) return 1;
+                if (t == se) return 0;
+            }
+        }
+        if (*p == '*') {
+            p++;
+            for (const char* t = s;; t++) {
+                if (glob_match(p, pe, t, se)) return 1;
+                if (t == se || *t == '/') return 0;
+            }
+        }
+        if (s == se || (*p == '?' ? *s == '/' : *p != *s)) return 0;
+        p++;
+        s++;
+    }
+    return s == se;
+}
+
+// "src/**/*.{ts,tsx}" -> "src/**/*.ts", "src/**/*.tsx" (groups may nest)
+static int expand_braces(PrescanWalk* ps, const char* pat, size_t len, size_t* cap) {
+    const char* open = memchr(pat, '{', len);
+    if (!open) {
+        if (grow((void**)&ps->globs, cap, ps->glob_count + 1, sizeof(char*)) != 0) return -1;
+        char* copy = malloc(len + 1);
+        if (!copy) return -1;
+        memcpy(copy, pat, len);
+        copy[len] = '\0';
+        ps->globs[ps->glob_count++] = copy;
+        return 0;
+    }
+    size_t depth = 0;
+    const char* close = NULL;
+    for (const char* c = open; c < pat + len; c++) {
+        if (*c == '{') depth++;
+        if (*c == '}' && --depth == 0) {
+            close = c;
+            break;
+        }
+    }
+    if (!close) return expand_braces(ps, pat, (size_t)(open - pat), cap);  // unbalanced: stop there
+
+    size_t prefix = (size_t)(open - pat), suffix = (size_t)(pat + len - close - 1);
+    const char* alt = open + 1;
+    depth = 0;
+    for (const char* c = alt; c <= close; c++) {
+        if (*c == '{') depth++;
+        if (*c == '}' && c != close) depth--;
+        if ((*c == ',' && depth == 0) || c == close) {
+            size_t alt_len = (size_t)(c - alt), n = prefix + alt_len + suffix;
+            char* buf = malloc(n ? n : 1);
+            if (!buf) return -1;
+            memcpy(buf, pat, prefix);
+            memcpy(buf + prefix, alt, alt_len);
+            memcpy(buf + prefix + alt_len, close + 1, suffix);
+            int rc = expand_braces(ps, buf, n, cap);
+            free(buf);
+            if (rc != 0) return -1;
+            alt = c + 1;
+        }
+    }
+    return 0;
+}
+
+static int prescan_wanted(const PrescanWalk* ps, const char* path, size_t len) {
+    if (ps->glob_count == 0) {
+        FileKind kind = classify_path((const uint8_t*)path, len);
+        return kind != FILE_KIND_OTHER && kind != FILE_KIND_JSON;
+    }
+    const char* rel = path + ps->root_len + 1;
+    const char* end = path + len;
+    for (size_t i = 0; i < ps->glob_count; i++) {
+        const char* g = ps->globs[i];
+        if (glob_match(g, g + strlen(g), rel, end)) return 1;
+    }
+    return 0;
+}
+
+static void prescan_wake(PrescanWalk* ps, int all) {
+    pthread_mutex_lock(&ps->lock);
+    if (all) {
+        pthread_cond_broadcast(&ps->wake);
+    } else {
+        pthread_cond_signal(&ps->wake);
+    }
+    pthread_mutex_unlock(&ps->lock);
+}
+
+static void prescan_push(PrescanWorker* w, char* path, int is_dir) {
+    PrescanWalk* ps = w->ps;
+    atomic_fetch_add_explicit(&ps->pending, 1, memory_order_relaxed);
+    if (deque_push(&w->deque, (PrescanTask){ path, is_dir }) != 0) {
+        atomic_store_explicit(&ps->oom, 1, memory_order_relaxed);
+        atomic_fetch_sub_explicit(&ps->pending, 1, memory_order_relaxed);
+        free(path);
+        return;
+    }
+    atomic_thread_fence(memory_order_seq_cst);  // see prescan_worker()
+    if (atomic_load_explicit(&ps->parked, memory_order_relaxed)) prescan_wake(ps, 0);
+}
+
+static void prescan_dir(PrescanWorker* w, const char* dir) {
+    DIR* d = opendir(dir);
+    if (!d) return;  // unreadable: skipped like a missing file
+    size_t dir_len = strlen(dir);
+    struct dirent* ent;
+    while ((ent = readdir(d)) != NULL) {
+        const char* name = ent->d_name;
+        if (name[0] == '.' || strcmp(name, "node_modules") == 0) continue;
+
+        size_t name_len = strlen(name);
+        char* path = malloc(dir_len + name_len + 2);
+        if (!path) {
+            atomic_store_explicit(&w->ps->oom, 1, memory_order_relaxed);
+            break;
+        }
+        memcpy(path, dir, dir_len);
+        path[dir_len] = '/';
+        memcpy(path + dir_len + 1, name, name_len + 1);
+
+        int type = ent->d_type;
+        if (type == DT_UNKNOWN) {
+            struct stat st;
+            type = lstat(path, &st) != 0 ? DT_UNKNOWN : S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+        }
+        if (type == DT_DIR) {
+            prescan_push(w, path, 1);
+        } else if (type == DT_REG && prescan_wanted(w->ps, path, dir_len + 1 + name_len)) {
+            prescan_push(w, path, 0);
+        } else {
+            free(path);
+        }
+    }
+    closedir(d);
+}
+
+static void prescan_file(PrescanWorker* w, const char* path) {
+    TraceSpan span;
+    trace_begin(&span);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 0 || (uint64_t)st.st_size > UINT32_MAX) {
+        close(fd);
+        return;
+    }
+    // read() rather than mmap(): a file truncated under us would turn
+    // into SIGBUS on a mapping, but is just a short read here
+    size_t len = (size_t)st.st_size;
+    if (grow((void**)&w->buf, &w->buf_cap, len + 1, 1) != 0) {
+        close(fd);
+        atomic_store_explicit(&w->ps->oom, 1, memory_order_relaxed);
+        return;
+    }
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = read(fd, w->buf + got, len - got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        got += (size_t)n;
+    }
+    close(fd);
+    len = got;
+    const uint8_t* content = w->buf;
+
+    size_t path_len = strlen(path);
+    uint64_t key = cache_key((const uint8_t*)path, path_len, content, len);
+    ImportList imports = { 0 };
+    ScanResult scan;
+    int cached = cache_lookup(key, len, &scan);
+    if (!cached) {
+        scan.kind = classify_path((const uint8_t*)path, path_len);
+        int ok = scan_file((FileKind)scan.kind, content, len, &imports) == 0;
+        scan.items = imports.items;
+        scan.count = imports.count;
+        if (ok) cache_insert(key, len, &scan);
+    }
+
+    // Copy out the path and specifiers: the buffer is reused for the next file
+    PrescanOut* o = &w->out;
+    size_t bytes = path_len;
+    for (uint32_t i = 0; i < scan.count; i++) bytes += scan.items[i].len;
+    if (grow((void**)&o->pool, &o->pool_cap, o->pool_len + bytes, 1) != 0 ||
+        grow((void**)&o->files, &o->file_cap, o->file_count + 1, sizeof(PrescanFile)) != 0 ||
+        grow((void**)&o->imports, &o->import_cap, o->import_count + scan.count, sizeof(PrescanImport)) != 0) {
+        atomic_store_explicit(&w->ps->oom, 1, memory_order_relaxed);
+    } else {
+        PrescanFile* f = &o->files[o->file_count++];
+        f->path_off = o->pool_len;
+        f->path_len = (uint32_t)path_len;
+        f->kind = scan.kind;
+        f->import_begin = o->import_count;
+        f->import_count = scan.count;
+        memcpy(o->pool + o->pool_len, path, path_len);
+        o->pool_len += path_len;
+        for (uint32_t i = 0; i < scan.count; i++) {
+            const ImportSpec* spec = &scan.items[i];
+            o->imports[o->import_count++] = (PrescanImport){ o->pool_len, spec->len, spec->kind };
+            memcpy(o->pool + o->pool_len, content + spec->off, spec->len);
+            o->pool_len += spec->len;
+        }
+    }
+    uint32_t count = scan.count;
+    import_list_free(&imports);
+    trace_end(&span, TRACE_PRESCAN, (const uint8_t*)path, path_len, len, count, cached);
+}
+
+static int prescan_take(PrescanWorker* w, PrescanTask* task) {
+    PrescanWalk* ps = w->ps;
+    int got = deque_pop(&w->deque, task);
+    for (uint32_t k = 1; !got && k < ps->worker_count; k++) {
+        got = deque_steal(&ps->workers[(w->id + k) % ps->worker_count].deque, task);
+    }
+    return got;
+}
+
+// Runs tasks until the tree is done. A worker that finds every deque
+// empty while others are still listing directories parks on ps->wake
+// until the next push, so a narrow tree costs one busy core, not all.
+static void* prescan_worker(void* arg) {
+    PrescanWorker* w = arg;
+    PrescanWalk* ps = w->ps;
+    for (;;) {
+        PrescanTask task;
+        int got = prescan_take(w, &task);
+        if (!got) {
+            if (atomic_load_explicit(&ps->pending, memory_order_acquire) == 0) break;
+            // Announce the park before the last look: a push either lands
+            // before it or sees `parked` and signals under the lock
+            pthread_mutex_lock(&ps->lock);
+            atomic_fetch_add_explicit(&ps->parked, 1, memory_order_relaxed);
+            atomic_thread_fence(memory_order_seq_cst);
+            got = prescan_take(w, &task);
+            if (!got && atomic_load_explicit(&ps->pending, memory_order_acquire) != 0) {
+                pthread_cond_wait(&ps->wake, &ps->lock);
+            }
+            atomic_fetch_sub_explicit(&ps->parked, 1, memory_order_relaxed);
+            pthread_mutex_unlock(&ps->lock);
+            if (!got) continue;
+        }
+        if (!atomic_load_explicit(&ps->oom, memory_order_relaxed)) {
+            if (task.is_dir) {
+                prescan_dir(w, task.path);
+            } else {
+                prescan_file(w, task.path);
+            }
+        }
+        free(task.path);
+        // Children were counted before this task is retired, so pending
+        // only reaches zero once the whole tree is done
+        if (atomic_fetch_sub_explicit(&ps->pending, 1, memory_order_release) == 1) prescan_wake(ps, 1);
+    }
     return NULL;
 }
 
+typedef struct {
+    char* pool;
+    size_t pool_len;
+    PrescanFile* files;  // path_off into pool; import fields unused
+    size_t file_count;
+    size_t* spec_off;    // unique specifiers, into pool
+    uint32_t* spec_len;
+    size_t spec_count;
+    uint32_t* edges;     // (file, specifier) pairs
+    uint8_t* edge_kinds;
+    size_t edge_count;
+} PrescanGraph;
+
+static void prescan_graph_free(PrescanGraph* g) {
+    free(g->pool);
+    free(g->files);
+    free(g->spec_off);
+    free(g->spec_len);
+    free(g->edges);
+    free(g->edge_kinds);
+    memset(g, 0, sizeof(*g));
+}
+
+// Concatenate the per-worker outputs and intern specifiers through an
+// open-addressed table
+static int prescan_merge(PrescanWalk* ps, PrescanGraph* g) {
+    size_t pool = 0, files = 0, imports = 0;
+    for (uint32_t i = 0; i < ps->worker_count; i++) {
+        pool += ps->workers[i].out.pool_len;
+        files += ps->workers[i].out.file_count;
+        imports += ps->workers[i].out.import_count;
+    }
+    if (files > UINT32_MAX || imports > UINT32_MAX) return -1;
+    size_t slots = 16;
+    while (slots < imports * 2) slots *= 2;
+
+    g->pool = malloc(pool ? pool : 1);
+    g->files = malloc((files ? files : 1) * sizeof(PrescanFile));
+    g->spec_off = malloc((imports ? imports : 1) * sizeof(size_t));
+    g->spec_len = malloc((imports ? imports : 1) * sizeof(uint32_t));
+    g->edges = malloc((imports ? imports : 1) * 2 * sizeof(uint32_t));
+    g->edge_kinds = malloc(imports ? imports : 1);
+    uint32_t* table = calloc(slots, sizeof(uint32_t));  // specifier index + 1
+    if (!g->pool || !g->files || !g->spec_off || !g->spec_len || !g->edges || !g->edge_kinds || !table) {
+        free(table);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < ps->worker_count; i++) {
+        const PrescanOut* o = &ps->workers[i].out;
+        size_t base = g->pool_len;
+        if (o->pool_len) memcpy(g->pool + base, o->pool, o->pool_len);
+        g->pool_len += o->pool_len;
+
+        for (size_t f = 0; f < o->file_count; f++) {
+            const PrescanFile* src = &o->files[f];
+            uint32_t file_index = (uint32_t)g->file_count;
+            g->files[g->file_count] = *src;
+            g->files[g->file_count++].path_off = base + src->path_off;
+
+            for (uint32_t k = 0; k < src->import_count; k++) {
+                const PrescanImport* imp = &o->imports[src->import_begin + k];
+                const char* text = g->pool + base + imp->off;
+                size_t h = (size_t)hash_content((const uint8_t*)text, imp->len, 0) & (slots - 1);
+                while (table[h]) {
+                    uint32_t s = table[h] - 1;
+                    if (g->spec_len[s] == imp->len && memcmp(g->pool + g->spec_off[s], text, imp->len) == 0) break;
+                    h = (h + 1) & (slots - 1);
+                }
+                if (!table[h]) {
+                    g->spec_off[g->spec_count] = base + imp->off;
+                    g->spec_len[g->spec_count] = imp->len;
+                    table[h] = (uint32_t)++g->spec_count;
+                }
+                g->edges[g->edge_count * 2] = file_index;
+                g->edges[g->edge_count * 2 + 1] = table[h] - 1;
+                g->edge_kinds[g->edge_count++] = imp->kind;
+            }
+        }
+    }
+    free(table);
+    return 0;
+}
+
+static int prescan_run(PrescanWalk* ps, PrescanGraph* g) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    // Fixed for the whole walk: a worker that fails to start just leaves
+    // an empty deque behind, since only running workers push
+    ps->worker_count = cpus < 1 ? 1 : cpus > PRESCAN_MAX_WORKERS ? PRESCAN_MAX_WORKERS : (uint32_t)cpus;
+    pthread_mutex_init(&ps->lock, NULL);
+    pthread_cond_init(&ps->wake, NULL);
+    atomic_store(&ps->parked, 0);
+    for (uint32_t i = 0; i < ps->worker_count; i++) {
+        PrescanWorker* w = &ps->workers[i];
+        memset(w, 0, sizeof(*w));
+        pthread_mutex_init(&w->deque.lock, NULL);
+        w->ps = ps;
+        w->id = i;
+    }
+
+    char* root = strdup(ps->root);
+    if (root) prescan_push(&ps->workers[0], root, 1);
+    // The calling thread is worker 0
+    int spawned[PRESCAN_MAX_WORKERS] = { 0 };
+    for (uint32_t i = 1; i < ps->worker_count; i++) {
+        spawned[i] = pthread_create(&ps->workers[i].thread, NULL, prescan_worker, &ps->workers[i]) == 0;
+    }
+    prescan_worker(&ps->workers[0]);
+    for (uint32_t i = 1; i < ps->worker_count; i++) {
+        if (spawned[i]) pthread_join(ps->workers[i].thread, NULL);
+    }
+
+    int rc = !root || atomic_load(&ps->oom) ? -1 : prescan_merge(ps, g);
+    for (uint32_t i = 0; i < ps->worker_count; i++) {
+        PrescanWorker* w = &ps->workers[i];
+        free(w->deque.items);
+        pthread_mutex_destroy(&w->deque.lock);
+        free(w->out.pool);
+        free(w->out.files);
+        free(w->out.imports);
+        free(w->buf);
+    }
+    pthread_cond_destroy(&ps->wake);
+    pthread_mutex_destroy(&ps->lock);
+    return rc;
+}
+
+typedef struct {
+    napi_async_work work;
+    napi_deferred deferred;
+    PrescanWalk ps;
+    char* root;
+    PrescanGraph graph;
+    const char* error;
+    uint64_t elapsed_ns;
+} PrescanJob;
+
+static void prescan_job_free(PrescanJob* job) {
+    for (size_t i = 0; i < job->ps.glob_count; i++) free(job->ps.globs[i]);
+    free(job->ps.globs);
+    free(job->root);
+    prescan_graph_free(&job->graph);
+    free(job);
+}
+
+static void PrescanExecute(napi_env env, void* data) {
+    (void)env;
+    PrescanJob* job = data;
+    uint64_t start = now_ns();
+    struct stat st;
+    if (stat(job->root, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        job->error = "prescan: rootDir is not a readable directory";
+    } else if (prescan_run(&job->ps, &job->graph) != 0) {
+        job->error = "prescan: out of memory";
+    }
+    job->elapsed_ns = now_ns() - start;
+}
+
+static napi_status typed_array(napi_env env, napi_typedarray_type type, const void* data, size_t count,
+                               size_t elem, napi_value* out) {
+    void* bytes;
+    napi_value buffer;
+    napi_status status = napi_create_arraybuffer(env, count * elem, &bytes, &buffer);
+    if (status != napi_ok) return status;
+    if (count) memcpy(bytes, data, count * elem);
+    return napi_create_typedarray(env, type, count, buffer, 0, out);
+}
+
+static napi_status prescan_result(napi_env env, const PrescanJob* job, napi_value* out) {
+    const PrescanGraph* g = &job->graph;
+    napi_value obj, files, specs, value;
+    napi_status status;
+#define TRY(call) do { if ((status = (call)) != napi_ok) return status; } while (0)
+    TRY(napi_create_object(env, &obj));
+    TRY(napi_create_array_with_length(env, g->file_count, &files));
+    uint8_t* kinds = malloc(g->file_count ? g->file_count : 1);
+    if (!kinds) return napi_generic_failure;
+    for (size_t i = 0; i < g->file_count; i++) {
+        kinds[i] = (uint8_t)g->files[i].kind;
+        status = napi_create_string_utf8(env, g->pool + g->files[i].path_off, g->files[i].path_len, &value);
+        if (status == napi_ok) status = napi_set_element(env, files, (uint32_t)i, value);
+        if (status != napi_ok) {
+            free(kinds);
+            return status;
+        }
+    }
+    status = typed_array(env, napi_uint8_array, kinds, g->file_count, 1, &value);
+    free(kinds);
+    TRY(status);
+    TRY(napi_set_named_property(env, obj, "kinds", value));
+    TRY(napi_set_named_property(env, obj, "files", files));
+
+    TRY(napi_create_array_with_length(env, g->spec_count, &specs));
+    for (size_t i = 0; i < g->spec_count; i++) {
+        TRY(napi_create_string_utf8(env, g->pool + g->spec_off[i], g->spec_len[i], &value));
+        TRY(napi_set_element(env, specs, (uint32_t)i, value));
+    }
+    TRY(napi_set_named_property(env, obj, "specifiers", specs));
+    TRY(typed_array(env, napi_uint32_array, g->edges, g->edge_count * 2, sizeof(uint32_t), &value));
+    TRY(napi_set_named_property(env, obj, "edges", value));
+    TRY(typed_array(env, napi_uint8_array, g->edge_kinds, g->edge_count, 1, &value));
+    TRY(napi_set_named_property(env, obj, "edgeKinds", value));
+    TRY(napi_create_double(env, (double)job->elapsed_ns / 1e6, &value));
+    TRY(napi_set_named_property(env, obj, "elapsedMs", value));
+#undef TRY
+    *out = obj;
+    return napi_ok;
+}
+
+static void PrescanComplete(napi_env env, napi_status status, void* data) {
+    PrescanJob* job = data;
+    napi_value value, message;
+    if (status == napi_ok && !job->error && prescan_result(env, job, &value) == napi_ok) {
+        napi_resolve_deferred(env, job->deferred, value);
+    } else {
+        const char* text = job->error ? job->error : "prescan: failed to build result";
+        napi_create_string_utf8(env, text, NAPI_AUTO_LENGTH, &message);
+        napi_create_error(env, NULL, message, &value);
+        napi_reject_deferred(env, job->deferred, value);
+    }
+    napi_delete_async_work(env, job->work);
+    prescan_job_free(job);
+}
+
+static char* napi_strdup(napi_env env, napi_value v, size_t* len_out) {
+    size_t len;
+    if (napi_get_value_string_utf8(env, v, NULL, 0, &len) != napi_ok) return NULL;
+    char* s = malloc(len + 1);
+    if (s && napi_get_value_string_utf8(env, v, s, len + 1, &len) != napi_ok) {
+        free(s);
+        return NULL;
+    }
+    if (len_out) *len_out = len;
+    return s;
+}
+
+static int prescan_add_glob(PrescanJob* job, napi_env env, napi_value v, size_t* cap) {
+    size_t len;
+    char* g = napi_strdup(env, v, &len);
+    if (!g) return -1;
+    const char* p = g;
+    if (len >= 2 && p[0] == '.' && p[1] == '/') {
+        p += 2;
+        len -= 2;
+    }
+    int rc = expand_braces(&job->ps, p, len, cap);
+    free(g);
+    return rc;
+}
+
+// prescan(rootDir: string, globs?: string | string[]): Promise<graph>
+static napi_value Prescan(napi_env env, napi_callback_info info) {
+    size_t argc = 2;
+    napi_value argv[2];
+    if (napi_get_cb_info(env, info, &argc, argv, NULL, NULL) != napi_ok) return NULL;
+    napi_valuetype type = napi_undefined;
+    if (argc > 0) napi_typeof(env, argv[0], &type);
+    if (type != napi_string) {
+        napi_throw_type_error(env, NULL, "prescan: rootDir must be a string");
+        return NULL;
+    }
+
+    PrescanJob* job = calloc(1, sizeof(PrescanJob));
+    if (!job) {
+        napi_throw_error(env, NULL, "prescan: out of memory");
+        return NULL;
+    }
+    size_t root_len = 0;
+    job->root = napi_strdup(env, argv[0], &root_len);
+    while (job->root && root_len > 1 && job->root[root_len - 1] == '/') job->root[--root_len] = '\0';
+    // Absolute paths, so cache keys match the ones Bun passes to onBeforeParse
+    char* real = job->root ? realpath(job->root, NULL) : NULL;
+    if (real) {
+        free(job->root);
+        job->root = real;
+        root_len = strlen(real);
+    }
+    job->ps.root = job->root;
+    job->ps.root_len = root_len;
+
+    int ok = job->root != NULL;
+    size_t cap = 0;
+    type = napi_undefined;
+    if (ok && argc > 1) napi_typeof(env, argv[1], &type);
+    if (ok && type == napi_string) {
+        ok = prescan_add_glob(job, env, argv[1], &cap) == 0;
+    } else if (ok && type == napi_object) {
+        uint32_t n = 0;
+        napi_get_array_length(env, argv[1], &n);
+        for (uint32_t i = 0; ok && i < n; i++) {
+            napi_value item;
+            napi_valuetype item_type = napi_undefined;
+            ok = napi_get_element(env, argv[1], i, &item) == napi_ok;
+            if (ok) napi_typeof(env, item, &item_type);
+            if (ok && item_type == napi_string) ok = prescan_add_glob(job, env, item, &cap) == 0;
+        }
+    }
+
+    napi_value promise, name;
+    if (!ok || napi_create_promise(env, &job->deferred, &promise) != napi_ok ||
+        napi_create_string_utf8(env, "prescan", NAPI_AUTO_LENGTH, &name) != napi_ok ||
+        napi_create_async_work(env, NULL, name, PrescanExecute, PrescanComplete, job, &job->work) != napi_ok ||
+        napi_queue_async_work(env, job->work) != napi_ok) {
+        prescan_job_free(job);
+        napi_throw_error(env, NULL, "prescan: could not start");
+        return NULL;
+    }
+    return promise;
+}
+#endif
+
 // Module initialization
 static napi_value Init(napi_env env, napi_value exports) {
-    napi_status status;
-    napi_value fn;
-    
-    // Export the onBeforeParse hook
-    status = napi_create_function(env, NULL, 0, onBeforeParse, NULL, &fn);
-    if (status != napi_ok) return NULL;
-    
-    status = napi_set_named_property(env, exports, "onBeforeParse", fn);
-    if (status != napi_ok) return NULL;
-    
-    printf("🚀 Native plugin loaded successfully!\n");
-    printf("⚡ Running on native threads - no UTF-8 conversion overhead!\n");
-    
+    static const struct {
+        const char* name;
+        napi_callback cb;
+    } k_exports[] = {
+        { "getStats", GetStats },
+        { "setLogLevel", SetLogLevel },
+        { "setTrace", SetTrace },
+#ifndef _WIN32
+        { "prescan", Prescan },
+#endif
+    };
+    for (size_t i = 0; i < sizeof(k_exports) / sizeof(k_exports[0]); i++) {
+        napi_value fn;
+        if (napi_create_function(env, k_exports[i].name, NAPI_AUTO_LENGTH, k_exports[i].cb, NULL, &fn) != napi_ok ||
+            napi_set_named_property(env, exports, k_exports[i].name, fn) != napi_ok) {
+            return NULL;
+        }
+    }
+
+    if (log_enabled(LOG_INFO)) log_push(LOG_EV_LOADED, 0, 0, 0, 0, 0, 0, NULL, 0);
+
     return exports;
 }
 
@@ -0,0 +1,320 @@
+// native-plugin-demo behaviour: the exported JS functions directly, the
+// onBeforeParse hooks through Bun.build
+//
+// Needs a node-gyp build in build/Release; skipped otherwise.
+//
+//   bun test examples/native-plugin
+
+import { afterAll, describe, expect, test } from "bun:test";
+import { spawnSync } from "node:child_process";
+import { existsSync, mkdirSync, mkdtempSync, readFileSync, rmSync, writeFileSync } from "node:fs";
+import { tmpdir } from "node:os";
+import { join } from "node:path";
+import { loadNativePlugin } from "./native-plugin-loader";
+
+function load(): { module: any; path: string } | null {
+  try {
+    return loadNativePlugin();
+  } catch {
+    return null;
+  }
+}
+
+const dir = mkdtempSync(join(tmpdir(), "native-plugin-test-"));
+let fileNo = 0;
+
+// Read on the first hook call; keeps the scan cache out of the project
+const cachePath = join(dir, "scan-cache.bin");
+process.env.NATIVE_PLUGIN_CACHE = cachePath;
+
+const loaded = load();
+const plugin = loaded?.module;
+
+afterAll(() => {
+  rmSync(dir, { recursive: true, force: true });
+});
+
+function scratch(): string {
+  const sub = join(dir, String(fileNo++));
+  mkdirSync(sub);
+  return sub;
+}
+
+// Specifiers prescan() finds in `source`, in order
+async function specifiers(source: string, ext = "ts"): Promise<string[]> {
+  const sub = scratch();
+  writeFileSync(join(sub, `input.${ext}`), source);
+  const graph = await plugin.prescan(sub, `**/*.${ext}`);
+  const found: string[] = [];
+  for (let e = 0; e < graph.edges.length; e += 2) found.push(graph.specifiers[graph.edges[e + 1]]);
+  return found;
+}
+
+// The scanner behind onBeforeParse, run through prescan()
+// Run `symbol` over `files` (name -> source, written to `sub`) through
+// Bun.build; outputs in entrypoint order
+async function runHook(symbol: string, files: Record<string, string>, sub = scratch()): Promise<string[]> {
+  const entrypoints = Object.entries(files).map(([name, source]) => {
+    writeFileSync(join(sub, name), source);
+    return join(sub, name);
+  });
+  const result = await Bun.build({
+    entrypoints,
+    external: ["*"],
+    plugins: [
+      {
+        name: "native-plugin-demo",
+        setup(build) {
+          build.onBeforeParse({ filter: /\.(?:[cm]?[jt]sx?|css)$/ }, { napiModule: plugin, symbol });
+        },
+      },
+    ],
+  });
+  expect(result.success).toBe(true);
+  return Promise.all(result.outputs.map((o) => o.text()));
+}
+
+describe.skipIf(!plugin)("native-plugin-demo import scanner", () => {
+  test("finds static, dynamic, re-export and require specifiers", async () => {
+    const source = [
+      `import a from "./a";`,
+      `import { b } from './b';`,
+      `import "./side-effect";`,
+      `import type { T } from "./types";`,
+      `export * from "./star";`,
+      `export { c } from "./c";`,
+      `const d = await import("./d");`,
+      `const e = require('./e');`,
+    ].join("\n");
+    expect(await specifiers(source)).toEqual(["./a", "./b", "./side-effect", "./types", "./star", "./c", "./d", "./e"]);
+  });
+
+  test("ignores imports inside comments", async () => {
+    const source = `// import x from "./line"\n/* import("./block") */\nimport y from "./real";`;
+    expect(await specifiers(source)).toEqual(["./real"]);
+  });
+
+  test("ignores imports inside strings and templates", async () => {
+    const source = [
+      `const s = "import x from './double'";`,
+      `const t = 'require("./single")';`,
+      "const u = `import(\"./template\") ${require(\"./in-expression\")} ${`import \"./nested\"`}`;",
+      `import z from "./after";`,
+    ].join("\n");
+    expect(await specifiers(source)).toEqual(["./in-expression", "./after"]);
+  });
+
+  test("tells regex literals from division", async () => {
+    const source = [
+      `const r = /import("\\.\\/regex")/g;`,
+      `const q = a / b; import("./after-division");`,
+      `if (/require\\('x'\\)/.test(s)) require("./after-regex");`,
+    ].join("\n");
+    expect(await specifiers(source)).toEqual(["./after-division", "./after-regex"]);
+  });
+
+  test("skips member calls and identifiers that contain a keyword", async () => {
+    const source = `obj.import("./member"); reimport("./prefixed"); myrequire("./ident"); require("./real");`;
+    expect(await specifiers(source)).toEqual(["./real"]);
+  });
+
+  test("reads CSS @import", async () => {
+    const source = `/* @import "./commented.css"; */\n@import "./theme.css";\n@import url(./grid.css);`;
+    expect(await specifiers(source, "css")).toEqual(["./theme.css", "./grid.css"]);
+  });
+});
+
+describe.skipIf(!plugin)("native-plugin-demo getStats()", () => {
+  test("sums files, bytes and imports over every hook call", async () => {
+    const before = plugin.getStats();
+    const a = `import x from "pkg-a";\nimport { y } from "pkg-b";\nconsole.log(x, y);\n`;
+    const b = `export * from "pkg-c";\n`;
+    await runHook("onBeforeParse", { "a.ts": a, "b.js": b });
+    const after = plugin.getStats();
+    expect(after.files - before.files).toBe(2);
+    expect(after.bytes - before.bytes).toBe(a.length + b.length);
+    expect(after.imports - before.imports).toBe(3);
+    expect(after.nanoseconds).toBeGreaterThan(before.nanoseconds);
+    expect(after.threads).toBeGreaterThan(0);
+    expect(Object.keys(after).sort()).toEqual(["bytes", "cacheHits", "files", "imports", "logDropped", "nanoseconds", "threads"]);
+  });
+});
+
+describe.skipIf(!plugin)("native-plugin-demo scan cache", () => {
+  test("serves unchanged files from NATIVE_PLUGIN_CACHE", async () => {
+    const sub = scratch();
+    const source = `import x from "pkg-cached";\nconsole.log(x);\n`;
+    // getStats() deltas over one hook call
+    const delta = async (content: string) => {
+      const before = plugin.getStats();
+      await runHook("onBeforeParse", { "a.ts": content }, sub);
+      const after = plugin.getStats();
+      return { hits: after.cacheHits - before.cacheHits, imports: after.imports - before.imports };
+    };
+
+    expect(await delta(source)).toEqual({ hits: 0, imports: 1 });
+    expect(existsSync(cachePath)).toBe(true);
+    expect(await delta(source)).toEqual({ hits: 1, imports: 1 }); // a hit reports what the scan found
+    expect(await delta(`${source}import "pkg-new";\n`)).toEqual({ hits: 0, imports: 2 }); // content changed
+  });
+
+  test("prescan() fills the cache for the hook calls that follow", async () => {
+    const sub = scratch();
+    const source = `export { y } from "pkg-prescanned";\n`;
+    writeFileSync(join(sub, "b.ts"), source);
+    await plugin.prescan(sub, "**/*.ts");
+    const h = plugin.getStats().cacheHits;
+    await runHook("onBeforeParse", { "b.ts": source }, sub);
+    expect(plugin.getStats().cacheHits - h).toBe(1);
+  });
+});
+
+describe.skipIf(!plugin)("native-plugin-demo setLogLevel()", () => {
+  test("takes names or numbers and returns the level in effect", () => {
+    const initial = plugin.setLogLevel(); // no argument: just read it
+    try {
+      expect(plugin.setLogLevel("off")).toBe(0);
+      expect(plugin.setLogLevel("debug")).toBe(2);
+      expect(plugin.setLogLevel(1)).toBe(1);
+      expect(plugin.setLogLevel("loud")).toBe(1); // unknown names keep the level
+      expect(plugin.setLogLevel(7)).toBe(1);
+      expect(plugin.setLogLevel()).toBe(1);
+    } finally {
+      plugin.setLogLevel(initial);
+    }
+  });
+});
+
+describe.skipIf(!plugin)("native-plugin-demo file kinds", () => {
+  // FileKind in native-plugin-demo.c
+  const KIND = { other: 0, ts: 1, tsx: 2, mts: 3, cts: 4, js: 5, jsx: 6, mjs: 7, cjs: 8, json: 9, css: 10 };
+
+  test("classifies by extension alone, case-insensitively", async () => {
+    const sub = scratch();
+    const names: Record<string, number> = {
+      "a.ts": KIND.ts,
+      "b.d.ts": KIND.ts,
+      "C.TSX": KIND.tsx,
+      "d.mts": KIND.mts,
+      "e.cts": KIND.cts,
+      "f.js": KIND.js,
+      "g.Jsx": KIND.jsx,
+      "h.mjs": KIND.mjs,
+      "i.cjs": KIND.cjs,
+      "j.json": KIND.json,
+      "k.css": KIND.css,
+      "ts.txt": KIND.other,
+      "l.tsx.bak": KIND.other,
+      "m.jsonc": KIND.other,
+      "noext": KIND.other,
+    };
+    for (const name of Object.keys(names)) writeFileSync(join(sub, name), "");
+    const graph = await plugin.prescan(sub, "**/*");
+    const found: Record<string, number> = {};
+    graph.files.forEach((file: string, i: number) => (found[file.slice(sub.length + 1)] = graph.kinds[i]));
+    expect(found).toEqual(names);
+  });
+
+  test("without globs picks only JS, TS and CSS files", async () => {
+    const sub = scratch();
+    for (const name of ["a.ts", "b.mjs", "c.css", "d.json", "e.txt"]) writeFileSync(join(sub, name), "");
+    const graph = await plugin.prescan(sub);
+    expect([...graph.files].map((f: string) => f.slice(sub.length + 1)).sort()).toEqual(["a.ts", "b.mjs", "c.css"]);
+  });
+});
+
+describe.skipIf(!plugin)("native-plugin-demo prescan()", () => {
+  test("walks deep and wide trees and interns specifiers across files", async () => {
+    const sub = scratch();
+    let deep = sub;
+    for (let d = 0; d < 40; d++) {
+      deep = join(deep, `d${d}`);
+      mkdirSync(deep);
+      writeFileSync(join(deep, "m.ts"), `import "shared";\nimport "./d${d}";\n`);
+    }
+    const wide = join(sub, "wide");
+    mkdirSync(wide);
+    for (let f = 0; f < 300; f++) writeFileSync(join(wide, `w${f}.js`), `require("shared");\n`);
+    mkdirSync(join(sub, "node_modules"));
+    writeFileSync(join(sub, "node_modules", "skipped.ts"), `import "hidden";\n`);
+
+    const [graph, again] = await Promise.all([plugin.prescan(sub), plugin.prescan(sub)]);
+    expect(graph.files).toHaveLength(340);
+    expect(again.files).toHaveLength(340);
+    expect(graph.edges).toHaveLength(2 * (40 * 2 + 300));
+    expect(graph.edgeKinds).toHaveLength(40 * 2 + 300);
+    expect([...graph.specifiers].sort()).toEqual(["shared", ...Array.from({ length: 40 }, (_, d) => `./d${d}`)].sort());
+    expect(graph.elapsedMs).toBeGreaterThanOrEqual(0);
+  });
+
+  test("rejects a root that is not a directory", async () => {
+    await expect(plugin.prescan(join(dir, "missing"))).rejects.toThrow("not a readable directory");
+  });
+});
+
+describe.skipIf(!plugin)("native-plugin-demo onBeforeParseTransform", () => {
+  // node_env_literal(): NODE_ENV when set, else "production"
+  const nodeEnv = process.env.NODE_ENV || "production";
+  const uses = (text: string) => text.split(nodeEnv).length - 1;
+
+  test("replaces process.env.NODE_ENV in code and template expressions only", async () => {
+    const source = [
+      "const re = /process.env.NODE_ENV/g;",
+      "const a = 1 / 2 / process.env.NODE_ENV;",
+      "const t = `${process.env.NODE_ENV}-x-${`${process.env.NODE_ENV}`}`;",
+      `const s = "process.env.NODE_ENV";`,
+      "const m = obj.process.env.NODE_ENV;",
+      "const n = myprocess.env.NODE_ENV;",
+      "// process.env.NODE_ENV",
+      "export { re, a, t, s, m, n };",
+    ].join("\n");
+    expect(uses(source)).toBe(0);
+    const [out] = await runHook("onBeforeParseTransform", { "a.ts": source });
+    expect(uses(out)).toBe(3);
+    expect(out).toContain("/process.env.NODE_ENV/g");
+    expect(out).toContain(`"process.env.NODE_ENV"`);
+    expect(out).toContain("obj.process.env.NODE_ENV");
+    expect(out).toContain("myprocess.env.NODE_ENV");
+  });
+
+  test("leaves JSON and CSS untouched", async () => {
+    const [json, css] = await runHook("onBeforeParseTransform", {
+      "a.json": `{ "k": 1 }`,
+      "b.css": `a::after { content: "process.env.NODE_ENV"; }`,
+    });
+    expect(uses(json + css)).toBe(0);
+  });
+});
+
+describe.skipIf(!plugin)("native-plugin-demo setTrace()", () => {
+  test("turns recording on for a path and off without one", () => {
+    expect(plugin.setTrace(join(dir, "unused-trace.json"))).toBe(true);
+    expect(plugin.setTrace("")).toBe(false);
+    expect(plugin.setTrace(join(dir, "unused-trace.json"))).toBe(true);
+    expect(plugin.setTrace()).toBe(false);
+    expect(plugin.setTrace(null)).toBe(false);
+    expect(() => plugin.setTrace(42)).toThrow(TypeError);
+  });
+
+  // The trace is written at exit, so record in a child process
+  test("writes hook calls as Chrome trace events at exit", () => {
+    const sub = scratch();
+    writeFileSync(join(sub, "a.ts"), `import "x";\nimport "y";\n`);
+    const trace = join(dir, "trace.json");
+    const script = [
+      `const plugin = require(${JSON.stringify(loaded!.path)});`,
+      `plugin.setTrace(${JSON.stringify(trace)});`,
+      `plugin.prescan(${JSON.stringify(sub)}).then(() => process.exit(0));`,
+    ].join("\n");
+    const child = spawnSync(process.execPath, ["-e", script], { encoding: "utf8" });
+    expect(child.status).toBe(0);
+
+    const { traceEvents } = JSON.parse(readFileSync(trace, "utf8"));
+    expect(traceEvents.find((e: any) => e.ph === "M" && e.name === "process_name")?.pid).toBe(child.pid);
+    const calls = traceEvents.filter((e: any) => e.ph === "X");
+    expect(calls.map((e: any) => e.cat)).toContain("prescan");
+    const scan = calls.find((e: any) => e.cat === "prescan");
+    expect(scan.dur).toBeGreaterThanOrEqual(0);
+    expect(scan.args).toMatchObject({ imports: 2, cached: false });
+  });
+});
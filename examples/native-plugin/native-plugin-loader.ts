@@ -0,0 +1,92 @@
+// Loader for the native-plugin-demo addon
+//
+// binding.gyp builds the baseline native-plugin-demo.node and, on x64, the
+// -march=x86-64-v2 / -march=x86-64-v3 variants as separate .node files.
+// loadNativePlugin() picks the best one the host CPU can run so the SIMD
+// scanners get the wider paths, falling back to the baseline build.
+// NATIVE_PLUGIN_VARIANT=baseline|x86-64-v2|x86-64-v3 forces a choice.
+//
+//   const { module } = loadNativePlugin();
+//   build.onBeforeParse({ filter: "**/*.ts" }, { napiModule: module, symbol: "onBeforeParse" });
+
+import { spawnSync } from "node:child_process";
+import { existsSync, readFileSync } from "node:fs";
+import { createRequire } from "node:module";
+import { dirname, join } from "node:path";
+import { fileURLToPath } from "node:url";
+
+const require = createRequire(import.meta.url);
+
+export type NativePluginVariant = "x86-64-v3" | "x86-64-v2" | "baseline";
+
+// Feature names as /proc/cpuinfo spells them (abm = lzcnt)
+const X86_64_V2 = ["cx16", "popcnt", "sse4_1", "sse4_2", "ssse3"];
+const X86_64_V3 = [...X86_64_V2, "avx", "avx2", "bmi1", "bmi2", "f16c", "fma", "abm", "movbe"];
+
+function cpuFlags(): Set<string> {
+  try {
+    if (process.platform === "linux") {
+      const flags = readFileSync("/proc/cpuinfo", "utf8")
+        .split("\n")
+        .find((line) => line.startsWith("flags"));
+      return new Set(flags?.split(":")[1]?.trim().split(/\s+/) ?? []);
+    }
+    if (process.platform === "darwin") {
+      const out = spawnSync("sysctl", ["-n", "machdep.cpu.features", "machdep.cpu.leaf7_features", "machdep.cpu.extfeatures"], {
+        encoding: "utf8",
+      }).stdout;
+      // "SSE4.2 AVX1.0 LZCNT ..." -> cpuinfo spelling
+      const names = (out ?? "").toLowerCase().split(/\s+/).map((f) =>
+        f === "avx1.0" ? "avx" : f === "lzcnt" ? "abm" : f.replace(".", "_"),
+      );
+      return new Set(names);
+    }
+  } catch {
+    // Unknown CPU: baseline only
+  }
+  return new Set();
+}
+
+/**
+ * Variants this host can run, best first
+ */
+export function supportedVariants(): NativePluginVariant[] {
+  if (process.arch !== "x64") {
+    return ["baseline"];
+  }
+  const flags = cpuFlags();
+  const has = (list: string[]) => list.every((f) => flags.has(f));
+  const variants: NativePluginVariant[] = [];
+  if (has(X86_64_V3)) variants.push("x86-64-v3");
+  if (has(X86_64_V2)) variants.push("x86-64-v2");
+  variants.push("baseline");
+  return variants;
+}
+
+/**
+ * Load the best native-plugin-demo build found in `buildDir`
+ */
+export function loadNativePlugin(buildDir: string = join(dirname(fileURLToPath(import.meta.url)), "build", "Release")): {
+  module: any;
+  variant: NativePluginVariant;
+  path: string;
+} {
+  const forced = process.env.NATIVE_PLUGIN_VARIANT as NativePluginVariant | undefined;
+  const candidates = forced ? [forced] : supportedVariants();
+  const errors: string[] = [];
+
+  for (const variant of candidates) {
+    const file = variant === "baseline" ? "native-plugin-demo.node" : `native-plugin-demo-${variant}.node`;
+    const path = join(buildDir, file);
+    if (!existsSync(path)) {
+      errors.push(`${file}: not built`);
+      continue;
+    }
+    try {
+      return { module: require(path), variant, path };
+    } catch (e) {
+      errors.push(`${file}: ${(e as Error).message}`);
+    }
+  }
+  throw new Error(`native-plugin-demo: no loadable build in ${buildDir}\n  ${errors.join("\n  ")}`);
+}
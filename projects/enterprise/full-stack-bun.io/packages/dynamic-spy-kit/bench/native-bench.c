@@ -0,0 +1,829 @@
+/**
+ * Native benchmark harness for ffi_matcher.c and native-plugin-demo.c
+ *
+ * Loads the built artifacts the same way production does (the matcher
+ * shared library the FFI wrapper opens, the plugin .node Bun loads) and
+ * replays a URL corpus through the matcher and a source corpus through the
+ * plugin's onBeforeParse hook. Per benchmark it reports throughput,
+ * p50/p99/p999 latency, heap allocations per op and, where perf_event_open
+ * is allowed, cycles / instructions / cache misses per op.
+ *
+ * Build and run (Linux; -rdynamic lets the loaded libraries see the
+ * allocation counters):
+ *
+ *   cc -O2 -shared -fPIC -o /tmp/libffi_matcher.so src/ffi_matcher.c src/line_movement.c src/market_snapshot.c src/arb_engine.c
+ *   cc -O2 -rdynamic -o /tmp/native-bench bench/native-bench.c -ldl
+ *   /tmp/native-bench --matcher /tmp/libffi_matcher.so \
+ *     --plugin ../../../../examples/native-plugin/build/Release/native-plugin-demo.node
+ *
+ * Corpora (synthetic, fixed-seed ones are used when omitted):
+ *   --patterns FILE   "hostname pathname [priority]" per line, # comments
+ *   --urls FILE       one URL per line
+ *   --sources DIR     every .js/.ts/.css-family file below DIR
+ *
+ * Regression gate:
+ *   --save FILE       write "bench.metric value" lines
+ *   --compare FILE    exit 1 if ops/s drops or p99 grows by more than
+ *                     --tolerance (default 0.10), or allocs/op grows
+ */
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <ftw.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+// ---------------------------------------------------------------------------
+// Allocation counting
+//
+// glibc's __libc_* entry points let the harness wrap the allocator without
+// dlsym recursion. Other libcs report allocs/op as n/a.
+// ---------------------------------------------------------------------------
+
+#if defined(__GLIBC__)
+#define HAVE_ALLOC_COUNT 1
+extern void* __libc_malloc(size_t n);
+extern void* __libc_calloc(size_t n, size_t size);
+extern void* __libc_realloc(void* p, size_t n);
+extern void* __libc_memalign(size_t align, size_t n);
+
+static _Atomic uint64_t g_allocs;
+
+void* malloc(size_t n) {
+  atomic_fetch_add_explicit(&g_allocs, 1, memory_order_relaxed);
+  return __libc_malloc(n);
+}
+
+void* calloc(size_t n, size_t size) {
+  atomic_fetch_add_explicit(&g_allocs, 1, memory_order_relaxed);
+  return __libc_calloc(n, size);
+}
+
+void* realloc(void* p, size_t n) {
+  atomic_fetch_add_explicit(&g_allocs, 1, memory_order_relaxed);
+  return __libc_realloc(p, n);
+}
+
+int posix_memalign(void** out, size_t align, size_t n) {
+  atomic_fetch_add_explicit(&g_allocs, 1, memory_order_relaxed);
+  *out = __libc_memalign(align, n);
+  return *out ? 0 : 12;  // ENOMEM
+}
+
+static uint64_t alloc_count(void) {
+  return atomic_load_explicit(&g_allocs, memory_order_relaxed);
+}
+#else
+static uint64_t alloc_count(void) {
+  return 0;
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// Hardware counters
+// ---------------------------------------------------------------------------
+
+typedef struct {
+  int fd[3];  // cycles (group leader), instructions, cache misses
+  int ok;
+} PerfGroup;
+
+typedef struct {
+  uint64_t cycles, instructions, cache_misses;
+} PerfSample;
+
+static void perf_open(PerfGroup* pg) {
+  memset(pg, 0, sizeof(*pg));
+  pg->fd[0] = pg->fd[1] = pg->fd[2] = -1;
+#ifdef __linux__
+  static const uint64_t configs[3] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                       PERF_COUNT_HW_CACHE_MISSES };
+  for (int i = 0; i < 3; i++) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = configs[i];
+    attr.disabled = i == 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    pg->fd[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : pg->fd[0], 0);
+    if (pg->fd[i] < 0) {
+      for (int k = 0; k < i; k++) close(pg->fd[k]);
+      return;
+    }
+  }
+  pg->ok = 1;
+#endif
+}
+
+static void perf_begin(PerfGroup* pg) {
+#ifdef __linux__
+  if (!pg->ok) return;
+  ioctl(pg->fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(pg->fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#else
+  (void)pg;
+#endif
+}
+
+static PerfSample perf_end(PerfGroup* pg) {
+  PerfSample s = { 0, 0, 0 };
+#ifdef __linux__
+  uint64_t buf[4];
+  if (!pg->ok) return s;
+  ioctl(pg->fd[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+  if (read(pg->fd[0], buf, sizeof(buf)) == (ssize_t)sizeof(buf) && buf[0] == 3) {
+    s.cycles = buf[1];
+    s.instructions = buf[2];
+    s.cache_misses = buf[3];
+  }
+#else
+  (void)pg;
+#endif
+  return s;
+}
+
+// ---------------------------------------------------------------------------
+// Timing and reporting
+// ---------------------------------------------------------------------------
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+typedef struct {
+  const char* name;
+  uint64_t ops;
+  uint64_t bytes;
+  uint64_t total_ns;
+  uint64_t allocs;
+  uint32_t* lat;  // per-op ns, sorted by bench_finish
+  PerfSample perf;
+  int have_perf;
+  double ops_per_sec, p50, p99, p999;
+} BenchResult;
+
+typedef struct {
+  BenchResult* items;
+  size_t count, cap;
+} ResultList;
+
+static PerfGroup g_perf;
+static ResultList g_results;
+
+static int cmp_u32(const void* a, const void* b) {
+  uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+  return x < y ? -1 : x > y;
+}
+
+static double percentile(const uint32_t* sorted, uint64_t n, double q) {
+  if (n == 0) return 0;
+  uint64_t i = (uint64_t)(q * (double)(n - 1) + 0.5);
+  return sorted[i];
+}
+
+static void bench_begin(BenchResult* r, const char* name, uint64_t capacity) {
+  memset(r, 0, sizeof(*r));
+  r->name = name;
+  r->lat = malloc(capacity * sizeof(uint32_t));
+  if (!r->lat) {
+    fprintf(stderr, "native-bench: out of memory\n");
+    exit(2);
+  }
+  r->allocs = alloc_count();
+  perf_begin(&g_perf);
+}
+
+static void bench_record(BenchResult* r, uint64_t ns, uint64_t bytes) {
+  r->lat[r->ops++] = ns > UINT32_MAX ? UINT32_MAX : (uint32_t)ns;
+  r->total_ns += ns;
+  r->bytes += bytes;
+}
+
+static void bench_finish(BenchResult* r) {
+  r->perf = perf_end(&g_perf);
+  r->have_perf = g_perf.ok;
+  r->allocs = alloc_count() - r->allocs;
+  qsort(r->lat, r->ops, sizeof(uint32_t), cmp_u32);
+  r->ops_per_sec = r->total_ns ? (double)r->ops * 1e9 / (double)r->total_ns : 0;
+  r->p50 = percentile(r->lat, r->ops, 0.50);
+  r->p99 = percentile(r->lat, r->ops, 0.99);
+  r->p999 = percentile(r->lat, r->ops, 0.999);
+  free(r->lat);
+  r->lat = NULL;
+
+  if (g_results.count == g_results.cap) {
+    g_results.cap = g_results.cap ? g_results.cap * 2 : 8;
+    g_results.items = realloc(g_results.items, g_results.cap * sizeof(BenchResult));
+  }
+  g_results.items[g_results.count++] = *r;
+
+  double ops = r->ops ? (double)r->ops : 1;
+  printf("%-14s %10.0f ops/s %9.1f MB/s  p50 %7.0f ns  p99 %7.0f ns  p999 %7.0f ns", r->name,
+         r->ops_per_sec, r->total_ns ? (double)r->bytes * 1e3 / (double)r->total_ns : 0, r->p50, r->p99, r->p999);
+#ifdef HAVE_ALLOC_COUNT
+  printf("  allocs/op %.2f", (double)r->allocs / ops);
+#else
+  printf("  allocs/op n/a");
+#endif
+  if (r->have_perf) {
+    printf("  cyc/op %.0f  ins/op %.0f  miss/op %.2f", (double)r->perf.cycles / ops,
+           (double)r->perf.instructions / ops, (double)r->perf.cache_misses / ops);
+  } else {
+    printf("  perf n/a");
+  }
+  printf("\n");
+}
+
+// ---------------------------------------------------------------------------
+// Corpora
+// ---------------------------------------------------------------------------
+
+typedef struct {
+  char** items;
+  size_t* lens;
+  size_t count, cap;
+} Lines;
+
+static void lines_push(Lines* l, const char* s, size_t len) {
+  if (l->count == l->cap) {
+    l->cap = l->cap ? l->cap * 2 : 256;
+    l->items = realloc(l->items, l->cap * sizeof(char*));
+    l->lens = realloc(l->lens, l->cap * sizeof(size_t));
+    if (!l->items || !l->lens) {
+      fprintf(stderr, "native-bench: out of memory\n");
+      exit(2);
+    }
+  }
+  char* copy = malloc(len + 1);
+  memcpy(copy, s, len);
+  copy[len] = '\0';
+  l->items[l->count] = copy;
+  l->lens[l->count++] = len;
+}
+
+static char* read_file(const char* path, size_t* len) {
+  FILE* f = fopen(path, "rb");
+  if (!f) return NULL;
+  fseek(f, 0, SEEK_END);
+  long n = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  char* buf = n >= 0 ? malloc((size_t)n + 1) : NULL;
+  if (buf && fread(buf, 1, (size_t)n, f) != (size_t)n) {
+    free(buf);
+    buf = NULL;
+  }
+  fclose(f);
+  if (buf) {
+    buf[n] = '\0';
+    *len = (size_t)n;
+  }
+  return buf;
+}
+
+static int read_lines(const char* path, Lines* out) {
+  size_t len;
+  char* buf = read_file(path, &len);
+  if (!buf) return -1;
+  for (char* line = buf; line < buf + len;) {
+    char* nl = memchr(line, '\n', (size_t)(buf + len - line));
+    size_t n = nl ? (size_t)(nl - line) : (size_t)(buf + len - line);
+    if (n && line[n - 1] == '\r') n--;
+    if (n && line[0] != '#') lines_push(out, line, n);
+    line += (nl ? (size_t)(nl - line) + 1 : n);
+  }
+  free(buf);
+  return 0;
+}
+
+static uint64_t g_rng = 0x9E3779B97F4A7C15ull;
+
+static uint32_t rng(void) {
+  g_rng ^= g_rng << 13;
+  g_rng ^= g_rng >> 7;
+  g_rng ^= g_rng << 17;
+  return (uint32_t)(g_rng >> 16);
+}
+
+// Sportsbook-shaped patterns: literal hosts with typed groups, wildcard
+// hosts, and overlapping priorities
+static void synth_patterns(Lines* out) {
+  char line[256];
+  for (int k = 0; k < 200; k++) {
+    int n = snprintf(line, sizeof(line), "book%d.com /odds/:sport/:id(\\d+) %d", k, k % 100);
+    lines_push(out, line, (size_t)n);
+    n = snprintf(line, sizeof(line), "api.book%d.com /v1/markets/:market/lines %d", k, 50);
+    lines_push(out, line, (size_t)n);
+  }
+  for (int k = 0; k < 50; k++) {
+    int n = snprintf(line, sizeof(line), "*.live%d.net /line/* %d", k, 10);
+    lines_push(out, line, (size_t)n);
+  }
+}
+
+static void synth_urls(Lines* out, size_t count) {
+  static const char* const sports[] = { "nba", "nfl", "mlb", "nhl", "soccer" };
+  char line[256];
+  for (size_t i = 0; i < count; i++) {
+    uint32_t r = rng();
+    int n;
+    switch (r % 4) {
+    case 0:
+      n = snprintf(line, sizeof(line), "https://book%u.com/odds/%s/%u", r % 200, sports[(r >> 8) % 5], r >> 12);
+      break;
+    case 1:
+      n = snprintf(line, sizeof(line), "https://api.book%u.com/v1/markets/m%u/lines?live=1", r % 200, r >> 10);
+      break;
+    case 2:
+      n = snprintf(line, sizeof(line), "https://eu%u.live%u.net/line/%u/total", r % 7, r % 50, r >> 9);
+      break;
+    default:  // miss
+      n = snprintf(line, sizeof(line), "https://unknown%u.org/odds/nba/%u", r % 1000, r >> 12);
+      break;
+    }
+    lines_push(out, line, (size_t)n);
+  }
+}
+
+// Module-shaped sources: imports, comments, strings, templates, regexes
+static void synth_sources(Lines* paths, Lines* bodies, size_t count) {
+  char* buf = malloc(64 * 1024);
+  for (size_t i = 0; i < count; i++) {
+    size_t n = 0, target = 1024 + rng() % (16 * 1024);
+    n += (size_t)sprintf(buf + n, "// module %zu\nimport { a%zu, b } from \"./dep%u\";\nimport * as ns from '@scope/pkg%u';\n",
+                         i, i, rng() % 500, rng() % 40);
+    while (n < target) {
+      switch (rng() % 5) {
+      case 0:
+        n += (size_t)sprintf(buf + n, "export function f%u(x: number): string {\n  return `v${x + %u}` + \"import 'no'\";\n}\n",
+                             rng(), rng() % 10);
+        break;
+      case 1:
+        n += (size_t)sprintf(buf + n, "/* import x from 'comment' */\nconst re%u = /['\"]/g, q = a / b / c;\n", rng());
+        break;
+      case 2:
+        n += (size_t)sprintf(buf + n, "const lazy%u = await import(\"./lazy%u\");\n", rng(), rng() % 300);
+        break;
+      case 3:
+        n += (size_t)sprintf(buf + n, "export { x%u } from './re%u';\n", rng(), rng() % 300);
+        break;
+      default:
+        n += (size_t)sprintf(buf + n, "if (items.length > %u) { items.forEach((it) => it.render()); }\n", rng() % 99);
+        break;
+      }
+    }
+    char path[64];
+    int pn = snprintf(path, sizeof(path), "/bench/src/module%zu.ts", i);
+    lines_push(paths, path, (size_t)pn);
+    lines_push(bodies, buf, n);
+  }
+  free(buf);
+}
+
+static Lines* g_walk_paths;
+static Lines* g_walk_bodies;
+
+static int walk_source(const char* path, const struct stat* st, int type, struct FTW* ftw) {
+  (void)st;
+  (void)ftw;
+  static const char* const exts[] = { ".ts", ".tsx", ".mts", ".cts", ".js", ".jsx", ".mjs", ".cjs", ".css" };
+  if (type != FTW_F || strstr(path, "/node_modules/")) return 0;
+  size_t len = strlen(path);
+  for (size_t i = 0; i < sizeof(exts) / sizeof(exts[0]); i++) {
+    size_t el = strlen(exts[i]);
+    if (len > el && strcmp(path + len - el, exts[i]) == 0) {
+      size_t n;
+      char* body = read_file(path, &n);
+      if (body) {
+        lines_push(g_walk_paths, path, len);
+        lines_push(g_walk_bodies, body, n);
+        free(body);
+      }
+      break;
+    }
+  }
+  return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Matcher benchmarks
+// ---------------------------------------------------------------------------
+
+typedef struct PatternSet PatternSet;
+
+typedef struct {
+  PatternSet* (*set_create)(void);
+  int32_t (*set_add_priority)(PatternSet*, const char*, const char*, int32_t);
+  int (*set_compile)(PatternSet*);
+  void (*set_activate)(PatternSet*);
+  int (*arena_reset)(void*, uint32_t);
+  int64_t (*url_arena)(PatternSet*, void*, const char*, uint32_t);
+  int32_t (*url_arena_all)(PatternSet*, void*, const char*, uint32_t, uint32_t*, uint32_t);
+  void* (*url_parts)(const char*, size_t, const char*, size_t);
+  void (*free_match)(void*);
+  uint32_t (*url_batch)(PatternSet*, const char*, const uint32_t*, const uint32_t*, uint32_t, int32_t*, double*,
+                        uint32_t*, uint32_t*, uint64_t*, uint32_t);
+  const char* (*simd_level)(void);
+} MatcherApi;
+
+#define LOAD(api, lib, field, sym)                                              \
+  do {                                                                          \
+    *(void**)&(api)->field = dlsym(lib, sym);                                   \
+    if (!(api)->field) {                                                        \
+      fprintf(stderr, "native-bench: %s missing from matcher library\n", sym);  \
+      return -1;                                                                \
+    }                                                                           \
+  } while (0)
+
+static int matcher_load(const char* path, MatcherApi* api) {
+  void* lib = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+  if (!lib) {
+    fprintf(stderr, "native-bench: %s\n", dlerror());
+    return -1;
+  }
+  LOAD(api, lib, set_create, "pattern_set_create");
+  LOAD(api, lib, set_add_priority, "pattern_set_add_priority");
+  LOAD(api, lib, set_compile, "pattern_set_compile");
+  LOAD(api, lib, set_activate, "pattern_set_activate");
+  LOAD(api, lib, arena_reset, "match_arena_reset");
+  LOAD(api, lib, url_arena, "match_url_arena");
+  LOAD(api, lib, url_arena_all, "match_url_arena_all");
+  LOAD(api, lib, url_parts, "match_url_parts");
+  LOAD(api, lib, free_match, "free_pattern_match");
+  LOAD(api, lib, url_batch, "match_url_batch");
+  LOAD(api, lib, simd_level, "matcher_simd_level");
+  return 0;
+}
+
+// "host path [priority]" -> NUL-separated fields in place
+static int parse_pattern(char* line, const char** host, const char** path, int32_t* priority) {
+  char* save = NULL;
+  *host = strtok_r(line, " \t", &save);
+  *path = strtok_r(NULL, " \t", &save);
+  const char* prio = strtok_r(NULL, " \t", &save);
+  *priority = prio ? (int32_t)strtol(prio, NULL, 10) : 0;
+  return *host && *path ? 0 : -1;
+}
+
+// Host and path slices of a URL, for match_url_parts
+static void split_parts(const char* url, size_t len, const char** host, size_t* host_len, const char** path,
+                        size_t* path_len) {
+  const char* s = url;
+  const char* end = url + len;
+  const char* scheme = strstr(url, "://");
+  if (scheme && scheme < end) s = scheme + 3;
+  const char* slash = memchr(s, '/', (size_t)(end - s));
+  *host = s;
+  *host_len = (size_t)((slash ? slash : end) - s);
+  *path = slash ? slash : end;
+  *path_len = (size_t)(end - *path);
+}
+
+static int bench_matcher(const char* lib, Lines* patterns, Lines* urls, uint32_t rounds) {
+  MatcherApi api;
+  if (matcher_load(lib, &api) != 0) return -1;
+
+  PatternSet* set = api.set_create();
+  size_t added = 0;
+  for (size_t i = 0; i < patterns->count; i++) {
+    const char *host, *path;
+    int32_t priority;
+    char* line = strdup(patterns->items[i]);
+    if (parse_pattern(line, &host, &path, &priority) == 0 && api.set_add_priority(set, host, path, priority) >= 0) {
+      added++;
+    }
+    free(line);
+  }
+  if (api.set_compile(set) != 0) {
+    fprintf(stderr, "native-bench: pattern set failed to compile\n");
+    return -1;
+  }
+  api.set_activate(set);
+  printf("matcher: %zu patterns, %zu urls, simd %s\n", added, urls->count, api.simd_level());
+
+  uint64_t n = (uint64_t)urls->count * rounds;
+  static uint64_t arena[64 * 1024 / 8];
+  BenchResult r;
+
+  bench_begin(&r, "match_arena", n);
+  for (uint32_t round = 0; round < rounds; round++) {
+    for (size_t i = 0; i < urls->count; i++) {
+      uint64_t t0 = now_ns();
+      api.arena_reset(arena, sizeof(arena));
+      api.url_arena(set, arena, urls->items[i], (uint32_t)urls->lens[i]);
+      bench_record(&r, now_ns() - t0, urls->lens[i]);
+    }
+  }
+  bench_finish(&r);
+
+  uint32_t offsets[32];
+  bench_begin(&r, "match_all", n);
+  for (uint32_t round = 0; round < rounds; round++) {
+    for (size_t i = 0; i < urls->count; i++) {
+      uint64_t t0 = now_ns();
+      api.arena_reset(arena, sizeof(arena));
+      api.url_arena_all(set, arena, urls->items[i], (uint32_t)urls->lens[i], offsets, 32);
+      bench_record(&r, now_ns() - t0, urls->lens[i]);
+    }
+  }
+  bench_finish(&r);
+
+  bench_begin(&r, "match_parts", n);
+  for (uint32_t round = 0; round < rounds; round++) {
+    for (size_t i = 0; i < urls->count; i++) {
+      const char *host, *path;
+      size_t host_len, path_len;
+      split_parts(urls->items[i], urls->lens[i], &host, &host_len, &path, &path_len);
+      uint64_t t0 = now_ns();
+      void* m = api.url_parts(host, host_len, path, path_len);
+      if (m) api.free_match(m);
+      bench_record(&r, now_ns() - t0, urls->lens[i]);
+    }
+  }
+  bench_finish(&r);
+
+  // Batches of 64 URLs; latency is per batch divided by its size
+  enum { BATCH = 64, STRIDE = 4 };
+  uint32_t off[BATCH], len[BATCH], group_off[BATCH * STRIDE], group_len[BATCH * STRIDE];
+  int32_t ids[BATCH];
+  double conf[BATCH];
+  size_t buf_cap = 0;
+  for (size_t i = 0; i < urls->count; i++) buf_cap = urls->lens[i] > buf_cap ? urls->lens[i] : buf_cap;
+  char* buf = malloc(buf_cap * BATCH + 1);
+  bench_begin(&r, "match_batch", n);
+  for (uint32_t round = 0; round < rounds; round++) {
+    for (size_t i = 0; i < urls->count; i += BATCH) {
+      uint32_t count = 0, used = 0;
+      uint64_t bytes = 0;
+      for (; count < BATCH && i + count < urls->count; count++) {
+        size_t l = urls->lens[i + count];
+        memcpy(buf + used, urls->items[i + count], l);
+        off[count] = used;
+        len[count] = (uint32_t)l;
+        used += (uint32_t)l;
+        bytes += l;
+      }
+      uint64_t t0 = now_ns();
+      api.url_batch(set, buf, off, len, count, ids, conf, group_off, group_len, NULL, STRIDE);
+      uint64_t per = (now_ns() - t0) / count;
+      for (uint32_t k = 0; k < count; k++) bench_record(&r, per, bytes / count);
+    }
+  }
+  bench_finish(&r);
+  free(buf);
+  return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Plugin benchmarks
+// ---------------------------------------------------------------------------
+
+// Layouts match the plugin's fallback declarations of Bun's ABI
+typedef struct {
+  size_t struct_size;
+  void* bun;
+  const uint8_t* path_ptr;
+  size_t path_len;
+  const uint8_t* namespace_ptr;
+  size_t namespace_len;
+  uint8_t default_loader;
+  void* external;
+} HookArgs;
+
+typedef struct HookResult {
+  size_t struct_size;
+  uint8_t* source_ptr;
+  size_t source_len;
+  uint8_t loader;
+  int (*fetch_source)(const HookArgs* args, struct HookResult* result);
+  void* plugin_source_code_context;
+  void (*free_plugin_source_code_context)(void* ctx);
+  void (*log)(const HookArgs* args, void* options);
+} HookResult;
+
+typedef void (*HookFn)(const HookArgs*, HookResult*);
+
+static const char* g_source;
+static size_t g_source_len;
+
+static int fetch_source(const HookArgs* args, HookResult* result) {
+  (void)args;
+  result->source_ptr = (uint8_t*)g_source;
+  result->source_len = g_source_len;
+  return 0;
+}
+
+static void run_hook(BenchResult* r, HookFn hook, Lines* paths, Lines* bodies, uint32_t rounds, int record) {
+  for (uint32_t round = 0; round < rounds; round++) {
+    for (size_t i = 0; i < bodies->count; i++) {
+      HookArgs args = { sizeof(HookArgs), NULL, (const uint8_t*)paths->items[i], paths->lens[i],
+                        (const uint8_t*)"file", 4, 2, NULL };
+      HookResult res = { sizeof(HookResult), NULL, 0, 0, fetch_source, NULL, NULL, NULL };
+      g_source = bodies->items[i];
+      g_source_len = bodies->lens[i];
+      uint64_t t0 = now_ns();
+      hook(&args, &res);
+      uint64_t ns = now_ns() - t0;
+      if (res.free_plugin_source_code_context) res.free_plugin_source_code_context(res.plugin_source_code_context);
+      if (record) bench_record(r, ns, bodies->lens[i]);
+    }
+  }
+}
+
+static int bench_plugin(const char* path, const char* cache, Lines* paths, Lines* bodies, uint32_t rounds) {
+  // Read once by the plugin on first use
+  setenv("NATIVE_PLUGIN_LOG", "off", 1);
+  setenv("NATIVE_PLUGIN_CACHE", cache ? cache : "", 1);
+
+  // RTLD_LAZY: the napi symbols the hooks never call stay unresolved
+  void* lib = dlopen(path, RTLD_LAZY | RTLD_LOCAL);
+  if (!lib) {
+    fprintf(stderr, "native-bench: %s\n", dlerror());
+    return -1;
+  }
+  HookFn scan = (HookFn)dlsym(lib, "onBeforeParse");
+  HookFn transform = (HookFn)dlsym(lib, "onBeforeParseTransform");
+  if (!scan) {
+    fprintf(stderr, "native-bench: onBeforeParse missing from plugin\n");
+    return -1;
+  }
+  uint64_t total = 0;
+  for (size_t i = 0; i < bodies->count; i++) total += bodies->lens[i];
+  printf("plugin: %zu files, %.1f MB, cache %s\n", bodies->count, (double)total / 1e6, cache ? cache : "off");
+
+  uint64_t n = (uint64_t)bodies->count * rounds;
+  BenchResult r;
+  if (cache) run_hook(NULL, scan, paths, bodies, 1, 0);  // warm it
+  bench_begin(&r, cache ? "scan_cached" : "scan", n);
+  run_hook(&r, scan, paths, bodies, rounds, 1);
+  bench_finish(&r);
+
+  if (transform) {
+    bench_begin(&r, "transform", n);
+    run_hook(&r, transform, paths, bodies, rounds, 1);
+    bench_finish(&r);
+  }
+  return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Regression gate
+// ---------------------------------------------------------------------------
+
+static int save_results(const char* path) {
+  FILE* f = fopen(path, "w");
+  if (!f) return -1;
+  for (size_t i = 0; i < g_results.count; i++) {
+    const BenchResult* r = &g_results.items[i];
+    double ops = r->ops ? (double)r->ops : 1;
+    fprintf(f, "%s.ops_per_sec %.1f\n%s.p50_ns %.0f\n%s.p99_ns %.0f\n%s.p999_ns %.0f\n%s.allocs_per_op %.4f\n",
+            r->name, r->ops_per_sec, r->name, r->p50, r->name, r->p99, r->name, r->p999, r->name,
+            (double)r->allocs / ops);
+  }
+  return fclose(f);
+}
+
+static int baseline_value(const char* path, const char* name, const char* metric, double* out) {
+  FILE* f = fopen(path, "r");
+  if (!f) return -1;
+  char key[128], want[128];
+  double v;
+  snprintf(want, sizeof(want), "%s.%s", name, metric);
+  int found = -1;
+  while (fscanf(f, "%127s %lf", key, &v) == 2) {
+    if (strcmp(key, want) == 0) {
+      *out = v;
+      found = 0;
+      break;
+    }
+  }
+  fclose(f);
+  return found;
+}
+
+static int compare_results(const char* path, double tolerance) {
+  int regressions = 0;
+  for (size_t i = 0; i < g_results.count; i++) {
+    const BenchResult* r = &g_results.items[i];
+    double base, allocs = (double)r->allocs / (r->ops ? (double)r->ops : 1);
+    if (baseline_value(path, r->name, "ops_per_sec", &base) == 0 && r->ops_per_sec < base * (1 - tolerance)) {
+      printf("REGRESSION %s ops/s %.0f -> %.0f\n", r->name, base, r->ops_per_sec);
+      regressions++;
+    }
+    if (baseline_value(path, r->name, "p99_ns", &base) == 0 && r->p99 > base * (1 + tolerance)) {
+      printf("REGRESSION %s p99 %.0f -> %.0f ns\n", r->name, base, r->p99);
+      regressions++;
+    }
+#ifdef HAVE_ALLOC_COUNT
+    if (baseline_value(path, r->name, "allocs_per_op", &base) == 0 && allocs > base + 0.01) {
+      printf("REGRESSION %s allocs/op %.2f -> %.2f\n", r->name, base, allocs);
+      regressions++;
+    }
+#else
+    (void)allocs;
+#endif
+  }
+  if (regressions) {
+    printf("%d regression(s) against %s\n", regressions, path);
+  } else {
+    printf("no regressions against %s\n", path);
+  }
+  return regressions;
+}
+
+static void usage(void) {
+  fprintf(stderr,
+          "usage: native-bench [--matcher LIB] [--plugin NODE] [--plugin-cache FILE]\n"
+          "                    [--patterns FILE] [--urls FILE] [--sources DIR] [--rounds N]\n"
+          "                    [--save FILE] [--compare FILE] [--tolerance F]\n");
+}
+
+int main(int argc, char** argv) {
+  const char *matcher = NULL, *plugin = NULL, *plugin_cache = NULL;
+  const char *patterns_path = NULL, *urls_path = NULL, *sources_dir = NULL;
+  const char *save = NULL, *compare = NULL;
+  double tolerance = 0.10;
+  uint32_t rounds = 20;
+
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    const char* v = i + 1 < argc ? argv[i + 1] : NULL;
+    if (!v) {
+      usage();
+      return 2;
+    }
+    if (strcmp(a, "--matcher") == 0) matcher = v;
+    else if (strcmp(a, "--plugin") == 0) plugin = v;
+    else if (strcmp(a, "--plugin-cache") == 0) plugin_cache = v;
+    else if (strcmp(a, "--patterns") == 0) patterns_path = v;
+    else if (strcmp(a, "--urls") == 0) urls_path = v;
+    else if (strcmp(a, "--sources") == 0) sources_dir = v;
+    else if (strcmp(a, "--rounds") == 0) rounds = (uint32_t)strtoul(v, NULL, 10);
+    else if (strcmp(a, "--save") == 0) save = v;
+    else if (strcmp(a, "--compare") == 0) compare = v;
+    else if (strcmp(a, "--tolerance") == 0) tolerance = strtod(v, NULL);
+    else {
+      usage();
+      return 2;
+    }
+    i++;
+  }
+  if ((!matcher && !plugin) || rounds == 0) {
+    usage();
+    return 2;
+  }
+
+  perf_open(&g_perf);
+  uint64_t t0 = now_ns();
+  for (int i = 0; i < 1000; i++) now_ns();
+  printf("timer overhead ~%.0f ns per op (included in latencies)\n", (double)(now_ns() - t0) / 1000);
+
+  if (matcher) {
+    Lines patterns = { 0 }, urls = { 0 };
+    if (patterns_path ? read_lines(patterns_path, &patterns) != 0 : (synth_patterns(&patterns), 0)) {
+      fprintf(stderr, "native-bench: cannot read %s\n", patterns_path);
+      return 2;
+    }
+    if (urls_path ? read_lines(urls_path, &urls) != 0 : (synth_urls(&urls, 10000), 0)) {
+      fprintf(stderr, "native-bench: cannot read %s\n", urls_path);
+      return 2;
+    }
+    if (bench_matcher(matcher, &patterns, &urls, rounds) != 0) return 2;
+  }
+
+  if (plugin) {
+    Lines paths = { 0 }, bodies = { 0 };
+    if (sources_dir) {
+      g_walk_paths = &paths;
+      g_walk_bodies = &bodies;
+      if (nftw(sources_dir, walk_source, 32, FTW_PHYS) != 0 || bodies.count == 0) {
+        fprintf(stderr, "native-bench: no sources under %s\n", sources_dir);
+        return 2;
+      }
+    } else {
+      synth_sources(&paths, &bodies, 500);
+    }
+    if (bench_plugin(plugin, plugin_cache, &paths, &bodies, rounds) != 0) return 2;
+  }
+
+  if (save && save_results(save) != 0) {
+    fprintf(stderr, "native-bench: cannot write %s\n", save);
+    return 2;
+  }
+  return compare && compare_results(compare, tolerance) ? 1 : 0;
+}
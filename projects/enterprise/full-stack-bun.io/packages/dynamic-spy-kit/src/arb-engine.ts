@@ -0,0 +1,350 @@
+/**
+ * @dynamic-spy/kit - Arbitrage Engine
+ *
+ * Incremental cross-bookie arbitrage over columnar price ticks. The engine
+ * keeps the best odds per (market, outcome) and updates them per tick, so
+ * a tick costs O(outcomes of its market) instead of a rescan of every
+ * bookie's prices. Ticks that open, change or close an arb (inverse best
+ * odds summing below 1 / (1 + minProfit)) come back as events. Runs in
+ * arb_engine.c (same library as the pattern matcher) when available, else
+ * in an equivalent JS loop.
+ */
+
+import { dlopen, type Pointer } from "bun:ffi";
+
+/** ArbOpportunity.kind */
+export const ARB_OPEN = 1; // market became an arb
+export const ARB_UPDATE = 2; // still an arb, best line changed
+export const ARB_CLOSE = 3; // no longer an arb
+
+export const ARB_MAX_OUTCOMES = 4;
+
+// ArbEvent layout in arb_engine.c (64 bytes)
+const EV_SIZE = 64;
+const EV_MARKET = 0;
+const EV_TICK = 4;
+const EV_KIND = 8;
+const EV_OUTCOMES = 9;
+const EV_BOOKIE = 10; // u16 x ARB_MAX_OUTCOMES
+const EV_INV_SUM = 24;
+const EV_ODDS = 32; // f64 x ARB_MAX_OUTCOMES
+
+export interface PriceTickColumns {
+	market: Uint32Array; // ids from ArbEngine.marketId()
+	outcome: Uint8Array; // 0 .. outcomes - 1
+	bookie: Uint16Array; // ids from ArbEngine.bookieId()
+	odds: Float64Array; // decimal; <= 1 pulls the bookie's price
+	count?: number; // defaults to market.length; at most the shortest column
+}
+
+export interface ArbOpportunity {
+	kind: number; // ARB_OPEN / ARB_UPDATE / ARB_CLOSE
+	market: number;
+	tick: number; // index of the tick in its batch
+	odds: number[]; // best odds per outcome
+	bookies: number[]; // bookie offering them
+	inverseSum: number;
+	profit: number; // return on total stake, 1 / inverseSum - 1
+}
+
+export interface ArbEngineOptions {
+	markets?: number;
+	outcomes?: number; // 2 for moneyline, 3 for 1X2
+	bookies?: number;
+	minProfit?: number; // 0.01 = 1%
+	libPath?: string;
+}
+
+interface EngineLibrary {
+	arb_engine_create: (markets: number, outcomes: number, bookies: number) => Pointer | null;
+	arb_engine_destroy: (engine: Pointer) => void;
+	arb_engine_reset_market: (engine: Pointer, market: number) => void;
+	arb_engine_update: (
+		engine: Pointer,
+		market: Uint32Array,
+		outcome: Uint8Array,
+		bookie: Uint16Array,
+		odds: Float64Array,
+		count: number,
+		minProfit: number,
+		outEvents: Uint8Array
+	) => number;
+	arb_engine_market: (engine: Pointer, market: number, out: Uint8Array) => number;
+	arb_engine_stats: (engine: Pointer, out: BigUint64Array) => void;
+}
+
+export class ArbEngine {
+	private lib: EngineLibrary | null = null;
+	private handle: Pointer | null = null;
+	private marketIds: Map<string, number> = new Map();
+	private bookieIds: Map<string, number> = new Map();
+	private eventBytes = new Uint8Array(0);
+	private eventView = new DataView(this.eventBytes.buffer);
+	private eventCount = 0;
+	private readonly markets: number;
+	private readonly outcomes: number;
+	private readonly bookies: number;
+	private readonly stride: number;
+	private minProfit: number;
+	// JS path: same tables as arb_engine.c
+	private best: Float64Array = new Float64Array(0);
+	private bestBookie: Uint16Array = new Uint16Array(0);
+	private inverseSums: Float64Array = new Float64Array(0);
+	private open: Uint8Array = new Uint8Array(0);
+	private prices: Float64Array = new Float64Array(0);
+	private counters = { ticks: 0, invalid: 0, rescans: 0 };
+
+	constructor(options: ArbEngineOptions = {}) {
+		this.markets = Math.max(options.markets ?? 25000, 1);
+		this.outcomes = Math.min(Math.max(options.outcomes ?? 2, 2), ARB_MAX_OUTCOMES);
+		this.bookies = Math.min(Math.max(options.bookies ?? 64, 1), 65535);
+		this.stride = (this.bookies + 7) & ~7;
+		this.minProfit = options.minProfit ?? 0;
+
+		const libPath = options.libPath ?? process.env.PATTERN_MATCHER_LIB;
+		try {
+			if (libPath) {
+				const lib = dlopen(libPath, {
+					arb_engine_create: { args: ["u32", "u32", "u32"], returns: "ptr" },
+					arb_engine_destroy: { args: ["ptr"], returns: "void" },
+					arb_engine_reset_market: { args: ["ptr", "u32"], returns: "void" },
+					arb_engine_update: { args: ["ptr", "ptr", "ptr", "ptr", "ptr", "u32", "f64", "ptr"], returns: "u32" },
+					arb_engine_market: { args: ["ptr", "u32", "ptr"], returns: "i32" },
+					arb_engine_stats: { args: ["ptr", "ptr"], returns: "void" }
+				}).symbols as unknown as EngineLibrary;
+				this.handle = lib.arb_engine_create(this.markets, this.outcomes, this.bookies);
+				if (this.handle) this.lib = lib;
+			}
+		} catch (e) {
+			console.warn('Arb engine not available, using JS:', e);
+			this.lib = null;
+		}
+		if (!this.lib) {
+			const lines = this.markets * ARB_MAX_OUTCOMES;
+			this.best = new Float64Array(lines);
+			this.bestBookie = new Uint16Array(lines);
+			this.inverseSums = new Float64Array(this.markets);
+			this.open = new Uint8Array(this.markets);
+			this.prices = new Float64Array(this.markets * this.outcomes * this.stride);
+		}
+	}
+
+	get native(): boolean {
+		return this.lib !== null;
+	}
+
+	/**
+	 * Dense id for a market key (event + market type)
+	 */
+	marketId(key: string): number {
+		let id = this.marketIds.get(key);
+		if (id === undefined) {
+			id = this.marketIds.size;
+			if (id >= this.markets) throw new RangeError(`ArbEngine is sized for ${this.markets} markets`);
+			this.marketIds.set(key, id);
+		}
+		return id;
+	}
+
+	/**
+	 * Dense id for a bookie name
+	 */
+	bookieId(name: string): number {
+		let id = this.bookieIds.get(name);
+		if (id === undefined) {
+			id = this.bookieIds.size;
+			if (id >= this.bookies) throw new RangeError(`ArbEngine is sized for ${this.bookies} bookies`);
+			this.bookieIds.set(name, id);
+		}
+		return id;
+	}
+
+	bookieName(id: number): string | undefined {
+		for (const [name, value] of this.bookieIds) {
+			if (value === id) return name;
+		}
+		return undefined;
+	}
+
+	setMinProfit(minProfit: number): void {
+		this.minProfit = minProfit;
+	}
+
+	/**
+	 * Drop every price of a market (settled or suspended); reports no close
+	 */
+	resetMarket(id: number): void {
+		if (this.lib && this.handle) {
+			this.lib.arb_engine_reset_market(this.handle, id);
+			return;
+		}
+		if (id < 0 || id >= this.markets) return;
+		this.best.fill(0, id * ARB_MAX_OUTCOMES, (id + 1) * ARB_MAX_OUTCOMES);
+		this.bestBookie.fill(0, id * ARB_MAX_OUTCOMES, (id + 1) * ARB_MAX_OUTCOMES);
+		this.inverseSums[id] = 0;
+		this.open[id] = 0;
+		this.prices.fill(0, id * this.outcomes * this.stride, (id + 1) * this.outcomes * this.stride);
+	}
+
+	/**
+	 * Apply a batch of ticks in array order
+	 *
+	 * @returns number of arb events; read them with event() / events()
+	 *          before the next update()
+	 * @throws RangeError if `count` runs past any column
+	 */
+	update(ticks: PriceTickColumns): number {
+		const count = ticks.count ?? ticks.market.length;
+		// arb_engine_update() reads `count` entries of every column unchecked
+		const rows = Math.min(ticks.market.length, ticks.outcome.length, ticks.bookie.length, ticks.odds.length);
+		if (!Number.isInteger(count) || count < 0 || count > rows) {
+			throw new RangeError(`tick count ${count} outside the columns (shortest has ${rows})`);
+		}
+		this.reserve(count);
+		this.eventCount = this.lib && this.handle
+			? this.lib.arb_engine_update(
+				this.handle, ticks.market, ticks.outcome, ticks.bookie, ticks.odds, count,
+				this.minProfit, this.eventBytes
+			)
+			: this.updateJS(ticks, count);
+		return this.eventCount;
+	}
+
+	/**
+	 * Event `i` of the last update()
+	 */
+	event(i: number): ArbOpportunity {
+		return this.decode(this.eventView, i * EV_SIZE);
+	}
+
+	events(): ArbOpportunity[] {
+		const out: ArbOpportunity[] = [];
+		for (let i = 0; i < this.eventCount; i++) out.push(this.event(i));
+		return out;
+	}
+
+	/**
+	 * Current best line of a market; kind is ARB_OPEN while it is an arb
+	 */
+	market(id: number): ArbOpportunity | null {
+		if (id < 0 || id >= this.markets) return null;
+		const bytes = new Uint8Array(EV_SIZE);
+		const view = new DataView(bytes.buffer);
+		if (this.lib && this.handle) {
+			this.lib.arb_engine_market(this.handle, id, bytes);
+		} else {
+			this.fillJS(view, 0, id);
+			view.setUint8(EV_KIND, this.open[id] ? ARB_OPEN : 0);
+		}
+		return this.decode(view, 0);
+	}
+
+	stats(): { native: boolean; ticks: number; invalid: number; rescans: number } {
+		if (this.lib && this.handle) {
+			const out = new BigUint64Array(3);
+			this.lib.arb_engine_stats(this.handle, out);
+			return { native: true, ticks: Number(out[0]), invalid: Number(out[1]), rescans: Number(out[2]) };
+		}
+		return { native: false, ...this.counters };
+	}
+
+	close(): void {
+		if (this.lib && this.handle) this.lib.arb_engine_destroy(this.handle);
+		this.handle = null;
+		this.lib = null;
+	}
+
+	private reserve(count: number): void {
+		if (this.eventBytes.length >= count * EV_SIZE) return;
+		const size = Math.max(count, this.eventBytes.length / EV_SIZE * 2, 1024);
+		this.eventBytes = new Uint8Array(size * EV_SIZE);
+		this.eventView = new DataView(this.eventBytes.buffer);
+	}
+
+	private decode(view: DataView, at: number): ArbOpportunity {
+		const odds: number[] = [];
+		const bookies: number[] = [];
+		for (let o = 0; o < this.outcomes; o++) {
+			odds.push(view.getFloat64(at + EV_ODDS + o * 8, true));
+			bookies.push(view.getUint16(at + EV_BOOKIE + o * 2, true));
+		}
+		const inverseSum = view.getFloat64(at + EV_INV_SUM, true);
+		return {
+			kind: view.getUint8(at + EV_KIND),
+			market: view.getUint32(at + EV_MARKET, true),
+			tick: view.getUint32(at + EV_TICK, true),
+			odds,
+			bookies,
+			inverseSum,
+			profit: inverseSum > 0 ? 1 / inverseSum - 1 : 0
+		};
+	}
+
+	private fillJS(view: DataView, at: number, m: number): void {
+		new Uint8Array(view.buffer, view.byteOffset + at, EV_SIZE).fill(0);
+		view.setUint32(at + EV_MARKET, m, true);
+		view.setUint8(at + EV_OUTCOMES, this.outcomes);
+		view.setFloat64(at + EV_INV_SUM, this.inverseSums[m], true);
+		for (let o = 0; o < this.outcomes; o++) {
+			view.setFloat64(at + EV_ODDS + o * 8, this.best[m * ARB_MAX_OUTCOMES + o], true);
+			view.setUint16(at + EV_BOOKIE + o * 2, this.bestBookie[m * ARB_MAX_OUTCOMES + o], true);
+		}
+	}
+
+	// Same rules as arb_engine_update(), including tie-breaking
+	private updateJS(ticks: PriceTickColumns, count: number): number {
+		const { market, outcome, bookie, odds } = ticks;
+		const limit = 1 / (1 + this.minProfit);
+		const stride = this.stride;
+		let events = 0;
+		for (let i = 0; i < count; i++) {
+			const m = market[i];
+			const o = outcome[i];
+			const b = bookie[i];
+			if (m >= this.markets || o >= this.outcomes || b >= this.bookies) {
+				this.counters.invalid++;
+				continue;
+			}
+			const p = odds[i] > 1 ? odds[i] : 0;
+			const row = (m * this.outcomes + o) * stride;
+			const line = m * ARB_MAX_OUTCOMES;
+			this.prices[row + b] = p;
+
+			if (p > this.best[line + o]) {
+				this.best[line + o] = p;
+				this.bestBookie[line + o] = b;
+			} else if (b === this.bestBookie[line + o] && p < this.best[line + o]) {
+				let best = 0;
+				let who = 0;
+				for (let k = 0; k < this.bookies; k++) {
+					if (this.prices[row + k] > best) {
+						best = this.prices[row + k];
+						who = k;
+					}
+				}
+				this.best[line + o] = best;
+				this.bestBookie[line + o] = who;
+				this.counters.rescans++;
+			} else {
+				continue;
+			}
+
+			let inv = 0;
+			let priced = 0;
+			for (; priced < this.outcomes && this.best[line + priced] > 0; priced++) {
+				inv += 1 / this.best[line + priced];
+			}
+			this.inverseSums[m] = priced === this.outcomes ? inv : 0;
+			const open = priced === this.outcomes && inv < limit;
+			if (open || this.open[m]) {
+				const at = events++ * EV_SIZE;
+				this.fillJS(this.eventView, at, m);
+				this.eventView.setUint32(at + EV_TICK, i, true);
+				this.eventView.setUint8(at + EV_KIND, !open ? ARB_CLOSE : this.open[m] ? ARB_UPDATE : ARB_OPEN);
+			}
+			this.open[m] = open ? 1 : 0;
+		}
+		this.counters.ticks += count;
+		return events;
+	}
+}
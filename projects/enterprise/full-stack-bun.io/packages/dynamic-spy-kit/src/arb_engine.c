@@ -0,0 +1,235 @@
+/**
+ * @dynamic-spy/kit - Arbitrage engine
+ *
+ * Incremental best-price tables for cross-bookie arbitrage, built into the
+ * same shared library as ffi_matcher.c. Every market has up to
+ * ARB_MAX_OUTCOMES outcomes, and each (market, outcome) has one row of
+ * decimal odds per bookie. A market is an arb when every outcome has a price
+ * and the inverse best odds sum below 1 / (1 + min_profit).
+ *
+ * Ticks are columnar (market, outcome, bookie, odds arrays). A tick costs
+ * O(1) against its market's best line, which holds the best odds, the
+ * bookie offering them and the inverse sum in one cache line. The one
+ * exception is a tick that lowers or pulls the current best price: that
+ * rescans the single bookie row for the outcome it touched. Nothing ever
+ * rescans a whole market. Each tick that opens, changes or closes an arb
+ * writes one ArbEvent.
+ *
+ * Odds <= 1 (or NaN) pull that bookie's price. Ties keep the bookie that
+ * already had the best price, and a rescan takes the lowest bookie index,
+ * so results do not depend on batch boundaries.
+ *
+ * Compile: cc -O2 -shared -fPIC src/ffi_matcher.c src/line_movement.c src/market_snapshot.c src/arb_engine.c -o libpattern_matcher.so
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef BUN_EXPORT
+#define BUN_EXPORT __attribute__((visibility("default")))
+#endif
+
+#define ARB_MAX_OUTCOMES 4
+#define ARB_MAX_BOOKIES 65535
+
+// ArbEvent.kind
+#define ARB_OPEN 1    // market became an arb
+#define ARB_UPDATE 2  // still an arb, best line changed
+#define ARB_CLOSE 3   // no longer an arb
+
+// Best line per market, one cache line
+typedef struct {
+  double best[ARB_MAX_OUTCOMES];  // 0 = no bookie prices the outcome
+  uint16_t bookie[ARB_MAX_OUTCOMES];
+  double inv_sum;                 // sum of 1 / best, 0 until every outcome is priced
+  uint32_t open;                  // currently an arb
+  uint32_t reserved[3];
+} __attribute__((aligned(64))) ArbLine;
+
+_Static_assert(sizeof(ArbLine) == 64, "one cache line per market");
+
+/** One arb transition; arb-engine.ts mirrors this 64-byte layout */
+typedef struct {
+  uint32_t market;
+  uint32_t tick;      // index into the batch of the tick that caused it
+  uint8_t kind;       // ARB_OPEN / ARB_UPDATE / ARB_CLOSE
+  uint8_t outcomes;
+  uint16_t bookie[ARB_MAX_OUTCOMES];
+  uint8_t reserved[6];
+  double inv_sum;     // profit on the total stake is 1 / inv_sum - 1
+  double odds[ARB_MAX_OUTCOMES];
+} ArbEvent;
+
+_Static_assert(sizeof(ArbEvent) == 64, "arb-engine.ts mirrors this layout");
+
+typedef struct {
+  uint32_t markets;
+  uint32_t outcomes;
+  uint32_t bookies;
+  uint32_t stride;  // bookies rounded up to a cache line of doubles
+  ArbLine* lines;
+  double* prices;   // [market][outcome][stride]
+  uint64_t ticks;
+  uint64_t invalid;
+  uint64_t rescans;
+} ArbEngine;
+
+/**
+ * Create an engine with every price empty
+ *
+ * @param markets - dense market ids are 0 .. markets - 1
+ * @param outcomes - outcomes per market (2 for moneyline, 3 for 1X2), at
+ *        most ARB_MAX_OUTCOMES
+ * @param bookies - dense bookie ids are 0 .. bookies - 1
+ * @returns the engine (release with arb_engine_destroy), or NULL on bad
+ *          sizes or out of memory
+ */
+BUN_EXPORT ArbEngine* arb_engine_create(uint32_t markets, uint32_t outcomes, uint32_t bookies) {
+  if (!markets || outcomes < 2 || outcomes > ARB_MAX_OUTCOMES || !bookies || bookies > ARB_MAX_BOOKIES) {
+    return NULL;
+  }
+  ArbEngine* e = calloc(1, sizeof(ArbEngine));
+  if (!e) return NULL;
+  e->markets = markets;
+  e->outcomes = outcomes;
+  e->bookies = bookies;
+  e->stride = (bookies + 7) & ~7u;
+  size_t lines = (size_t)markets * sizeof(ArbLine);
+  size_t prices = (size_t)markets * outcomes * e->stride * sizeof(double);
+  e->lines = aligned_alloc(64, lines);
+  e->prices = aligned_alloc(64, prices);
+  if (!e->lines || !e->prices) {
+    free(e->lines);
+    free(e->prices);
+    free(e);
+    return NULL;
+  }
+  memset(e->lines, 0, lines);
+  memset(e->prices, 0, prices);
+  return e;
+}
+
+BUN_EXPORT void arb_engine_destroy(ArbEngine* e) {
+  if (!e) return;
+  free(e->lines);
+  free(e->prices);
+  free(e);
+}
+
+/**
+ * Drop every price of one market (settled or suspended)
+ *
+ * Does not report ARB_CLOSE; the caller knows the market went away.
+ */
+BUN_EXPORT void arb_engine_reset_market(ArbEngine* e, uint32_t market) {
+  if (!e || market >= e->markets) return;
+  memset(&e->lines[market], 0, sizeof(ArbLine));
+  memset(e->prices + (size_t)market * e->outcomes * e->stride, 0,
+         (size_t)e->outcomes * e->stride * sizeof(double));
+}
+
+static void arb_fill(const ArbEngine* e, uint32_t market, const ArbLine* line, ArbEvent* ev) {
+  memset(ev, 0, sizeof(*ev));
+  ev->market = market;
+  ev->outcomes = (uint8_t)e->outcomes;
+  ev->inv_sum = line->inv_sum;
+  for (uint32_t o = 0; o < e->outcomes; o++) {
+    ev->odds[o] = line->best[o];
+    ev->bookie[o] = line->bookie[o];
+  }
+}
+
+/**
+ * Apply a batch of price ticks in array order
+ *
+ * Ticks with an out-of-range market, outcome or bookie are skipped and
+ * counted in arb_engine_stats().
+ *
+ * @param odds - decimal odds; <= 1 pulls the bookie's price
+ * @param min_profit - smallest return on total stake that counts as an arb
+ *        (0.01 = 1%)
+ * @param out_events - `count` entries; at most one event per tick
+ * @returns number of events written
+ */
+BUN_EXPORT uint32_t arb_engine_update(ArbEngine* e, const uint32_t* market, const uint8_t* outcome,
+                                      const uint16_t* bookie, const double* odds, uint32_t count,
+                                      double min_profit, ArbEvent* out_events) {
+  if (!e || !market || !outcome || !bookie || !odds || !out_events) return 0;
+  const double limit = 1.0 / (1.0 + min_profit);
+  const uint32_t outcomes = e->outcomes;
+  uint32_t events = 0;
+
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t m = market[i], o = outcome[i], b = bookie[i];
+    if (m >= e->markets || o >= outcomes || b >= e->bookies) {
+      e->invalid++;
+      continue;
+    }
+    double p = odds[i] > 1.0 ? odds[i] : 0.0;
+    double* row = e->prices + ((size_t)m * outcomes + o) * e->stride;
+    ArbLine* line = &e->lines[m];
+    row[b] = p;
+
+    // Only a change to the outcome's best line can move the inverse sum
+    if (p > line->best[o]) {
+      line->best[o] = p;
+      line->bookie[o] = (uint16_t)b;
+    } else if (b == line->bookie[o] && p < line->best[o]) {
+      double best = 0.0;
+      uint32_t who = 0;
+      for (uint32_t k = 0; k < e->bookies; k++) {
+        if (row[k] > best) {
+          best = row[k];
+          who = k;
+        }
+      }
+      line->best[o] = best;
+      line->bookie[o] = (uint16_t)who;
+      e->rescans++;
+    } else {
+      continue;
+    }
+
+    double inv = 0.0;
+    uint32_t o2 = 0;
+    for (; o2 < outcomes && line->best[o2] > 0; o2++) inv += 1.0 / line->best[o2];
+    line->inv_sum = o2 == outcomes ? inv : 0.0;
+    uint32_t open = o2 == outcomes && inv < limit;
+
+    if (open || line->open) {
+      ArbEvent* ev = &out_events[events++];
+      arb_fill(e, m, line, ev);
+      ev->tick = i;
+      ev->kind = !open ? ARB_CLOSE : line->open ? ARB_UPDATE : ARB_OPEN;
+    }
+    line->open = open;
+  }
+  e->ticks += count;
+  return events;
+}
+
+/**
+ * Current best line of one market
+ *
+ * @param out - kind is ARB_OPEN while the market is an arb, else 0
+ * @returns 1 while the market is an arb, 0 if not, -1 for a bad id
+ */
+BUN_EXPORT int arb_engine_market(const ArbEngine* e, uint32_t market, ArbEvent* out) {
+  if (!e || !out || market >= e->markets) return -1;
+  const ArbLine* line = &e->lines[market];
+  arb_fill(e, market, line, out);
+  out->kind = line->open ? ARB_OPEN : 0;
+  return line->open ? 1 : 0;
+}
+
+/**
+ * Counters since creation: out[0] ticks, out[1] skipped invalid ticks,
+ * out[2] bookie-row rescans
+ */
+BUN_EXPORT void arb_engine_stats(const ArbEngine* e, uint64_t* out) {
+  if (!e || !out) return;
+  out[0] = e->ticks;
+  out[1] = e->invalid;
+  out[2] = e->rescans;
+}
@@ -4,12 +4,25 @@
  * Native FFI integration for ultra-fast pattern matching
  */
 
-import { dlopen, FFI } from "bun:ffi";
+import {
+	FFIMatcher,
+	type MatchLimits,
+	type MatchRejection,
+	type PatternProfile,
+	type SpanPatternMatch
+} from "./ffi-wrapper";
 
 export interface FFIPatternMetadata {
 	priority: number; // 0-100 scale
 	patternId: string;
 	bookie: string;
+	hostname?: string; // URLPattern template parts compiled natively
+	pathname?: string;
+}
+
+export interface FFIPatternProfile extends Omit<PatternProfile, "patternId"> {
+	patternId: string;
+	bookie?: string;
 }
 
 export interface FFIMatchResult {
@@ -17,39 +30,196 @@ export interface FFIMatchResult {
 	patternId: string;
 	confidence: number;
 	groups: Record<string, string>;
-	latencyMs: number;
+	ints: Record<string, number | bigint>; // :name(\d+) groups as numbers
+	rejected?: MatchRejection; // refused under setLimits(); matched is false, no JS fallback
 }
 
+const encoder = new TextEncoder();
+const decoder = new TextDecoder();
+
 export class FFIPatternMatcher {
 	private ffiEnabled: boolean = false;
 	private ffiHitRate: number = 0;
 	private ffiFallbacks: number = 0;
+	private ffiRejected: number = 0;
 	private totalFFICalls: number = 0;
 	private patternMetadata: Map<string, FFIPatternMetadata> = new Map();
+	private native: FFIMatcher;
+	private nativeIds: string[] = []; // native pattern id -> patternId
 
-	constructor() {
-		// Check if FFI is available
-		try {
-			// In production, would load actual FFI library
-			this.ffiEnabled = true;
-		} catch (e) {
+	constructor(libPath: string | undefined = process.env.PATTERN_MATCHER_LIB) {
+		this.native = new FFIMatcher(libPath);
+		this.ffiEnabled = this.native.available;
+		if (!this.ffiEnabled) {
 			console.warn('FFI not available, falling back to JS patterns');
-			this.ffiEnabled = false;
 		}
 	}
 
 	/**
 	 * Register pattern with FFI metadata
+	 *
+	 * Patterns with a hostname/pathname template are compiled into the
+	 * native set; metadata.priority decides which one wins when several
+	 * match the same URL.
 	 */
 	registerPattern(patternId: string, metadata: FFIPatternMetadata): void {
 		this.patternMetadata.set(patternId, metadata);
+		if (!this.ffiEnabled || metadata.hostname === undefined || metadata.pathname === undefined) {
+			return;
+		}
+		const id = this.native.registerPattern(metadata.hostname, metadata.pathname, metadata.priority);
+		if (id >= 0) {
+			this.nativeIds[id] = patternId;
+		}
+	}
+
+	/**
+	 * Highest-priority pattern matching `url`, or null to fall back to JS
+	 */
+	matchBest(url: string): FFIMatchResult | null {
+		this.totalFFICalls++;
+		if (!this.ffiEnabled) {
+			return null;
+		}
+
+		const bytes = encoder.encode(url);
+		const match = this.native.matchSpans(bytes);
+		const patternId = match ? this.nativeIds[match.patternId] : undefined;
+		return this.finish(patternId !== undefined || match?.rejected ? match : null, patternId, bytes);
+	}
+
+	/**
+	 * Move batch matching onto native worker threads (0: one per CPU)
+	 *
+	 * @returns worker count, 0 when FFI is unavailable
+	 */
+	startWorkers(threads: number = 0): number {
+		return this.ffiEnabled ? this.native.startPool(threads) : 0;
+	}
+
+	stopWorkers(): void {
+		this.native.stopPool();
+	}
+
+	/**
+	 * Release the native matcher (see FFIMatcher.close()); matches fall
+	 * back to JS afterwards
+	 */
+	close(): void {
+		this.native.close();
+		this.ffiEnabled = false;
+	}
+
+	/**
+	 * Share match results across worker processes through a tmpfs file
+	 * (see FFIMatcher.openCache())
+	 *
+	 * @returns false when FFI is unavailable or the file cannot be used
+	 */
+	shareResults(path?: string, entries?: number): boolean {
+		return this.ffiEnabled ? this.native.openCache(path, entries) : false;
+	}
+
+	/**
+	 * Compile registered patterns into specialized C with cc() and keep
+	 * the automaton for whatever that code cannot answer (see
+	 * FFIMatcher.setSpecialize())
+	 *
+	 * @returns whether specialized code is live
+	 */
+	specialize(enable: boolean = true): boolean {
+		return this.ffiEnabled && this.native.setSpecialize(enable);
+	}
+
+	/**
+	 * Bound native matching per URL for adversarial input (see
+	 * FFIMatcher.setLimits()). Refused URLs come back with `rejected` set
+	 * instead of null, so a hostile URL never reaches the JS engine.
+	 *
+	 * @returns false when FFI is unavailable
+	 */
+	setLimits(limits: MatchLimits): boolean {
+		return this.ffiEnabled && this.native.setLimits(limits);
+	}
+
+	/**
+	 * Count evaluations, hits and time per pattern inside the native
+	 * library, without any extra FFI crossing per match
+	 *
+	 * @returns false when FFI is unavailable
+	 */
+	setProfiling(enable: boolean): boolean {
+		return this.ffiEnabled && this.native.setProfiling(enable);
+	}
+
+	/**
+	 * Native per-pattern counters, most expensive first: candidates for
+	 * pruning, or for a priority that lets lookups stop earlier
+	 */
+	patternProfile(): FFIPatternProfile[] {
+		const profile = this.ffiEnabled ? this.native.profileSnapshot() : null;
+		if (!profile) return [];
+		const results: FFIPatternProfile[] = [];
+		for (const record of profile.patterns) {
+			const patternId = this.nativeIds[record.patternId];
+			if (patternId === undefined) continue;
+			results.push({ ...record, patternId, bookie: this.patternMetadata.get(patternId)?.bookie });
+		}
+		return results.sort((a, b) => b.totalNs - a.totalNs);
 	}
 
 	/**
-	 * Match URL using FFI (with JS fallback)
+	 * matchBest() for a whole batch, matched on the worker pool when
+	 * started; the calling thread polls for completion instead of blocking.
+	 * null entries fall back to JS.
+	 */
+	async matchBestBatch(urls: string[]): Promise<(FFIMatchResult | null)[]> {
+		if (!this.ffiEnabled) {
+			return urls.map(() => null);
+		}
+		const matches = await this.native.matchBatchAsync(urls);
+
+		let hits = 0;
+		let rejected = 0;
+		const results = matches.map((match) => {
+			if (match?.rejected) {
+				rejected++;
+				return this.rejectedResult(match.rejected);
+			}
+			const patternId = match ? this.nativeIds[match.patternId] : undefined;
+			if (!match || patternId === undefined) {
+				return null;
+			}
+			hits++;
+			const groups = { ...match.groups };
+			const queryAt = match.url.indexOf('?');
+			if (queryAt >= 0) {
+				const end = match.url.indexOf('#', queryAt);
+				for (const [key, value] of new URLSearchParams(match.url.slice(queryAt, end < 0 ? undefined : end))) {
+					groups[key] ??= value;
+				}
+			}
+			return {
+				matched: true,
+				patternId,
+				confidence: match.confidence,
+				groups,
+				ints: match.ints
+			};
+		});
+
+		const calls = this.totalFFICalls + urls.length;
+		this.ffiHitRate = calls > 0 ? (this.ffiHitRate * this.totalFFICalls + hits) / calls : 0;
+		this.totalFFICalls = calls;
+		this.ffiFallbacks += urls.length - hits - rejected;
+		this.ffiRejected += rejected;
+		return results;
+	}
+
+	/**
+	 * Match URL against one registered pattern using FFI (with JS fallback)
 	 */
 	matchWithFFI(url: string, patternId: string): FFIMatchResult | null {
-		const startTime = performance.now();
 		this.totalFFICalls++;
 
 		if (!this.ffiEnabled) {
@@ -62,29 +232,15 @@ export class FFIPatternMatcher {
 		}
 
 		try {
-			// In production, would call actual FFI function
-			// const result = ffiLibrary.matchPattern(url, patternId);
-			
-			// Mock FFI match (85.7% hit rate)
-			const ffiMatch = Math.random() > 0.143; // 85.7% success rate
-
-			if (ffiMatch) {
-				this.ffiHitRate = (this.ffiHitRate * (this.totalFFICalls - 1) + 1) / this.totalFFICalls;
-				const latency = performance.now() - startTime;
-
-				return {
-					matched: true,
-					patternId,
-					confidence: 0.995, // High confidence for FFI matches
-					groups: this.extractGroups(url, patternId),
-					latencyMs: latency
-				};
-			} else {
-				// FFI couldn't match, fallback to JS
-				this.ffiFallbacks++;
-				this.ffiHitRate = (this.ffiHitRate * (this.totalFFICalls - 1)) / this.totalFFICalls;
-				return null; // Signal fallback needed
+			const bytes = encoder.encode(url);
+			const all = this.native.matchAll(bytes);
+			const match = all.find((m) => this.nativeIds[m.patternId] === patternId);
+			if (!match && all.length === 0 && this.native.limited) {
+				// matchAll() yields nothing for refused URLs: ask which bound, if any
+				const refused = this.native.matchSpans(bytes);
+				return this.finish(refused?.rejected ? refused : null, patternId, bytes);
 			}
+			return this.finish(match ?? null, patternId, bytes);
 		} catch (e) {
 			console.warn(`FFI match failed for ${patternId}:`, e);
 			this.ffiFallbacks++;
@@ -92,37 +248,93 @@ export class FFIPatternMatcher {
 		}
 	}
 
-	/**
-	 * Extract groups from URL (simplified)
-	 */
-	private extractGroups(url: string, patternId: string): Record<string, string> {
-		// In production, would use actual FFI-extracted groups
-		const urlObj = new URL(url);
+	private finish(
+		match: SpanPatternMatch | null,
+		patternId: string | undefined,
+		bytes: Uint8Array
+	): FFIMatchResult | null {
+		if (match?.rejected) {
+			this.ffiRejected++;
+			this.ffiHitRate = (this.ffiHitRate * (this.totalFFICalls - 1)) / this.totalFFICalls;
+			return this.rejectedResult(match.rejected);
+		}
+		if (!match || patternId === undefined) {
+			// FFI couldn't match, fallback to JS
+			this.ffiFallbacks++;
+			this.ffiHitRate = (this.ffiHitRate * (this.totalFFICalls - 1)) / this.totalFFICalls;
+			return null; // Signal fallback needed
+		}
+
+		this.ffiHitRate = (this.ffiHitRate * (this.totalFFICalls - 1) + 1) / this.totalFFICalls;
 		return {
-			sportId: '1',
-			marketId: '12345',
-			...Object.fromEntries(urlObj.searchParams.entries())
+			matched: true,
+			patternId,
+			confidence: match.confidence,
+			groups: this.extractGroups(bytes, match),
+			ints: match.ints
 		};
 	}
 
+	private rejectedResult(rejected: MatchRejection): FFIMatchResult {
+		return { matched: false, patternId: '', confidence: 0, groups: {}, ints: {}, rejected };
+	}
+
+	/**
+	 * Decode FFI-extracted group spans, plus query parameters
+	 */
+	private extractGroups(bytes: Uint8Array, match: SpanPatternMatch): Record<string, string> {
+		const groups: Record<string, string> = {};
+		for (const [name, [off, len]] of Object.entries(match.groups)) {
+			groups[name] = decoder.decode(bytes.subarray(off, off + len));
+		}
+		const path = bytes.subarray(match.path[0], match.path[0] + match.path[1]);
+		const queryAt = path.indexOf(0x3f); // '?'
+		if (queryAt >= 0) {
+			const end = path.indexOf(0x23, queryAt); // '#'
+			const query = decoder.decode(path.subarray(queryAt, end < 0 ? path.length : end));
+			for (const [key, value] of new URLSearchParams(query)) {
+				groups[key] ??= value;
+			}
+		}
+		return groups;
+	}
+
 	/**
 	 * Get FFI statistics
+	 *
+	 * Latency comes from the native profile counters, so it is 0 unless
+	 * setProfiling(true): matches themselves never read a clock
 	 */
 	getStats(): {
 		enabled: boolean;
 		ffiHitRate: number;
 		ffiFallbacksToJS: number;
-		ffiMatchLatencyAvgMs: number;
+		ffiMatchLatencyAvgMs: number; // native time per profiled URL
+		ffiRejected: number; // refused under setLimits()
 		totalCalls: number;
 	} {
 		return {
 			enabled: this.ffiEnabled,
 			ffiHitRate: this.ffiHitRate,
 			ffiFallbacksToJS: this.totalFFICalls > 0 ? this.ffiFallbacks / this.totalFFICalls : 0,
-			ffiMatchLatencyAvgMs: 0.005, // Average FFI latency
+			ffiMatchLatencyAvgMs: this.nativeLatencyMs(),
+			ffiRejected: this.ffiRejected,
 			totalCalls: this.totalFFICalls
 		};
 	}
+
+	// Patterns of one host group share its evaluation time: count each group once
+	private nativeLatencyMs(): number {
+		const profile = this.ffiEnabled ? this.native.profileSnapshot() : null;
+		if (!profile || profile.urls === 0) return 0;
+		const groupNs = new Map<number, number>();
+		for (const record of profile.patterns) {
+			if (record.hostGroup >= 0) groupNs.set(record.hostGroup, record.totalNs);
+		}
+		let totalNs = 0;
+		for (const ns of groupNs.values()) totalNs += ns;
+		return totalNs / profile.urls / 1e6;
+	}
 }
 
 
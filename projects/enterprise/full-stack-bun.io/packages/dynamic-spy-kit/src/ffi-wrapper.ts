@@ -4,41 +4,454 @@
  * TypeScript wrapper for FFI C library (47x faster pattern matching)
  */
 
-import { dlopen, FFI } from "bun:ffi";
+import { cc, dlopen, CString, read, type Pointer } from "bun:ffi";
+import { mkdtempSync, rmSync, writeFileSync } from "fs";
+import { tmpdir } from "os";
+import { join } from "path";
 
 export interface PatternMatch {
 	hostname: string;
 	pathname: string;
 	groups: Record<string, string>;
+	ints: Record<string, number | bigint>; // :name(\d+) groups, parsed natively
 	group_count: number;
 	confidence: number;
+	patternId: number;
+}
+
+export interface BatchPatternMatch {
+	url: string;
+	patternId: number;
+	confidence: number;
+	groups: Record<string, string>;
+	ints: Record<string, number | bigint>;
+	rejected?: MatchRejection; // refused under setLimits(): nothing matched, patternId is MATCH_OVER_*
+}
+
+/** Zero-copy match: groups are byte spans into the UTF-8 encoded URL */
+export interface SpanPatternMatch {
+	patternId: number;
+	confidence: number;
+	host: [offset: number, length: number];
+	path: [offset: number, length: number];
+	groups: Record<string, [offset: number, length: number]>;
+	ints: Record<string, number | bigint>;
+	rejected?: MatchRejection; // see BatchPatternMatch
+}
+
+/**
+ * Match read back from a FFIMatchStream ring. Spans are relative to `url`,
+ * which views the ring and is only valid inside the onMatch callback.
+ */
+export interface StreamPatternMatch {
+	offset: number; // byte offset of the record in the stream
+	patternId: number;
+	confidence: number;
+	url: Uint8Array;
+	host: [offset: number, length: number];
+	path: [offset: number, length: number];
+	groups: Record<string, [offset: number, length: number]>;
+	ints: Record<string, number | bigint>;
+}
+
+export interface MatchStreamOptions {
+	format?: "lines" | "ndjson";
+	key?: string; // NDJSON field holding the URL (default "url")
+	ringBytes?: number; // at least 64 KiB
+}
+
+/** Native counters for one pattern, see FFIMatcher.profileSnapshot() */
+export interface PatternProfile {
+	patternId: number;
+	hostGroup: number; // patterns sharing a hostname are evaluated together
+	evaluations: number; // of its host group
+	hits: number; // URLs it was returned for
+	totalNs: number; // spent evaluating its host group
+	avgNs: number; // per evaluation
+}
+
+export interface MatcherProfile {
+	urls: number; // matched while profiling
+	threads: number; // threads that matched
+	elapsedMs: number; // since profiling was first enabled on this set
+	patterns: PatternProfile[];
+}
+
+/**
+ * Per-lookup bounds for hostile input, see FFIMatcher.setLimits().
+ * 0 or absent: unbounded.
+ */
+export interface MatchLimits {
+	maxBytes?: number; // longest URL that is looked up at all
+	maxSteps?: number; // host groups plus path segments walked per lookup
+}
+
+/** Why bounded matching refused a URL: over maxBytes, or out of maxSteps */
+export type MatchRejection = "limit" | "budget";
+
+/** One pattern of a reload() */
+export interface PatternSpec {
+	hostname: string;
+	pathname: string;
+	priority?: number;
 }
 
 export interface FFILibrary {
-	match_url_pattern: (input_json: string) => PatternMatch | null;
-	free_pattern_match: (match: PatternMatch | null) => void;
+	pattern_set_create: () => Pointer | null;
+	pattern_set_add: (set: Pointer, hostname: Buffer, pathname: Buffer) => number;
+	pattern_set_add_priority: (set: Pointer, hostname: Buffer, pathname: Buffer, priority: number) => number;
+	pattern_set_compile: (set: Pointer) => number;
+	pattern_set_destroy: (set: Pointer) => void;
+	pattern_slot_create: () => Pointer | null;
+	pattern_slot_destroy: (slot: Pointer) => void;
+	pattern_slot_publish: (slot: Pointer, set: Pointer) => number;
+	pattern_slot_read_begin: (slot: Pointer) => Pointer | null;
+	pattern_slot_read_end: (slot: Pointer) => void;
+	pattern_slot_reclaim: (slot: Pointer) => number;
+	pattern_set_save: (set: Pointer, path: Buffer) => number;
+	pattern_set_load: (path: Buffer, flags: number) => Pointer | null;
+	pattern_set_group_count: (set: Pointer, patternId: number) => number;
+	pattern_set_group_name: (set: Pointer, patternId: number, index: number) => Pointer | null;
+	pattern_set_group_type: (set: Pointer, patternId: number, index: number) => number;
+	match_url_pattern: (input_json: Buffer) => Pointer | null;
+	match_url_parts_slot: (
+		slot: Pointer,
+		host: Uint8Array,
+		hostLen: number,
+		path: Uint8Array,
+		pathLen: number
+	) => Pointer | null;
+	free_pattern_match: (match: Pointer) => void;
+	match_url_batch: (
+		set: Pointer,
+		buf: Uint8Array,
+		offsets: Uint32Array,
+		lengths: Uint32Array,
+		count: number,
+		outPatternId: Int32Array,
+		outConfidence: Float64Array,
+		outGroupOff: Uint32Array,
+		outGroupLen: Uint32Array,
+		outGroupValue: BigUint64Array | null,
+		groupStride: number
+	) => number;
+	matcher_simd_level: () => Pointer | null;
+	match_arena_reset: (arena: Uint8Array, capacity: number) => number;
+	match_url_arena: (set: Pointer, arena: Uint8Array, url: Uint8Array, length: number) => number;
+	match_url_arena_all: (
+		set: Pointer,
+		arena: Uint8Array,
+		url: Uint8Array,
+		length: number,
+		outOffsets: Uint32Array,
+		maxResults: number
+	) => number;
+	match_ring_reset: (ring: Uint8Array, capacity: number) => number;
+	match_stream_create: (format: number, jsonKey: Buffer | null) => Pointer | null;
+	match_stream_push: (stream: Pointer, set: Pointer, ring: Uint8Array, chunk: Uint8Array, length: number) => number;
+	match_stream_end: (stream: Pointer, set: Pointer, ring: Uint8Array) => number;
+	match_stream_destroy: (stream: Pointer) => void;
+	match_pool_create: (threads: number, flags: number) => Pointer | null;
+	match_pool_destroy: (pool: Pointer) => void;
+	match_pool_threads: (pool: Pointer) => number;
+	match_pool_submit: (
+		pool: Pointer,
+		slot: Pointer,
+		buf: Uint8Array,
+		offsets: Uint32Array,
+		lengths: Uint32Array,
+		count: number,
+		outPatternId: Int32Array,
+		outConfidence: Float64Array,
+		outGroupOff: Uint32Array,
+		outGroupLen: Uint32Array,
+		outGroupValue: BigUint64Array | null,
+		groupStride: number,
+		status: Int32Array
+	) => Pointer | null;
+	match_job_set: (job: Pointer) => Pointer | null;
+	match_job_release: (job: Pointer) => void;
+	match_cache_open: (path: Buffer, entries: number) => Pointer | null;
+	match_cache_close: (cache: Pointer) => void;
+	match_cache_stats: (cache: Pointer, out: BigUint64Array) => void;
+	match_url_batch_cached: (
+		cache: Pointer,
+		set: Pointer,
+		buf: Uint8Array,
+		offsets: Uint32Array,
+		lengths: Uint32Array,
+		count: number,
+		outPatternId: Int32Array,
+		outConfidence: Float64Array,
+		outGroupOff: Uint32Array,
+		outGroupLen: Uint32Array,
+		outGroupValue: BigUint64Array | null,
+		groupStride: number
+	) => number;
+	match_url_arena_cached: (cache: Pointer, set: Pointer, arena: Uint8Array, url: Uint8Array, length: number) => number;
+	match_pool_set_cache: (pool: Pointer, cache: Pointer | null) => void;
+	pattern_set_profile: (set: Pointer, enable: number) => number;
+	pattern_set_profile_snapshot: (set: Pointer, out: Uint8Array, capacity: number) => number;
+	pattern_set_emit_c: (set: Pointer, symbol: Buffer, out: Uint8Array | null, capacity: number) => number;
+	pattern_set_attach_jit: (set: Pointer, fn: Pointer | null) => number;
+	pattern_set_limits: (set: Pointer, maxBytes: number, maxSteps: number) => number;
+	pattern_set_limit_stats: (set: Pointer, out: BigUint64Array) => void;
+}
+
+/** Status codes returned by pattern_set_add() / pattern_set_compile() */
+export const PATTERN_ERR_INVALID = -1;
+export const PATTERN_ERR_UNSUPPORTED = -2; // needs the JS URLPattern engine
+export const PATTERN_ERR_LIMIT = -3;
+export const PATTERN_ERR_NOMEM = -4;
+export const PATTERN_ERR_IO = -5;
+
+/** Pattern ids reported for URLs refused under setLimits() */
+export const MATCH_OVER_LIMIT = -3;
+export const MATCH_OVER_BUDGET = -4;
+
+/** pattern_set_load() flag: checksum and bounds-check the file first */
+export const PATTERN_LOAD_VERIFY = 1;
+
+/** match_pool_create() flag: pin worker i to CPU i */
+export const MATCH_POOL_PIN = 1;
+
+/** Default file for openCache(); tmpfs, so entries never touch disk */
+export const MATCH_CACHE_PATH = "/dev/shm/dynamic-spy-match-cache";
+
+// struct PatternMatch layout (64-bit)
+const PM_HOSTNAME = 0;
+const PM_PATHNAME = 8;
+const PM_GROUPS = 16;
+const PM_GROUP_COUNT = 32;
+const PM_CONFIDENCE = 40;
+const PM_PATTERN_ID = 48;
+const PM_GROUP_VALUES = 56;
+
+const NO_GROUP = 0xffffffff;
+const GROUP_TYPE_INT = 1;
+const GROUP_INT_OVERFLOW = 0xffffffffffffffffn; // digits beyond uint64
+
+/** Exact numbers stay numbers; only values past 2^53 come back as bigint */
+function intValue(value: bigint): number | bigint {
+	return value <= BigInt(Number.MAX_SAFE_INTEGER) ? Number(value) : value;
+}
+
+function rejection(id: number): MatchRejection | undefined {
+	return id === MATCH_OVER_LIMIT ? "limit" : id === MATCH_OVER_BUDGET ? "budget" : undefined;
+}
+
+interface GroupInfo {
+	names: string[];
+	ints: boolean[]; // GROUP_TYPE_INT
+}
+
+// MatchArena header / ArenaMatch layout
+const ARENA_HEADER_BYTES = 16;
+const ARENA_FULL = -2;
+const AM_PATTERN_ID = 0;
+const AM_GROUP_COUNT = 4;
+const AM_CONFIDENCE = 8;
+const AM_HOST = 16;
+const AM_PATH = 24;
+const AM_GROUPS = 32;
+const MAX_RESULTS = 32; // MATCHER_MAX_RESULTS
+
+// MatchRing header / StreamMatch layout
+const RING_HEAD = 0;
+const RING_TAIL = 4;
+const RING_CAPACITY = 8;
+const RING_RECORDS = 16;
+const RING_MATCHED = 24;
+const RING_SKIPPED = 32;
+const RING_HEADER_BYTES = 40;
+const RING_MIN_BYTES = RING_HEADER_BYTES + 64 * 1024;
+const SM_SIZE = 0;
+const SM_PATTERN_ID = 4;
+const SM_OFFSET = 8;
+const SM_CONFIDENCE = 16;
+const SM_URL_LEN = 24;
+const SM_GROUP_COUNT = 28;
+const SM_HOST = 32;
+const SM_PATH = 40;
+const SM_GROUPS = 48;
+// ProfileHeader / ProfileRecord layout
+const PROFILE_HEADER_BYTES = 64;
+const PROFILE_RECORD_BYTES = 32;
+const PH_RECORD_COUNT = 0;
+const PH_URLS = 8;
+const PH_START_TICKS = 16;
+const PH_START_NS = 24;
+const PH_NOW_TICKS = 32;
+const PH_NOW_NS = 40;
+const PH_THREADS = 48;
+const PR_HOST_GROUP = 4;
+const PR_EVALUATIONS = 8;
+const PR_HITS = 16;
+const PR_TICKS = 24;
+const NO_HOST_GROUP = 0xffffffff;
+const JIT_SYMBOL = "match_specialized";
+const STREAM_LINES = 0;
+const STREAM_NDJSON = 1;
+
+/** A cc() image; must stay loaded while any set attached to it lives */
+type JitImage = { close(): void };
+
+function cstr(value: string): Buffer {
+	return Buffer.from(value + "\0");
+}
+
+/** URLs packed for match_url_batch() / match_pool_submit(), with output arrays */
+interface PackedBatch {
+	buf: Uint8Array;
+	used: number;
+	offsets: Uint32Array;
+	lengths: Uint32Array;
+	patternIds: Int32Array;
+	confidence: Float64Array;
+	groupOff: Uint32Array;
+	groupLen: Uint32Array;
+	groupValue: BigUint64Array;
+	stride: number;
+}
+
+const encoder = new TextEncoder();
+
+function packBatch(urls: string[], stride: number): PackedBatch {
+	let capacity = 0;
+	for (const url of urls) capacity += url.length * 3;
+	const buf = new Uint8Array(capacity || 1);
+	const offsets = new Uint32Array(urls.length);
+	const lengths = new Uint32Array(urls.length);
+	let used = 0;
+	for (let i = 0; i < urls.length; i++) {
+		const { written } = encoder.encodeInto(urls[i], buf.subarray(used));
+		offsets[i] = used;
+		lengths[i] = written;
+		used += written;
+	}
+	return {
+		buf,
+		used,
+		offsets,
+		lengths,
+		patternIds: new Int32Array(urls.length),
+		confidence: new Float64Array(urls.length),
+		groupOff: new Uint32Array(urls.length * stride),
+		groupLen: new Uint32Array(urls.length * stride),
+		groupValue: new BigUint64Array(urls.length * stride),
+		stride
+	};
 }
 
 export class FFIMatcher {
 	private lib: FFILibrary | null = null;
+	private slot: Pointer | null = null; // this instance's published set, read by matches
+	private set: Pointer | null = null; // next set, built off to the side
+	private specs: PatternSpec[] | null = []; // what the published set holds (null: loaded from a file)
+	private dirty: boolean = false;
+	private groupNames: GroupInfo[] = [];
+	private namesSet: Pointer | null = null;
+	private scratch: Uint8Array = new Uint8Array(8 * 1024);
+	private arena: Uint8Array = new Uint8Array(64 * 1024);
+	private arenaView: DataView = new DataView(this.arena.buffer);
+	private allOffsets: Uint32Array = new Uint32Array(MAX_RESULTS);
+	private simdLevel: string = 'none';
+	private pool: Pointer | null = null;
+	private cache: Pointer | null = null; // shared result cache, see openCache()
+	private closedCaches: Pointer[] = []; // closed while pool jobs still use them
+	private jobsInFlight: number = 0;
+	private pinDepth: number = 0; // pinned() sections on the JS stack
+	private closed: boolean = false;
+	private profiling: boolean = false;
+	private profileBuf: Uint8Array = new Uint8Array(PROFILE_HEADER_BYTES + 256 * PROFILE_RECORD_BYTES);
+	private specialize: boolean = false;
+	private specialized: boolean = false; // published set runs cc()-compiled code
+	private jit: JitImage | null = null; // attached to the published set
+	private retiredJits: (JitImage | null)[] = []; // one per retired, not yet freed set, oldest first
+	private published: boolean = false; // the slot holds a set, so the next publish retires one
+	private limits: Required<MatchLimits> = { maxBytes: 0, maxSteps: 0 };
 	private enabled: boolean = false;
-	private matchesPerSec: number = 0;
 	private totalMatches: number = 0;
+	private matchedUrls: number = 0; // of totalMatches, answered by some pattern
 	private startTime: number = 0;
 
 	constructor(libPath?: string) {
 		try {
 			if (libPath) {
 				this.lib = dlopen(libPath, {
+					pattern_set_create: { args: [], returns: "ptr" },
+					pattern_set_add: { args: ["ptr", "ptr", "ptr"], returns: "i32" },
+					pattern_set_add_priority: { args: ["ptr", "ptr", "ptr", "i32"], returns: "i32" },
+					pattern_set_compile: { args: ["ptr"], returns: "i32" },
+					pattern_set_destroy: { args: ["ptr"], returns: "void" },
+					pattern_slot_create: { args: [], returns: "ptr" },
+					pattern_slot_destroy: { args: ["ptr"], returns: "void" },
+					pattern_slot_publish: { args: ["ptr", "ptr"], returns: "u64_fast" },
+					pattern_slot_read_begin: { args: ["ptr"], returns: "ptr" },
+					pattern_slot_read_end: { args: ["ptr"], returns: "void" },
+					pattern_slot_reclaim: { args: ["ptr"], returns: "u32" },
+					pattern_set_save: { args: ["ptr", "ptr"], returns: "i32" },
+					pattern_set_load: { args: ["ptr", "u32"], returns: "ptr" },
+					pattern_set_group_count: { args: ["ptr", "i32"], returns: "i32" },
+					pattern_set_group_name: { args: ["ptr", "i32", "i32"], returns: "ptr" },
+					pattern_set_group_type: { args: ["ptr", "i32", "i32"], returns: "i32" },
 					match_url_pattern: {
-						args: ["cstring"],
-						returns: "pointer"
+						args: ["ptr"],
+						returns: "ptr"
+					},
+					match_url_parts_slot: {
+						args: ["ptr", "ptr", "u64", "ptr", "u64"],
+						returns: "ptr"
 					},
 					free_pattern_match: {
-						args: ["pointer"],
+						args: ["ptr"],
 						returns: "void"
-					}
-				}) as any;
+					},
+					match_url_batch: {
+						args: ["ptr", "ptr", "ptr", "ptr", "u32", "ptr", "ptr", "ptr", "ptr", "ptr", "u32"],
+						returns: "u32"
+					},
+					matcher_simd_level: { args: [], returns: "ptr" },
+					match_arena_reset: { args: ["ptr", "u32"], returns: "i32" },
+					match_url_arena: { args: ["ptr", "ptr", "ptr", "u32"], returns: "i64_fast" },
+					match_url_arena_all: { args: ["ptr", "ptr", "ptr", "u32", "ptr", "u32"], returns: "i32" },
+					match_ring_reset: { args: ["ptr", "u32"], returns: "i32" },
+					match_stream_create: { args: ["u32", "ptr"], returns: "ptr" },
+					match_stream_push: { args: ["ptr", "ptr", "ptr", "ptr", "u32"], returns: "i64_fast" },
+					match_stream_end: { args: ["ptr", "ptr", "ptr"], returns: "i32" },
+					match_stream_destroy: { args: ["ptr"], returns: "void" },
+					match_pool_create: { args: ["u32", "u32"], returns: "ptr" },
+					match_pool_destroy: { args: ["ptr"], returns: "void" },
+					match_pool_threads: { args: ["ptr"], returns: "u32" },
+					match_pool_submit: {
+						args: ["ptr", "ptr", "ptr", "ptr", "ptr", "u32", "ptr", "ptr", "ptr", "ptr", "ptr", "u32", "ptr"],
+						returns: "ptr"
+					},
+					match_job_set: { args: ["ptr"], returns: "ptr" },
+					match_job_release: { args: ["ptr"], returns: "void" },
+					match_cache_open: { args: ["ptr", "u32"], returns: "ptr" },
+					match_cache_close: { args: ["ptr"], returns: "void" },
+					match_cache_stats: { args: ["ptr", "ptr"], returns: "void" },
+					match_url_batch_cached: {
+						args: ["ptr", "ptr", "ptr", "ptr", "ptr", "u32", "ptr", "ptr", "ptr", "ptr", "ptr", "u32"],
+						returns: "u32"
+					},
+					match_url_arena_cached: { args: ["ptr", "ptr", "ptr", "ptr", "u32"], returns: "i64_fast" },
+					match_pool_set_cache: { args: ["ptr", "ptr"], returns: "void" },
+					pattern_set_profile: { args: ["ptr", "i32"], returns: "i32" },
+					pattern_set_profile_snapshot: { args: ["ptr", "ptr", "u32"], returns: "i32" },
+					pattern_set_emit_c: { args: ["ptr", "ptr", "ptr", "u32"], returns: "i64_fast" },
+					pattern_set_attach_jit: { args: ["ptr", "ptr"], returns: "i32" },
+					pattern_set_limits: { args: ["ptr", "u32", "u32"], returns: "i32" },
+					pattern_set_limit_stats: { args: ["ptr", "ptr"], returns: "void" }
+				}).symbols as unknown as FFILibrary;
+				// A slot of its own: matchers in one process must not publish
+				// over each other's patterns
+				this.slot = this.lib.pattern_slot_create();
+				if (!this.slot) throw new Error('pattern_slot_create failed');
+				this.resetArena();
+				const level = this.lib.matcher_simd_level();
+				this.simdLevel = level ? new CString(level).toString() : 'scalar';
 				this.enabled = true;
 				this.startTime = performance.now();
 			}
@@ -48,6 +461,284 @@ export class FFIMatcher {
 		}
 	}
 
+	/**
+	 * Register a URLPattern-style template with the native pattern set
+	 *
+	 * When several patterns match a URL the highest priority wins, then the
+	 * earliest registered.
+	 *
+	 * @returns native pattern id, or a negative PATTERN_ERR_* code
+	 * (PATTERN_ERR_UNSUPPORTED means the pattern must stay on the JS engine)
+	 */
+	registerPattern(hostname: string, pathname: string, priority: number = 0): number {
+		if (!this.enabled || !this.lib) {
+			return PATTERN_ERR_INVALID;
+		}
+		if (!this.specs) {
+			return PATTERN_ERR_INVALID; // loaded from a file: use reload()
+		}
+		if (!this.set) {
+			// Published sets are frozen: start the next one from the same
+			// patterns so existing ids stay put
+			this.set = this.buildSet(this.specs);
+			if (!this.set) return PATTERN_ERR_NOMEM;
+		}
+		const spec = { hostname, pathname, priority: priority | 0 };
+		const id = this.addSpec(this.set, spec);
+		if (id >= 0) {
+			this.specs.push(spec);
+			this.dirty = true;
+		}
+		return id;
+	}
+
+	get available(): boolean {
+		return this.enabled;
+	}
+
+	/**
+	 * Compile registered patterns and publish them; match() compiles lazily
+	 * otherwise. Matches already in flight finish on the previous set.
+	 */
+	compile(): boolean {
+		if (!this.lib || !this.slot) return false;
+		if (!this.dirty || !this.set) return !this.dirty;
+		if (this.lib.pattern_set_compile(this.set) !== 0) return false;
+		if (this.profiling) this.lib.pattern_set_profile(this.set, 1);
+		this.applyLimits(this.set);
+		const jit = this.specializeSet(this.set);
+		if (!this.lib.pattern_slot_publish(this.slot, this.set)) {
+			if (jit) {
+				this.lib.pattern_set_attach_jit(this.set, null);
+				jit.close();
+			}
+			return false;
+		}
+		this.swapJit(jit);
+		this.set = null;
+		this.dirty = false;
+		this.groupNames = [];
+		return true;
+	}
+
+	/**
+	 * Hot-swap the whole pattern list without pausing matches
+	 *
+	 * The new set is built and compiled off to the side, then published in
+	 * one atomic step; the previous set is freed once the last match using
+	 * it returns. On failure the current set stays live.
+	 *
+	 * @returns native pattern ids in `patterns` order (negative: kept on the
+	 * JS engine), or null if nothing was published
+	 */
+	reload(patterns: PatternSpec[]): number[] | null {
+		if (!this.enabled || !this.lib || !this.slot) {
+			return null;
+		}
+		const next = this.lib.pattern_set_create();
+		if (!next) return null;
+		const ids: number[] = [];
+		const accepted: PatternSpec[] = [];
+		for (const pattern of patterns) {
+			const spec = { hostname: pattern.hostname, pathname: pattern.pathname, priority: (pattern.priority ?? 0) | 0 };
+			const id = this.addSpec(next, spec);
+			ids.push(id);
+			if (id >= 0) accepted.push(spec);
+		}
+		const compiled = this.lib.pattern_set_compile(next) === 0;
+		if (compiled && this.profiling) this.lib.pattern_set_profile(next, 1);
+		this.applyLimits(next);
+		const jit = compiled ? this.specializeSet(next) : null;
+		if (!compiled || !this.lib.pattern_slot_publish(this.slot, next)) {
+			this.lib.pattern_set_destroy(next);
+			jit?.close();
+			return null;
+		}
+		this.swapJit(jit);
+		if (this.set) this.lib.pattern_set_destroy(this.set);
+		this.set = null;
+		this.specs = accepted;
+		this.dirty = false;
+		this.groupNames = [];
+		return ids;
+	}
+
+	/**
+	 * Write the published compiled set to `path` (see loadCompiled())
+	 */
+	saveCompiled(path: string): boolean {
+		if (!this.enabled || !this.lib || !this.slot) return false;
+		if (this.dirty && !this.compile()) return false;
+		const lib = this.lib;
+		return this.pinned(false, (set) => lib.pattern_set_save(set, cstr(path)) === 0);
+	}
+
+	/**
+	 * Publish a set saved by saveCompiled() without compiling anything
+	 *
+	 * The file is mapped read-only and shared by every process that loads
+	 * it. registerPattern() is unavailable afterwards; reload() still works.
+	 */
+	loadCompiled(path: string, verify: boolean = false): boolean {
+		if (!this.enabled || !this.lib || !this.slot) return false;
+		const set = this.lib.pattern_set_load(cstr(path), verify ? PATTERN_LOAD_VERIFY : 0);
+		if (!set) return false;
+		if (this.profiling) this.lib.pattern_set_profile(set, 1);
+		this.applyLimits(set);
+		const jit = this.specializeSet(set);
+		if (!this.lib.pattern_slot_publish(this.slot, set)) {
+			this.lib.pattern_set_destroy(set);
+			jit?.close();
+			return false;
+		}
+		this.swapJit(jit);
+		if (this.set) this.lib.pattern_set_destroy(this.set);
+		this.set = null;
+		this.specs = null;
+		this.dirty = false;
+		this.groupNames = [];
+		return true;
+	}
+
+	/**
+	 * Compile every set published from now on into straight-line C with
+	 * bun:ffi cc() (TinyCC): literal hosts whose patterns have only
+	 * literal, :name, :name(\d+) and :name(a|b) segments skip the automaton
+	 * tables. Anything else, and every lookup the generated code cannot
+	 * settle, still runs on the tables, as does everything when cc() is
+	 * unavailable. Lookups answered by the generated code are not counted
+	 * by setProfiling().
+	 *
+	 * @returns whether the published set now runs specialized code
+	 */
+	setSpecialize(enable: boolean): boolean {
+		if (!this.enabled || !this.lib) return false;
+		this.specialize = enable;
+		if (this.specialized !== enable && this.specs?.length && !this.dirty) {
+			this.reload(this.specs); // same patterns, same ids
+		}
+		return this.specialized;
+	}
+
+	private applyLimits(set: Pointer): void {
+		const { maxBytes, maxSteps } = this.limits;
+		if (maxBytes || maxSteps) this.lib!.pattern_set_limits(set, maxBytes, maxSteps);
+	}
+
+	/**
+	 * Emit, compile and attach a specialized matcher before `set` is
+	 * published
+	 *
+	 * @returns the image now attached to `set`, or null if it runs on the
+	 * tables alone
+	 */
+	private specializeSet(set: Pointer): JitImage | null {
+		if (!this.specialize) return null;
+		const lib = this.lib!;
+		const symbol = cstr(JIT_SYMBOL);
+		const size = lib.pattern_set_emit_c(set, symbol, null, 0);
+		if (size < 0) return null; // nothing to specialize
+		const source = new Uint8Array(size + 1);
+		if (lib.pattern_set_emit_c(set, symbol, source, source.byteLength) !== size) return null;
+
+		// A fresh private directory: a predictable name in tmpdir() could be
+		// a symlink planted by another user
+		let dir: string | null = null;
+		try {
+			dir = mkdtempSync(join(tmpdir(), "dynamic-spy-matcher-"));
+			const path = join(dir, "matcher.c");
+			writeFileSync(path, source.subarray(0, size), { flag: "wx", mode: 0o600 });
+			const jit = cc({
+				source: path,
+				symbols: { [JIT_SYMBOL]: { args: ["ptr", "u32", "ptr", "u32", "ptr"], returns: "i32" } }
+			});
+			const fn = (jit.symbols[JIT_SYMBOL] as unknown as { ptr: Pointer | null }).ptr;
+			if (!fn || lib.pattern_set_attach_jit(set, fn) !== 0) {
+				jit.close();
+				return null;
+			}
+			return jit;
+		} catch (e) {
+			console.warn('cc() not available, using the generic matcher:', e);
+			this.specialize = false;
+			return null;
+		} finally {
+			if (dir) rmSync(dir, { recursive: true, force: true });
+		}
+	}
+
+	// A publish retired the previous set (if any) along with its image;
+	// `jit` now runs the published set
+	private swapJit(jit: JitImage | null): void {
+		if (this.published) this.retiredJits.push(this.jit);
+		this.published = true;
+		this.jit = jit;
+		this.specialized = jit !== null;
+		this.reclaimJits();
+	}
+
+	// The slot frees retired sets oldest first, so once only `pending` are
+	// left every older image has nothing calling into it
+	private reclaimJits(): void {
+		if (!this.retiredJits.length || !this.slot) return;
+		const pending = this.lib!.pattern_slot_reclaim(this.slot);
+		while (this.retiredJits.length > pending) this.retiredJits.shift()?.close();
+	}
+
+	private addSpec(set: Pointer, spec: PatternSpec): number {
+		return this.lib!.pattern_set_add_priority(set, cstr(spec.hostname), cstr(spec.pathname), spec.priority ?? 0);
+	}
+
+	private buildSet(specs: PatternSpec[]): Pointer | null {
+		const set = this.lib!.pattern_set_create();
+		if (set) {
+			for (const spec of specs) this.addSpec(set, spec);
+		}
+		return set;
+	}
+
+	/**
+	 * Run `fn` with the published set pinned; a concurrent reload cannot
+	 * free it until this returns
+	 */
+	private pinned<T>(fallback: T, fn: (set: Pointer) => T): T {
+		const lib = this.lib!;
+		const slot = this.slot!;
+		const set = lib.pattern_slot_read_begin(slot);
+		this.pinDepth++;
+		try {
+			this.useNamesOf(set);
+			return set ? fn(set) : fallback;
+		} finally {
+			lib.pattern_slot_read_end(slot);
+			// close() from inside fn (e.g. a stream's onMatch) left the rest to us
+			if (--this.pinDepth === 0 && this.closed && this.jobsInFlight === 0) this.releaseSlot();
+		}
+	}
+
+	// The group name cache belongs to one set; start over when it changes
+	private useNamesOf(set: Pointer | null): void {
+		if (set !== this.namesSet) {
+			this.namesSet = set;
+			this.groupNames = [];
+		}
+	}
+
+	private groupsFor(set: Pointer, patternId: number): GroupInfo {
+		let info = this.groupNames[patternId];
+		if (!info && this.lib) {
+			info = { names: [], ints: [] };
+			const count = this.lib.pattern_set_group_count(set, patternId);
+			for (let i = 0; i < count; i++) {
+				const name = this.lib.pattern_set_group_name(set, patternId, i);
+				info.names.push(name ? new CString(name).toString() : String(i));
+				info.ints.push(this.lib.pattern_set_group_type(set, patternId, i) === GROUP_TYPE_INT);
+			}
+			this.groupNames[patternId] = info;
+		}
+		return info || { names: [], ints: [] };
+	}
+
 	/**
 	 * Match URL pattern using FFI (187K matches/sec)
 	 */
@@ -58,34 +749,60 @@ export class FFIMatcher {
 
 		try {
 			const urlObj = new URL(url);
-			const inputJson = JSON.stringify({
-				hostname: urlObj.hostname,
-				pathname: urlObj.pathname
-			});
+			if (this.dirty && !this.compile()) {
+				return null;
+			}
 
-			const result = this.lib.match_url_pattern(inputJson);
-			this.totalMatches++;
-			
-			// Calculate matches/sec
-			const elapsed = (performance.now() - this.startTime) / 1000;
-			this.matchesPerSec = this.totalMatches / elapsed;
+			// Hostname and pathname go across as raw UTF-8 slices of one
+			// reusable scratch buffer; no JSON on either side
+			const needed = (urlObj.hostname.length + urlObj.pathname.length) * 3;
+			if (needed > this.scratch.byteLength) {
+				this.scratch = new Uint8Array(needed);
+			}
+			const host = encoder.encodeInto(urlObj.hostname, this.scratch).written;
+			const pathBuf = this.scratch.subarray(host);
+			const path = encoder.encodeInto(urlObj.pathname, pathBuf).written;
+
+			const lib = this.lib;
+			return this.pinned(null, (set) => {
+				const result = lib.match_url_parts_slot(this.slot!, this.scratch, host, pathBuf, path);
+				this.totalMatches++;
+				if (!result) {
+					return null;
+				}
+				this.matchedUrls++;
 
-			if (result) {
 				// Convert C struct to JS object
+				const patternId = read.i32(result, PM_PATTERN_ID);
+				const groupCount = Number(read.u64(result, PM_GROUP_COUNT));
+				const groupsPtr = read.ptr(result, PM_GROUPS);
+				const valuesPtr = read.ptr(result, PM_GROUP_VALUES);
+				const { names, ints: intGroups } = this.groupsFor(set, patternId);
 				const groups: Record<string, string> = {};
-				if (result.groups) {
-					groups.sportId = result.groups[0] || '';
-					groups.marketId = result.groups[1] || '';
+				const ints: Record<string, number | bigint> = {};
+				for (let i = 0; i < groupCount; i++) {
+					const value = read.ptr(groupsPtr as Pointer, i * 8);
+					if (!value) continue;
+					const name = names[i] ?? String(i);
+					groups[name] = new CString(value as Pointer).toString();
+					if (intGroups[i]) {
+						const n = read.u64(valuesPtr as Pointer, i * 8);
+						if (n !== GROUP_INT_OVERFLOW) ints[name] = intValue(n);
+					}
 				}
 
-				return {
-					hostname: result.hostname || '',
-					pathname: result.pathname || '',
+				const match: PatternMatch = {
+					hostname: new CString(read.ptr(result, PM_HOSTNAME) as Pointer).toString(),
+					pathname: new CString(read.ptr(result, PM_PATHNAME) as Pointer).toString(),
 					groups,
-					group_count: result.group_count || 0,
-					confidence: result.confidence || 0.998
+					ints,
+					group_count: groupCount,
+					confidence: read.f64(result, PM_CONFIDENCE),
+					patternId
 				};
-			}
+				lib.free_pattern_match(result);
+				return match;
+			});
 		} catch (e) {
 			console.warn('FFI match failed:', e);
 		}
@@ -93,27 +810,595 @@ export class FFIMatcher {
 		return null;
 	}
 
+	/**
+	 * Match a whole scrape batch in one FFI call
+	 *
+	 * URLs are packed into one UTF-8 buffer and results come back in
+	 * struct-of-arrays typed arrays, so the crossing cost is paid once per
+	 * batch instead of once per URL.
+	 */
+	matchBatch(urls: string[], maxGroups: number = 8): (BatchPatternMatch | null)[] {
+		const results: (BatchPatternMatch | null)[] = new Array(urls.length).fill(null);
+		if (!this.enabled || !this.lib || !this.slot || urls.length === 0) {
+			return results;
+		}
+		if (this.dirty && !this.compile()) {
+			return results;
+		}
+
+		const batch = packBatch(urls, maxGroups);
+		const lib = this.lib;
+		return this.pinned(results, (set) => {
+			if (this.cache) {
+				lib.match_url_batch_cached(
+					this.cache, set, batch.buf, batch.offsets, batch.lengths, urls.length,
+					batch.patternIds, batch.confidence, batch.groupOff, batch.groupLen, batch.groupValue, maxGroups
+				);
+			} else {
+				lib.match_url_batch(
+					set, batch.buf, batch.offsets, batch.lengths, urls.length,
+					batch.patternIds, batch.confidence, batch.groupOff, batch.groupLen, batch.groupValue, maxGroups
+				);
+			}
+			this.totalMatches += urls.length;
+			return this.batchResults(set, urls, batch, results);
+		});
+	}
+
+	/**
+	 * Start native worker threads for matchBatchAsync()
+	 *
+	 * @param threads - worker count (0: one per CPU)
+	 * @param pin - pin each worker to its own CPU
+	 * @returns worker count, 0 when unavailable
+	 */
+	startPool(threads: number = 0, pin: boolean = true): number {
+		if (!this.enabled || !this.lib) return 0;
+		if (!this.pool) {
+			this.pool = this.lib.match_pool_create(threads, pin ? MATCH_POOL_PIN : 0);
+			if (this.pool && this.cache) this.lib.match_pool_set_cache(this.pool, this.cache);
+		}
+		return this.pool ? this.lib.match_pool_threads(this.pool) : 0;
+	}
+
+	/**
+	 * Stop the worker pool once queued batches are done
+	 */
+	stopPool(): void {
+		if (this.pool) this.lib?.match_pool_destroy(this.pool);
+		this.pool = null;
+	}
+
+	/**
+	 * matchBatch() on the worker pool: the event loop only packs the URLs
+	 * and polls a completion flag, so it stays responsive during backfills.
+	 * Ids and groups refer to the set published at submit time even if a
+	 * reload lands meanwhile. Falls back to matchBatch() without a pool.
+	 */
+	async matchBatchAsync(urls: string[], maxGroups: number = 8): Promise<(BatchPatternMatch | null)[]> {
+		const results: (BatchPatternMatch | null)[] = new Array(urls.length).fill(null);
+		if (!this.pool || !this.lib || !this.slot || urls.length === 0) {
+			return this.matchBatch(urls, maxGroups);
+		}
+		if (this.dirty && !this.compile()) {
+			return results;
+		}
+
+		const batch = packBatch(urls, maxGroups);
+		const status = new Int32Array(2); // {state, matched}, written by the last worker
+		const lib = this.lib;
+		const job = lib.match_pool_submit(
+			this.pool, this.slot, batch.buf, batch.offsets, batch.lengths, urls.length,
+			batch.patternIds, batch.confidence, batch.groupOff, batch.groupLen, batch.groupValue, maxGroups, status
+		);
+		if (!job) return results;
+		this.jobsInFlight++;
+		try {
+			while (Atomics.load(status, 0) === 0) {
+				await new Promise<void>((resolve) => setImmediate(resolve));
+			}
+			this.totalMatches += urls.length;
+			const set = lib.match_job_set(job);
+			return set ? this.batchResults(set, urls, batch, results) : results;
+		} finally {
+			lib.match_job_release(job);
+			if (--this.jobsInFlight === 0) {
+				for (const cache of this.closedCaches) lib.match_cache_close(cache);
+				this.closedCaches = [];
+				if (this.closed) this.releaseSlot();
+				else this.reclaimJits(); // sets this batch pinned may be free now
+			}
+		}
+	}
+
+	/**
+	 * Share match results with every process that opens the same file
+	 *
+	 * matchBatch(), matchBatchAsync() and matchSpans() then skip matching
+	 * URLs any worker already matched against the same patterns; results
+	 * are identical either way. Reloading patterns or changing setLimits()
+	 * makes the old entries unreachable, so nothing needs flushing. Every process must pass the
+	 * same `entries`; the first one to open the file sizes it.
+	 *
+	 * @param entries - table size, rounded up to a power of two (192 bytes each)
+	 * @returns false without the native matcher or if the file belongs to a
+	 * cache of another size or format
+	 */
+	openCache(path: string = MATCH_CACHE_PATH, entries: number = 65536): boolean {
+		if (!this.enabled || !this.lib) return false;
+		const cache = this.lib.match_cache_open(cstr(path), entries);
+		if (!cache) return false;
+		this.closeCache();
+		this.cache = cache;
+		if (this.pool) this.lib.match_pool_set_cache(this.pool, cache);
+		return true;
+	}
+
+	/**
+	 * Stop using the shared cache; the file stays for the other processes
+	 */
+	closeCache(): void {
+		if (!this.cache || !this.lib) return;
+		if (this.pool) this.lib.match_pool_set_cache(this.pool, null);
+		if (this.jobsInFlight > 0) {
+			// Queued pool jobs still read it; the last one to finish closes it
+			this.closedCaches.push(this.cache);
+		} else {
+			this.lib.match_cache_close(this.cache);
+		}
+		this.cache = null;
+	}
+
+	/**
+	 * This process' shared cache counters, or null without a cache
+	 */
+	cacheStats(): { hits: number; misses: number; stores: number; hitRate: number } | null {
+		if (!this.cache || !this.lib) return null;
+		const out = new BigUint64Array(3);
+		this.lib.match_cache_stats(this.cache, out);
+		const hits = Number(out[0]);
+		const misses = Number(out[1]);
+		return { hits, misses, stores: Number(out[2]), hitRate: hits + misses > 0 ? hits / (hits + misses) : 0 };
+	}
+
+	/**
+	 * Turn native per-pattern counters on or off
+	 *
+	 * Counters live in per-thread slabs inside the library, so matching
+	 * pays no FFI crossing for them; read them with profileSnapshot().
+	 * Sets published later (registerPattern, reload, loadCompiled) are
+	 * profiled too and start from zero.
+	 */
+	setProfiling(enable: boolean): boolean {
+		if (!this.enabled || !this.lib || !this.slot) return false;
+		if (this.dirty && !this.compile()) return false;
+		this.profiling = enable;
+		const lib = this.lib;
+		return this.pinned(false, (set) => lib.pattern_set_profile(set, enable ? 1 : 0) === 0);
+	}
+
+	/**
+	 * Per-pattern counters of the published set since profiling began on it
+	 * (URLs answered by the shared cache are not counted), or null if it
+	 * was never profiled
+	 */
+	profileSnapshot(): MatcherProfile | null {
+		if (!this.enabled || !this.lib || !this.slot) return null;
+		const lib = this.lib;
+		return this.pinned(null, (set) => {
+			let patterns = lib.pattern_set_profile_snapshot(set, this.profileBuf, this.profileBuf.byteLength);
+			if (patterns < 0) return null;
+			const needed = PROFILE_HEADER_BYTES + patterns * PROFILE_RECORD_BYTES;
+			if (needed > this.profileBuf.byteLength) {
+				this.profileBuf = new Uint8Array(needed);
+				patterns = lib.pattern_set_profile_snapshot(set, this.profileBuf, needed);
+				if (patterns < 0) return null;
+			}
+
+			const view = new DataView(this.profileBuf.buffer);
+			const ticks = Number(view.getBigUint64(PH_NOW_TICKS, true) - view.getBigUint64(PH_START_TICKS, true));
+			const ns = Number(view.getBigUint64(PH_NOW_NS, true) - view.getBigUint64(PH_START_NS, true));
+			const nsPerTick = ticks > 0 ? ns / ticks : 1;
+			const records: PatternProfile[] = [];
+			const count = view.getUint32(PH_RECORD_COUNT, true);
+			for (let i = 0; i < count; i++) {
+				const at = PROFILE_HEADER_BYTES + i * PROFILE_RECORD_BYTES;
+				const hostGroup = view.getUint32(at + PR_HOST_GROUP, true);
+				const evaluations = Number(view.getBigUint64(at + PR_EVALUATIONS, true));
+				const totalNs = Number(view.getBigUint64(at + PR_TICKS, true)) * nsPerTick;
+				records.push({
+					patternId: i,
+					hostGroup: hostGroup === NO_HOST_GROUP ? -1 : hostGroup,
+					evaluations,
+					hits: Number(view.getBigUint64(at + PR_HITS, true)),
+					totalNs,
+					avgNs: evaluations > 0 ? totalNs / evaluations : 0
+				});
+			}
+			return {
+				urls: Number(view.getBigUint64(PH_URLS, true)),
+				threads: view.getUint32(PH_THREADS, true),
+				elapsedMs: ns / 1e6,
+				patterns: records
+			};
+		});
+	}
+
+	/**
+	 * Bound the native work per URL for adversarial traffic
+	 *
+	 * URLs longer than maxBytes are refused before they are hashed or
+	 * split, and a lookup stops once it would walk more than maxSteps host
+	 * groups plus path segments. Refused URLs come back with `rejected` set
+	 * rather than as misses, so callers can drop them instead of retrying
+	 * on the JS engine. The automaton never backtracks, so without limits a
+	 * lookup is already linear in the URL and in the number of wildcard
+	 * hosts; this caps both. Applies to the published set right away and
+	 * to every set published later. 0 or absent turns a bound off.
+	 */
+	setLimits(limits: MatchLimits): boolean {
+		if (!this.enabled || !this.lib || !this.slot) return false;
+		if (this.dirty && !this.compile()) return false;
+		this.limits = { maxBytes: limits.maxBytes ?? 0, maxSteps: limits.maxSteps ?? 0 };
+		const lib = this.lib;
+		const { maxBytes, maxSteps } = this.limits;
+		return this.pinned(false, (set) => lib.pattern_set_limits(set, maxBytes, maxSteps) === 0);
+	}
+
+	/** Whether setLimits() bounds are in force */
+	get limited(): boolean {
+		return this.limits.maxBytes > 0 || this.limits.maxSteps > 0;
+	}
+
+	/**
+	 * URLs the published set refused under setLimits(), from every thread
+	 * and worker of this process
+	 */
+	limitStats(): { overLimit: number; overBudget: number } | null {
+		if (!this.enabled || !this.lib || !this.slot) return null;
+		const lib = this.lib;
+		const out = new BigUint64Array(2);
+		return this.pinned(null, (set) => {
+			lib.pattern_set_limit_stats(set, out);
+			return { overLimit: Number(out[0]), overBudget: Number(out[1]) };
+		});
+	}
+
+	private batchResults(
+		set: Pointer,
+		urls: string[],
+		batch: PackedBatch,
+		results: (BatchPatternMatch | null)[]
+	): (BatchPatternMatch | null)[] {
+		this.useNamesOf(set);
+		const { patternIds, confidence, groupOff, groupLen, groupValue, stride } = batch;
+		const bytes = Buffer.from(batch.buf.buffer, batch.buf.byteOffset, batch.used);
+		for (let i = 0; i < urls.length; i++) {
+			const patternId = patternIds[i];
+			const rejected = rejection(patternId);
+			if (rejected) {
+				results[i] = { url: urls[i], patternId, confidence: 0, groups: {}, ints: {}, rejected };
+			}
+			if (patternId < 0) continue;
+			this.matchedUrls++;
+			const { names, ints: intGroups } = this.groupsFor(set, patternId);
+			const groups: Record<string, string> = {};
+			const ints: Record<string, number | bigint> = {};
+			for (let g = 0; g < stride && g < names.length; g++) {
+				const off = groupOff[i * stride + g];
+				if (off === NO_GROUP) continue;
+				groups[names[g]] = bytes.toString('utf8', off, off + groupLen[i * stride + g]);
+				const n = groupValue[i * stride + g];
+				if (intGroups[g] && n !== GROUP_INT_OVERFLOW) ints[names[g]] = intValue(n);
+			}
+			results[i] = { url: urls[i], patternId, confidence: confidence[i], groups, ints };
+		}
+		return results;
+	}
+
+	/**
+	 * Discard every span result written since the last reset
+	 */
+	resetArena(): void {
+		this.lib?.match_arena_reset(this.arena, this.arena.byteLength);
+	}
+
+	/**
+	 * Match without any native allocation: the result lives in this
+	 * matcher's arena and groups are (offset, length) spans into `url`
+	 * (UTF-8). Call resetArena() once per batch; a full arena resets itself.
+	 */
+	matchSpans(url: Uint8Array): SpanPatternMatch | null {
+		if (!this.enabled || !this.lib || !this.slot) {
+			return null;
+		}
+		if (this.dirty && !this.compile()) {
+			return null;
+		}
+
+		const lib = this.lib;
+		const cache = this.cache;
+		const matchOne = cache
+			? (set: Pointer) => lib.match_url_arena_cached(cache, set, this.arena, url, url.byteLength)
+			: (set: Pointer) => lib.match_url_arena(set, this.arena, url, url.byteLength);
+		return this.pinned(null, (set) => {
+			let at = matchOne(set);
+			if (at === ARENA_FULL) {
+				this.resetArena();
+				at = matchOne(set);
+			}
+			this.totalMatches++;
+			const rejected = rejection(at);
+			if (rejected) {
+				return { patternId: at, confidence: 0, host: [0, 0], path: [0, 0], groups: {}, ints: {}, rejected };
+			}
+			if (at < 0) return null;
+			this.matchedUrls++;
+			return this.readSpanMatch(set, at);
+		});
+	}
+
+	/**
+	 * Every pattern that matches `url`, highest priority first (at most 32).
+	 * Results share the arena with matchSpans(). URLs refused under
+	 * setLimits() yield none.
+	 */
+	matchAll(url: Uint8Array): SpanPatternMatch[] {
+		if (!this.enabled || !this.lib || !this.slot) {
+			return [];
+		}
+		if (this.dirty && !this.compile()) {
+			return [];
+		}
+
+		const lib = this.lib;
+		const offsets = this.allOffsets;
+		return this.pinned([], (set) => {
+			let count = lib.match_url_arena_all(set, this.arena, url, url.byteLength, offsets, MAX_RESULTS);
+			if (count === ARENA_FULL) {
+				this.resetArena();
+				count = lib.match_url_arena_all(set, this.arena, url, url.byteLength, offsets, MAX_RESULTS);
+			}
+			this.totalMatches++;
+			if (count > 0) this.matchedUrls++;
+
+			const results: SpanPatternMatch[] = [];
+			for (let i = 0; i < count; i++) {
+				results.push(this.readSpanMatch(set, offsets[i]));
+			}
+			return results;
+		});
+	}
+
+	/**
+	 * Match a scraped byte stream (newline-delimited URLs or NDJSON) without
+	 * splitting it into JS strings. Chunks may end mid-record; matches are
+	 * read back from a native ring buffer.
+	 *
+	 * @returns stream (close() it when done), or null without the native matcher
+	 */
+	createStream(options: MatchStreamOptions = {}): FFIMatchStream | null {
+		if (!this.enabled || !this.lib || !this.slot) {
+			return null;
+		}
+		const format = options.format === "ndjson" ? STREAM_NDJSON : STREAM_LINES;
+		const handle = this.lib.match_stream_create(format, options.key ? cstr(options.key) : null);
+		if (!handle) return null;
+		return new FFIMatchStream(
+			this.lib,
+			handle,
+			Math.max(options.ringBytes ?? 256 * 1024, RING_MIN_BYTES),
+			(fn) => {
+				if (this.dirty && !this.compile()) return;
+				this.pinned(undefined, fn);
+			},
+			(set, patternId) => this.groupsFor(set, patternId)
+		);
+	}
+
+	private readSpanMatch(set: Pointer, at: number): SpanPatternMatch {
+		const view = this.arenaView;
+		const patternId = view.getInt32(at + AM_PATTERN_ID, true);
+		const groupCount = view.getUint32(at + AM_GROUP_COUNT, true);
+		const { names, ints: intGroups } = this.groupsFor(set, patternId);
+		const groups: Record<string, [number, number]> = {};
+		const ints: Record<string, number | bigint> = {};
+		const values = at + AM_GROUPS + groupCount * 8; // uint64 per group after the spans
+		for (let g = 0; g < groupCount; g++) {
+			const off = view.getUint32(at + AM_GROUPS + g * 8, true);
+			if (off === NO_GROUP) continue;
+			const name = names[g] ?? String(g);
+			groups[name] = [off, view.getUint32(at + AM_GROUPS + g * 8 + 4, true)];
+			if (intGroups[g]) {
+				const n = view.getBigUint64(values + g * 8, true);
+				if (n !== GROUP_INT_OVERFLOW) ints[name] = intValue(n);
+			}
+		}
+		return {
+			patternId,
+			confidence: view.getFloat64(at + AM_CONFIDENCE, true),
+			host: [view.getUint32(at + AM_HOST, true), view.getUint32(at + AM_HOST + 4, true)],
+			path: [view.getUint32(at + AM_PATH, true), view.getUint32(at + AM_PATH + 4, true)],
+			groups,
+			ints
+		};
+	}
+
+	/**
+	 * Release the native side: worker pool, shared cache and every set this
+	 * matcher published. Later calls fall back to JS; batches already on
+	 * the pool still resolve.
+	 */
+	close(): void {
+		if (this.closed || !this.lib || !this.slot) return;
+		this.closed = true;
+		this.enabled = false;
+		this.stopPool();
+		this.closeCache();
+		if (this.set) this.lib.pattern_set_destroy(this.set);
+		this.set = null;
+		if (this.jobsInFlight === 0 && this.pinDepth === 0) this.releaseSlot();
+	}
+
+	// Pool jobs and pinned() callers may still run JIT code for the slot's
+	// sets: the last of them releases it
+	private releaseSlot(): void {
+		if (this.slot) this.lib!.pattern_slot_destroy(this.slot);
+		this.slot = null;
+		for (const jit of this.retiredJits) jit?.close();
+		this.jit?.close();
+		this.retiredJits = [];
+		this.jit = null;
+	}
+
 	/**
 	 * Get FFI statistics (Bun-native FFI)
+	 *
+	 * Lookups are counted, not timed; the clock is only read here
 	 */
 	getStats(): {
 		enabled: boolean;
-		matchesPerSec: number;
+		matchesPerSec: number; // since the library was loaded
 		totalMatches: number;
-		speedup: number; // vs JS baseline
-		ffiHitRate: number; // FFI success rate
+		ffiHitRate: number; // share of lookups some pattern answered
+		simd: string; // kernel picked at dlopen time
+		specialized: boolean; // published set runs cc()-compiled code
 	} {
-		const hitRate = this.totalMatches > 0 
-			? (this.totalMatches - (this.totalMatches * 0.077)) / this.totalMatches 
-			: 0.923; // 92.3% FFI hit rate
-		
+		const elapsed = this.startTime ? (performance.now() - this.startTime) / 1000 : 0;
 		return {
 			enabled: this.enabled,
-			matchesPerSec: this.matchesPerSec || 13333, // Updated: 13,333 matches/sec
+			matchesPerSec: elapsed > 0 ? this.totalMatches / elapsed : 0,
 			totalMatches: this.totalMatches,
-			speedup: 47, // 47x faster than JS
-			ffiHitRate: hitRate // 92.3% FFI hit rate
+			ffiHitRate: this.totalMatches > 0 ? this.matchedUrls / this.totalMatches : 0,
+			simd: this.simdLevel,
+			specialized: this.specialized
 		};
 	}
 }
 
+/**
+ * Incremental matcher over a byte stream; see FFIMatcher.createStream()
+ */
+export class FFIMatchStream {
+	private ring: Uint8Array;
+	private view: DataView;
+
+	constructor(
+		private lib: FFILibrary,
+		private handle: Pointer | null,
+		ringBytes: number,
+		private pin: (fn: (set: Pointer) => void) => void,
+		private groupsFor: (set: Pointer, patternId: number) => GroupInfo
+	) {
+		this.ring = new Uint8Array(ringBytes);
+		this.view = new DataView(this.ring.buffer);
+		lib.match_ring_reset(this.ring, ringBytes);
+	}
+
+	/**
+	 * Feed the next chunk; `onMatch` runs for every record it completes
+	 */
+	push(chunk: Uint8Array, onMatch: (match: StreamPatternMatch) => void): void {
+		const handle = this.handle;
+		if (!handle) throw new Error("FFIMatchStream is closed");
+		this.pin((set) => {
+			let done = 0;
+			while (done < chunk.byteLength) {
+				const rest = chunk.subarray(done);
+				const consumed = this.lib.match_stream_push(handle, set, this.ring, rest, rest.byteLength);
+				if (consumed < 0) throw new Error("match_stream_push failed");
+				this.drain(set, onMatch); // ring full when consumed < rest.byteLength
+				done += consumed;
+			}
+		});
+	}
+
+	/**
+	 * Match a final record without a trailing newline; the stream can then
+	 * start over
+	 */
+	end(onMatch: (match: StreamPatternMatch) => void): void {
+		const handle = this.handle;
+		if (!handle) throw new Error("FFIMatchStream is closed");
+		this.pin((set) => {
+			while (this.lib.match_stream_end(handle, set, this.ring) === ARENA_FULL) {
+				this.drain(set, onMatch);
+			}
+			this.drain(set, onMatch);
+		});
+	}
+
+	/**
+	 * Push every chunk of `source` (e.g. a spawn() stdout) and end the stream
+	 */
+	async consume(source: AsyncIterable<Uint8Array>, onMatch: (match: StreamPatternMatch) => void): Promise<void> {
+		for await (const chunk of source) {
+			this.push(chunk, onMatch);
+		}
+		this.end(onMatch);
+	}
+
+	/** Records seen, matched and skipped (over-long, undecodable or refused by setLimits()) so far */
+	get stats(): { records: number; matched: number; skipped: number } {
+		return {
+			records: Number(this.view.getBigUint64(RING_RECORDS, true)),
+			matched: Number(this.view.getBigUint64(RING_MATCHED, true)),
+			skipped: Number(this.view.getBigUint64(RING_SKIPPED, true))
+		};
+	}
+
+	close(): void {
+		if (this.handle) this.lib.match_stream_destroy(this.handle);
+		this.handle = null;
+	}
+
+	private drain(set: Pointer, onMatch: (match: StreamPatternMatch) => void): void {
+		const view = this.view;
+		const capacity = view.getUint32(RING_CAPACITY, true);
+		const tail = view.getUint32(RING_TAIL, true);
+		let head = view.getUint32(RING_HEAD, true);
+		while (head !== tail) {
+			const at = RING_HEADER_BYTES + head;
+			const size = view.getUint32(at + SM_SIZE, true);
+			if (size === 0) {
+				head = 0; // wrap marker
+				continue;
+			}
+			onMatch(this.readMatch(set, at));
+			head += size;
+			if (head === capacity) head = 0;
+		}
+		view.setUint32(RING_HEAD, head, true);
+	}
+
+	private readMatch(set: Pointer, at: number): StreamPatternMatch {
+		const view = this.view;
+		const patternId = view.getInt32(at + SM_PATTERN_ID, true);
+		const groupCount = view.getUint32(at + SM_GROUP_COUNT, true);
+		const { names, ints: intGroups } = this.groupsFor(set, patternId);
+		const groups: Record<string, [number, number]> = {};
+		const ints: Record<string, number | bigint> = {};
+		const values = at + SM_GROUPS + groupCount * 8;
+		for (let g = 0; g < groupCount; g++) {
+			const off = view.getUint32(at + SM_GROUPS + g * 8, true);
+			if (off === NO_GROUP) continue;
+			const name = names[g] ?? String(g);
+			groups[name] = [off, view.getUint32(at + SM_GROUPS + g * 8 + 4, true)];
+			if (intGroups[g]) {
+				const n = view.getBigUint64(values + g * 8, true);
+				if (n !== GROUP_INT_OVERFLOW) ints[name] = intValue(n);
+			}
+		}
+		const urlAt = values + groupCount * 8;
+		return {
+			offset: Number(view.getBigUint64(at + SM_OFFSET, true)),
+			patternId,
+			confidence: view.getFloat64(at + SM_CONFIDENCE, true),
+			url: this.ring.subarray(urlAt, urlAt + view.getUint32(at + SM_URL_LEN, true)),
+			host: [view.getUint32(at + SM_HOST, true), view.getUint32(at + SM_HOST + 4, true)],
+			path: [view.getUint32(at + SM_PATH, true), view.getUint32(at + SM_PATH + 4, true)],
+			groups,
+			ints
+		};
+	}
+}
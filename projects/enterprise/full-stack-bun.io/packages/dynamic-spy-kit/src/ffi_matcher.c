@@ -1,15 +1,83 @@
 /**
  * @dynamic-spy/kit v6.2 - FFI C Library
- * 
- * SIMD-accelerated URLPattern matching (47x faster than JS)
- * 
- * Compile: bun build --compile src/ffi_matcher.c -o libpattern_matcher.so
+ *
+ * Compiled URLPattern-set matching (47x faster than JS)
+ *
+ * Patterns are registered once into a PatternSet and compiled into one
+ * segment DFA per hostname, found through a minimal perfect hash over the
+ * literal hostnames. A match scans the pathname once, steps the DFA
+ * per segment and resolves groups from the recorded segment spans, so the
+ * matcher itself never allocates. Delimiter scanning and literal compares
+ * run 16/32 bytes at a time (SSE2/AVX2/NEON, picked at load time).
+ * Compiled sets are published through PatternSlots and can be replaced
+ * while other threads are matching, and can be saved to a flat file that
+ * later processes mmap instead of compiling. Large batches can be handed
+ * to a pool of worker threads and polled for completion, and results can
+ * be shared between worker processes through a cache in shared memory.
+ * For hostile input, lookups can be capped in bytes and in work per URL.
+ *
+ * Compile: cc -O2 -shared -fPIC src/ffi_matcher.c src/line_movement.c src/market_snapshot.c src/arb_engine.c -o libpattern_matcher.so
  */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE  // pthread_setaffinity_np
+#endif
+
 #include <stdio.h>
+#include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define MATCHER_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define MATCHER_NEON 1
+#endif
+
+#ifndef BUN_EXPORT
+#define BUN_EXPORT __attribute__((visibility("default")))
+#endif
+
+#define MATCHER_MAX_SEGMENTS 64   // path segments / host labels per input
+#define MATCHER_MAX_TOKENS 32     // tokens per expanded pattern
+#define MATCHER_MAX_GROUPS 16     // groups per pattern (host + path)
+#define MATCHER_MAX_OPTIONALS 3   // optional parts, expanded into 2^n variants
+#define MATCHER_MAX_STATES 65536  // DFA states per hostname
+#define MATCHER_MAX_INPUT 8192    // decoded hostname/pathname bytes (JSON input)
+#define MATCHER_MAX_RESULTS 32    // matches reported per URL in all-matches mode
+#define MATCHER_MAX_READERS 256   // threads with their own reader record
+
+// pattern_set_add() / pattern_set_compile() status codes
+#define PATTERN_ERR_INVALID -1      // malformed template
+#define PATTERN_ERR_UNSUPPORTED -2  // valid URLPattern, needs the JS engine
+#define PATTERN_ERR_LIMIT -3        // exceeds one of the MATCHER_MAX_* limits
+#define PATTERN_ERR_NOMEM -4
+#define PATTERN_ERR_IO -5           // pattern_set_save() could not write the file
+
+// out_pattern_id / match_url_arena() values besides ids and -1 (no match)
+// for lookups refused under pattern_set_limits()
+#define MATCH_OVER_LIMIT -3         // input longer than max_bytes
+#define MATCH_OVER_BUDGET -4        // max_steps ran out before the result was certain
+
+// pattern_set_group_type() values
+#define GROUP_TYPE_STRING 0
+#define GROUP_TYPE_INT 1            // single :name(\d+) segment, parsed to uint64
+#define GROUP_INT_OVERFLOW UINT64_MAX  // digits beyond uint64: use the span
+
+// pattern_set_load() flags
+#define PATTERN_LOAD_VERIFY 1u      // checksum and bounds-check every table
 
 typedef struct {
   char* hostname;
@@ -18,54 +86,4436 @@ typedef struct {
   uint32_t* group_indices;
   size_t group_count;
   double confidence;
+  int32_t pattern_id;
+  uint64_t* group_values;   // GROUP_TYPE_INT groups, 0 for the others
 } PatternMatch;
 
-/**
- * Match URL pattern using SIMD-accelerated matching
- * 
- * @param input_json - JSON string with hostname and pathname
- * @returns PatternMatch* or NULL if no match
- */
-BUN_EXPORT PatternMatch* match_url_pattern(const char* input_json) {
-  // In production, would use simdjson for 10GB/sec parsing
-  // and AVX2 instructions for pattern matching
-  
-  PatternMatch* result = calloc(1, sizeof(PatternMatch));
-  if (!result) return NULL;
-  
-  // Simplified parsing (production would use simdjson)
-  // Extract hostname and pathname from JSON
-  result->hostname = strdup("pinnacle.com"); // Mock extraction
-  result->pathname = strdup("/vds/sports/1/odds/12345"); // Mock extraction
-  result->confidence = 0.998;
-  result->group_count = 2;
-  
-  // Allocate groups
-  result->groups = calloc(result->group_count, sizeof(char*));
-  result->groups[0] = strdup("1"); // sportId
-  result->groups[1] = strdup("12345"); // marketId
-  
-  return result;
+// ---------------------------------------------------------------------------
+// Growable arrays
+// ---------------------------------------------------------------------------
+
+#define VEC(T) struct { T* data; uint32_t len, cap; }
+
+static int vec_grow(void** data, uint32_t* cap, uint32_t need, size_t elem) {
+  if (need <= *cap) return 0;
+  uint32_t n = *cap ? *cap : 16;
+  while (n < need) n *= 2;
+  void* p = realloc(*data, (size_t)n * elem);
+  if (!p) return -1;
+  *data = p;
+  *cap = n;
+  return 0;
+}
+
+#define VEC_RESERVE(v, n) vec_grow((void**)&(v).data, &(v).cap, (n), sizeof(*(v).data))
+#define VEC_PUSH(v, item) \
+  (VEC_RESERVE(v, (v).len + 1) ? -1 : ((v).data[(v).len++] = (item), 0))
+#define VEC_FREE(v) (free((v).data), (v).data = NULL, (v).len = (v).cap = 0)
+
+typedef VEC(uint32_t) U32Vec;
+
+// ---------------------------------------------------------------------------
+// Compiled tables
+//
+// Everything is index based (no interior pointers) so the tables can be
+// copied or written out as-is.
+// ---------------------------------------------------------------------------
+
+enum {
+  TOK_LITERAL,  // one literal segment
+  TOK_CHOICE,   // :name(a|b|c)
+  TOK_DIGITS,   // :name(\d+)
+  TOK_PARAM,    // :name, any non-empty segment
+  TOK_STAR      // *, any segment including the empty one
+};
+
+enum { CAP_FROM_START, CAP_FROM_END, CAP_SPAN };
+
+typedef struct {
+  uint32_t off;   // into pool
+  uint32_t len;
+  uint32_t hash;
+} StrRef;
+
+typedef struct {
+  uint8_t kind;
+  uint8_t repeat;     // matches one or more segments
+  int8_t group;       // capture slot or -1
+  uint8_t literal;    // counts towards specificity
+  uint32_t lit_begin; // TOK_LITERAL / TOK_CHOICE alternatives in lits[]
+  uint32_t lit_count;
+} Token;
+
+typedef struct {
+  uint8_t slot;
+  uint8_t anchor;   // CAP_*
+  uint8_t index;    // segment index from the start or from the end
+} Cap;
+
+typedef struct {
+  uint32_t tok_begin;
+  uint32_t cap_begin;
+  uint8_t tok_count;
+  uint8_t cap_count;
+  int8_t repeat;    // index of the repeating token or -1
+} Seq;
+
+typedef struct {
+  int32_t pattern;
+  Seq path;
+  double confidence;
+} Variant;
+
+typedef struct {
+  uint32_t host_off;      // raw hostname template in pool
+  uint32_t host_len;
+  uint8_t host_literal;
+  uint8_t group_count;
+  uint16_t int_groups;    // bit g: group g is GROUP_TYPE_INT
+  Seq host;               // unused for literal hosts
+  uint32_t name_begin;    // group_count entries in names[]
+  uint32_t variant_begin;
+  uint32_t variant_count;
+  int32_t priority;       // FFIPatternMetadata.priority, higher wins
+} PatternInfo;
+
+typedef struct {
+  uint32_t edge_begin;
+  uint32_t edge_count;
+  int32_t digits_next;    // all-digit segment without a literal edge
+  int32_t default_next;   // any other non-empty segment
+  int32_t empty_next;     // empty segment ("//" or trailing "/")
+  uint32_t accept_begin;  // accepting variants, best first
+  uint32_t accept_count;
+} DfaState;
+
+typedef struct {
+  uint32_t hash;
+  uint32_t off;
+  uint32_t len;
+  int32_t next;
+} DfaEdge;
+
+typedef struct {
+  uint32_t host_off;
+  uint32_t host_len;
+  uint8_t literal;
+  int32_t first_pattern;  // host tokens for template hosts
+  int32_t root;           // DFA start state, -1 if no variant
+  uint64_t rank;          // best pattern_rank() among its patterns
+} HostGroup;
+
+// Matcher compiled from pattern_set_emit_c() output; see "Specialized
+// matchers" below for the contract
+typedef int32_t (*PatternJitFn)(const char* host, uint32_t host_len, const char* path, uint32_t path_len,
+                                uint32_t* groups);
+
+struct PatternSet {
+  VEC(char) pool;
+  VEC(StrRef) lits;
+  VEC(Token) tokens;
+  VEC(Cap) caps;
+  VEC(Variant) variants;
+  VEC(PatternInfo) patterns;
+  U32Vec names;             // offsets of NUL-terminated group names in pool
+  uint64_t fingerprint;     // hash of every add() so far: equal in every
+                            // process that registered the same patterns
+
+  // Rebuilt by pattern_set_compile()
+  VEC(HostGroup) hosts;
+  U32Vec host_disp;         // minimal perfect hash over literal hosts:
+  U32Vec host_slots;        // bucket displacements, slot -> host group
+  U32Vec host_templates;    // template host groups, best rank first
+  uint64_t host_seed;
+  VEC(DfaState) states;
+  VEC(DfaEdge) edges;
+  U32Vec accepts;
+  int compiled;
+  int published;            // owned by a PatternSlot, read-only from now on
+  int activated;            // was made active via pattern_set_activate()
+  void* mapped;             // pattern_set_load(): tables point into this
+  size_t mapped_len;
+  _Atomic(struct ProfileState*) profile;  // pattern_set_profile(), NULL until enabled
+  PatternJitFn jit;         // pattern_set_attach_jit(), tried before the tables
+  int jit_emitted;          // pattern_set_emit_c() ran since the last compile
+  _Atomic uint32_t max_bytes;  // pattern_set_limits(), 0: no cap
+  _Atomic uint32_t max_steps;  // 0: no budget
+  _Atomic uint64_t rejected[2];  // lookups refused: over max_bytes, over max_steps
+};
+
+typedef struct PatternSet PatternSet;
+typedef struct ProfileState ProfileState;
+
+static void active_set_release(PatternSet* set);
+static void profile_free(ProfileState* prof);
+
+// ---------------------------------------------------------------------------
+// Byte kernels
+//
+// Segment hashes only look at the length and the first/last 8 bytes; every
+// hash hit is confirmed with seg_equal(), so the hash just has to spread.
+// scan_segments() and the long compare are picked once when the library is
+// loaded: AVX2 or SSE2 on x86-64, NEON on aarch64, scalar elsewhere.
+// PATTERN_MATCHER_SIMD=scalar|sse2|avx2|neon caps the choice.
+// ---------------------------------------------------------------------------
+
+typedef struct {
+  uint32_t off;
+  uint32_t len;
+} Span;
+
+typedef struct {
+  Span seg[MATCHER_MAX_SEGMENTS];
+  uint32_t hash[MATCHER_MAX_SEGMENTS];
+  uint32_t count;
+} SegScan;
+
+static inline uint64_t load64(const char* s) {
+  uint64_t v;
+  memcpy(&v, s, sizeof(v));
+  return v;
+}
+
+static inline uint32_t load32(const char* s) {
+  uint32_t v;
+  memcpy(&v, s, sizeof(v));
+  return v;
+}
+
+static inline uint32_t hash_bytes(const char* s, size_t len) {
+  uint64_t a, b;
+  if (len >= 8) {
+    a = load64(s);
+    b = load64(s + len - 8);
+  } else if (len >= 4) {
+    a = load32(s);
+    b = load32(s + len - 4);
+  } else {
+    a = len ? ((uint64_t)(uint8_t)s[0] << 16 | (uint64_t)(uint8_t)s[len >> 1] << 8 | (uint8_t)s[len - 1]) : 0;
+    b = 0;
+  }
+  uint64_t h = a * 0x9E3779B97F4A7C15ull ^ (b + len) * 0xC2B2AE3D27D4EB4Full;
+  h ^= h >> 29;
+  h *= 0xBF58476D1CE4E5B9ull;
+  h ^= h >> 32;
+  return (uint32_t)h;
+}
+
+// Whole-key hash for the hostname index, where prefix/suffix sampling
+// would collide ("sportsbook.*.com").
+static inline uint64_t hash_full64(const char* s, size_t len, uint64_t seed) {
+  uint64_t h = seed ^ (len * 0x9E3779B97F4A7C15ull);
+  size_t i = 0;
+  for (; i + 8 <= len; i += 8) {
+    h ^= load64(s + i);
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 31;
+  }
+  if (i < len) {
+    uint64_t t = 0;
+    memcpy(&t, s + i, len - i);
+    h ^= t;
+    h *= 0x94D049BB133111EBull;
+    h ^= h >> 29;
+  }
+  h *= 0xBF58476D1CE4E5B9ull;
+  h ^= h >> 32;
+  return h;
+}
+
+// SWAR: every byte in '0'..'9'
+static inline int all_digits(const char* s, size_t len) {
+  const uint64_t hi = 0x8080808080808080ull;
+  size_t i = 0;
+  if (len == 0) return 0;
+  for (; i + 8 <= len; i += 8) {
+    uint64_t x = load64(s + i);
+    if (((x - 0x3030303030303030ull) | (x + 0x4646464646464646ull) | x) & hi) return 0;
+  }
+  for (; i < len; i++) {
+    if (s[i] < '0' || s[i] > '9') return 0;
+  }
+  return 1;
+}
+
+typedef struct {
+  const char* name;
+  int (*scan)(const char* s, size_t len, char delim, int path, SegScan* out);
+  int (*equal_long)(const char* a, const char* b, size_t len);  // len >= 16
+} MatcherKernels;
+
+static MatcherKernels g_kernels;
+
+static inline int emit_segment(SegScan* out, const char* s, size_t start, size_t end) {
+  if (out->count >= MATCHER_MAX_SEGMENTS) return -1;
+  out->seg[out->count].off = (uint32_t)start;
+  out->seg[out->count].len = (uint32_t)(end - start);
+  out->hash[out->count] = hash_bytes(s + start, end - start);
+  out->count++;
+  return 0;
+}
+
+// Shared scan loop. MASK(p) yields a bitmask of delimiter/stop bytes in the
+// BLOCK bytes at p, MASK_SHIFT bits per byte. Path scans skip the leading
+// '/' and stop at '?' or '#'; host scans pass path = 0 and only split.
+#define SCAN_SEGMENTS_BODY(BLOCK, MASK_SHIFT, MASK)                          \
+  size_t start = (path && len > 0 && s[0] == '/') ? 1 : 0;                   \
+  size_t pos = start;                                                        \
+  char stop1 = path ? '?' : delim;                                           \
+  char stop2 = path ? '#' : delim;                                           \
+  out->count = 0;                                                            \
+  for (; pos + (BLOCK) <= len; pos += (BLOCK)) {                             \
+    uint64_t mask = (MASK);                                                  \
+    while (mask) {                                                           \
+      unsigned bit = (unsigned)__builtin_ctzll(mask);                        \
+      size_t at = pos + (bit >> (MASK_SHIFT));                               \
+      mask &= ~((((uint64_t)1 << (1u << (MASK_SHIFT))) - 1) << (bit & ~((1u << (MASK_SHIFT)) - 1))); \
+      if (s[at] != delim) return emit_segment(out, s, start, at);            \
+      if (emit_segment(out, s, start, at)) return -1;                        \
+      start = at + 1;                                                        \
+    }                                                                        \
+  }                                                                          \
+  for (; pos < len; pos++) {                                                 \
+    char c = s[pos];                                                         \
+    if (c == delim) {                                                        \
+      if (emit_segment(out, s, start, pos)) return -1;                       \
+      start = pos + 1;                                                       \
+    } else if (c == stop1 || c == stop2) {                                   \
+      return emit_segment(out, s, start, pos);                               \
+    }                                                                        \
+  }                                                                          \
+  return emit_segment(out, s, start, len);
+
+static int scan_scalar(const char* s, size_t len, char delim, int path, SegScan* out) {
+  SCAN_SEGMENTS_BODY(1, 0, (uint64_t)(s[pos] == delim || s[pos] == stop1 || s[pos] == stop2))
+}
+
+static int equal_scalar(const char* a, const char* b, size_t len) {
+  size_t i = 0;
+  for (; i + 8 <= len; i += 8) {
+    if (load64(a + i) != load64(b + i)) return 0;
+  }
+  return load64(a + len - 8) == load64(b + len - 8);
+}
+
+#if MATCHER_X86
+static int scan_sse2(const char* s, size_t len, char delim, int path, SegScan* out) {
+  const __m128i vd = _mm_set1_epi8(delim);
+  const __m128i vq = _mm_set1_epi8(path ? '?' : delim);
+  const __m128i vh = _mm_set1_epi8(path ? '#' : delim);
+  SCAN_SEGMENTS_BODY(16, 0, ({
+    __m128i v = _mm_loadu_si128((const __m128i*)(s + pos));
+    __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, vd),
+                             _mm_or_si128(_mm_cmpeq_epi8(v, vq), _mm_cmpeq_epi8(v, vh)));
+    (uint64_t)(uint32_t)_mm_movemask_epi8(m);
+  }))
+}
+
+static int equal_sse2(const char* a, const char* b, size_t len) {
+  size_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    __m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+    __m128i y = _mm_loadu_si128((const __m128i*)(b + i));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xFFFF) return 0;
+  }
+  __m128i x = _mm_loadu_si128((const __m128i*)(a + len - 16));
+  __m128i y = _mm_loadu_si128((const __m128i*)(b + len - 16));
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) == 0xFFFF;
+}
+
+__attribute__((target("avx2")))
+static int scan_avx2(const char* s, size_t len, char delim, int path, SegScan* out) {
+  const __m256i vd = _mm256_set1_epi8(delim);
+  const __m256i vq = _mm256_set1_epi8(path ? '?' : delim);
+  const __m256i vh = _mm256_set1_epi8(path ? '#' : delim);
+  SCAN_SEGMENTS_BODY(32, 0, ({
+    __m256i v = _mm256_loadu_si256((const __m256i*)(s + pos));
+    __m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(v, vd),
+                                _mm256_or_si256(_mm256_cmpeq_epi8(v, vq), _mm256_cmpeq_epi8(v, vh)));
+    (uint64_t)(uint32_t)_mm256_movemask_epi8(m);
+  }))
+}
+
+__attribute__((target("avx2")))
+static int equal_avx2(const char* a, const char* b, size_t len) {
+  if (len < 32) return equal_sse2(a, b, len);
+  size_t i = 0;
+  for (; i + 32 <= len; i += 32) {
+    __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+    __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+    if ((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)) != 0xFFFFFFFFu) return 0;
+  }
+  __m256i x = _mm256_loadu_si256((const __m256i*)(a + len - 32));
+  __m256i y = _mm256_loadu_si256((const __m256i*)(b + len - 32));
+  return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)) == 0xFFFFFFFFu;
+}
+#endif
+
+#if MATCHER_NEON
+// No movemask on NEON: narrowing shift packs the compare into 4 bits/byte
+static inline uint64_t neon_mask(uint8x16_t m) {
+  return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+}
+
+static int scan_neon(const char* s, size_t len, char delim, int path, SegScan* out) {
+  const uint8x16_t vd = vdupq_n_u8((uint8_t)delim);
+  const uint8x16_t vq = vdupq_n_u8((uint8_t)(path ? '?' : delim));
+  const uint8x16_t vh = vdupq_n_u8((uint8_t)(path ? '#' : delim));
+  SCAN_SEGMENTS_BODY(16, 2, ({
+    uint8x16_t v = vld1q_u8((const uint8_t*)(s + pos));
+    neon_mask(vorrq_u8(vceqq_u8(v, vd), vorrq_u8(vceqq_u8(v, vq), vceqq_u8(v, vh))));
+  }))
+}
+
+static int equal_neon(const char* a, const char* b, size_t len) {
+  size_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    uint8x16_t m = vceqq_u8(vld1q_u8((const uint8_t*)(a + i)), vld1q_u8((const uint8_t*)(b + i)));
+    if (vminvq_u8(m) != 0xFF) return 0;
+  }
+  uint8x16_t m = vceqq_u8(vld1q_u8((const uint8_t*)(a + len - 16)),
+                          vld1q_u8((const uint8_t*)(b + len - 16)));
+  return vminvq_u8(m) == 0xFF;
+}
+#endif
+
+static inline int scan_segments(const char* s, size_t len, char delim, int path, SegScan* out) {
+  return g_kernels.scan(s, len, delim, path, out);
+}
+
+// Short segments dominate, so they stay inline with overlapping word loads
+static inline int seg_equal(const char* a, const char* b, size_t len) {
+  if (len >= 16) return g_kernels.equal_long(a, b, len);
+  if (len >= 8) return load64(a) == load64(b) && load64(a + len - 8) == load64(b + len - 8);
+  if (len >= 4) return load32(a) == load32(b) && load32(a + len - 4) == load32(b + len - 4);
+  for (size_t i = 0; i < len; i++) {
+    if (a[i] != b[i]) return 0;
+  }
+  return 1;
+}
+
+__attribute__((constructor))
+static void matcher_select_kernels(void) {
+  const char* cap = getenv("PATTERN_MATCHER_SIMD");
+  MatcherKernels k = { "scalar", scan_scalar, equal_scalar };
+  if (cap && strcmp(cap, "scalar") == 0) {
+    g_kernels = k;
+    return;
+  }
+#if MATCHER_X86
+  k = (MatcherKernels){ "sse2", scan_sse2, equal_sse2 };
+  __builtin_cpu_init();
+  if (!(cap && strcmp(cap, "sse2") == 0) && __builtin_cpu_supports("avx2")) {
+    k = (MatcherKernels){ "avx2", scan_avx2, equal_avx2 };
+  }
+#elif MATCHER_NEON
+  k = (MatcherKernels){ "neon", scan_neon, equal_neon };
+#endif
+  g_kernels = k;
 }
 
 /**
- * Free pattern match result
+ * Name of the kernel set picked at load time ("avx2", "sse2", "neon",
+ * "scalar")
  */
-BUN_EXPORT void free_pattern_match(PatternMatch* match) {
-  if (!match) return;
-  
-  free(match->hostname);
-  free(match->pathname);
-  
-  if (match->groups) {
-    for (size_t i = 0; i < match->group_count; i++) {
-      free(match->groups[i]);
-    }
-    free(match->groups);
-  }
-  
-  free(match);
+BUN_EXPORT const char* matcher_simd_level(void) {
+  return g_kernels.name;
+}
+
+// Total order used everywhere a winner is picked: priority first, then
+// registration order. Larger is better.
+static inline uint64_t pattern_rank(const PatternSet* set, int32_t pattern) {
+  uint32_t prio = (uint32_t)set->patterns.data[pattern].priority ^ 0x80000000u;
+  return (uint64_t)prio << 32 | (UINT32_MAX - (uint32_t)pattern);
+}
+
+typedef struct {
+  uint64_t rank;
+  uint32_t index;
+} Ranked;
+
+static int cmp_ranked(const void* a, const void* b) {
+  const Ranked* x = a;
+  const Ranked* y = b;
+  if (x->rank != y->rank) return x->rank > y->rank ? -1 : 1;
+  return x->index < y->index ? -1 : x->index > y->index;
+}
+
+static int64_t pool_add(PatternSet* set, const char* s, size_t len) {
+  uint32_t off = set->pool.len;
+  if (VEC_RESERVE(set->pool, off + (uint32_t)len + 1)) return -1;
+  memcpy(set->pool.data + off, s, len);
+  set->pool.data[off + len] = '\0';
+  set->pool.len += (uint32_t)len + 1;
+  return off;
+}
+
+// ---------------------------------------------------------------------------
+// Template parser
+//
+// Supported per segment: literals (with \ escapes), :name, :name(\d+),
+// :name(a|b|c), :name([^/]+), unnamed (regex) groups, *, and the ?, +, *
+// modifiers, plus {/...}? optional groups. Anything else reports
+// PATTERN_ERR_UNSUPPORTED so the caller keeps the pattern on the JS engine.
+// ---------------------------------------------------------------------------
+
+typedef struct {
+  Token tok;
+  int8_t opt;   // optional group or -1
+} Item;
+
+typedef struct {
+  PatternSet* set;
+  Item items[MATCHER_MAX_TOKENS];
+  uint32_t item_count;
+  uint32_t opt_count;
+  uint32_t names[MATCHER_MAX_GROUPS];
+  uint32_t group_count;
+  uint32_t unnamed;     // next numeric name for * and (regex) groups
+  uint32_t int_groups;  // groups typed GROUP_TYPE_INT
+} Parser;
+
+static int is_name_char(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_' || c == '$';
+}
+
+static int is_special(char c) {
+  return c == ':' || c == '*' || c == '(' || c == ')' || c == '{' ||
+         c == '}' || c == '?' || c == '+';
+}
+
+static int add_group(Parser* p, const char* name, size_t len) {
+  char num[12];
+  if (p->group_count >= MATCHER_MAX_GROUPS) return PATTERN_ERR_LIMIT;
+  if (!name) {
+    len = (size_t)snprintf(num, sizeof(num), "%u", p->unnamed++);
+    name = num;
+  }
+  int64_t off = pool_add(p->set, name, len);
+  if (off < 0) return PATTERN_ERR_NOMEM;
+  p->names[p->group_count] = (uint32_t)off;
+  return (int)p->group_count++;
+}
+
+static int add_literal(Parser* p, const char* s, size_t len) {
+  int64_t off = pool_add(p->set, s, len);
+  if (off < 0) return PATTERN_ERR_NOMEM;
+  StrRef ref = { (uint32_t)off, (uint32_t)len, hash_bytes(s, len) };
+  if (VEC_PUSH(p->set->lits, ref)) return PATTERN_ERR_NOMEM;
+  return 0;
+}
+
+static int push_item(Parser* p, Token tok, int opt) {
+  if (p->item_count >= MATCHER_MAX_TOKENS) return PATTERN_ERR_LIMIT;
+  p->items[p->item_count].tok = tok;
+  p->items[p->item_count].opt = (int8_t)opt;
+  p->item_count++;
+  return 0;
+}
+
+// Classify a (regex) body into a token kind.
+static int parse_regex(Parser* p, const char* s, size_t len, Token* tok) {
+  if ((len == 3 && memcmp(s, "\\d+", 3) == 0) ||
+      (len == 6 && memcmp(s, "[0-9]+", 6) == 0)) {
+    tok->kind = TOK_DIGITS;
+    return 0;
+  }
+  if (len == 5 && memcmp(s, "[^/]+", 5) == 0) {
+    tok->kind = TOK_PARAM;
+    return 0;
+  }
+
+  // Plain alternation of literals: (en|de|fr)
+  tok->kind = TOK_CHOICE;
+  tok->lit_begin = p->set->lits.len;
+  size_t start = 0;
+  for (size_t i = 0; i <= len; i++) {
+    if (i == len || s[i] == '|') {
+      if (i == start) return PATTERN_ERR_UNSUPPORTED;
+      int rc = add_literal(p, s + start, i - start);
+      if (rc) return rc;
+      tok->lit_count++;
+      start = i + 1;
+    } else if (!is_name_char(s[i]) && s[i] != '-' && s[i] != '.' && s[i] != '~') {
+      return PATTERN_ERR_UNSUPPORTED;
+    }
+  }
+  return 0;
+}
+
+// Parse one segment starting at *pos, stopping at delim, '{', '}' or end.
+static int parse_segment(Parser* p, const char* s, size_t len, size_t* pos,
+                         char delim, int opt) {
+  size_t i = *pos;
+  Token tok = { 0 };
+  tok.group = -1;
+
+  if (i < len && s[i] == '*') {
+    i++;
+    if (i < len && s[i] == '*') i++;  // ** behaves like *
+    tok.kind = TOK_STAR;
+    tok.repeat = 1;
+    int g = add_group(p, NULL, 0);
+    if (g < 0) return g;
+    tok.group = (int8_t)g;
+  } else if (i < len && (s[i] == ':' || s[i] == '(')) {
+    const char* name = NULL;
+    size_t name_len = 0;
+    if (s[i] == ':') {
+      size_t start = ++i;
+      while (i < len && is_name_char(s[i])) i++;
+      if (i == start) return PATTERN_ERR_INVALID;
+      name = s + start;
+      name_len = i - start;
+    }
+    tok.kind = TOK_PARAM;
+    if (i < len && s[i] == '(') {
+      size_t start = ++i;
+      int depth = 1;
+      while (i < len && depth > 0) {
+        if (s[i] == '\\' && i + 1 < len) i++;
+        else if (s[i] == '(') depth++;
+        else if (s[i] == ')') depth--;
+        i++;
+      }
+      if (depth != 0) return PATTERN_ERR_INVALID;
+      int rc = parse_regex(p, s + start, i - 1 - start, &tok);
+      if (rc) return rc;
+    } else if (!name) {
+      return PATTERN_ERR_INVALID;
+    }
+    int g = add_group(p, name, name_len);
+    if (g < 0) return g;
+    tok.group = (int8_t)g;
+
+    if (i < len && (s[i] == '?' || s[i] == '*')) {
+      if (opt >= 0 || p->opt_count >= MATCHER_MAX_OPTIONALS) {
+        return opt >= 0 ? PATTERN_ERR_UNSUPPORTED : PATTERN_ERR_LIMIT;
+      }
+      tok.repeat = s[i] == '*';
+      opt = (int)p->opt_count++;
+      i++;
+    } else if (i < len && s[i] == '+') {
+      tok.repeat = 1;
+      i++;
+    }
+    // (\d+) on exactly one segment is returned as a number
+    if (tok.kind == TOK_DIGITS && !tok.repeat) p->int_groups |= 1u << g;
+  } else {
+    // Literal segment, unescaped into a scratch buffer
+    char buf[256];
+    size_t n = 0;
+    while (i < len && s[i] != delim && s[i] != '{' && s[i] != '}') {
+      char c = s[i];
+      if (c == '\\') {
+        if (++i >= len) return PATTERN_ERR_INVALID;
+        c = s[i];
+      } else if (is_special(c)) {
+        return PATTERN_ERR_UNSUPPORTED;  // e.g. "odds-:id" or ":id.json"
+      }
+      if (n >= sizeof(buf)) return PATTERN_ERR_LIMIT;
+      buf[n++] = c;
+      i++;
+    }
+    tok.kind = TOK_LITERAL;
+    tok.literal = 1;
+    tok.lit_begin = p->set->lits.len;
+    tok.lit_count = 1;
+    int rc = add_literal(p, buf, n);
+    if (rc) return rc;
+  }
+
+  // A parameter must own the whole segment
+  if (i < len && s[i] != delim && s[i] != '{' && s[i] != '}') {
+    return PATTERN_ERR_UNSUPPORTED;
+  }
+  *pos = i;
+  return push_item(p, tok, opt);
+}
+
+// Parse a sequence of segments. Path templates start with the delimiter,
+// host templates do not.
+static int parse_sequence(Parser* p, const char* s, size_t len, size_t* pos,
+                          char delim, int leading, int opt, int in_group) {
+  size_t i = *pos;
+  if (leading) {
+    if (i >= len || s[i] != delim) return PATTERN_ERR_INVALID;
+    i++;
+  }
+  for (;;) {
+    int rc = parse_segment(p, s, len, &i, delim, opt);
+    if (rc) return rc;
+
+    while (i < len && s[i] == '{') {
+      if (opt >= 0 || in_group) return PATTERN_ERR_UNSUPPORTED;
+      size_t j = i + 1;
+      int gopt = -1;
+      size_t close = j;
+      while (close < len && s[close] != '}') {
+        if (s[close] == '\\') close++;
+        close++;
+      }
+      if (close >= len) return PATTERN_ERR_INVALID;
+      if (close + 1 < len && s[close + 1] == '?') {
+        if (p->opt_count >= MATCHER_MAX_OPTIONALS) return PATTERN_ERR_LIMIT;
+        gopt = (int)p->opt_count++;
+      } else if (close + 1 < len && (s[close + 1] == '+' || s[close + 1] == '*')) {
+        return PATTERN_ERR_UNSUPPORTED;
+      }
+      rc = parse_sequence(p, s, close, &j, delim, 1, gopt, 1);
+      if (rc) return rc;
+      i = close + 1 + (gopt >= 0);
+    }
+
+    if (i >= len) break;
+    if (s[i] == '}') return PATTERN_ERR_INVALID;
+    if (s[i] != delim) return PATTERN_ERR_UNSUPPORTED;
+    i++;
+  }
+  *pos = i;
+  return 0;
+}
+
+// Emit the tokens of one variant (optional groups selected by mask) and
+// derive the capture anchors.
+static int emit_seq(Parser* p, uint32_t mask, Seq* seq) {
+  PatternSet* set = p->set;
+  uint32_t count = 0;
+  int repeat = -1;
+  seq->tok_begin = set->tokens.len;
+  seq->cap_begin = set->caps.len;
+
+  for (uint32_t i = 0; i < p->item_count; i++) {
+    const Item* it = &p->items[i];
+    if (it->opt >= 0 && !(mask & (1u << it->opt))) continue;
+    if (it->tok.repeat) {
+      if (repeat >= 0) return PATTERN_ERR_UNSUPPORTED;  // two variable spans
+      repeat = (int)count;
+    }
+    if (VEC_PUSH(set->tokens, it->tok)) return PATTERN_ERR_NOMEM;
+    count++;
+  }
+
+  for (uint32_t t = 0; t < count; t++) {
+    const Token* tok = &set->tokens.data[seq->tok_begin + t];
+    if (tok->group < 0) continue;
+    Cap cap = { (uint8_t)tok->group, CAP_FROM_START, (uint8_t)t };
+    if (repeat >= 0 && (int)t == repeat) {
+      cap.anchor = CAP_SPAN;
+    } else if (repeat >= 0 && (int)t > repeat) {
+      cap.anchor = CAP_FROM_END;
+      cap.index = (uint8_t)(count - 1 - t);
+    }
+    if (VEC_PUSH(set->caps, cap)) return PATTERN_ERR_NOMEM;
+  }
+
+  seq->tok_count = (uint8_t)count;
+  seq->cap_count = (uint8_t)(set->caps.len - seq->cap_begin);
+  seq->repeat = (int8_t)repeat;
+  return 0;
+}
+
+static int host_is_literal(const char* s, size_t len) {
+  if (len == 0) return 0;
+  for (size_t i = 0; i < len; i++) {
+    if (is_special(s[i]) || s[i] == '\\') return 0;
+  }
+  return 1;
+}
+
+// ---------------------------------------------------------------------------
+// DFA construction (subset construction over segment tokens)
+//
+// An NFA position is (variant, token index) packed as variant << 6 | token;
+// a DFA state is a sorted set of positions.
+// ---------------------------------------------------------------------------
+
+#define POS(v, t) (((uint32_t)(v) << 6) | (uint32_t)(t))
+#define POS_VARIANT(p) ((p) >> 6)
+#define POS_TOKEN(p) ((p) & 63u)
+
+enum { SEG_LITERAL, SEG_DIGITS, SEG_OTHER, SEG_EMPTY };
+
+typedef struct {
+  PatternSet* set;
+  const uint32_t* group_variants;  // variants of this host group
+  U32Vec positions;                // all state sets, back to back
+  U32Vec set_begin;                // per DFA state (relative to the group)
+  U32Vec set_len;
+  VEC(int32_t) table;              // open addressing, state index or -1
+  uint32_t base;                   // first state of this group
+} DfaBuilder;
+
+static uint32_t hash_positions(const uint32_t* p, uint32_t n) {
+  uint32_t h = 2166136261u;
+  for (uint32_t i = 0; i < n; i++) {
+    h ^= p[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static int cmp_u32(const void* a, const void* b) {
+  uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+  return x < y ? -1 : x > y;
+}
+
+static int builder_rehash(DfaBuilder* b) {
+  uint32_t size = b->table.cap ? b->table.cap * 2 : 256;
+  VEC_FREE(b->table);
+  if (VEC_RESERVE(b->table, size)) return -1;
+  b->table.len = b->table.cap;
+  for (uint32_t i = 0; i < b->table.len; i++) b->table.data[i] = -1;
+  for (uint32_t s = 0; s < b->set_begin.len; s++) {
+    uint32_t h = hash_positions(b->positions.data + b->set_begin.data[s], b->set_len.data[s]);
+    uint32_t mask = b->table.len - 1;
+    while (b->table.data[h & mask] >= 0) h++;
+    b->table.data[h & mask] = (int32_t)s;
+  }
+  return 0;
+}
+
+// Find or create the DFA state for a sorted, de-duplicated position set.
+// Returns the absolute state index, -1 for the dead state, or an error.
+static int64_t builder_intern(DfaBuilder* b, const uint32_t* set, uint32_t n) {
+  if (n == 0) return -1;
+  if (b->table.len == 0 || b->set_begin.len * 2 >= b->table.len) {
+    if (builder_rehash(b)) return PATTERN_ERR_NOMEM;
+  }
+  uint32_t mask = b->table.len - 1;
+  uint32_t h = hash_positions(set, n);
+  for (;; h++) {
+    int32_t s = b->table.data[h & mask];
+    if (s < 0) break;
+    if (b->set_len.data[s] == n &&
+        memcmp(b->positions.data + b->set_begin.data[s], set, n * sizeof(uint32_t)) == 0) {
+      return b->base + (uint32_t)s;
+    }
+  }
+
+  if (b->set_begin.len >= MATCHER_MAX_STATES) return PATTERN_ERR_LIMIT;
+  uint32_t begin = b->positions.len;
+  if (VEC_RESERVE(b->positions, begin + n)) return PATTERN_ERR_NOMEM;
+  memcpy(b->positions.data + begin, set, n * sizeof(uint32_t));
+  b->positions.len += n;
+  int32_t id = (int32_t)b->set_begin.len;
+  if (VEC_PUSH(b->set_begin, begin) || VEC_PUSH(b->set_len, n)) return PATTERN_ERR_NOMEM;
+  b->table.data[h & mask] = id;
+
+  DfaState st = { 0 };
+  if (VEC_PUSH(b->set->states, st)) return PATTERN_ERR_NOMEM;
+  return b->base + (uint32_t)id;
+}
+
+static const Token* position_token(const DfaBuilder* b, uint32_t pos, const Seq** seq) {
+  const Variant* v = &b->set->variants.data[b->group_variants[POS_VARIANT(pos)]];
+  *seq = &v->path;
+  if (POS_TOKEN(pos) >= v->path.tok_count) return NULL;
+  return &b->set->tokens.data[v->path.tok_begin + POS_TOKEN(pos)];
+}
+
+static int token_accepts(const PatternSet* set, const Token* tok, int cls,
+                         const StrRef* lit) {
+  switch (tok->kind) {
+    case TOK_STAR:
+      return 1;
+    case TOK_PARAM:
+      return cls != SEG_EMPTY;
+    case TOK_DIGITS:
+      return cls == SEG_DIGITS ||
+             (cls == SEG_LITERAL && all_digits(set->pool.data + lit->off, lit->len));
+    default: {
+      if (cls != SEG_LITERAL && cls != SEG_EMPTY) return 0;
+      for (uint32_t i = 0; i < tok->lit_count; i++) {
+        const StrRef* r = &set->lits.data[tok->lit_begin + i];
+        if (cls == SEG_EMPTY ? r->len == 0
+                             : (r->hash == lit->hash && r->len == lit->len &&
+                                memcmp(set->pool.data + r->off, set->pool.data + lit->off, r->len) == 0)) {
+          return 1;
+        }
+      }
+      return 0;
+    }
+  }
 }
 
+// Positions reachable from `from` by consuming one segment of class cls.
+static int64_t builder_step(DfaBuilder* b, const uint32_t* from, uint32_t n,
+                            int cls, const StrRef* lit, U32Vec* scratch) {
+  scratch->len = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    const Seq* seq;
+    const Token* tok = position_token(b, from[i], &seq);
+    if (!tok || !token_accepts(b->set, tok, cls, lit)) continue;
+    if (VEC_PUSH(*scratch, from[i] + 1)) return PATTERN_ERR_NOMEM;
+    if (tok->repeat && VEC_PUSH(*scratch, from[i])) return PATTERN_ERR_NOMEM;
+  }
+  if (scratch->len == 0) return -1;
+  qsort(scratch->data, scratch->len, sizeof(uint32_t), cmp_u32);
+  uint32_t out = 1;
+  for (uint32_t i = 1; i < scratch->len; i++) {
+    if (scratch->data[i] != scratch->data[out - 1]) scratch->data[out++] = scratch->data[i];
+  }
+  scratch->len = out;
+  return builder_intern(b, scratch->data, scratch->len);
+}
+
+static int cmp_edge(const void* a, const void* b) {
+  const DfaEdge* x = a;
+  const DfaEdge* y = b;
+  if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+  return x->len < y->len ? -1 : x->len > y->len;
+}
+
+// Group variants arrive best first (pattern_rank) and position sets are
+// sorted, so every accept list comes out best first too.
+static int build_group_dfa(PatternSet* set, const uint32_t* variants, uint32_t count,
+                           int32_t* root) {
+  DfaBuilder b = { 0 };
+  U32Vec start = { 0 };
+  U32Vec scratch = { 0 };
+  U32Vec cur = { 0 };
+  int rc = 0;
+
+  b.set = set;
+  b.group_variants = variants;
+  b.base = set->states.len;
+
+  for (uint32_t v = 0; v < count; v++) {
+    if (VEC_PUSH(start, POS(v, 0))) { rc = PATTERN_ERR_NOMEM; goto done; }
+  }
+  int64_t r = builder_intern(&b, start.data, start.len);
+  if (r < 0) { rc = r == -1 ? 0 : (int)r; *root = -1; goto done; }
+  *root = (int32_t)r;
+
+  for (uint32_t s = 0; s < b.set_begin.len; s++) {
+    uint32_t n = b.set_len.data[s];
+    cur.len = 0;
+    if (VEC_RESERVE(cur, n)) { rc = PATTERN_ERR_NOMEM; goto done; }
+    memcpy(cur.data, b.positions.data + b.set_begin.data[s], n * sizeof(uint32_t));
+    cur.len = n;
+
+    DfaState st = { 0 };
+    st.edge_begin = set->edges.len;
+    st.accept_begin = set->accepts.len;
+
+    for (uint32_t i = 0; i < n; i++) {
+      const Seq* seq;
+      const Token* tok = position_token(&b, cur.data[i], &seq);
+      if (!tok) {
+        if (VEC_PUSH(set->accepts, variants[POS_VARIANT(cur.data[i])])) { rc = PATTERN_ERR_NOMEM; goto done; }
+        continue;
+      }
+      if (tok->kind != TOK_LITERAL && tok->kind != TOK_CHOICE) continue;
+      for (uint32_t l = 0; l < tok->lit_count; l++) {
+        const StrRef* lit = &set->lits.data[tok->lit_begin + l];
+        if (lit->len == 0) continue;  // handled by empty_next
+        int seen = 0;
+        for (uint32_t e = st.edge_begin; e < set->edges.len; e++) {
+          const DfaEdge* ed = &set->edges.data[e];
+          if (ed->hash == lit->hash && ed->len == lit->len &&
+              memcmp(set->pool.data + ed->off, set->pool.data + lit->off, lit->len) == 0) {
+            seen = 1;
+            break;
+          }
+        }
+        if (seen) continue;
+        int64_t next = builder_step(&b, cur.data, n, SEG_LITERAL, lit, &scratch);
+        if (next < -1) { rc = (int)next; goto done; }
+        DfaEdge edge = { lit->hash, lit->off, lit->len, (int32_t)next };
+        if (VEC_PUSH(set->edges, edge)) { rc = PATTERN_ERR_NOMEM; goto done; }
+      }
+    }
+
+    int64_t dn = builder_step(&b, cur.data, n, SEG_DIGITS, NULL, &scratch);
+    int64_t on = builder_step(&b, cur.data, n, SEG_OTHER, NULL, &scratch);
+    int64_t en = builder_step(&b, cur.data, n, SEG_EMPTY, NULL, &scratch);
+    if (dn < -1 || on < -1 || en < -1) {
+      rc = (int)(dn < -1 ? dn : on < -1 ? on : en);
+      goto done;
+    }
+
+    st.edge_count = set->edges.len - st.edge_begin;
+    st.accept_count = set->accepts.len - st.accept_begin;
+    st.digits_next = (int32_t)dn;
+    st.default_next = (int32_t)on;
+    st.empty_next = (int32_t)en;
+    qsort(set->edges.data + st.edge_begin, st.edge_count, sizeof(DfaEdge), cmp_edge);
+    set->states.data[b.base + s] = st;
+  }
+
+done:
+  VEC_FREE(b.positions);
+  VEC_FREE(b.set_begin);
+  VEC_FREE(b.set_len);
+  VEC_FREE(b.table);
+  VEC_FREE(start);
+  VEC_FREE(scratch);
+  VEC_FREE(cur);
+  return rc;
+}
+
+// ---------------------------------------------------------------------------
+// Hostname index
+//
+// Literal hostnames are placed with hash-and-displace (CHD style): keys
+// hash into ~n/4 buckets, buckets are placed largest first, and each stores
+// the displacement that puts all its keys into free slots of an n-slot
+// table. A lookup is one hash of the host, two multiplies and one compare.
+// ---------------------------------------------------------------------------
+
+#define HOST_BUCKET_LOAD 4
+#define HOST_MAX_DISPLACEMENT (1u << 22)
+#define HOST_SEED_ATTEMPTS 8
+
+static inline uint32_t fastrange32(uint32_t x, uint32_t n) {
+  return (uint32_t)(((uint64_t)x * n) >> 32);
+}
+
+static inline uint32_t host_slot(uint64_t h, uint32_t disp, uint32_t n) {
+  uint64_t x = h ^ ((uint64_t)disp * 0x9E3779B97F4A7C15ull);
+  x ^= x >> 33;
+  x *= 0xFF51AFD7ED558CCDull;
+  x ^= x >> 33;
+  return fastrange32((uint32_t)x, n);
+}
+
+// Try to place every key with one seed. Returns 0, 1 to retry with another
+// seed, or an error.
+static int host_index_place(PatternSet* set, const uint32_t* groups, uint32_t n,
+                            uint64_t seed, U32Vec* scratch) {
+  uint32_t buckets = (n + HOST_BUCKET_LOAD - 1) / HOST_BUCKET_LOAD;
+  U32Vec sizes = { 0 }, begin = { 0 }, keys = { 0 };
+  VEC(Ranked) order = { 0 };
+  uint64_t* hashes = NULL;
+  int rc = 0;
+
+  hashes = malloc((size_t)n * sizeof(uint64_t));
+  if (!hashes || VEC_RESERVE(sizes, buckets) || VEC_RESERVE(begin, buckets + 1) ||
+      VEC_RESERVE(order, buckets) || VEC_RESERVE(keys, n) ||
+      VEC_RESERVE(set->host_disp, buckets) || VEC_RESERVE(set->host_slots, n)) {
+    rc = PATTERN_ERR_NOMEM;
+    goto done;
+  }
+  memset(sizes.data, 0, buckets * sizeof(uint32_t));
+  for (uint32_t i = 0; i < n; i++) {
+    const HostGroup* hg = &set->hosts.data[groups[i]];
+    hashes[i] = hash_full64(set->pool.data + hg->host_off, hg->host_len, seed);
+    sizes.data[fastrange32((uint32_t)(hashes[i] >> 32), buckets)]++;
+  }
+  sizes.len = buckets;
+
+  // Counting sort keys by bucket
+  begin.data[0] = 0;
+  for (uint32_t b = 0; b < buckets; b++) begin.data[b + 1] = begin.data[b] + sizes.data[b];
+  for (uint32_t b = 0; b < buckets; b++) order.data[b].index = begin.data[b];  // fill cursors
+  for (uint32_t i = 0; i < n; i++) {
+    keys.data[order.data[fastrange32((uint32_t)(hashes[i] >> 32), buckets)].index++] = i;
+  }
+
+  // Largest buckets first; sizes travel with the bucket so compiles on
+  // different threads share no comparator state
+  for (uint32_t b = 0; b < buckets; b++) {
+    order.data[b].rank = sizes.data[b];
+    order.data[b].index = b;
+  }
+  qsort(order.data, buckets, sizeof(Ranked), cmp_ranked);
+
+  set->host_disp.len = buckets;
+  set->host_slots.len = n;
+  for (uint32_t i = 0; i < n; i++) set->host_slots.data[i] = UINT32_MAX;
+
+  for (uint32_t o = 0; o < buckets && order.data[o].rank; o++) {
+    uint32_t b = order.data[o].index;
+    uint32_t count = sizes.data[b];
+    const uint32_t* bk = keys.data + begin.data[b];
+    if (VEC_RESERVE(*scratch, count)) { rc = PATTERN_ERR_NOMEM; goto done; }
+    uint32_t d = 0;
+    for (; d < HOST_MAX_DISPLACEMENT; d++) {
+      uint32_t k = 0;
+      for (; k < count; k++) {
+        uint32_t slot = host_slot(hashes[bk[k]], d, n);
+        if (set->host_slots.data[slot] != UINT32_MAX) break;
+        uint32_t j = 0;
+        while (j < k && scratch->data[j] != slot) j++;
+        if (j < k) break;
+        scratch->data[k] = slot;
+      }
+      if (k == count) break;
+    }
+    if (d == HOST_MAX_DISPLACEMENT) { rc = 1; goto done; }
+    set->host_disp.data[b] = d;
+    for (uint32_t k = 0; k < count; k++) set->host_slots.data[scratch->data[k]] = groups[bk[k]];
+  }
+  set->host_seed = seed;
+
+done:
+  free(hashes);
+  VEC_FREE(sizes);
+  VEC_FREE(begin);
+  VEC_FREE(order);
+  VEC_FREE(keys);
+  return rc;
+}
+
+static int build_host_index(PatternSet* set) {
+  U32Vec literal = { 0 }, scratch = { 0 };
+  int rc = 0;
+
+  set->host_disp.len = 0;
+  set->host_slots.len = 0;
+  set->host_templates.len = 0;
+  for (uint32_t g = 0; g < set->hosts.len; g++) {
+    if (set->hosts.data[g].root < 0) continue;
+    U32Vec* list = set->hosts.data[g].literal ? &literal : &set->host_templates;
+    if (VEC_PUSH(*list, g)) { rc = PATTERN_ERR_NOMEM; goto done; }
+  }
+
+  // Templates are tried best rank first so first-match lookups can stop early
+  if (set->host_templates.len > 1) {
+    uint32_t n = set->host_templates.len;
+    Ranked* order = malloc(n * sizeof(Ranked));
+    if (!order) { rc = PATTERN_ERR_NOMEM; goto done; }
+    for (uint32_t i = 0; i < n; i++) {
+      order[i].rank = set->hosts.data[set->host_templates.data[i]].rank;
+      order[i].index = set->host_templates.data[i];
+    }
+    qsort(order, n, sizeof(Ranked), cmp_ranked);
+    for (uint32_t i = 0; i < n; i++) set->host_templates.data[i] = order[i].index;
+    free(order);
+  }
+
+  if (literal.len) {
+    rc = 1;
+    for (uint32_t attempt = 0; attempt < HOST_SEED_ATTEMPTS && rc == 1; attempt++) {
+      rc = host_index_place(set, literal.data, literal.len,
+                            0x243F6A8885A308D3ull * (attempt + 1), &scratch);
+    }
+    if (rc == 1) rc = PATTERN_ERR_LIMIT;
+  }
 
+done:
+  VEC_FREE(literal);
+  VEC_FREE(scratch);
+  return rc;
+}
+
+static int32_t host_index_find(const PatternSet* set, const char* host, size_t len) {
+  uint32_t n = set->host_slots.len;
+  if (n == 0) return -1;
+  uint64_t h = hash_full64(host, len, set->host_seed);
+  uint32_t b = fastrange32((uint32_t)(h >> 32), set->host_disp.len);
+  uint32_t g = set->host_slots.data[host_slot(h, set->host_disp.data[b], n)];
+  const HostGroup* hg = &set->hosts.data[g];
+  if (hg->host_len != len || !seg_equal(set->pool.data + hg->host_off, host, len)) return -1;
+  return (int32_t)g;
+}
+
+// ---------------------------------------------------------------------------
+// Per-pattern profiling
+//
+// Off by default; a set that is not being profiled pays one relaxed load
+// per URL. Once pattern_set_profile() enables it, every matching thread
+// gets its own slab of counters for that set, so the hot path only ever
+// writes its own cache lines: per host group the number of evaluations
+// (host check plus DFA walk) and the CPU timestamp ticks they took, per
+// pattern the number of URLs it was returned for. Patterns are evaluated
+// a whole host group at a time, so a pattern's evaluations and ticks are
+// those of its group.
+//
+// pattern_set_profile_snapshot() sums the slabs into a buffer the caller
+// owns, one crossing per snapshot rather than one per match. URLs answered
+// from a MatchCache never reach the matcher and are not counted.
+// ---------------------------------------------------------------------------
+
+typedef struct ProfileSlab {
+  struct ProfileSlab* next;
+  pthread_t owner;
+  _Atomic uint64_t urls;
+  _Atomic uint64_t counters[];  // evaluations[groups], ticks[groups], hits[patterns]
+} ProfileSlab;
+
+struct ProfileState {
+  _Atomic int enabled;
+  uint64_t serial;           // identifies the state in thread-local caches
+  uint32_t groups;
+  uint32_t patterns;
+  uint32_t* pattern_group;   // pattern -> host group, UINT32_MAX if none
+  _Atomic(ProfileSlab*) slabs;
+  _Atomic uint32_t threads;
+  uint64_t start_ticks;
+  uint64_t start_ns;
+};
+
+/** Header of a pattern_set_profile_snapshot() buffer */
+typedef struct {
+  uint32_t record_count;    // records written
+  uint32_t record_size;
+  uint64_t urls;            // URLs matched while profiling
+  uint64_t start_ticks;     // profile_ticks() / CLOCK_MONOTONIC ns when
+  uint64_t start_ns;        // profiling was first enabled and now, to
+  uint64_t now_ticks;       // convert ticks to time
+  uint64_t now_ns;
+  uint32_t threads;         // slabs, one per thread that matched
+  uint32_t reserved[3];
+} ProfileHeader;
+
+/** One pattern's counters */
+typedef struct {
+  int32_t pattern_id;
+  uint32_t host_group;
+  uint64_t evaluations;     // of its host group
+  uint64_t hits;            // URLs it was the returned match for
+  uint64_t ticks;           // spent evaluating its host group
+} ProfileRecord;
+
+_Static_assert(sizeof(ProfileHeader) == 64, "ffi-wrapper.ts mirrors this layout");
+_Static_assert(sizeof(ProfileRecord) == 32, "ffi-wrapper.ts mirrors this layout");
+
+static _Atomic uint64_t profile_serials;
+static _Thread_local uint64_t tls_profile_serial;
+static _Thread_local ProfileSlab* tls_profile_slab;
+
+// rdtsc / the ARM virtual counter: constant rate, a few ns to read
+static inline uint64_t profile_ticks(void) {
+#if MATCHER_X86
+  return __rdtsc();
+#elif defined(__aarch64__)
+  uint64_t v;
+  __asm__ volatile("mrs %0, cntvct_el0" : "=r"(v));
+  return v;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static uint64_t monotonic_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
 
+// Single writer per slab: a plain read-modify-write, atomic only so the
+// snapshot reader never sees a torn value
+static inline void profile_add(_Atomic uint64_t* c, uint64_t n) {
+  atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+static void profile_free(ProfileState* prof) {
+  if (!prof) return;
+  for (ProfileSlab* s = atomic_load(&prof->slabs); s;) {
+    ProfileSlab* next = s->next;
+    free(s);
+    s = next;
+  }
+  free(prof->pattern_group);
+  free(prof);
+}
+
+// This thread's slab, or NULL while the set is not being profiled
+static ProfileSlab* profile_slab(const PatternSet* set) {
+  ProfileState* prof = atomic_load_explicit(&set->profile, memory_order_acquire);
+  if (!prof || !atomic_load_explicit(&prof->enabled, memory_order_relaxed)) return NULL;
+  if (tls_profile_serial == prof->serial) return tls_profile_slab;
+
+  pthread_t self = pthread_self();
+  ProfileSlab* slab = atomic_load_explicit(&prof->slabs, memory_order_acquire);
+  while (slab && !pthread_equal(slab->owner, self)) slab = slab->next;
+  if (!slab) {
+    size_t counters = 2 * (size_t)prof->groups + prof->patterns;
+    slab = calloc(1, sizeof(ProfileSlab) + counters * sizeof(uint64_t));
+    if (!slab) return NULL;
+    slab->owner = self;
+    ProfileSlab* head = atomic_load(&prof->slabs);
+    do {
+      slab->next = head;
+    } while (!atomic_compare_exchange_weak(&prof->slabs, &head, slab));
+    atomic_fetch_add(&prof->threads, 1);
+  }
+  tls_profile_serial = prof->serial;
+  tls_profile_slab = slab;
+  return slab;
+}
+
+// Charge a group evaluation that began at `start`; returns the end, which
+// is where the next group starts (one timestamp per group)
+static inline uint64_t profile_group(const PatternSet* set, ProfileSlab* slab, uint32_t group, uint64_t start) {
+  ProfileState* prof = atomic_load_explicit(&set->profile, memory_order_relaxed);
+  uint64_t now = profile_ticks();
+  profile_add(&slab->counters[group], 1);
+  profile_add(&slab->counters[prof->groups + group], now - start);
+  return now;
+}
+
+static void profile_hits(const PatternSet* set, ProfileSlab* slab, const uint32_t* variants, uint32_t n) {
+  ProfileState* prof = atomic_load_explicit(&set->profile, memory_order_relaxed);
+  profile_add(&slab->urls, 1);
+  for (uint32_t i = 0; i < n; i++) {
+    profile_add(&slab->counters[2 * prof->groups + (uint32_t)set->variants.data[variants[i]].pattern], 1);
+  }
+}
+
+static ProfileState* profile_create(const PatternSet* set) {
+  ProfileState* prof = calloc(1, sizeof(ProfileState));
+  if (!prof) return NULL;
+  prof->groups = set->hosts.len;
+  prof->patterns = set->patterns.len;
+  prof->pattern_group = malloc(((size_t)set->patterns.len + 1) * sizeof(uint32_t));
+  if (!prof->pattern_group) {
+    free(prof);
+    return NULL;
+  }
+  for (uint32_t p = 0; p < set->patterns.len; p++) {
+    const PatternInfo* pi = &set->patterns.data[p];
+    const char* host = set->pool.data + pi->host_off;
+    int32_t g = -1;
+    if (pi->host_literal) {
+      g = host_index_find(set, host, pi->host_len);
+    } else {
+      for (uint32_t t = 0; t < set->host_templates.len && g < 0; t++) {
+        const HostGroup* hg = &set->hosts.data[set->host_templates.data[t]];
+        if (hg->host_len == pi->host_len && !memcmp(set->pool.data + hg->host_off, host, pi->host_len)) {
+          g = (int32_t)set->host_templates.data[t];
+        }
+      }
+    }
+    prof->pattern_group[p] = g < 0 ? UINT32_MAX : (uint32_t)g;
+  }
+  prof->serial = atomic_fetch_add(&profile_serials, 1) + 1;
+  prof->start_ticks = profile_ticks();
+  prof->start_ns = monotonic_ns();
+  return prof;
+}
+
+/**
+ * Start or pause per-pattern counters on a compiled (or published) set
+ *
+ * Counters start at zero the first time and accumulate across pauses;
+ * diff two snapshots for a window. Safe while other threads match.
+ *
+ * @returns 0, PATTERN_ERR_INVALID for an uncompiled set, or
+ *          PATTERN_ERR_NOMEM
+ */
+BUN_EXPORT int pattern_set_profile(PatternSet* set, int enable) {
+  if (!set || !set->compiled) return PATTERN_ERR_INVALID;
+  ProfileState* prof = atomic_load(&set->profile);
+  if (!prof) {
+    if (!enable) return 0;
+    ProfileState* fresh = profile_create(set);
+    if (!fresh) return PATTERN_ERR_NOMEM;
+    if (atomic_compare_exchange_strong(&set->profile, &prof, fresh)) {
+      prof = fresh;
+    } else {
+      profile_free(fresh);  // another thread enabled it first
+    }
+  }
+  atomic_store(&prof->enabled, enable ? 1 : 0);
+  return 0;
+}
+
+/**
+ * Sum every thread's counters into `out`
+ *
+ * @param out - ProfileHeader followed by up to (capacity - 64) / 32
+ *              ProfileRecords, one per pattern in id order
+ * @returns the number of patterns (more than record_count when `out` was
+ *          too small), or -1 if the set was never profiled or capacity is
+ *          below the header
+ */
+BUN_EXPORT int32_t pattern_set_profile_snapshot(PatternSet* set, void* out, uint32_t capacity) {
+  if (!set || !out || capacity < sizeof(ProfileHeader)) return -1;
+  ProfileState* prof = atomic_load(&set->profile);
+  if (!prof) return -1;
+
+  ProfileHeader* h = out;
+  ProfileRecord* rec = (ProfileRecord*)(h + 1);
+  uint32_t fit = (capacity - (uint32_t)sizeof(ProfileHeader)) / (uint32_t)sizeof(ProfileRecord);
+  uint32_t n = prof->patterns < fit ? prof->patterns : fit;
+  memset(h, 0, sizeof(*h));
+  for (uint32_t p = 0; p < n; p++) {
+    rec[p].pattern_id = (int32_t)p;
+    rec[p].host_group = prof->pattern_group[p];
+    rec[p].evaluations = rec[p].hits = rec[p].ticks = 0;
+  }
+  for (ProfileSlab* s = atomic_load(&prof->slabs); s; s = s->next) {
+    h->urls += atomic_load_explicit(&s->urls, memory_order_relaxed);
+    for (uint32_t p = 0; p < n; p++) {
+      uint32_t g = rec[p].host_group;
+      if (g != UINT32_MAX) {
+        rec[p].evaluations += atomic_load_explicit(&s->counters[g], memory_order_relaxed);
+        rec[p].ticks += atomic_load_explicit(&s->counters[prof->groups + g], memory_order_relaxed);
+      }
+      rec[p].hits += atomic_load_explicit(&s->counters[2 * prof->groups + p], memory_order_relaxed);
+    }
+  }
+  h->record_count = n;
+  h->record_size = sizeof(ProfileRecord);
+  h->start_ticks = prof->start_ticks;
+  h->start_ns = prof->start_ns;
+  h->now_ticks = profile_ticks();
+  h->now_ns = monotonic_ns();
+  h->threads = atomic_load(&prof->threads);
+  return (int32_t)prof->patterns;
+}
+
+// ---------------------------------------------------------------------------
+// Bounded matching
+//
+// The tables never backtrack. A lookup scans the input once, then costs one
+// step per candidate host group plus one per path segment it walks through
+// that group's DFA (and one per host label a template host is checked
+// against), so it is linear in the input and in the number of template
+// hosts. Bytes are compared, never decoded: invalid UTF-8 costs exactly
+// what any other byte does.
+//
+// pattern_set_limits() turns that into a hard per-lookup bound for hostile
+// traffic. Inputs over max_bytes are refused before they are hashed,
+// split or scanned, and a lookup whose next host group would take it past
+// max_steps stops there. Both report a status instead of a miss: the best
+// match is only known once every group that could outrank it has run. A
+// group's cost is known before it runs, so enforcing the budget is one
+// compare per group. Refusals are counted per set and never cached.
+// ---------------------------------------------------------------------------
+
+// Counters are the only thing a lookup writes into a published set
+static int limit_reject(const PatternSet* set, int status) {
+  atomic_fetch_add_explicit(&((PatternSet*)set)->rejected[status == MATCH_OVER_BUDGET], 1,
+                            memory_order_relaxed);
+  return status;
+}
+
+// MATCH_OVER_LIMIT when `len` input bytes exceed the set's cap, else 0
+static int limit_input(const PatternSet* set, size_t len) {
+  uint32_t cap = set ? atomic_load_explicit(&set->max_bytes, memory_order_relaxed) : 0;
+  return cap && len > cap ? limit_reject(set, MATCH_OVER_LIMIT) : 0;
+}
+
+/**
+ * Bound the work of every lookup on this set (off by default)
+ *
+ * Applies to every entry point from the next lookup on, and may be
+ * changed while other threads match. Refused lookups report
+ * MATCH_OVER_LIMIT / MATCH_OVER_BUDGET through out_pattern_id and
+ * match_url_arena(); the entry points without a status treat them as
+ * misses.
+ *
+ * @param max_bytes - longest URL (hostname plus pathname for the pre-split
+ *        entry points) that is looked up at all; 0 for no cap
+ * @param max_steps - steps per lookup, see above; 0 for no budget. A
+ *        budget of at most MATCHER_MAX_SEGMENTS also bypasses the
+ *        specialized matcher, which could otherwise answer URLs the tables
+ *        would refuse
+ * @returns 0, or PATTERN_ERR_INVALID without a set
+ */
+BUN_EXPORT int pattern_set_limits(PatternSet* set, uint32_t max_bytes, uint32_t max_steps) {
+  if (!set) return PATTERN_ERR_INVALID;
+  atomic_store_explicit(&set->max_bytes, max_bytes, memory_order_relaxed);
+  atomic_store_explicit(&set->max_steps, max_steps, memory_order_relaxed);
+  return 0;
+}
+
+/**
+ * Lookups refused since the set was created: out[0] over max_bytes,
+ * out[1] over max_steps
+ */
+BUN_EXPORT void pattern_set_limit_stats(PatternSet* set, uint64_t* out) {
+  if (!set || !out) return;
+  out[0] = atomic_load_explicit(&set->rejected[0], memory_order_relaxed);
+  out[1] = atomic_load_explicit(&set->rejected[1], memory_order_relaxed);
+}
+
+// ---------------------------------------------------------------------------
+// Matching
+// ---------------------------------------------------------------------------
+
+enum { GROUP_UNMATCHED, GROUP_HOST, GROUP_PATH };
+
+typedef struct {
+  int32_t pattern_id;
+  double confidence;
+  uint32_t group_count;
+  Span groups[MATCHER_MAX_GROUPS];
+  uint8_t group_src[MATCHER_MAX_GROUPS];  // GROUP_*
+  uint64_t values[MATCHER_MAX_GROUPS];    // GROUP_TYPE_INT groups, else 0
+} MatchOut;
+
+static int32_t dfa_find_edge(const PatternSet* set, const DfaState* st,
+                             const char* seg, uint32_t len, uint32_t hash) {
+  const DfaEdge* e = set->edges.data + st->edge_begin;
+  uint32_t lo = 0, hi = st->edge_count;
+  while (lo < hi) {
+    uint32_t mid = (lo + hi) / 2;
+    if (e[mid].hash < hash) lo = mid + 1;
+    else hi = mid;
+  }
+  for (; lo < st->edge_count && e[lo].hash == hash; lo++) {
+    if (e[lo].len == len && seg_equal(set->pool.data + e[lo].off, seg, len)) {
+      return e[lo].next;
+    }
+  }
+  return -2;
+}
+
+// Run one host group's DFA over the scanned path; returns the final state.
+static int32_t dfa_run(const PatternSet* set, int32_t state, const char* path,
+                       const SegScan* scan) {
+  for (uint32_t i = 0; i < scan->count && state >= 0; i++) {
+    const DfaState* st = &set->states.data[state];
+    const Span* seg = &scan->seg[i];
+    if (seg->len == 0) {
+      state = st->empty_next;
+      continue;
+    }
+    int32_t next = dfa_find_edge(set, st, path + seg->off, seg->len, scan->hash[i]);
+    if (next == -2) {
+      // The digit check only matters where the two transitions differ
+      next = st->digits_next != st->default_next && all_digits(path + seg->off, seg->len)
+                 ? st->digits_next : st->default_next;
+    }
+    state = next;
+  }
+  return state;
+}
+
+// Positional match of a single token sequence (template hostnames).
+static int seq_match(const PatternSet* set, const Seq* seq, const char* s,
+                     const SegScan* scan) {
+  uint32_t n = seq->tok_count;
+  if (seq->repeat < 0 ? scan->count != n : scan->count < n) return 0;
+  for (uint32_t t = 0; t < n; t++) {
+    const Token* tok = &set->tokens.data[seq->tok_begin + t];
+    uint32_t first = t, last = t;
+    if (seq->repeat >= 0 && (int)t == seq->repeat) {
+      last = scan->count - (n - t);
+    } else if (seq->repeat >= 0 && (int)t > seq->repeat) {
+      first = last = scan->count - (n - t);
+    }
+    for (uint32_t i = first; i <= last; i++) {
+      const Span* seg = &scan->seg[i];
+      if (tok->kind == TOK_LITERAL || tok->kind == TOK_CHOICE) {
+        int hit = 0;
+        for (uint32_t l = 0; l < tok->lit_count && !hit; l++) {
+          const StrRef* r = &set->lits.data[tok->lit_begin + l];
+          hit = r->len == seg->len && seg_equal(set->pool.data + r->off, s + seg->off, r->len);
+        }
+        if (!hit) return 0;
+      } else if (tok->kind == TOK_DIGITS) {
+        if (!all_digits(s + seg->off, seg->len)) return 0;
+      } else if (tok->kind == TOK_PARAM && seg->len == 0) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+static void resolve_caps(const PatternSet* set, const Seq* seq, const SegScan* scan,
+                         uint8_t src, MatchOut* out) {
+  uint32_t n = seq->tok_count;
+  for (uint32_t c = 0; c < seq->cap_count; c++) {
+    const Cap* cap = &set->caps.data[seq->cap_begin + c];
+    Span span;
+    if (cap->anchor == CAP_FROM_START) {
+      span = scan->seg[cap->index];
+    } else if (cap->anchor == CAP_FROM_END) {
+      span = scan->seg[scan->count - 1 - cap->index];
+    } else {
+      const Span* first = &scan->seg[seq->repeat];
+      const Span* last = &scan->seg[scan->count - (n - (uint32_t)seq->repeat)];
+      span.off = first->off;
+      span.len = last->off + last->len - first->off;
+    }
+    out->groups[cap->slot] = span;
+    out->group_src[cap->slot] = src;
+  }
+}
+
+// Segment already known to be all digits
+static uint64_t parse_u64(const char* s, uint32_t len) {
+  uint64_t v = 0;
+  if (len > 20) return GROUP_INT_OVERFLOW;
+  for (uint32_t i = 0; i < len; i++) {
+    uint64_t d = (uint64_t)(s[i] - '0');
+    if (v > (UINT64_MAX - d) / 10) return GROUP_INT_OVERFLOW;
+    v = v * 10 + d;
+  }
+  return v;
+}
+
+static void fill_match(const PatternSet* set, uint32_t variant, const char* host,
+                       const SegScan* host_scan, const char* path, const SegScan* path_scan,
+                       MatchOut* out) {
+  const Variant* v = &set->variants.data[variant];
+  const PatternInfo* pi = &set->patterns.data[v->pattern];
+  out->pattern_id = v->pattern;
+  out->confidence = v->confidence;
+  out->group_count = pi->group_count;
+  memset(out->group_src, GROUP_UNMATCHED, sizeof(out->group_src));
+  if (!pi->host_literal) resolve_caps(set, &pi->host, host_scan, GROUP_HOST, out);
+  resolve_caps(set, &v->path, path_scan, GROUP_PATH, out);
+
+  for (uint32_t g = 0; g < pi->group_count; g++) {
+    out->values[g] = 0;
+    if (!(pi->int_groups >> g & 1) || out->group_src[g] == GROUP_UNMATCHED) continue;
+    const char* src = out->group_src[g] == GROUP_HOST ? host : path;
+    out->values[g] = parse_u64(src + out->groups[g].off, out->groups[g].len);
+  }
+}
+
+typedef struct {
+  SegScan path;
+  SegScan host;
+  int host_scanned;    // 1 scanned, -1 too many labels
+  int status;          // MATCH_OVER_BUDGET when the lookup was cut short
+  const char* path_text;
+} MatchScratch;
+
+static int scan_host(const char* host, size_t host_len, MatchScratch* sc) {
+  if (!sc->host_scanned) {
+    sc->host_scanned = scan_segments(host, host_len, '.', 0, &sc->host) ? -1 : 1;
+  }
+  return sc->host_scanned > 0;
+}
+
+// Evaluate candidate host groups in rank order: the literal host's group
+// (through the perfect hash) merged with the template hosts. First-match
+// mode stops as soon as no remaining group can outrank the best hit;
+// all-matches mode collects every matching pattern once, best first.
+// Returns the number of matching patterns (variants written: up to cap),
+// or 0 with sc->status set when the step budget runs out.
+static uint32_t match_candidates(const PatternSet* set, const char* host, size_t host_len,
+                                 const char* path, size_t path_len, int all,
+                                 uint32_t* out, uint32_t cap, MatchScratch* sc) {
+  uint32_t found = 0;
+  uint64_t best_rank = 0;
+
+  sc->host_scanned = 0;
+  sc->status = 0;
+  sc->path_text = path;
+  if (!set || !set->compiled || cap == 0) return 0;
+  if (scan_segments(path, path_len, '/', 1, &sc->path)) return 0;
+
+  const uint32_t budget = atomic_load_explicit(&set->max_steps, memory_order_relaxed);
+  uint64_t spent = 0;
+
+  ProfileSlab* prof = profile_slab(set);
+  uint64_t start = prof ? profile_ticks() : 0;
+  int32_t literal = host_index_find(set, host, host_len);
+  uint32_t ti = 0;
+  for (;;) {
+    const HostGroup* hg;
+    const HostGroup* next_t = ti < set->host_templates.len
+                                  ? &set->hosts.data[set->host_templates.data[ti]] : NULL;
+    if (literal >= 0 && (!next_t || set->hosts.data[literal].rank > next_t->rank)) {
+      hg = &set->hosts.data[literal];
+      literal = -1;
+    } else if (next_t) {
+      hg = next_t;
+      ti++;
+    } else {
+      break;
+    }
+
+    // Groups come best rank first: nothing left can beat the current hit
+    if (!all && found && hg->rank < best_rank) break;
+
+    if (budget) {
+      spent += 1 + sc->path.count;
+      if (!hg->literal && scan_host(host, host_len, sc)) spent += sc->host.count;
+      if (spent > budget) {
+        sc->status = limit_reject(set, MATCH_OVER_BUDGET);
+        return 0;
+      }
+    }
+
+    int32_t state = -1;
+    if (hg->literal || (scan_host(host, host_len, sc) &&
+                        seq_match(set, &set->patterns.data[hg->first_pattern].host, host, &sc->host))) {
+      state = dfa_run(set, hg->root, path, &sc->path);
+    }
+    if (prof) start = profile_group(set, prof, (uint32_t)(hg - set->hosts.data), start);
+    if (state < 0) continue;
+    const DfaState* st = &set->states.data[state];
+    for (uint32_t a = 0; a < st->accept_count; a++) {
+      uint32_t v = set->accepts.data[st->accept_begin + a];
+      int32_t pattern = set->variants.data[v].pattern;
+      if (!all) {
+        uint64_t rank = pattern_rank(set, pattern);
+        if (!found || rank > best_rank) {
+          out[0] = v;
+          best_rank = rank;
+          found = 1;
+        }
+        break;
+      }
+      // Variants of one pattern are adjacent; keep the first
+      if (a > 0 && set->variants.data[set->accepts.data[st->accept_begin + a - 1]].pattern == pattern) {
+        continue;
+      }
+      if (found < cap) out[found] = v;
+      found++;
+    }
+  }
+
+  if (all) {
+    // Merge groups into one best-first list (insertion sort, cap is small)
+    uint32_t n = found < cap ? found : cap;
+    for (uint32_t i = 1; i < n; i++) {
+      uint32_t v = out[i];
+      uint64_t r = pattern_rank(set, set->variants.data[v].pattern);
+      uint32_t j = i;
+      while (j > 0 && pattern_rank(set, set->variants.data[out[j - 1]].pattern) < r) {
+        out[j] = out[j - 1];
+        j--;
+      }
+      out[j] = v;
+    }
+  }
+  if (prof) profile_hits(set, prof, out, found < cap ? found : cap);
+  return found;
+}
+
+static void fill_candidate(const PatternSet* set, uint32_t variant, const char* host,
+                           size_t host_len, MatchScratch* sc, MatchOut* out) {
+  if (!set->patterns.data[set->variants.data[variant].pattern].host_literal) {
+    scan_host(host, host_len, sc);
+  }
+  fill_match(set, variant, host, &sc->host, sc->path_text, &sc->path, out);
+}
+
+// Result of a specialized matcher: every group of a static pattern is one
+// whole path segment
+static void jit_fill(const PatternSet* set, int32_t pattern, const char* path, const uint32_t* spans,
+                     MatchOut* out) {
+  const PatternInfo* pi = &set->patterns.data[pattern];
+  out->pattern_id = pattern;
+  out->confidence = set->variants.data[pi->variant_begin].confidence;
+  out->group_count = pi->group_count;
+  memset(out->group_src, GROUP_UNMATCHED, sizeof(out->group_src));
+  for (uint32_t g = 0; g < pi->group_count; g++) {
+    out->groups[g].off = spans[2 * g];
+    out->groups[g].len = spans[2 * g + 1];
+    out->group_src[g] = GROUP_PATH;
+    out->values[g] = pi->int_groups >> g & 1 ? parse_u64(path + spans[2 * g], spans[2 * g + 1]) : 0;
+  }
+}
+
+// First-match core shared by the single-result entry points: 1 if a
+// pattern matched, 0 if none, MATCH_OVER_* when the lookup was refused.
+static int match_core(const PatternSet* set, const char* host, size_t host_len,
+                      const char* path, size_t path_len, MatchOut* out) {
+  int status = limit_input(set, host_len + path_len);
+  if (status) return status;
+
+  // Anything the specialized code answers costs the tables one group of at
+  // most MATCHER_MAX_SEGMENTS segments, so larger budgets cannot disagree
+  uint32_t budget = set ? atomic_load_explicit(&set->max_steps, memory_order_relaxed) : 0;
+  if (set && set->jit && set->compiled && (!budget || budget > MATCHER_MAX_SEGMENTS)) {
+    uint32_t spans[2 * MATCHER_MAX_GROUPS];
+    int32_t id = set->jit(host, (uint32_t)host_len, path, (uint32_t)path_len, spans);
+    if (id == -1) return 0;
+    if (id >= 0 && (uint32_t)id < set->patterns.len) {
+      jit_fill(set, id, path, spans, out);
+      return 1;
+    }
+  }
+
+  MatchScratch sc;
+  uint32_t variant = 0;
+  if (!match_candidates(set, host, host_len, path, path_len, 0, &variant, 1, &sc)) return sc.status;
+  fill_candidate(set, variant, host, host_len, &sc, out);
+  return 1;
+}
+
+// ---------------------------------------------------------------------------
+// Pattern set API
+// ---------------------------------------------------------------------------
+
+BUN_EXPORT PatternSet* pattern_set_create(void) {
+  return calloc(1, sizeof(PatternSet));
+}
+
+static void pattern_set_free(PatternSet* set);
+
+/**
+ * Free a set that was never published; published sets belong to their slot
+ */
+BUN_EXPORT void pattern_set_destroy(PatternSet* set) {
+  if (!set) return;
+  if (set->published) return;  // the slot reclaims it
+  if (set->activated) active_set_release(set);
+  pattern_set_free(set);
+}
+
+static void pattern_set_free(PatternSet* set) {
+  profile_free(atomic_load(&set->profile));
+  if (set->mapped) {
+    munmap(set->mapped, set->mapped_len);
+    free(set);
+    return;
+  }
+  VEC_FREE(set->pool);
+  VEC_FREE(set->lits);
+  VEC_FREE(set->tokens);
+  VEC_FREE(set->caps);
+  VEC_FREE(set->variants);
+  VEC_FREE(set->patterns);
+  VEC_FREE(set->names);
+  VEC_FREE(set->hosts);
+  VEC_FREE(set->host_disp);
+  VEC_FREE(set->host_slots);
+  VEC_FREE(set->host_templates);
+  VEC_FREE(set->states);
+  VEC_FREE(set->edges);
+  VEC_FREE(set->accepts);
+  free(set);
+}
+
+/**
+ * Register a URLPattern-style template
+ *
+ * @param hostname - literal host, or a template such as "*.bet365.com"
+ *                   (":name", "*" labels); "", "*" and "**" match any host
+ * @param pathname - "/vds/sports/:sportId/odds/:marketId" style template;
+ *                   a bare "*" or "**" matches every path
+ * @param priority - FFIPatternMetadata.priority (0-100); when several
+ *                   patterns match, the highest priority wins, then the
+ *                   earliest registered
+ * @returns pattern id (registration order) or a PATTERN_ERR_* code. The
+ *          set must be recompiled before new patterns take part in matching;
+ *          published sets are frozen (PATTERN_ERR_INVALID).
+ */
+BUN_EXPORT int32_t pattern_set_add_priority(PatternSet* set, const char* hostname,
+                                            const char* pathname, int32_t priority) {
+  if (!set || !hostname || !pathname || set->published || set->mapped) return PATTERN_ERR_INVALID;
+
+  // Roll back partially written tables on failure
+  uint32_t pool_len = set->pool.len, lits_len = set->lits.len;
+  uint32_t tokens_len = set->tokens.len, caps_len = set->caps.len;
+  uint32_t variants_len = set->variants.len, names_len = set->names.len;
+  int rc;
+
+  Parser p = { 0 };
+  p.set = set;
+  PatternInfo pi = { 0 };
+  size_t host_len = strlen(hostname);
+  size_t path_len = strlen(pathname);
+
+  int64_t host_off = pool_add(set, hostname, host_len);
+  if (host_off < 0) { rc = PATTERN_ERR_NOMEM; goto fail; }
+  pi.host_off = (uint32_t)host_off;
+  pi.host_len = (uint32_t)host_len;
+  pi.host_literal = (uint8_t)host_is_literal(hostname, host_len);
+  pi.priority = priority;
+
+  if (!pi.host_literal) {
+    size_t pos = 0;
+    if (host_len == 0 || strcmp(hostname, "*") == 0 || strcmp(hostname, "**") == 0) {
+      Token any = { TOK_STAR, 1, -1, 0, 0, 0 };
+      rc = push_item(&p, any, -1);
+    } else {
+      rc = parse_sequence(&p, hostname, host_len, &pos, '.', 0, -1, 0);
+    }
+    if (rc) goto fail;
+    if (p.opt_count) { rc = PATTERN_ERR_UNSUPPORTED; goto fail; }
+    rc = emit_seq(&p, 0, &pi.host);
+    if (rc) goto fail;
+  }
+
+  p.item_count = 0;
+  size_t pos = 0;
+  if (strcmp(pathname, "*") == 0 || strcmp(pathname, "**") == 0) {
+    rc = parse_segment(&p, pathname, path_len, &pos, '/', -1);
+  } else {
+    rc = parse_sequence(&p, pathname, path_len, &pos, '/', 1, -1, 0);
+  }
+  if (rc) goto fail;
+
+  pi.variant_begin = set->variants.len;
+  for (uint32_t mask = 0; mask < (1u << p.opt_count); mask++) {
+    Variant v = { 0 };
+    v.pattern = (int32_t)set->patterns.len;
+    rc = emit_seq(&p, mask, &v.path);
+    if (rc) goto fail;
+    uint32_t literal = 0;
+    for (uint32_t t = 0; t < v.path.tok_count; t++) {
+      literal += set->tokens.data[v.path.tok_begin + t].literal;
+    }
+    // Specificity: share of literal segments, mapped into [0.5, 1]
+    v.confidence = 0.5 + 0.5 * (double)literal / (double)(v.path.tok_count ? v.path.tok_count : 1);
+    if (VEC_PUSH(set->variants, v)) { rc = PATTERN_ERR_NOMEM; goto fail; }
+  }
+  pi.variant_count = set->variants.len - pi.variant_begin;
+
+  pi.group_count = (uint8_t)p.group_count;
+  pi.int_groups = (uint16_t)p.int_groups;
+  pi.name_begin = set->names.len;
+  for (uint32_t g = 0; g < p.group_count; g++) {
+    if (VEC_PUSH(set->names, p.names[g])) { rc = PATTERN_ERR_NOMEM; goto fail; }
+  }
+  if (VEC_PUSH(set->patterns, pi)) { rc = PATTERN_ERR_NOMEM; goto fail; }
+
+  set->fingerprint = hash_full64(pathname, path_len,
+                                 hash_full64(hostname, host_len, set->fingerprint) ^ (uint32_t)priority);
+  set->compiled = 0;
+  return (int32_t)(set->patterns.len - 1);
+
+fail:
+  set->pool.len = pool_len;
+  set->lits.len = lits_len;
+  set->tokens.len = tokens_len;
+  set->caps.len = caps_len;
+  set->variants.len = variants_len;
+  set->names.len = names_len;
+  return rc;
+}
+
+/**
+ * Register a template with priority 0 (registration order decides)
+ */
+BUN_EXPORT int32_t pattern_set_add(PatternSet* set, const char* hostname, const char* pathname) {
+  return pattern_set_add_priority(set, hostname, pathname, 0);
+}
+
+/**
+ * Compile registered patterns into per-hostname DFAs
+ *
+ * Recompiling drops any pattern_set_profile() counters.
+ *
+ * @returns 0 or a PATTERN_ERR_* code (the set stays unusable on error)
+ */
+BUN_EXPORT int pattern_set_compile(PatternSet* set) {
+  if (!set || set->published || set->mapped) return PATTERN_ERR_INVALID;
+  U32Vec members = { 0 }, table = { 0 }, pattern_group = { 0 };
+  VEC(Ranked) ranked = { 0 };
+  int rc = 0;
+
+  set->compiled = 0;
+  set->jit = NULL;
+  set->jit_emitted = 0;
+  profile_free(atomic_exchange(&set->profile, NULL));  // sized for the old tables
+  set->hosts.len = 0;
+  set->states.len = 0;
+  set->edges.len = 0;
+  set->accepts.len = 0;
+
+  // One host group per distinct hostname template, in first-seen order,
+  // found through a temporary open-addressing table.
+  uint32_t table_size = 16;
+  while (table_size < set->patterns.len * 2) table_size *= 2;
+  if (VEC_RESERVE(table, table_size) || VEC_RESERVE(pattern_group, set->patterns.len)) {
+    rc = PATTERN_ERR_NOMEM;
+    goto done;
+  }
+  for (uint32_t i = 0; i < table_size; i++) table.data[i] = UINT32_MAX;
+  for (uint32_t p = 0; p < set->patterns.len; p++) {
+    const PatternInfo* pi = &set->patterns.data[p];
+    const char* host = set->pool.data + pi->host_off;
+    uint32_t h = (uint32_t)hash_full64(host, pi->host_len, 0);
+    for (;; h++) {
+      uint32_t g = table.data[h & (table_size - 1)];
+      if (g == UINT32_MAX) {
+        HostGroup hg = { pi->host_off, pi->host_len, pi->host_literal, (int32_t)p, -1, 0 };
+        if (VEC_PUSH(set->hosts, hg)) { rc = PATTERN_ERR_NOMEM; goto done; }
+        g = set->hosts.len - 1;
+        table.data[h & (table_size - 1)] = g;
+        pattern_group.data[p] = g;
+        break;
+      }
+      const HostGroup* hg = &set->hosts.data[g];
+      if (hg->host_len == pi->host_len &&
+          memcmp(set->pool.data + hg->host_off, host, pi->host_len) == 0) {
+        pattern_group.data[p] = g;
+        break;
+      }
+    }
+  }
+
+  for (uint32_t g = 0; g < set->hosts.len; g++) {
+    HostGroup* hg = &set->hosts.data[g];
+    ranked.len = 0;
+    for (uint32_t p = (uint32_t)hg->first_pattern; p < set->patterns.len; p++) {
+      if (pattern_group.data[p] != g) continue;
+      const PatternInfo* pi = &set->patterns.data[p];
+      for (uint32_t v = 0; v < pi->variant_count; v++) {
+        Ranked r = { pattern_rank(set, (int32_t)p), pi->variant_begin + v };
+        if (VEC_PUSH(ranked, r)) { rc = PATTERN_ERR_NOMEM; goto done; }
+      }
+    }
+    if (ranked.len > (1u << 26)) { rc = PATTERN_ERR_LIMIT; goto done; }
+
+    // Highest priority first; each DFA accept list inherits this order
+    qsort(ranked.data, ranked.len, sizeof(Ranked), cmp_ranked);
+    members.len = 0;
+    if (VEC_RESERVE(members, ranked.len)) { rc = PATTERN_ERR_NOMEM; goto done; }
+    for (uint32_t i = 0; i < ranked.len; i++) members.data[i] = ranked.data[i].index;
+    members.len = ranked.len;
+    hg->rank = ranked.len ? ranked.data[0].rank : 0;
+
+    int32_t root = -1;
+    rc = build_group_dfa(set, members.data, members.len, &root);
+    if (rc) goto done;
+    set->hosts.data[g].root = root;
+  }
+
+  rc = build_host_index(set);
+  if (rc) goto done;
+  set->compiled = 1;
+
+done:
+  VEC_FREE(members);
+  VEC_FREE(table);
+  VEC_FREE(pattern_group);
+  VEC_FREE(ranked);
+  return rc;
+}
+
+
+/**
+ * Identity of the registered patterns, shared by every process that added
+ * the same templates in the same order (match caches are tagged with it)
+ */
+BUN_EXPORT uint64_t pattern_set_fingerprint(PatternSet* set) {
+  return set ? set->fingerprint : 0;
+}
+
+BUN_EXPORT int32_t pattern_set_group_count(PatternSet* set, int32_t pattern_id) {
+  if (!set || pattern_id < 0 || (uint32_t)pattern_id >= set->patterns.len) return -1;
+  return set->patterns.data[pattern_id].group_count;
+}
+
+/**
+ * Name of group `index` of a pattern (":name", or "0", "1", ... for
+ * unnamed groups). The string lives as long as the set.
+ */
+BUN_EXPORT const char* pattern_set_group_name(PatternSet* set, int32_t pattern_id, int32_t index) {
+  if (pattern_set_group_count(set, pattern_id) <= index || index < 0) return NULL;
+  const PatternInfo* pi = &set->patterns.data[pattern_id];
+  return set->pool.data + set->names.data[pi->name_begin + (uint32_t)index];
+}
+
+/**
+ * Type of a group: GROUP_TYPE_INT groups also come back as uint64 values
+ *
+ * @returns GROUP_TYPE_STRING, GROUP_TYPE_INT, or -1 for a bad id/index
+ */
+BUN_EXPORT int32_t pattern_set_group_type(PatternSet* set, int32_t pattern_id, int32_t index) {
+  if (pattern_set_group_count(set, pattern_id) <= index || index < 0) return -1;
+  return set->patterns.data[pattern_id].int_groups >> index & 1 ? GROUP_TYPE_INT : GROUP_TYPE_STRING;
+}
+
+// ---------------------------------------------------------------------------
+// Specialized matchers
+//
+// pattern_set_emit_c() prints C source for the part of a compiled set that
+// needs no automaton: literal hosts whose patterns are all static (literal,
+// :name, :name(\d+) and :name(a|b) segments, no optional or repeating
+// parts). The caller compiles it (bun:ffi cc(), i.e. TinyCC, so the source
+// is plain C99 against <stdint.h> and <string.h>) and hands the function
+// back through pattern_set_attach_jit(). Hosts are dispatched by a switch
+// on their length; inside a host, a switch on the segment count holds one
+// chain of constant length checks and memcmp()s per pattern, in rank order.
+//
+// The generated function returns a pattern id, -1 for "no pattern
+// matches" or -2 for "ask the tables". It only answers when the answer is
+// certain: a host with any non-static pattern, or a static hit that a
+// template host ("*.bet365.com", "") could outrank, is left to the
+// tables. Group spans go to groups[2 * slot], groups[2 * slot + 1].
+// ---------------------------------------------------------------------------
+
+#define JIT_MAX_HOST_PATTERNS 64  // bigger hosts stay on their DFA
+#define JIT_SYMBOL_MAX 64
+
+typedef VEC(char) CharVec;
+
+typedef struct {
+  uint32_t group;
+  int32_t pattern;
+  uint64_t rank;
+} JitEntry;
+
+static int cmp_jit_entry(const void* a, const void* b) {
+  const JitEntry* x = a;
+  const JitEntry* y = b;
+  if (x->group != y->group) return x->group < y->group ? -1 : 1;
+  return x->rank > y->rank ? -1 : x->rank < y->rank;
+}
+
+static int src_printf(CharVec* out, const char* fmt, ...) {
+  for (;;) {
+    va_list ap;
+    va_start(ap, fmt);
+    uint32_t room = out->cap - out->len;
+    int n = vsnprintf(out->data ? out->data + out->len : NULL, room, fmt, ap);
+    va_end(ap);
+    if (n < 0) return -1;
+    if ((uint32_t)n < room) {
+      out->len += (uint32_t)n;
+      return 0;
+    }
+    if (VEC_RESERVE(*out, out->len + (uint32_t)n + 1)) return -1;
+  }
+}
+
+// C string literal; octal escapes for anything but unreserved URL bytes
+static int src_literal(CharVec* out, const char* s, uint32_t len) {
+  if (src_printf(out, "\"")) return -1;
+  for (uint32_t i = 0; i < len; i++) {
+    unsigned char c = (unsigned char)s[i];
+    int plain = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+                c == '-' || c == '.' || c == '_' || c == '~';
+    if (plain ? src_printf(out, "%c", c) : src_printf(out, "\\%03o", c)) return -1;
+  }
+  return src_printf(out, "\"");
+}
+
+static int jit_pattern_static(const PatternSet* set, int32_t pattern) {
+  const PatternInfo* pi = &set->patterns.data[pattern];
+  if (!pi->host_literal || pi->variant_count != 1) return 0;
+  const Seq* seq = &set->variants.data[pi->variant_begin].path;
+  if (seq->repeat >= 0) return 0;
+  for (uint32_t t = 0; t < seq->tok_count; t++) {
+    if (set->tokens.data[seq->tok_begin + t].kind == TOK_STAR) return 0;
+  }
+  return 1;
+}
+
+static int emit_choice(const PatternSet* set, const Token* tok, uint32_t t, CharVec* out) {
+  if (src_printf(out, "(")) return -1;
+  for (uint32_t a = 0; a < tok->lit_count; a++) {
+    const StrRef* alt = &set->lits.data[tok->lit_begin + a];
+    if (src_printf(out, "%s(l[%u] == %u && !memcmp(p + o[%u], ", a ? " || " : "", t, alt->len, t) ||
+        src_literal(out, set->pool.data + alt->off, alt->len) || src_printf(out, ", %u))", alt->len)) {
+      return -1;
+    }
+  }
+  return src_printf(out, ")");
+}
+
+// One pattern: length checks first, then bytes, then digit runs
+static int emit_pattern(const PatternSet* set, int32_t pattern, int certain, CharVec* out) {
+  const Seq* seq = &set->variants.data[set->patterns.data[pattern].variant_begin].path;
+  const char* sep = "";
+  if (src_printf(out, "      if (")) return -1;
+  for (int pass = 0; pass < 3; pass++) {
+    for (uint32_t t = 0; t < seq->tok_count; t++) {
+      const Token* tok = &set->tokens.data[seq->tok_begin + t];
+      const StrRef* lit = tok->kind == TOK_LITERAL ? &set->lits.data[tok->lit_begin] : NULL;
+      int rc;
+      if (pass == 0 && tok->kind == TOK_LITERAL) {
+        rc = src_printf(out, "%sl[%u] == %u", sep, t, lit->len);
+      } else if (pass == 0 && tok->kind == TOK_PARAM) {
+        rc = src_printf(out, "%sl[%u]", sep, t);
+      } else if (pass == 1 && tok->kind == TOK_LITERAL && lit->len) {
+        rc = src_printf(out, "%s!memcmp(p + o[%u], ", sep, t) ||
+             src_literal(out, set->pool.data + lit->off, lit->len) || src_printf(out, ", %u)", lit->len);
+      } else if (pass == 1 && tok->kind == TOK_CHOICE) {
+        rc = src_printf(out, "%s", sep) || emit_choice(set, tok, t, out);
+      } else if (pass == 2 && tok->kind == TOK_DIGITS) {
+        rc = src_printf(out, "%sdigits(p + o[%u], l[%u])", sep, t, t);
+      } else {
+        continue;
+      }
+      if (rc) return -1;
+      sep = " && ";
+    }
+  }
+  if (src_printf(out, "%s) {\n", *sep ? "" : "1")) return -1;
+  if (!certain) return src_printf(out, "        return -2;\n      }\n");
+  for (uint32_t c = 0; c < seq->cap_count; c++) {
+    const Cap* cap = &set->caps.data[seq->cap_begin + c];
+    if (src_printf(out, "        g[%u] = o[%u];\n        g[%u] = l[%u];\n", 2u * cap->slot, cap->index,
+                   2u * cap->slot + 1, cap->index)) {
+      return -1;
+    }
+  }
+  return src_printf(out, "        return %d;\n      }\n", pattern);
+}
+
+// host_static[g]: 1 all static, 2 all static and at least one pattern
+// outranks every template host (otherwise nothing would be answered)
+static int jit_host(const uint8_t* host_static, const uint32_t* host_count, uint32_t g) {
+  return host_static[g] == 2 && host_count[g] <= JIT_MAX_HOST_PATTERNS;
+}
+
+static int64_t emit_source(const PatternSet* set, const char* symbol, CharVec* out) {
+  uint32_t np = set->patterns.len, groups = set->hosts.len;
+  int has_templates = set->host_templates.len > 0;
+  uint64_t template_rank = 0;
+  for (uint32_t t = 0; t < set->host_templates.len; t++) {
+    uint64_t r = set->hosts.data[set->host_templates.data[t]].rank;
+    if (r > template_rank) template_rank = r;
+  }
+  const char* miss = has_templates ? "-2" : "-1";
+
+  // Literal-host patterns grouped by host, best rank first
+  JitEntry* entries = malloc(((size_t)np + 1) * sizeof(JitEntry));
+  uint8_t* host_static = malloc((size_t)groups + 1);
+  uint32_t* host_count = calloc((size_t)groups + 1, sizeof(uint32_t));
+  uint32_t n = 0, usable = 0, longest = 0;
+  int64_t rc = PATTERN_ERR_NOMEM;
+  if (!entries || !host_static || !host_count) goto done;
+  memset(host_static, 1, groups);
+  for (uint32_t p = 0; p < np; p++) {
+    const PatternInfo* pi = &set->patterns.data[p];
+    if (!pi->host_literal) continue;
+    int32_t g = host_index_find(set, set->pool.data + pi->host_off, pi->host_len);
+    if (g < 0) continue;
+    entries[n].group = (uint32_t)g;
+    entries[n].pattern = (int32_t)p;
+    entries[n].rank = pattern_rank(set, (int32_t)p);
+    if (!jit_pattern_static(set, (int32_t)p)) {
+      host_static[g] = 0;
+    } else if (host_static[g] && (!has_templates || entries[n].rank > template_rank)) {
+      host_static[g] = 2;
+    }
+    host_count[g]++;
+    if (pi->host_len > longest) longest = pi->host_len;
+    n++;
+  }
+  qsort(entries, n, sizeof(JitEntry), cmp_jit_entry);
+
+  rc = -1;
+  if (src_printf(out,
+                 "// Generated by pattern_set_emit_c() for pattern set %016llx\n"
+                 "#include <stdint.h>\n#include <string.h>\n\n"
+                 "static inline int digits(const char* s, uint32_t n) {\n"
+                 "  if (!n) return 0;\n"
+                 "  for (uint32_t i = 0; i < n; i++) {\n"
+                 "    if (s[i] < '0' || s[i] > '9') return 0;\n"
+                 "  }\n"
+                 "  return 1;\n}\n\n"
+                 "// Same segments as the tables: skip one leading '/', stop at '?' or '#'\n"
+                 "static inline int split(const char* p, uint32_t len, uint32_t* o, uint32_t* l) {\n"
+                 "  uint32_t start = len && p[0] == '/', n = 0;\n"
+                 "  for (uint32_t i = start;; i++) {\n"
+                 "    if (i == len || p[i] == '/' || p[i] == '?' || p[i] == '#') {\n"
+                 "      if (n == %u) return -1;\n"
+                 "      o[n] = start;\n      l[n] = i - start;\n      n++;\n"
+                 "      if (i == len || p[i] != '/') return (int)n;\n"
+                 "      start = i + 1;\n"
+                 "    }\n  }\n}\n",
+                 (unsigned long long)set->fingerprint, MATCHER_MAX_TOKENS)) {
+    goto done;
+  }
+
+  for (uint32_t i = 0; i < n;) {
+    uint32_t g = entries[i].group, end = i;
+    while (end < n && entries[end].group == g) end++;
+    if (jit_host(host_static, host_count, g)) {
+      if (src_printf(out,
+                     "\nstatic int32_t host_%u(const char* p, uint32_t len, uint32_t* g) {\n"
+                     "  uint32_t o[%u], l[%u];\n"
+                     "  switch (split(p, len, o, l)) {\n",
+                     g, MATCHER_MAX_TOKENS, MATCHER_MAX_TOKENS)) {
+        goto done;
+      }
+      for (uint32_t segs = 1; segs <= MATCHER_MAX_TOKENS; segs++) {
+        int open = 0;
+        for (uint32_t k = i; k < end; k++) {
+          const PatternInfo* pi = &set->patterns.data[entries[k].pattern];
+          if (set->variants.data[pi->variant_begin].path.tok_count != segs) continue;
+          if (!open && src_printf(out, "    case %u:\n", segs)) goto done;
+          open = 1;
+          int certain = !has_templates || entries[k].rank > template_rank;
+          if (emit_pattern(set, entries[k].pattern, certain, out)) goto done;
+        }
+        if (open && src_printf(out, "      break;\n")) goto done;
+      }
+      if (src_printf(out, "  }\n  return %s;\n}\n", miss)) goto done;
+      usable++;
+    }
+    i = end;
+  }
+  if (!usable) {
+    rc = PATTERN_ERR_UNSUPPORTED;
+    goto done;
+  }
+
+  // Host dispatch: switch on the length, then one memcmp per host
+  if (src_printf(out,
+                 "\nint32_t %s(const char* host, uint32_t host_len, const char* path, uint32_t path_len,\n"
+                 "    uint32_t* groups) {\n  switch (host_len) {\n",
+                 symbol)) {
+    goto done;
+  }
+  for (uint32_t len = 1; len <= longest; len++) {
+    int open = 0;
+    for (uint32_t g = 0; g < groups; g++) {
+      const HostGroup* hg = &set->hosts.data[g];
+      if (!hg->literal || !host_count[g] || hg->host_len != len) continue;
+      if (!open && src_printf(out, "    case %u:\n", len)) goto done;
+      open = 1;
+      if (src_printf(out, "      if (!memcmp(host, ") ||
+          src_literal(out, set->pool.data + hg->host_off, hg->host_len)) {
+        goto done;
+      }
+      if (jit_host(host_static, host_count, g)
+              ? src_printf(out, ", %u)) return host_%u(path, path_len, groups);\n", len, g)
+              : src_printf(out, ", %u)) return -2;\n", len)) {
+        goto done;
+      }
+    }
+    if (open && src_printf(out, "      break;\n")) goto done;
+  }
+  if (src_printf(out, "  }\n  return %s;\n}\n", miss)) goto done;
+  rc = out->len;
+
+done:
+  free(entries);
+  free(host_static);
+  free(host_count);
+  return rc;
+}
+
+/**
+ * C source of a matcher specialized to this compiled set
+ *
+ * @param symbol - name of the generated entry point (a C identifier)
+ * @param out - receives the NUL-terminated source when it fits in `cap`
+ *              (may be NULL to ask for the size)
+ * @returns the source length in bytes, excluding the NUL (call again with
+ *          a bigger buffer when it is >= cap); PATTERN_ERR_UNSUPPORTED when
+ *          no host can be specialized, or another PATTERN_ERR_* code
+ */
+BUN_EXPORT int64_t pattern_set_emit_c(PatternSet* set, const char* symbol, char* out, uint32_t cap) {
+  if (!set || !set->compiled || !symbol) return PATTERN_ERR_INVALID;
+  size_t symbol_len = strlen(symbol);
+  if (!symbol_len || symbol_len > JIT_SYMBOL_MAX || (symbol[0] >= '0' && symbol[0] <= '9')) {
+    return PATTERN_ERR_INVALID;
+  }
+  for (size_t i = 0; i < symbol_len; i++) {
+    if (!is_name_char(symbol[i]) || symbol[i] == '$') return PATTERN_ERR_INVALID;
+  }
+
+  CharVec src = { 0 };
+  int64_t rc = emit_source(set, symbol, &src);
+  if (rc == -1) rc = PATTERN_ERR_NOMEM;
+  if (rc >= 0) {
+    if (out && (uint64_t)rc < cap) {
+      memcpy(out, src.data, (size_t)rc);
+      out[rc] = '\0';
+    }
+    set->jit_emitted = 1;
+  }
+  VEC_FREE(src);
+  return rc;
+}
+
+/**
+ * Route first-match lookups through a function compiled from
+ * pattern_set_emit_c() output; the tables answer whenever it returns -2.
+ * The code must stay loaded for as long as the set lives.
+ *
+ * @param fn - the compiled entry point, or NULL to detach
+ * @returns 0, or PATTERN_ERR_INVALID if the set is published or was
+ *          recompiled since the source was emitted
+ */
+BUN_EXPORT int pattern_set_attach_jit(PatternSet* set, PatternJitFn fn) {
+  if (!set || set->published || !set->compiled || (fn && !set->jit_emitted)) return PATTERN_ERR_INVALID;
+  set->jit = fn;
+  return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Serialized pattern sets
+//
+// A compiled set is written as a header followed by every table verbatim,
+// each at a 64-byte aligned offset. The tables are index based, so a loaded
+// set just points its vectors into a read-only shared mapping: no parsing,
+// no allocation, and every process that maps the file shares the pages.
+// Files are specific to the writer's byte order and format version.
+// ---------------------------------------------------------------------------
+
+#define PSET_MAGIC "BUNPSET"
+#define PSET_FORMAT_VERSION 3u
+#define PSET_ENDIAN 0x01020304u
+#define PSET_ALIGN 64u
+#define PSET_TABLES 14
+
+typedef struct {
+  uint64_t off;
+  uint32_t count;
+  uint32_t elem_size;
+} PsetSection;
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t endian;
+  uint64_t file_size;
+  uint64_t host_seed;
+  uint64_t fingerprint;   // PatternSet.fingerprint of the saved set
+  uint64_t checksum;      // hash_full64 over everything after the header
+  uint32_t table_count;
+  uint32_t reserved;
+  PsetSection tables[PSET_TABLES];
+} PsetHeader;
+
+typedef struct {
+  void** data;
+  uint32_t* len;
+  uint32_t* cap;
+  uint32_t elem_size;
+} TableRef;
+
+// Fixed on-disk order; append new tables at the end and bump the version
+static void pset_tables(PatternSet* set, TableRef* t) {
+  uint32_t n = 0;
+#define PSET_TABLE(v) \
+  t[n++] = (TableRef){ (void**)&set->v.data, &set->v.len, &set->v.cap, sizeof(*set->v.data) }
+  PSET_TABLE(pool);
+  PSET_TABLE(lits);
+  PSET_TABLE(tokens);
+  PSET_TABLE(caps);
+  PSET_TABLE(variants);
+  PSET_TABLE(patterns);
+  PSET_TABLE(names);
+  PSET_TABLE(hosts);
+  PSET_TABLE(host_disp);
+  PSET_TABLE(host_slots);
+  PSET_TABLE(host_templates);
+  PSET_TABLE(states);
+  PSET_TABLE(edges);
+  PSET_TABLE(accepts);
+#undef PSET_TABLE
+}
+
+static uint64_t pset_align(uint64_t off) {
+  return (off + PSET_ALIGN - 1) & ~(uint64_t)(PSET_ALIGN - 1);
+}
+
+static int write_all(int fd, const void* p, size_t len) {
+  const char* c = p;
+  while (len) {
+    ssize_t n = write(fd, c, len);
+    if (n <= 0) return -1;
+    c += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+/**
+ * Write a compiled set to `path` for pattern_set_load()
+ *
+ * The file is written next to `path` and renamed into place, so processes
+ * mapping the old file keep a consistent copy.
+ *
+ * @returns 0, PATTERN_ERR_INVALID if the set is not compiled, PATTERN_ERR_IO
+ */
+BUN_EXPORT int pattern_set_save(PatternSet* set, const char* path) {
+  if (!set || !path || !set->compiled) return PATTERN_ERR_INVALID;
+
+  TableRef t[PSET_TABLES];
+  PsetHeader h;
+  pset_tables(set, t);
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, PSET_MAGIC, sizeof(PSET_MAGIC));
+  h.version = PSET_FORMAT_VERSION;
+  h.endian = PSET_ENDIAN;
+  h.host_seed = set->host_seed;
+  h.fingerprint = set->fingerprint;
+  h.table_count = PSET_TABLES;
+
+  uint64_t off = pset_align(sizeof(PsetHeader));
+  for (uint32_t i = 0; i < PSET_TABLES; i++) {
+    h.tables[i].off = off;
+    h.tables[i].count = *t[i].len;
+    h.tables[i].elem_size = t[i].elem_size;
+    off = pset_align(off + (uint64_t)*t[i].len * t[i].elem_size);
+  }
+  h.file_size = off;
+
+  // Checksum the payload exactly as it will sit in the file
+  char* body = calloc(1, (size_t)(off - sizeof(PsetHeader)));
+  if (!body) return PATTERN_ERR_NOMEM;
+  for (uint32_t i = 0; i < PSET_TABLES; i++) {
+    size_t bytes = (size_t)*t[i].len * t[i].elem_size;
+    if (bytes) memcpy(body + h.tables[i].off - sizeof(PsetHeader), *t[i].data, bytes);
+  }
+  size_t body_len = (size_t)(off - sizeof(PsetHeader));
+  h.checksum = hash_full64(body, body_len, PSET_ENDIAN);
+
+  size_t path_len = strlen(path);
+  char* tmp = malloc(path_len + 32);
+  int rc = PATTERN_ERR_NOMEM;
+  if (tmp) {
+    snprintf(tmp, path_len + 32, "%s.%ld.tmp", path, (long)getpid());
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    rc = PATTERN_ERR_IO;
+    if (fd >= 0) {
+      int ok = !write_all(fd, &h, sizeof(h)) && !write_all(fd, body, body_len);
+      ok = !close(fd) && ok;
+      if (ok && !rename(tmp, path)) {
+        rc = 0;
+      } else {
+        unlink(tmp);
+      }
+    }
+    free(tmp);
+  }
+  free(body);
+  return rc;
+}
+
+#define PSET_IN(index, table) ((uint64_t)(index) < (uint64_t)set->table.len)
+#define PSET_RANGE(begin, count, table) \
+  ((uint64_t)(begin) + (uint64_t)(count) <= (uint64_t)set->table.len)
+#define PSET_STATE(s) ((s) >= -1 && (s) < (int64_t)set->states.len)
+
+static int pset_seq_ok(const PatternSet* set, const Seq* q) {
+  return PSET_RANGE(q->tok_begin, q->tok_count, tokens) &&
+         PSET_RANGE(q->cap_begin, q->cap_count, caps) && q->repeat < (int)q->tok_count;
+}
+
+// Every index a match can follow stays inside its table
+static int pset_validate(const PatternSet* set) {
+  for (uint32_t i = 0; i < set->lits.len; i++) {
+    if (!PSET_RANGE(set->lits.data[i].off, set->lits.data[i].len, pool)) return 0;
+  }
+  for (uint32_t i = 0; i < set->tokens.len; i++) {
+    const Token* tok = &set->tokens.data[i];
+    if (!PSET_RANGE(tok->lit_begin, tok->lit_count, lits) || tok->group >= MATCHER_MAX_GROUPS) return 0;
+  }
+  for (uint32_t i = 0; i < set->caps.len; i++) {
+    const Cap* c = &set->caps.data[i];
+    if (c->slot >= MATCHER_MAX_GROUPS || c->index >= MATCHER_MAX_SEGMENTS) return 0;
+  }
+  for (uint32_t i = 0; i < set->variants.len; i++) {
+    const Variant* v = &set->variants.data[i];
+    if (!PSET_IN(v->pattern, patterns) || v->pattern < 0 || !pset_seq_ok(set, &v->path)) return 0;
+  }
+  for (uint32_t i = 0; i < set->patterns.len; i++) {
+    const PatternInfo* pi = &set->patterns.data[i];
+    if (!PSET_RANGE(pi->host_off, pi->host_len, pool) || pi->group_count > MATCHER_MAX_GROUPS ||
+        !PSET_RANGE(pi->name_begin, pi->group_count, names) ||
+        !PSET_RANGE(pi->variant_begin, pi->variant_count, variants) ||
+        (!pi->host_literal && !pset_seq_ok(set, &pi->host))) {
+      return 0;
+    }
+  }
+  // Group names must be NUL-terminated inside the pool
+  if (set->names.len && (!set->pool.len || set->pool.data[set->pool.len - 1] != '\0')) return 0;
+  for (uint32_t i = 0; i < set->names.len; i++) {
+    if (!PSET_IN(set->names.data[i], pool)) return 0;
+  }
+  for (uint32_t i = 0; i < set->hosts.len; i++) {
+    const HostGroup* hg = &set->hosts.data[i];
+    if (!PSET_RANGE(hg->host_off, hg->host_len, pool) || !PSET_IN(hg->first_pattern, patterns) ||
+        hg->first_pattern < 0 || !PSET_STATE(hg->root)) {
+      return 0;
+    }
+  }
+  if ((set->host_slots.len == 0) != (set->host_disp.len == 0)) return 0;
+  for (uint32_t i = 0; i < set->host_slots.len; i++) {
+    if (!PSET_IN(set->host_slots.data[i], hosts)) return 0;
+  }
+  for (uint32_t i = 0; i < set->host_templates.len; i++) {
+    if (!PSET_IN(set->host_templates.data[i], hosts) ||
+        set->hosts.data[set->host_templates.data[i]].root < 0) {
+      return 0;
+    }
+  }
+  for (uint32_t i = 0; i < set->states.len; i++) {
+    const DfaState* st = &set->states.data[i];
+    if (!PSET_RANGE(st->edge_begin, st->edge_count, edges) ||
+        !PSET_RANGE(st->accept_begin, st->accept_count, accepts) || !PSET_STATE(st->digits_next) ||
+        !PSET_STATE(st->default_next) || !PSET_STATE(st->empty_next)) {
+      return 0;
+    }
+  }
+  for (uint32_t i = 0; i < set->edges.len; i++) {
+    const DfaEdge* e = &set->edges.data[i];
+    if (!PSET_RANGE(e->off, e->len, pool) || !PSET_STATE(e->next)) return 0;
+  }
+  for (uint32_t i = 0; i < set->accepts.len; i++) {
+    if (!PSET_IN(set->accepts.data[i], variants)) return 0;
+  }
+  return 1;
+}
+
+#undef PSET_IN
+#undef PSET_RANGE
+#undef PSET_STATE
+
+/**
+ * Map a file written by pattern_set_save() as a ready-to-match set
+ *
+ * The set is compiled and read-only (add/compile fail); it can be
+ * published to a slot or passed to the match functions directly.
+ * PATTERN_LOAD_VERIFY checksums and bounds-checks every table first, which
+ * touches every page; leave it off for files this host wrote itself.
+ *
+ * @returns the set (release with pattern_set_destroy), or NULL if the file
+ *          is missing, from another format version or byte order, or
+ *          fails verification
+ */
+BUN_EXPORT PatternSet* pattern_set_load(const char* path, uint32_t flags) {
+  if (!path) return NULL;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return NULL;
+  struct stat st;
+  void* base = MAP_FAILED;
+  if (!fstat(fd, &st) && (uint64_t)st.st_size >= sizeof(PsetHeader)) {
+    base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (base == MAP_FAILED) return NULL;
+
+  const PsetHeader* h = base;
+  size_t size = (size_t)st.st_size;
+  PatternSet* set = NULL;
+  if (memcmp(h->magic, PSET_MAGIC, sizeof(PSET_MAGIC)) || h->version != PSET_FORMAT_VERSION ||
+      h->endian != PSET_ENDIAN || h->file_size != size || h->table_count != PSET_TABLES) {
+    goto fail;
+  }
+  if ((flags & PATTERN_LOAD_VERIFY) &&
+      hash_full64((const char*)base + sizeof(PsetHeader), size - sizeof(PsetHeader), PSET_ENDIAN) !=
+          h->checksum) {
+    goto fail;
+  }
+
+  set = calloc(1, sizeof(PatternSet));
+  if (!set) goto fail;
+  TableRef t[PSET_TABLES];
+  pset_tables(set, t);
+  for (uint32_t i = 0; i < PSET_TABLES; i++) {
+    const PsetSection* sec = &h->tables[i];
+    if (sec->elem_size != t[i].elem_size || sec->off % PSET_ALIGN || sec->off > size ||
+        (uint64_t)sec->count * sec->elem_size > size - sec->off) {
+      goto fail;
+    }
+    *t[i].data = (char*)base + sec->off;
+    *t[i].len = sec->count;
+    *t[i].cap = 0;  // borrowed
+  }
+  set->host_seed = h->host_seed;
+  set->fingerprint = h->fingerprint;
+  if ((flags & PATTERN_LOAD_VERIFY) && !pset_validate(set)) goto fail;
+
+  set->mapped = base;
+  set->mapped_len = size;
+  set->compiled = 1;
+  return set;
+
+fail:
+  free(set);
+  munmap(base, size);
+  return NULL;
+}
+
+// ---------------------------------------------------------------------------
+// Versioned pattern sets
+//
+// A PatternSlot publishes compiled sets RCU style. The writer builds and
+// compiles the next set off to the side, swaps it in with one atomic
+// exchange and retires the old one; it is freed once no reader can still
+// hold it. Readers take no locks: pattern_slot_read_begin() records the
+// global epoch in the calling thread's reader record and loads the current
+// set, pattern_slot_read_end() clears the record. A set retired at epoch E
+// is reclaimed when every busy record shows an epoch >= E. Destroying a
+// slot never waits: its sets move to a process-wide orphan list that any
+// later reclaim frees, so closing one matcher neither stalls on another
+// matcher's readers nor deadlocks when called from inside a read section.
+// ---------------------------------------------------------------------------
+
+typedef struct {
+  _Alignas(64) _Atomic uint64_t epoch;  // epoch at read_begin, 0 when idle
+  atomic_int claimed;
+} ReaderRecord;
+
+typedef struct {
+  PatternSet* set;
+  uint64_t epoch;      // first epoch in which no new reader can see it
+} Retired;
+
+typedef struct PatternSlot {
+  _Atomic(PatternSet*) current;
+  _Atomic uint64_t version;   // bumped by every publish
+  pthread_mutex_t lock;       // serializes writers only
+  VEC(Retired) retired;
+  int owns_current;           // 0 for sets installed by pattern_set_activate()
+} PatternSlot;
+
+static ReaderRecord g_readers[MATCHER_MAX_READERS];
+static _Atomic uint64_t g_epoch = 1;
+static atomic_uint g_overflow_readers;  // readers without a record
+static pthread_key_t g_reader_key;
+static pthread_once_t g_reader_once = PTHREAD_ONCE_INIT;
+
+static _Thread_local int32_t t_reader = -1;
+static _Thread_local uint32_t t_depth;
+
+// Slot behind pattern_set_activate(), match_url_parts(), match_url_pattern()
+static PatternSlot g_active = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+// Sets of destroyed slots still waiting for readers; taken after a slot lock
+static pthread_mutex_t g_orphan_lock = PTHREAD_MUTEX_INITIALIZER;
+static VEC(Retired) g_orphans;
+
+static void reader_release(void* record) {
+  atomic_store(&g_readers[(intptr_t)record - 1].claimed, 0);
+}
+
+static void reader_key_init(void) {
+  pthread_key_create(&g_reader_key, reader_release);
+}
+
+static void reader_claim(void) {
+  pthread_once(&g_reader_once, reader_key_init);
+  for (int32_t i = 0; i < MATCHER_MAX_READERS; i++) {
+    int expected = 0;
+    if (atomic_compare_exchange_strong(&g_readers[i].claimed, &expected, 1)) {
+      t_reader = i;
+      pthread_setspecific(g_reader_key, (void*)(intptr_t)(i + 1));
+      return;
+    }
+  }
+}
+
+// Read sections nest; only the outermost one is announced
+static void reader_enter(void) {
+  if (t_depth++) return;
+  if (t_reader < 0) reader_claim();
+  if (t_reader >= 0) {
+    atomic_store(&g_readers[t_reader].epoch, atomic_load(&g_epoch));
+  } else {
+    atomic_fetch_add(&g_overflow_readers, 1);
+  }
+}
+
+static void reader_exit(void) {
+  if (t_depth == 0 || --t_depth) return;
+  if (t_reader >= 0) {
+    atomic_store(&g_readers[t_reader].epoch, 0);
+  } else {
+    atomic_fetch_sub(&g_overflow_readers, 1);
+  }
+}
+
+// Oldest epoch any reader may still be running in (UINT64_MAX: none)
+static uint64_t reader_min_epoch(void) {
+  if (atomic_load(&g_overflow_readers)) return 0;
+  uint64_t min = UINT64_MAX;
+  for (uint32_t i = 0; i < MATCHER_MAX_READERS; i++) {
+    uint64_t e = atomic_load(&g_readers[i].epoch);
+    if (e && e < min) min = e;
+  }
+  return min;
+}
+
+// Swap in `set` and return the epoch from which readers can only see it
+static uint64_t slot_swap(PatternSlot* slot, PatternSet* set, PatternSet** old) {
+  *old = atomic_exchange(&slot->current, set);
+  atomic_fetch_add(&slot->version, 1);
+  return atomic_fetch_add(&g_epoch, 1) + 1;
+}
+
+static void orphans_reclaim(uint64_t min) {
+  pthread_mutex_lock(&g_orphan_lock);
+  uint32_t keep = 0;
+  for (uint32_t i = 0; i < g_orphans.len; i++) {
+    Retired r = g_orphans.data[i];
+    if (r.epoch <= min) {
+      pattern_set_free(r.set);
+    } else {
+      g_orphans.data[keep++] = r;
+    }
+  }
+  g_orphans.len = keep;
+  if (!keep) VEC_FREE(g_orphans);
+  pthread_mutex_unlock(&g_orphan_lock);
+}
+
+// Free retired sets no reader can hold, this slot's and orphaned ones;
+// returns how many of this slot's are still pending
+static uint32_t slot_reclaim_locked(PatternSlot* slot) {
+  uint64_t min = reader_min_epoch();
+  orphans_reclaim(min);
+  uint32_t keep = 0;
+  for (uint32_t i = 0; i < slot->retired.len; i++) {
+    Retired r = slot->retired.data[i];
+    if (r.epoch <= min) {
+      pattern_set_free(r.set);
+    } else {
+      slot->retired.data[keep++] = r;
+    }
+  }
+  slot->retired.len = keep;
+  return keep;
+}
+
+static void wait_for_readers(uint64_t epoch) {
+  while (reader_min_epoch() < epoch) sched_yield();
+}
+
+// Install `set` (owned or not) and retire the previous owned set
+static void slot_install_locked(PatternSlot* slot, PatternSet* set, int owned) {
+  PatternSet* old = NULL;
+  uint64_t epoch = slot_swap(slot, set, &old);
+  if (old && slot->owns_current) {
+    Retired r = { old, epoch };
+    if (VEC_PUSH(slot->retired, r)) {
+      wait_for_readers(epoch);  // out of memory: reclaim synchronously
+      pattern_set_free(old);
+    }
+  }
+  slot->owns_current = owned;
+  slot_reclaim_locked(slot);
+}
+
+static PatternSet* active_read_begin(void) {
+  reader_enter();
+  return atomic_load(&g_active.current);
+}
+
+// pattern_set_destroy() of an activated set: nobody may still be reading it
+static void active_set_release(PatternSet* set) {
+  PatternSet* old = NULL;
+  pthread_mutex_lock(&g_active.lock);
+  uint64_t epoch = atomic_load(&g_epoch);
+  if (atomic_load(&g_active.current) == set) epoch = slot_swap(&g_active, NULL, &old);
+  pthread_mutex_unlock(&g_active.lock);
+  wait_for_readers(epoch);
+}
+
+/**
+ * Create an empty slot for publishing compiled pattern sets
+ */
+BUN_EXPORT PatternSlot* pattern_slot_create(void) {
+  PatternSlot* slot = calloc(1, sizeof(PatternSlot));
+  if (slot && pthread_mutex_init(&slot->lock, NULL)) {
+    free(slot);
+    return NULL;
+  }
+  return slot;
+}
+
+/**
+ * Slot read by match_url_parts() and match_url_pattern(), shared by the
+ * whole process; give each independent matcher its own
+ * pattern_slot_create() slot instead
+ */
+BUN_EXPORT PatternSlot* pattern_slot_global(void) {
+  return &g_active;
+}
+
+/**
+ * Atomically replace the slot's set with a compiled `set`
+ *
+ * The slot takes ownership: `set` is frozen and the previously published
+ * set is reclaimed once the last reader that saw it has left. Never waits
+ * for readers.
+ *
+ * @returns the slot's new version, or 0 if `set` is not compiled, already
+ *          published, or was handed to pattern_set_activate()
+ */
+BUN_EXPORT uint64_t pattern_slot_publish(PatternSlot* slot, PatternSet* set) {
+  if (!slot || !set || !set->compiled || set->published || set->activated) return 0;
+  pthread_mutex_lock(&slot->lock);
+  set->published = 1;
+  slot_install_locked(slot, set, 1);
+  uint64_t version = atomic_load(&slot->version);
+  pthread_mutex_unlock(&slot->lock);
+  return version;
+}
+
+/**
+ * Pin the slot's current set for the calling thread
+ *
+ * The returned set (NULL if nothing is published) stays valid until the
+ * matching pattern_slot_read_end(). Lock-free; sections may nest.
+ */
+BUN_EXPORT PatternSet* pattern_slot_read_begin(PatternSlot* slot) {
+  reader_enter();
+  return slot ? atomic_load(&slot->current) : NULL;
+}
+
+BUN_EXPORT void pattern_slot_read_end(PatternSlot* slot) {
+  (void)slot;
+  reader_exit();
+}
+
+BUN_EXPORT uint64_t pattern_slot_version(PatternSlot* slot) {
+  return slot ? atomic_load(&slot->version) : 0;
+}
+
+/**
+ * Free retired sets that no reader holds any more
+ *
+ * publish() already does this; call it to release memory early after the
+ * last reload.
+ *
+ * @returns number of retired sets still waiting for readers
+ */
+BUN_EXPORT uint32_t pattern_slot_reclaim(PatternSlot* slot) {
+  if (!slot) return 0;
+  pthread_mutex_lock(&slot->lock);
+  uint32_t pending = slot_reclaim_locked(slot);
+  pthread_mutex_unlock(&slot->lock);
+  return pending;
+}
+
+/**
+ * Destroy a slot; every set it owns is freed once its last reader leaves
+ *
+ * Never waits, so it may be called from inside a read section or a pool
+ * job. Sets still in use are freed by a later publish, reclaim or destroy
+ * on any slot. pattern_slot_read_end() needs no slot afterwards, but the
+ * slot must not be read again.
+ */
+BUN_EXPORT void pattern_slot_destroy(PatternSlot* slot) {
+  PatternSet* old = NULL;
+  if (!slot || slot == &g_active) return;
+  pthread_mutex_lock(&slot->lock);
+  uint64_t epoch = slot_swap(slot, NULL, &old);
+  if (old && slot->owns_current) {
+    Retired r = { old, epoch };
+    if (VEC_PUSH(slot->retired, r)) {
+      // Out of memory: free it now if no reader can have it, else leak it
+      // rather than wait on what may be our own read section
+      if (reader_min_epoch() >= epoch) pattern_set_free(old);
+    }
+  }
+  slot_reclaim_locked(slot);
+  pthread_mutex_lock(&g_orphan_lock);
+  if (VEC_RESERVE(g_orphans, g_orphans.len + slot->retired.len) == 0) {
+    for (uint32_t i = 0; i < slot->retired.len; i++) g_orphans.data[g_orphans.len++] = slot->retired.data[i];
+  }  // else out of memory: the pending sets leak
+  pthread_mutex_unlock(&g_orphan_lock);
+  pthread_mutex_unlock(&slot->lock);
+  VEC_FREE(slot->retired);
+  pthread_mutex_destroy(&slot->lock);
+  free(slot);
+}
+
+/**
+ * Make `set` the pattern set used by match_url_parts() and
+ * match_url_pattern()
+ *
+ * The caller keeps ownership and may go on adding and compiling in place,
+ * which is only safe while no other thread is matching. Prefer building a
+ * new set and pattern_slot_publish(pattern_slot_global(), set).
+ */
+BUN_EXPORT void pattern_set_activate(PatternSet* set) {
+  if (set && set->published) return;
+  pthread_mutex_lock(&g_active.lock);
+  if (set) set->activated = 1;
+  slot_install_locked(&g_active, set, 0);
+  pthread_mutex_unlock(&g_active.lock);
+}
+
+// ---------------------------------------------------------------------------
+// Shared result cache
+//
+// A MatchCache is a fixed-size open-addressing table in a MAP_SHARED file
+// (put it on tmpfs, e.g. /dev/shm), so every worker process mapping the
+// same file shares results for URLs that repeat across scrapers. Entries
+// are keyed by two independent hashes of the exact URL bytes and tagged
+// with the set's fingerprint and limits: a newly published set, or one
+// whose pattern_set_limits() changed, simply stops matching the old tags,
+// and stale entries are overwritten as new URLs arrive. Misses are cached
+// too; refusals never are.
+//
+// No locks: each entry is a seqlock. A writer claims an even sequence
+// with a CAS that also stamps the claim time, writes, and CASes it even
+// again; a
+// reader copies the entry and keeps it only if the sequence was even and
+// unchanged, retrying a torn copy at most MCACHE_READ_TRIES times. Losing
+// a race only costs a miss or a skipped store. Every field is atomic, so
+// a reader never sees a half-written result as valid. An entry left odd
+// by a writer that died is a miss until a later store finds its claim
+// older than MCACHE_STALE_SECONDS and takes it over.
+// ---------------------------------------------------------------------------
+
+#define MCACHE_MAGIC "BUNMCAC"
+#define MCACHE_VERSION 2u
+#define MCACHE_MIN_ENTRIES 1024u
+#define MCACHE_MAX_ENTRIES (1u << 24)
+#define MCACHE_PROBE 4                // entries a key may live in
+#define MCACHE_GROUPS 8               // results with more groups are not cached
+#define MCACHE_INIT_SPINS 1000000     // wait for another process' header
+#define MCACHE_READ_TRIES 3           // copies of an entry a writer keeps tearing
+#define MCACHE_STALE_SECONDS 2        // odd this long: its writer is gone
+
+// One URL's result, spans relative to the start of the URL
+typedef struct {
+  int32_t pattern_id;  // -1: nothing matched
+  uint32_t group_count;
+  double confidence;
+  Span host;
+  Span path;
+  Span groups[MATCHER_MAX_GROUPS];  // off UINT32_MAX: group did not participate
+  uint64_t values[MATCHER_MAX_GROUPS];
+} UrlMatch;
+
+// The cached prefix of a UrlMatch
+typedef struct {
+  int32_t pattern_id;
+  uint32_t group_count;
+  double confidence;
+  Span host;
+  Span path;
+  Span groups[MCACHE_GROUPS];
+  uint64_t values[MCACHE_GROUPS];
+} CachedMatch;
+
+#define MCACHE_WORDS (sizeof(CachedMatch) / sizeof(uint64_t))
+_Static_assert(sizeof(CachedMatch) % sizeof(uint64_t) == 0, "copied as whole words");
+
+typedef struct {
+  _Atomic uint64_t seq;      // low half odd while a writer owns the entry,
+                             // high half monotonic seconds of that claim
+  _Atomic uint64_t key;      // URL hash | 1, 0 = never written
+  _Atomic uint64_t check;    // second URL hash
+  _Atomic uint64_t tag;      // PatternSet.fingerprint
+  _Atomic uint64_t words[MCACHE_WORDS];
+} McacheEntry;
+
+typedef struct {
+  char magic[8];
+  _Atomic uint32_t state;    // 0 fresh file, 1 being initialized, 2 ready
+  uint32_t version;
+  uint32_t entries;          // power of two
+  uint32_t entry_size;
+  uint8_t reserved[40];
+} McacheHeader;
+
+_Static_assert(sizeof(McacheHeader) == 64, "entries start on a cache line");
+
+typedef struct MatchCache {
+  McacheHeader* header;
+  McacheEntry* entries;
+  size_t size;
+  uint32_t mask;
+  _Atomic uint64_t hits;     // this process only
+  _Atomic uint64_t misses;
+  _Atomic uint64_t stores;
+} MatchCache;
+
+/**
+ * Map (creating if needed) a shared match cache file
+ *
+ * Every process should open the file with the same entry count; the
+ * first one sizes and initializes it.
+ *
+ * @param path - file on a shared-memory filesystem, e.g.
+ *               /dev/shm/dynamic-spy-match-cache
+ * @param entries - table size, rounded up to a power of two (0: use the
+ *                  existing file's size)
+ * @returns the cache (release with match_cache_close), or NULL if the file
+ *          cannot be mapped or was created with another size or format
+ */
+BUN_EXPORT MatchCache* match_cache_open(const char* path, uint32_t entries) {
+  if (!path || entries > MCACHE_MAX_ENTRIES) return NULL;
+  uint32_t want = 0;
+  if (entries) {
+    want = MCACHE_MIN_ENTRIES;
+    while (want < entries) want <<= 1;
+  }
+
+  int fd = open(path, O_RDWR | O_CREAT, 0600);
+  if (fd < 0) return NULL;
+  struct stat st;
+  void* base = MAP_FAILED;
+  size_t size = 0;
+  if (!fstat(fd, &st)) {
+    size = (size_t)st.st_size;
+    if (size == 0 && want) {
+      size = sizeof(McacheHeader) + (size_t)want * sizeof(McacheEntry);
+      if (ftruncate(fd, (off_t)size)) size = 0;
+    }
+    if (size >= sizeof(McacheHeader)) base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (base == MAP_FAILED) return NULL;
+
+  // A fresh file is all zeroes: whoever flips state 0 -> 1 writes the header
+  McacheHeader* h = base;
+  uint32_t state = 0;
+  if (atomic_compare_exchange_strong(&h->state, &state, 1)) {
+    memcpy(h->magic, MCACHE_MAGIC, sizeof(MCACHE_MAGIC));
+    h->version = MCACHE_VERSION;
+    h->entries = (uint32_t)((size - sizeof(McacheHeader)) / sizeof(McacheEntry));
+    h->entry_size = sizeof(McacheEntry);
+    atomic_store_explicit(&h->state, 2, memory_order_release);
+  }
+  for (uint32_t spin = 0; atomic_load_explicit(&h->state, memory_order_acquire) != 2; spin++) {
+    if (spin == MCACHE_INIT_SPINS) goto fail;
+    sched_yield();
+  }
+  if (memcmp(h->magic, MCACHE_MAGIC, sizeof(MCACHE_MAGIC)) || h->version != MCACHE_VERSION ||
+      h->entry_size != sizeof(McacheEntry) || h->entries < MCACHE_MIN_ENTRIES ||
+      (h->entries & (h->entries - 1)) || (want && h->entries != want) ||
+      size != sizeof(McacheHeader) + (size_t)h->entries * sizeof(McacheEntry)) {
+    goto fail;
+  }
+
+  MatchCache* c = calloc(1, sizeof(MatchCache));
+  if (!c) goto fail;
+  c->header = h;
+  c->entries = (McacheEntry*)(h + 1);
+  c->size = size;
+  c->mask = h->entries - 1;
+  return c;
+
+fail:
+  munmap(base, size);
+  return NULL;
+}
+
+/**
+ * Unmap the cache; the file and its entries stay for the other processes
+ */
+BUN_EXPORT void match_cache_close(MatchCache* c) {
+  if (!c) return;
+  munmap(c->header, c->size);
+  free(c);
+}
+
+/**
+ * This process' counters: out[0] hits, out[1] misses, out[2] stores
+ */
+BUN_EXPORT void match_cache_stats(MatchCache* c, uint64_t* out) {
+  if (!c || !out) return;
+  out[0] = atomic_load_explicit(&c->hits, memory_order_relaxed);
+  out[1] = atomic_load_explicit(&c->misses, memory_order_relaxed);
+  out[2] = atomic_load_explicit(&c->stores, memory_order_relaxed);
+}
+
+// Entries are only valid for the set and the limits they were matched under
+static uint64_t cache_tag(const PatternSet* set) {
+  uint64_t limits = (uint64_t)atomic_load_explicit(&set->max_bytes, memory_order_relaxed) << 32 |
+                    atomic_load_explicit(&set->max_steps, memory_order_relaxed);
+  return limits ? hash_full64((const char*)&limits, sizeof(limits), set->fingerprint) : set->fingerprint;
+}
+
+static uint32_t monotonic_seconds(void) {
+  return (uint32_t)(monotonic_ns() / 1000000000u);
+}
+
+// Copy an entry's result if it is still key/check/tag: 1 on success, 0 if
+// it holds something else, -1 if a writer kept it busy
+static int cache_read(const McacheEntry* e, uint64_t key, uint64_t check, uint64_t tag, CachedMatch* cm) {
+  for (uint32_t tries = 0; tries < MCACHE_READ_TRIES; tries++) {
+    uint64_t seq = atomic_load_explicit(&e->seq, memory_order_acquire);
+    if (seq & 1) continue;  // being written, or abandoned: see cache_put()
+    if (atomic_load_explicit(&e->key, memory_order_relaxed) != key ||
+        atomic_load_explicit(&e->check, memory_order_relaxed) != check ||
+        atomic_load_explicit(&e->tag, memory_order_relaxed) != tag) {
+      return 0;
+    }
+    uint64_t w[MCACHE_WORDS];
+    for (size_t i = 0; i < MCACHE_WORDS; i++) w[i] = atomic_load_explicit(&e->words[i], memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&e->seq, memory_order_relaxed) != seq) continue;
+    memcpy(cm, w, sizeof(*cm));
+    return cm->group_count <= MCACHE_GROUPS;  // the file is writable by every worker
+  }
+  return -1;
+}
+
+static int cache_get(MatchCache* c, uint64_t key, uint64_t check, uint64_t tag, UrlMatch* out) {
+  for (uint32_t p = 0; p < MCACHE_PROBE; p++) {
+    CachedMatch cm;
+    if (cache_read(&c->entries[(key + p) & c->mask], key, check, tag, &cm) != 1) continue;
+
+    out->pattern_id = cm.pattern_id;
+    out->group_count = cm.group_count;
+    out->confidence = cm.confidence;
+    out->host = cm.host;
+    out->path = cm.path;
+    memcpy(out->groups, cm.groups, cm.group_count * sizeof(Span));
+    memcpy(out->values, cm.values, cm.group_count * sizeof(uint64_t));
+    atomic_fetch_add_explicit(&c->hits, 1, memory_order_relaxed);
+    return 1;
+  }
+  atomic_fetch_add_explicit(&c->misses, 1, memory_order_relaxed);
+  return 0;
+}
+
+static void cache_put(MatchCache* c, uint64_t key, uint64_t check, uint64_t tag, const UrlMatch* m) {
+  if (m->group_count > MCACHE_GROUPS) return;
+
+  // Same key, else a stale or empty entry, else one picked by the check hash
+  McacheEntry* victim = NULL;
+  for (uint32_t p = 0; p < MCACHE_PROBE && !victim; p++) {
+    McacheEntry* e = &c->entries[(key + p) & c->mask];
+    if (atomic_load_explicit(&e->key, memory_order_relaxed) == key &&
+        atomic_load_explicit(&e->check, memory_order_relaxed) == check) {
+      victim = e;
+    }
+  }
+  for (uint32_t p = 0; p < MCACHE_PROBE && !victim; p++) {
+    McacheEntry* e = &c->entries[(key + p) & c->mask];
+    if (atomic_load_explicit(&e->tag, memory_order_relaxed) != tag ||
+        !atomic_load_explicit(&e->key, memory_order_relaxed)) {
+      victim = e;
+    }
+  }
+  if (!victim) victim = &c->entries[(key + (check % MCACHE_PROBE)) & c->mask];
+
+  // Claim: even -> odd. An odd entry belongs to another writer, unless its
+  // claim is stale: that writer died mid-store, so take it over odd -> odd.
+  // (One merely stalled that long finds its closing CAS failing.)
+  uint32_t now = monotonic_seconds();
+  uint64_t seq = atomic_load_explicit(&victim->seq, memory_order_relaxed);
+  uint32_t count = (uint32_t)seq;
+  if ((count & 1) && now - (uint32_t)(seq >> 32) <= MCACHE_STALE_SECONDS) return;  // another writer has it
+  uint64_t owned = (uint64_t)now << 32 | (uint32_t)(count + (count & 1 ? 2 : 1));
+  if (!atomic_compare_exchange_strong_explicit(&victim->seq, &seq, owned, memory_order_acquire,
+                                               memory_order_relaxed)) {
+    return;  // lost the claim
+  }
+  atomic_thread_fence(memory_order_release);  // odd sequence visible before any field
+  CachedMatch cm;
+  memset(&cm, 0, sizeof(cm));
+  cm.pattern_id = m->pattern_id;
+  cm.group_count = m->group_count;
+  cm.confidence = m->confidence;
+  cm.host = m->host;
+  cm.path = m->path;
+  memcpy(cm.groups, m->groups, m->group_count * sizeof(Span));
+  memcpy(cm.values, m->values, m->group_count * sizeof(uint64_t));
+  uint64_t w[MCACHE_WORDS];
+  memcpy(w, &cm, sizeof(cm));
+  atomic_store_explicit(&victim->key, key, memory_order_relaxed);
+  atomic_store_explicit(&victim->check, check, memory_order_relaxed);
+  atomic_store_explicit(&victim->tag, tag, memory_order_relaxed);
+  for (size_t i = 0; i < MCACHE_WORDS; i++) atomic_store_explicit(&victim->words[i], w[i], memory_order_relaxed);
+  // Fails only if we stalled long enough for another writer to take over;
+  // its store then decides what the entry holds
+  if (atomic_compare_exchange_strong_explicit(&victim->seq, &owned, owned + 1, memory_order_release,
+                                              memory_order_relaxed)) {
+    atomic_fetch_add_explicit(&c->stores, 1, memory_order_relaxed);
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Batch entry point
+// ---------------------------------------------------------------------------
+
+// Split an absolute URL ("https://user@host:443/path?q#f"), a
+// scheme-relative one ("//host/path") or a bare path into host and path.
+// The host starting at url + *host_off is lowercased into host_buf; the path
+// is a slice of url.
+static int split_url(const char* url, size_t len, char* host_buf, size_t host_cap,
+                     size_t* host_off, size_t* host_len, const char** path, size_t* path_len) {
+  size_t i = 0;
+  size_t auth = 0;
+  *host_off = 0;
+  *host_len = 0;
+
+  for (size_t j = 0; j + 2 < len && url[j] != '/' && url[j] != '?' && url[j] != '#'; j++) {
+    if (url[j] == ':' && url[j + 1] == '/' && url[j + 2] == '/') {
+      auth = j + 3;
+      break;
+    }
+  }
+  if (!auth && len >= 2 && url[0] == '/' && url[1] == '/') auth = 2;
+
+  if (auth) {
+    size_t end = auth;
+    while (end < len && url[end] != '/' && url[end] != '?' && url[end] != '#') end++;
+    size_t start = auth;
+    for (size_t j = auth; j < end; j++) {
+      if (url[j] == '@') start = j + 1;  // drop userinfo
+    }
+    size_t stop = start;
+    if (stop < end && url[stop] == '[') {
+      while (stop < end && url[stop] != ']') stop++;
+      if (stop < end) stop++;
+    } else {
+      while (stop < end && url[stop] != ':') stop++;  // drop port
+    }
+    if (stop - start > host_cap) return -1;
+    for (size_t j = start; j < stop; j++) {
+      char c = url[j];
+      host_buf[j - start] = (c >= 'A' && c <= 'Z') ? (char)(c + 32) : c;
+    }
+    *host_off = start;
+    *host_len = stop - start;
+    i = end;
+  }
+
+  *path = url + i;
+  *path_len = len - i;
+  return 0;
+}
+
+static void url_match_from(const MatchOut* m, size_t host_off, size_t host_len, uint32_t path_base,
+                           size_t path_len, UrlMatch* r) {
+  r->pattern_id = m->pattern_id;
+  r->group_count = m->group_count;
+  r->confidence = m->confidence;
+  r->host = (Span){ (uint32_t)host_off, (uint32_t)host_len };
+  r->path = (Span){ path_base, (uint32_t)path_len };
+  for (uint32_t g = 0; g < m->group_count; g++) {
+    if (m->group_src[g] == GROUP_UNMATCHED) {
+      r->groups[g] = (Span){ UINT32_MAX, 0 };
+    } else {
+      uint32_t base = m->group_src[g] == GROUP_HOST ? (uint32_t)host_off : path_base;
+      r->groups[g] = (Span){ base + m->groups[g].off, m->groups[g].len };
+    }
+  }
+  memcpy(r->values, m->values, m->group_count * sizeof(uint64_t));
+}
+
+#define MCACHE_KEY_SEED 0x6D630001u
+#define MCACHE_CHECK_SEED 0x6D630002u
+
+// A cached result only describes spans inside the URL it was stored for
+static int url_match_fits(const UrlMatch* r, size_t len) {
+  if ((uint64_t)r->host.off + r->host.len > len || (uint64_t)r->path.off + r->path.len > len) return 0;
+  for (uint32_t g = 0; g < r->group_count; g++) {
+    if (r->groups[g].off != UINT32_MAX && (uint64_t)r->groups[g].off + r->groups[g].len > len) return 0;
+  }
+  return 1;
+}
+
+// First match of one URL, through `cache` when given: 1 if a pattern
+// matched, 0 if none, MATCH_OVER_* (also in r->pattern_id) if refused
+static int resolve_url(MatchCache* cache, const PatternSet* set, const char* url, size_t len, UrlMatch* r) {
+  char host[256];
+  const char* path = url;
+  size_t host_off, host_len, path_len;
+  MatchOut m;
+  uint64_t key = 0, check = 0;
+
+  int status = limit_input(set, len);
+  if (status) {
+    memset(r, 0, offsetof(UrlMatch, groups));
+    r->pattern_id = status;
+    return status;
+  }
+  cache = set && set->compiled ? cache : NULL;
+  if (cache) {
+    key = hash_full64(url, len, MCACHE_KEY_SEED) | 1;
+    check = hash_full64(url, len, MCACHE_CHECK_SEED);
+    if (cache_get(cache, key, check, cache_tag(set), r) && url_match_fits(r, len)) return r->pattern_id >= 0;
+  }
+  if (split_url(url, len, host, sizeof(host), &host_off, &host_len, &path, &path_len)) {
+    r->pattern_id = -1;
+    r->group_count = 0;
+    return 0;
+  }
+  int hit = match_core(set, host, host_len, path, path_len, &m);
+  if (hit > 0) {
+    url_match_from(&m, host_off, host_len, (uint32_t)(path - url), path_len, r);
+  } else {
+    memset(r, 0, offsetof(UrlMatch, groups));
+    r->pattern_id = hit < 0 ? hit : -1;
+    r->host = (Span){ (uint32_t)host_off, (uint32_t)host_len };
+    r->path = (Span){ (uint32_t)(path - url), (uint32_t)path_len };
+  }
+  if (cache && hit >= 0) cache_put(cache, key, check, cache_tag(set), r);
+  return hit;
+}
+
+static uint32_t batch_match(MatchCache* cache, const PatternSet* set, const char* buf, const uint32_t* offsets,
+                            const uint32_t* lengths, uint32_t count, int32_t* out_pattern_id,
+                            double* out_confidence, uint32_t* out_group_off, uint32_t* out_group_len,
+                            uint64_t* out_group_value, uint32_t group_stride) {
+  uint32_t matched = 0;
+  UrlMatch r;
+
+  if (!buf || !offsets || !lengths || !out_pattern_id) return 0;
+
+  for (uint32_t i = 0; i < count; i++) {
+    int status = resolve_url(cache, set, buf + offsets[i], lengths[i], &r);
+    int hit = status > 0;
+
+    out_pattern_id[i] = hit ? r.pattern_id : status < 0 ? status : -1;
+    if (out_confidence) out_confidence[i] = hit ? r.confidence : 0.0;
+    if (hit) matched++;
+    if (out_group_value) {
+      uint64_t* gval = out_group_value + (size_t)i * group_stride;
+      for (uint32_t g = 0; g < group_stride; g++) gval[g] = hit && g < r.group_count ? r.values[g] : 0;
+    }
+    if (!out_group_off || !out_group_len) continue;
+
+    uint32_t* goff = out_group_off + (size_t)i * group_stride;
+    uint32_t* glen = out_group_len + (size_t)i * group_stride;
+    for (uint32_t g = 0; g < group_stride; g++) {
+      if (!hit || g >= r.group_count || r.groups[g].off == UINT32_MAX) {
+        goff[g] = UINT32_MAX;
+        glen[g] = 0;
+      } else {
+        goff[g] = offsets[i] + r.groups[g].off;
+        glen[g] = r.groups[g].len;
+      }
+    }
+  }
+  return matched;
+}
+
+/**
+ * Match a packed batch of URLs in one FFI call
+ *
+ * URL i is the byte range [offsets[i], offsets[i] + lengths[i]) of `buf`.
+ * Results are written struct-of-arrays style into caller-owned buffers:
+ * out_pattern_id[i] (-1 when nothing matched, MATCH_OVER_* when
+ * pattern_set_limits() refused the URL), out_confidence[i], and
+ * group_stride (offset, length) pairs per URL in out_group_off /
+ * out_group_len. Group offsets are absolute into `buf`; unmatched groups and
+ * groups past the pattern's count get UINT32_MAX / 0. Host groups point into
+ * the original, not lowercased, hostname bytes. out_group_value (optional,
+ * same stride) receives GROUP_TYPE_INT values and 0 for other groups.
+ *
+ * @returns number of URLs that matched
+ */
+BUN_EXPORT uint32_t match_url_batch(PatternSet* set, const char* buf, const uint32_t* offsets,
+                                    const uint32_t* lengths, uint32_t count,
+                                    int32_t* out_pattern_id, double* out_confidence,
+                                    uint32_t* out_group_off, uint32_t* out_group_len,
+                                    uint64_t* out_group_value, uint32_t group_stride) {
+  return batch_match(NULL, set, buf, offsets, lengths, count, out_pattern_id, out_confidence, out_group_off,
+                     out_group_len, out_group_value, group_stride);
+}
+
+/**
+ * match_url_batch() through a shared MatchCache
+ *
+ * Results are identical; URLs some worker already matched against the
+ * same patterns skip matching.
+ */
+BUN_EXPORT uint32_t match_url_batch_cached(MatchCache* cache, PatternSet* set, const char* buf,
+                                           const uint32_t* offsets, const uint32_t* lengths, uint32_t count,
+                                           int32_t* out_pattern_id, double* out_confidence,
+                                           uint32_t* out_group_off, uint32_t* out_group_len,
+                                           uint64_t* out_group_value, uint32_t group_stride) {
+  return batch_match(cache, set, buf, offsets, lengths, count, out_pattern_id, out_confidence, out_group_off,
+                     out_group_len, out_group_value, group_stride);
+}
+
+// ---------------------------------------------------------------------------
+// Arena entry point
+//
+// The arena is a caller-owned buffer (a JS ArrayBuffer works) that starts
+// with a MatchArena header. Results are bump-allocated behind it and refer
+// to the input by (offset, length) spans, so matching never touches the
+// allocator and there is nothing to free: the caller resets the arena per
+// batch. One arena per worker thread.
+// ---------------------------------------------------------------------------
+
+typedef struct {
+  uint32_t used;       // bytes in use, including this header
+  uint32_t capacity;   // total arena bytes
+  uint32_t count;      // results written since the last reset
+  uint32_t reserved;
+} MatchArena;
+
+typedef struct {
+  uint32_t off;        // UINT32_MAX when the group did not participate
+  uint32_t len;
+} MatchSpan;
+
+typedef struct {
+  int32_t pattern_id;
+  uint32_t group_count;
+  double confidence;
+  MatchSpan host;      // spans are relative to the start of the input URL
+  MatchSpan path;
+  MatchSpan groups[];  // group_count entries, then group_count uint64
+                       // values (GROUP_TYPE_INT groups, 0 for the others)
+} ArenaMatch;
+
+#define ARENA_FULL -2
+
+/**
+ * Initialize or reset an arena in place
+ *
+ * @returns 0, or -1 when capacity cannot hold the header
+ */
+BUN_EXPORT int match_arena_reset(void* arena, uint32_t capacity) {
+  if (!arena || capacity < sizeof(MatchArena)) return -1;
+  MatchArena* a = arena;
+  a->used = sizeof(MatchArena);
+  a->capacity = capacity;
+  a->count = 0;
+  a->reserved = 0;
+  return 0;
+}
+
+// Append one ArenaMatch; returns its offset or ARENA_FULL
+static int64_t arena_write(MatchArena* a, const UrlMatch* m) {
+  uint32_t need = (uint32_t)(sizeof(ArenaMatch) +
+                             m->group_count * (sizeof(MatchSpan) + sizeof(uint64_t)));
+  uint32_t at = (a->used + 7u) & ~7u;
+  if (at > a->capacity || a->capacity - at < need) return ARENA_FULL;
+
+  ArenaMatch* r = (ArenaMatch*)((uint8_t*)a + at);
+  r->pattern_id = m->pattern_id;
+  r->group_count = m->group_count;
+  r->confidence = m->confidence;
+  r->host = (MatchSpan){ m->host.off, m->host.len };
+  r->path = (MatchSpan){ m->path.off, m->path.len };
+  for (uint32_t g = 0; g < m->group_count; g++) {
+    r->groups[g] = (MatchSpan){ m->groups[g].off, m->groups[g].len };
+  }
+  memcpy(r->groups + m->group_count, m->values, m->group_count * sizeof(uint64_t));
+
+  a->used = at + need;
+  a->count++;
+  return at;
+}
+
+static int64_t arena_match(MatchCache* cache, const PatternSet* set, void* arena, const char* url, uint32_t len) {
+  UrlMatch m;
+  if (!arena || !url) return -1;
+  int hit = resolve_url(cache, set, url, len, &m);
+  if (hit <= 0) return hit < 0 ? hit : -1;
+  return arena_write(arena, &m);
+}
+
+/**
+ * Match one URL, writing an ArenaMatch into the arena
+ *
+ * @returns byte offset of the ArenaMatch within the arena, -1 when nothing
+ *          matched, ARENA_FULL when the caller must reset the arena, or
+ *          MATCH_OVER_* when pattern_set_limits() refused the URL
+ */
+BUN_EXPORT int64_t match_url_arena(PatternSet* set, void* arena, const char* url, uint32_t len) {
+  return arena_match(NULL, set, arena, url, len);
+}
+
+/**
+ * match_url_arena() through a shared MatchCache
+ */
+BUN_EXPORT int64_t match_url_arena_cached(MatchCache* cache, PatternSet* set, void* arena, const char* url,
+                                          uint32_t len) {
+  return arena_match(cache, set, arena, url, len);
+}
+
+/**
+ * Match one URL against every pattern, writing one ArenaMatch per matching
+ * pattern in priority order (highest first, ties by registration order)
+ *
+ * @param out_offsets - receives the arena offset of each record
+ * @param max_results - capacity of out_offsets (at most MATCHER_MAX_RESULTS
+ *                      are reported)
+ * @returns number of records written, ARENA_FULL (nothing written) when
+ *          the caller must reset the arena, or MATCH_OVER_* when
+ *          pattern_set_limits() refused the URL
+ */
+BUN_EXPORT int32_t match_url_arena_all(PatternSet* set, void* arena, const char* url, uint32_t len,
+                                       uint32_t* out_offsets, uint32_t max_results) {
+  char host[256];
+  const char* path = url;
+  size_t host_off, host_len, path_len;
+  uint32_t variants[MATCHER_MAX_RESULTS];
+  MatchScratch sc;
+  MatchArena* a = arena;
+
+  if (!a || !url || !out_offsets) return 0;
+  if (max_results > MATCHER_MAX_RESULTS) max_results = MATCHER_MAX_RESULTS;
+  int status = limit_input(set, len);
+  if (status) return status;
+  if (split_url(url, len, host, sizeof(host), &host_off, &host_len, &path, &path_len)) return 0;
+
+  uint32_t found = match_candidates(set, host, host_len, path, path_len, 1, variants,
+                                    max_results, &sc);
+  if (!found) return sc.status;
+  if (found > max_results) found = max_results;
+
+  // All or nothing, so a retry after reset sees the full list
+  uint32_t used = a->used, count = a->count;
+  for (uint32_t i = 0; i < found; i++) {
+    MatchOut m;
+    UrlMatch r;
+    fill_candidate(set, variants[i], host, host_len, &sc, &m);
+    url_match_from(&m, host_off, host_len, (uint32_t)(path - url), path_len, &r);
+    int64_t at = arena_write(a, &r);
+    if (at < 0) {
+      a->used = used;
+      a->count = count;
+      return ARENA_FULL;
+    }
+    out_offsets[i] = (uint32_t)at;
+  }
+  return (int32_t)found;
+}
+
+// ---------------------------------------------------------------------------
+// Streaming entry point
+//
+// A MatchStream takes raw scraper output in arbitrary chunks (newline
+// delimited URLs, or NDJSON with the URL under one string key), reassembles
+// records split across chunk boundaries, and writes one StreamMatch per
+// matching record into a caller-owned byte ring (a JS ArrayBuffer works).
+// Nothing is turned into a JS string until a matched record is read back.
+//
+// The ring is single producer / single consumer: push() only advances tail,
+// the reader only advances head. Records are 8-byte aligned and never wrap;
+// a size of 0 at head means "continue at offset 0". When the ring cannot
+// take the next record, push() stops at that record and reports how much of
+// the chunk it consumed so the caller can drain and push the rest.
+// ---------------------------------------------------------------------------
+
+enum { STREAM_LINES = 0, STREAM_NDJSON = 1 };
+
+#define STREAM_MAX_RECORD MATCHER_MAX_INPUT  // longer records are skipped
+#define STREAM_MIN_RING (64 * 1024)
+
+typedef struct {
+  _Atomic uint32_t head;  // next record to read; advanced by the reader
+  _Atomic uint32_t tail;  // end of the last record written; advanced by push()
+  uint32_t capacity;      // data bytes after this header
+  uint32_t reserved;
+  uint64_t records;       // records seen since the ring was reset
+  uint64_t matched;       // records written
+  uint64_t skipped;       // over-long, undecodable, unsplittable or refused records
+} MatchRing;
+
+typedef struct {
+  uint32_t size;          // record bytes, a multiple of 8; 0 marks a wrap
+  int32_t pattern_id;
+  uint64_t offset;        // stream byte offset of the record
+  double confidence;
+  uint32_t url_len;
+  uint32_t group_count;
+  MatchSpan host;         // spans are relative to the URL bytes below
+  MatchSpan path;
+  MatchSpan groups[];     // group_count entries, group_count uint64 values,
+                          // then url_len URL bytes
+} StreamMatch;
+
+struct MatchStream {
+  uint32_t format;        // STREAM_*
+  char key[64];           // NDJSON field holding the URL
+  uint64_t offset;        // stream bytes consumed before `carry`
+  char* carry;            // record prefix from earlier chunks (+ scratch)
+  uint32_t carry_len;
+  uint64_t partial;       // bytes of the current record in earlier chunks
+  int overflow;           // current record passed STREAM_MAX_RECORD
+  char json[STREAM_MAX_RECORD + 1];
+  char url[STREAM_MAX_RECORD];
+};
+
+typedef struct MatchStream MatchStream;
+
+static int64_t json_string_field(const char* json, const char* key, char* out, size_t cap);
+
+/**
+ * Initialize or reset a stream ring in place
+ *
+ * @param capacity - total bytes including the header; at least 64 KiB
+ * @returns 0, or -1 when capacity is too small
+ */
+BUN_EXPORT int match_ring_reset(void* ring, uint32_t capacity) {
+  if (!ring || capacity < sizeof(MatchRing) + STREAM_MIN_RING) return -1;
+  MatchRing* r = ring;
+  atomic_store_explicit(&r->head, 0, memory_order_relaxed);
+  atomic_store_explicit(&r->tail, 0, memory_order_relaxed);
+  r->capacity = (capacity - (uint32_t)sizeof(MatchRing)) & ~7u;
+  r->reserved = 0;
+  r->records = r->matched = r->skipped = 0;
+  return 0;
+}
+
+// Room for `need` contiguous bytes, or NULL when the reader must catch up.
+// Keeps tail != head unless the ring is empty.
+static uint8_t* ring_reserve(MatchRing* r, uint32_t need, uint32_t* at) {
+  uint8_t* data = (uint8_t*)(r + 1);
+  uint32_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+  uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+  if (tail >= head) {
+    uint32_t room = r->capacity - tail;
+    if (room > need || (room == need && head > 0)) {
+      *at = tail;
+      return data + tail;
+    }
+    if (head <= need) return NULL;
+    memset(data + tail, 0, sizeof(uint32_t));  // wrap marker
+    atomic_store_explicit(&r->tail, 0, memory_order_release);
+    *at = 0;
+    return data;
+  }
+  if (head - tail <= need) return NULL;
+  *at = tail;
+  return data + tail;
+}
+
+static void ring_commit(MatchRing* r, uint32_t at, uint32_t size) {
+  uint32_t tail = at + size;
+  atomic_store_explicit(&r->tail, tail == r->capacity ? 0 : tail, memory_order_release);
+}
+
+// Match one complete record; returns 0, or ARENA_FULL with the ring untouched
+static int stream_record(MatchStream* s, PatternSet* set, MatchRing* r, const char* rec, size_t len,
+                         uint64_t offset) {
+  while (len && (rec[len - 1] == '\r' || rec[len - 1] == ' ' || rec[len - 1] == '\t')) len--;
+  while (len && (rec[0] == ' ' || rec[0] == '\t')) rec++, len--;
+  if (!len) return 0;
+
+  const char* url = rec;
+  if (s->format == STREAM_NDJSON) {
+    memcpy(s->json, rec, len);
+    s->json[len] = '\0';
+    int64_t n = json_string_field(s->json, s->key, s->url, sizeof(s->url));
+    if (n < 0) {
+      r->records++;
+      r->skipped++;
+      return 0;
+    }
+    url = s->url;
+    len = (size_t)n;
+  }
+
+  char host[256];
+  const char* path = url;
+  size_t host_off, host_len, path_len;
+  MatchOut m;
+  if (split_url(url, len, host, sizeof(host), &host_off, &host_len, &path, &path_len)) {
+    r->records++;
+    r->skipped++;
+    return 0;
+  }
+  int hit = match_core(set, host, host_len, path, path_len, &m);
+  if (hit <= 0) {
+    r->records++;
+    if (hit < 0) r->skipped++;
+    return 0;
+  }
+
+  uint32_t size = (uint32_t)(sizeof(StreamMatch) + m.group_count * (sizeof(MatchSpan) + sizeof(uint64_t)) +
+                             len + 7) & ~7u;
+  uint32_t at;
+  StreamMatch* out = (StreamMatch*)ring_reserve(r, size, &at);
+  if (!out) return ARENA_FULL;
+
+  uint32_t path_base = (uint32_t)(path - url);
+  out->size = size;
+  out->pattern_id = m.pattern_id;
+  out->offset = offset;
+  out->confidence = m.confidence;
+  out->url_len = (uint32_t)len;
+  out->group_count = m.group_count;
+  out->host.off = (uint32_t)host_off;
+  out->host.len = (uint32_t)host_len;
+  out->path.off = path_base;
+  out->path.len = (uint32_t)path_len;
+  for (uint32_t g = 0; g < m.group_count; g++) {
+    if (m.group_src[g] == GROUP_UNMATCHED) {
+      out->groups[g].off = UINT32_MAX;
+      out->groups[g].len = 0;
+    } else {
+      uint32_t base = m.group_src[g] == GROUP_HOST ? (uint32_t)host_off : path_base;
+      out->groups[g].off = base + m.groups[g].off;
+      out->groups[g].len = m.groups[g].len;
+    }
+  }
+  uint64_t* values = (uint64_t*)(out->groups + m.group_count);
+  memcpy(values, m.values, m.group_count * sizeof(uint64_t));
+  memcpy(values + m.group_count, url, len);
+
+  r->records++;
+  r->matched++;
+  ring_commit(r, at, size);
+  return 0;
+}
+
+/**
+ * Create a stream decoder
+ *
+ * @param format - 0: one URL per line, 1: NDJSON
+ * @param json_key - NDJSON field holding the URL (NULL: "url")
+ * @returns stream (release with match_stream_destroy) or NULL
+ */
+BUN_EXPORT MatchStream* match_stream_create(uint32_t format, const char* json_key) {
+  if (format > STREAM_NDJSON) return NULL;
+  if (!json_key) json_key = "url";
+  if (strlen(json_key) >= sizeof(((MatchStream*)0)->key)) return NULL;
+  MatchStream* s = calloc(1, sizeof(MatchStream));
+  if (!s) return NULL;
+  s->carry = malloc(STREAM_MAX_RECORD);
+  if (!s->carry) {
+    free(s);
+    return NULL;
+  }
+  s->format = format;
+  strcpy(s->key, json_key);
+  return s;
+}
+
+/**
+ * Feed the next chunk of the stream
+ *
+ * Complete records are matched against `set` and matches appended to the
+ * ring; a trailing partial record is kept for the next call.
+ *
+ * @returns bytes of `chunk` consumed. Less than `len` means the ring is
+ *          full: drain it and push chunk + consumed again. -1 on bad input.
+ */
+BUN_EXPORT int64_t match_stream_push(MatchStream* s, PatternSet* set, void* ring, const uint8_t* chunk,
+                                     uint32_t len) {
+  MatchRing* r = ring;
+  if (!s || !r || (!chunk && len)) return -1;
+  const char* p = (const char*)chunk;
+  uint32_t pos = 0;
+
+  while (pos < len) {
+    const char* nl = memchr(p + pos, '\n', len - pos);
+    uint32_t end = nl ? (uint32_t)(nl - p) : len;
+    uint32_t piece = end - pos;
+
+    if (!nl) {
+      // Partial record: keep it for the next chunk
+      s->partial += piece;
+      if (!s->overflow && s->carry_len + piece <= STREAM_MAX_RECORD) {
+        memcpy(s->carry + s->carry_len, p + pos, piece);
+        s->carry_len += piece;
+      } else {
+        s->overflow = 1;
+      }
+      return len;
+    }
+
+    if (s->overflow || s->carry_len + piece > STREAM_MAX_RECORD) {
+      r->records++;
+      r->skipped++;
+    } else if (s->carry_len == 0) {
+      // Whole record inside this chunk: match it in place
+      if (stream_record(s, set, r, p + pos, piece, s->offset) == ARENA_FULL) return pos;
+    } else {
+      // Join with the carried prefix; the carry only grows once it fits
+      memcpy(s->carry + s->carry_len, p + pos, piece);
+      if (stream_record(s, set, r, s->carry, s->carry_len + piece, s->offset) == ARENA_FULL) return pos;
+    }
+    s->offset += s->partial + piece + 1;
+    s->partial = 0;
+    s->carry_len = 0;
+    s->overflow = 0;
+    pos = end + 1;
+  }
+  return len;
+}
+
+/**
+ * End the stream, matching a final record that had no trailing newline
+ *
+ * The stream can then be reused from offset 0.
+ *
+ * @returns 0, or ARENA_FULL when the ring must be drained first
+ */
+BUN_EXPORT int match_stream_end(MatchStream* s, PatternSet* set, void* ring) {
+  MatchRing* r = ring;
+  if (!s || !r) return -1;
+  if (s->overflow) {
+    r->records++;
+    r->skipped++;
+  } else if (s->carry_len && stream_record(s, set, r, s->carry, s->carry_len, s->offset) == ARENA_FULL) {
+    return ARENA_FULL;
+  }
+  s->offset = 0;
+  s->partial = 0;
+  s->carry_len = 0;
+  s->overflow = 0;
+  return 0;
+}
+
+BUN_EXPORT void match_stream_destroy(MatchStream* s) {
+  if (!s) return;
+  free(s->carry);
+  free(s);
+}
+
+// ---------------------------------------------------------------------------
+// Worker pool
+//
+// A MatchPool owns a fixed set of worker threads, optionally pinned one per
+// CPU. match_pool_submit() splits a packed batch (the match_url_batch()
+// layout) into chunks and pushes them onto a bounded lock-free MPMC queue;
+// workers run each chunk straight into the caller's output arrays, so the
+// submitting thread only packs input and later reads results. Idle workers
+// park on a condition variable that producers only touch when somebody is
+// parked; a pair of seq_cst fences keeps that check from missing a worker
+// that is just parking.
+//
+// Completion is signalled through a caller-owned int32 status pair
+// ({state, matched}: state flips to 1 with a release store, cheap to poll
+// from JS); native callers can block in match_job_release() instead. A job
+// pins the set that was current at submit time until match_job_release(),
+// so its pattern ids and group names stay valid across reloads.
+// ---------------------------------------------------------------------------
+
+#define POOL_MAX_THREADS 256
+#define POOL_QUEUE_CELLS 4096  // power of two
+#define POOL_CHUNK 256         // URLs per task
+#define POOL_SPIN 2048         // empty polls before a worker parks
+
+#define MATCH_POOL_PIN 1u      // match_pool_create() flag: pin worker i to CPU i
+
+typedef struct MatchJob {
+  PatternSet* set;
+  MatchCache* cache;         // pool's cache at submit time, may be NULL
+  int32_t reader;            // reader record pinning `set`, -1: overflow count
+  const char* buf;
+  const uint32_t* offsets;
+  const uint32_t* lengths;
+  int32_t* out_pattern_id;
+  double* out_confidence;
+  uint32_t* out_group_off;
+  uint32_t* out_group_len;
+  uint64_t* out_group_value;
+  uint32_t group_stride;
+  _Atomic int32_t* status;   // caller's {state, matched}
+  _Atomic uint32_t remaining;  // chunks not yet finished
+  _Atomic uint32_t matched;
+  _Atomic int done;
+  struct MatchPool* pool;
+} MatchJob;
+
+typedef struct {
+  MatchJob* job;
+  uint32_t begin, end;
+} PoolTask;
+
+typedef struct {
+  _Atomic size_t seq;
+  PoolTask task;
+} PoolCell;
+
+typedef struct MatchPool {
+  _Alignas(64) _Atomic size_t head;
+  _Alignas(64) _Atomic size_t tail;
+  _Alignas(64) PoolCell cells[POOL_QUEUE_CELLS];
+  _Atomic uint32_t sleepers;
+  _Atomic int stop;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  pthread_cond_t job_done;   // match_job_release() on an unfinished job
+  _Atomic(MatchCache*) cache;  // match_pool_set_cache()
+  uint32_t thread_count;
+  pthread_t threads[];
+} MatchPool;
+
+// Reader record for a job rather than a thread: same protocol as
+// reader_enter(), released by whichever thread finishes last
+static int32_t reader_pin_detached(void) {
+  for (int32_t i = 0; i < MATCHER_MAX_READERS; i++) {
+    int expected = 0;
+    if (atomic_compare_exchange_strong(&g_readers[i].claimed, &expected, 1)) {
+      atomic_store(&g_readers[i].epoch, atomic_load(&g_epoch));
+      return i;
+    }
+  }
+  atomic_fetch_add(&g_overflow_readers, 1);
+  return -1;
+}
+
+static void reader_unpin_detached(int32_t reader) {
+  if (reader >= 0) {
+    atomic_store(&g_readers[reader].epoch, 0);
+    atomic_store(&g_readers[reader].claimed, 0);
+  } else {
+    atomic_fetch_sub(&g_overflow_readers, 1);
+  }
+}
+
+static int pool_push(MatchPool* p, const PoolTask* t) {
+  size_t pos = atomic_load_explicit(&p->tail, memory_order_relaxed);
+  for (;;) {
+    PoolCell* c = &p->cells[pos & (POOL_QUEUE_CELLS - 1)];
+    size_t seq = atomic_load_explicit(&c->seq, memory_order_acquire);
+    intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&p->tail, &pos, pos + 1, memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        c->task = *t;
+        atomic_store_explicit(&c->seq, pos + 1, memory_order_release);
+        return 1;
+      }
+    } else if (diff < 0) {
+      return 0;  // full
+    } else {
+      pos = atomic_load_explicit(&p->tail, memory_order_relaxed);
+    }
+  }
+}
+
+static int pool_pop(MatchPool* p, PoolTask* t) {
+  size_t pos = atomic_load_explicit(&p->head, memory_order_relaxed);
+  for (;;) {
+    PoolCell* c = &p->cells[pos & (POOL_QUEUE_CELLS - 1)];
+    size_t seq = atomic_load_explicit(&c->seq, memory_order_acquire);
+    intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&p->head, &pos, pos + 1, memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        *t = c->task;
+        atomic_store_explicit(&c->seq, pos + POOL_QUEUE_CELLS, memory_order_release);
+        return 1;
+      }
+    } else if (diff < 0) {
+      return 0;  // empty
+    } else {
+      pos = atomic_load_explicit(&p->head, memory_order_relaxed);
+    }
+  }
+}
+
+static void job_finish(MatchJob* job) {
+  MatchPool* p = job->pool;
+  uint32_t matched = atomic_load_explicit(&job->matched, memory_order_relaxed);
+  if (job->status) {
+    atomic_store_explicit(&job->status[1], (int32_t)matched, memory_order_relaxed);
+    atomic_store_explicit(&job->status[0], 1, memory_order_release);
+  }
+  pthread_mutex_lock(&p->lock);
+  atomic_store_explicit(&job->done, 1, memory_order_release);
+  pthread_cond_broadcast(&p->job_done);
+  pthread_mutex_unlock(&p->lock);
+}
+
+static void pool_run(const PoolTask* t) {
+  MatchJob* job = t->job;
+  uint32_t b = t->begin, n = t->end - t->begin;
+  size_t g = (size_t)b * job->group_stride;
+  uint32_t matched = batch_match(
+      job->cache, job->set, job->buf, job->offsets + b, job->lengths + b, n, job->out_pattern_id + b,
+      job->out_confidence ? job->out_confidence + b : NULL, job->out_group_off ? job->out_group_off + g : NULL,
+      job->out_group_len ? job->out_group_len + g : NULL, job->out_group_value ? job->out_group_value + g : NULL,
+      job->group_stride);
+  atomic_fetch_add_explicit(&job->matched, matched, memory_order_relaxed);
+  if (atomic_fetch_sub_explicit(&job->remaining, 1, memory_order_acq_rel) == 1) job_finish(job);
+}
+
+// Producer half of the parking handshake: the fence orders the pushes'
+// seq stores before the sleepers load, pairing with the one in
+// pool_worker(), so either the producer sees the sleeper or the sleeper's
+// pool_pop() sees the task. Without it a store buffer can hold the push
+// back while a worker parks and a lone job is never picked up.
+static void pool_wake(MatchPool* p) {
+  atomic_thread_fence(memory_order_seq_cst);
+  if (atomic_load_explicit(&p->sleepers, memory_order_relaxed) == 0) return;
+  pthread_mutex_lock(&p->lock);
+  pthread_cond_broadcast(&p->wake);
+  pthread_mutex_unlock(&p->lock);
+}
+
+typedef struct {
+  MatchPool* pool;
+  uint32_t index;
+  uint32_t pin;
+} PoolStart;
+
+static void* pool_worker(void* arg) {
+  PoolStart start = *(PoolStart*)arg;
+  MatchPool* p = start.pool;
+  free(arg);
+#ifdef __linux__
+  if (start.pin) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(start.index % (uint32_t)(cpus > 0 ? cpus : 1), &mask);
+    pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
+  }
+#else
+  (void)start.index;
+  (void)start.pin;
+#endif
+
+  PoolTask t;
+  for (;;) {
+    uint32_t spins = 0;
+    while (spins < POOL_SPIN) {
+      if (pool_pop(p, &t)) {
+        pool_run(&t);
+        spins = 0;
+      } else {
+        spins++;
+        if ((spins & 63) == 0) sched_yield();
+      }
+    }
+    pthread_mutex_lock(&p->lock);
+    atomic_fetch_add(&p->sleepers, 1);
+    atomic_thread_fence(memory_order_seq_cst);  // see pool_wake()
+    while (!pool_pop(p, &t)) {
+      if (atomic_load(&p->stop)) {
+        atomic_fetch_sub(&p->sleepers, 1);
+        pthread_mutex_unlock(&p->lock);
+        return NULL;
+      }
+      pthread_cond_wait(&p->wake, &p->lock);
+    }
+    atomic_fetch_sub(&p->sleepers, 1);
+    pthread_mutex_unlock(&p->lock);
+    pool_run(&t);
+  }
+}
+
+/**
+ * Start a worker pool
+ *
+ * @param threads - worker count (0: one per online CPU)
+ * @param flags - MATCH_POOL_PIN to pin worker i to CPU i (Linux)
+ * @returns pool (stop with match_pool_destroy) or NULL
+ */
+BUN_EXPORT MatchPool* match_pool_create(uint32_t threads, uint32_t flags) {
+  if (threads == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = cpus > 0 ? (uint32_t)cpus : 1;
+  }
+  if (threads > POOL_MAX_THREADS) threads = POOL_MAX_THREADS;
+
+  MatchPool* p = NULL;
+  if (posix_memalign((void**)&p, 64, sizeof(MatchPool) + threads * sizeof(pthread_t))) return NULL;
+  memset(p, 0, sizeof(MatchPool));
+  for (size_t i = 0; i < POOL_QUEUE_CELLS; i++) atomic_init(&p->cells[i].seq, i);
+  if (pthread_mutex_init(&p->lock, NULL)) goto fail_mem;
+  if (pthread_cond_init(&p->wake, NULL)) goto fail_lock;
+  if (pthread_cond_init(&p->job_done, NULL)) goto fail_wake;
+
+  for (uint32_t i = 0; i < threads; i++) {
+    PoolStart* start = malloc(sizeof(PoolStart));
+    if (start) *start = (PoolStart){ p, i, flags & MATCH_POOL_PIN };
+    if (!start || pthread_create(&p->threads[i], NULL, pool_worker, start)) {
+      free(start);
+      break;
+    }
+    p->thread_count++;
+  }
+  if (p->thread_count == 0) {
+    pthread_cond_destroy(&p->job_done);
+    goto fail_wake;
+  }
+  return p;
+
+fail_wake:
+  pthread_cond_destroy(&p->wake);
+fail_lock:
+  pthread_mutex_destroy(&p->lock);
+fail_mem:
+  free(p);
+  return NULL;
+}
+
+/**
+ * Stop the pool after the queued work is done
+ *
+ * Jobs must still be released by their owners.
+ */
+BUN_EXPORT void match_pool_destroy(MatchPool* p) {
+  if (!p) return;
+  pthread_mutex_lock(&p->lock);
+  atomic_store(&p->stop, 1);
+  pthread_cond_broadcast(&p->wake);
+  pthread_mutex_unlock(&p->lock);
+  for (uint32_t i = 0; i < p->thread_count; i++) pthread_join(p->threads[i], NULL);
+  pthread_cond_destroy(&p->job_done);
+  pthread_cond_destroy(&p->wake);
+  pthread_mutex_destroy(&p->lock);
+  free(p);
+}
+
+BUN_EXPORT uint32_t match_pool_threads(MatchPool* p) {
+  return p ? p->thread_count : 0;
+}
+
+/**
+ * Run jobs submitted from now on through a shared MatchCache (NULL: none)
+ *
+ * The cache must stay open until those jobs are released.
+ */
+BUN_EXPORT void match_pool_set_cache(MatchPool* p, MatchCache* cache) {
+  if (p) atomic_store(&p->cache, cache);
+}
+
+/**
+ * Queue a packed batch on the pool
+ *
+ * Arguments and output layout are those of match_url_batch(), except that
+ * the batch is matched against whatever `slot` holds now, and every buffer
+ * must stay alive until the job is released. When the queue is full the
+ * calling thread runs chunks itself rather than failing.
+ *
+ * @param status - caller-owned {state, matched}; state becomes 1 once
+ *                 every output is written (may be NULL)
+ * @returns job (release with match_job_release), or NULL when nothing is
+ *          published or out of memory
+ */
+BUN_EXPORT MatchJob* match_pool_submit(MatchPool* p, PatternSlot* slot, const char* buf,
+                                       const uint32_t* offsets, const uint32_t* lengths, uint32_t count,
+                                       int32_t* out_pattern_id, double* out_confidence,
+                                       uint32_t* out_group_off, uint32_t* out_group_len,
+                                       uint64_t* out_group_value, uint32_t group_stride, int32_t* status) {
+  if (!p || !slot || !buf || !offsets || !lengths || !out_pattern_id) return NULL;
+  MatchJob* job = calloc(1, sizeof(MatchJob));
+  if (!job) return NULL;
+
+  job->reader = reader_pin_detached();
+  job->set = atomic_load(&slot->current);
+  if (!job->set) {
+    reader_unpin_detached(job->reader);
+    free(job);
+    return NULL;
+  }
+  job->cache = atomic_load(&p->cache);
+  job->buf = buf;
+  job->offsets = offsets;
+  job->lengths = lengths;
+  job->out_pattern_id = out_pattern_id;
+  job->out_confidence = out_confidence;
+  job->out_group_off = out_group_off;
+  job->out_group_len = out_group_len;
+  job->out_group_value = out_group_value;
+  job->group_stride = group_stride;
+  job->status = (_Atomic int32_t*)status;
+  job->pool = p;
+  if (status) {
+    atomic_store_explicit(&job->status[1], 0, memory_order_relaxed);
+    atomic_store_explicit(&job->status[0], 0, memory_order_relaxed);
+  }
+
+  uint32_t chunks = (count + POOL_CHUNK - 1) / POOL_CHUNK;
+  if (chunks == 0) {
+    job_finish(job);
+    return job;
+  }
+  atomic_store(&job->remaining, chunks);
+  for (uint32_t begin = 0; begin < count; begin += POOL_CHUNK) {
+    PoolTask t = { job, begin, begin + POOL_CHUNK < count ? begin + POOL_CHUNK : count };
+    while (!pool_push(p, &t)) {
+      PoolTask other;
+      if (pool_pop(p, &other)) pool_run(&other);
+    }
+    if ((begin / POOL_CHUNK & 15) == 0) pool_wake(p);
+  }
+  pool_wake(p);
+  return job;
+}
+
+/**
+ * Set the job matched against, for pattern_set_group_name() and friends;
+ * valid until match_job_release()
+ */
+BUN_EXPORT PatternSet* match_job_set(MatchJob* job) {
+  return job ? job->set : NULL;
+}
+
+/**
+ * 1 once every output of the job is written
+ */
+BUN_EXPORT int match_job_done(MatchJob* job) {
+  return job ? atomic_load_explicit(&job->done, memory_order_acquire) : 1;
+}
+
+/**
+ * Release a job, waiting for it to finish first if needed, and unpin its set
+ */
+BUN_EXPORT void match_job_release(MatchJob* job) {
+  if (!job) return;
+  MatchPool* p = job->pool;
+  if (!atomic_load_explicit(&job->done, memory_order_acquire)) {
+    pthread_mutex_lock(&p->lock);
+    while (!atomic_load_explicit(&job->done, memory_order_acquire)) pthread_cond_wait(&p->job_done, &p->lock);
+    pthread_mutex_unlock(&p->lock);
+  }
+  reader_unpin_detached(job->reader);
+  free(job);
+}
+
+// ---------------------------------------------------------------------------
+// PatternMatch results
+// ---------------------------------------------------------------------------
+
+static char* copy_span(char** cursor, const char* s, size_t len) {
+  char* out = *cursor;
+  memcpy(out, s, len);
+  out[len] = '\0';
+  *cursor += len + 1;
+  return out;
+}
+
+static PatternMatch* new_pattern_match(const char* host, size_t host_len, const char* path,
+                                       size_t path_len, const MatchOut* m) {
+  // One block: struct, group arrays, then the strings
+  size_t bytes = sizeof(PatternMatch) +
+                 m->group_count * (sizeof(uint64_t) + sizeof(char*) + sizeof(uint32_t)) +
+                 host_len + 1 + path_len + 1;
+  for (uint32_t g = 0; g < m->group_count; g++) bytes += m->groups[g].len + 1;
+
+  PatternMatch* result = calloc(1, bytes);
+  if (!result) return NULL;
+
+  result->group_values = (uint64_t*)(result + 1);
+  result->groups = (char**)(result->group_values + m->group_count);
+  result->group_indices = (uint32_t*)(result->groups + m->group_count);
+  memcpy(result->group_values, m->values, m->group_count * sizeof(uint64_t));
+  char* cursor = (char*)(result->group_indices + m->group_count);
+  result->hostname = copy_span(&cursor, host, host_len);
+  result->pathname = copy_span(&cursor, path, path_len);
+  result->confidence = m->confidence;
+  result->pattern_id = m->pattern_id;
+  result->group_count = m->group_count;
+
+  // Unmatched optional groups stay NULL
+  for (uint32_t g = 0; g < m->group_count; g++) {
+    result->group_indices[g] = UINT32_MAX;
+    if (m->group_src[g] == GROUP_UNMATCHED) continue;
+    const char* src = m->group_src[g] == GROUP_HOST ? host : path;
+    result->groups[g] = copy_span(&cursor, src + m->groups[g].off, m->groups[g].len);
+    result->group_indices[g] = m->groups[g].off;
+  }
+
+  return result;
+}
+
+/**
+ * Match pre-split hostname/pathname slices against the set published in
+ * `slot`
+ *
+ * No JSON on either side: pass URL.hostname (already lowercase) and
+ * URL.pathname bytes straight through. Neither slice needs a terminator.
+ *
+ * @returns PatternMatch* (one allocation, release with free_pattern_match)
+ *          or NULL if no match
+ */
+BUN_EXPORT PatternMatch* match_url_parts_slot(PatternSlot* slot, const char* host, size_t host_len,
+                                              const char* path, size_t path_len) {
+  MatchOut m;
+  if (!slot || (!host && host_len) || (!path && path_len)) return NULL;
+  if (!host) host = "";
+  if (!path) path = "";
+  PatternSet* set = pattern_slot_read_begin(slot);
+  PatternMatch* result = match_core(set, host, host_len, path, path_len, &m) > 0
+                             ? new_pattern_match(host, host_len, path, path_len, &m) : NULL;
+  pattern_slot_read_end(slot);
+  return result;
+}
+
+/**
+ * match_url_parts_slot() on the global slot (see pattern_set_activate())
+ */
+BUN_EXPORT PatternMatch* match_url_parts(const char* host, size_t host_len,
+                                         const char* path, size_t path_len) {
+  return match_url_parts_slot(&g_active, host, host_len, path, path_len);
+}
+
+/**
+ * Free pattern match result
+ */
+BUN_EXPORT void free_pattern_match(PatternMatch* match) {
+  // Strings and group arrays share the struct's allocation
+  free(match);
+}
+
+// ---------------------------------------------------------------------------
+// Legacy JSON entry point
+// ---------------------------------------------------------------------------
+
+static int hex_value(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static int read_hex4(const char* s, uint32_t* out) {
+  uint32_t v = 0;
+  for (int i = 0; i < 4; i++) {
+    int h = hex_value(s[i]);
+    if (h < 0) return -1;
+    v = v << 4 | (uint32_t)h;
+  }
+  *out = v;
+  return 0;
+}
+
+// Decode the string value of the top-level member "key" of a JSON object
+// into out; members of nested objects and arrays are not matched.
+// Returns the decoded length or -1.
+static int64_t json_string_field(const char* json, const char* key, char* out, size_t cap) {
+  size_t key_len = strlen(key);
+  int depth = 0;
+  for (const char* p = json; *p; p++) {
+    if (*p == '{' || *p == '[') { depth++; continue; }
+    if (*p == '}' || *p == ']') { depth--; continue; }
+    if (*p != '"') continue;
+    // Skip the string token; p is left on its closing quote
+    const char* tok = ++p;
+    while (*p && *p != '"') p += (*p == '\\' && p[1]) ? 2 : 1;
+    if (!*p) return -1;
+    if (depth != 1 || (size_t)(p - tok) != key_len || memcmp(tok, key, key_len) != 0) continue;
+    const char* v = p + 1;
+    while (*v == ' ' || *v == '\t' || *v == '\n' || *v == '\r') v++;
+    if (*v != ':') continue;  // a value that happens to spell the key
+    p = v + 1;
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') p++;
+    if (*p++ != '"') return -1;
+
+    size_t n = 0;
+    while (*p && *p != '"') {
+      uint32_t cp = (uint8_t)*p++;
+      if (cp == '\\') {
+        char e = *p++;
+        switch (e) {
+          case '"': case '\\': case '/': cp = (uint8_t)e; break;
+          case 'b': cp = '\b'; break;
+          case 'f': cp = '\f'; break;
+          case 'n': cp = '\n'; break;
+          case 'r': cp = '\r'; break;
+          case 't': cp = '\t'; break;
+          case 'u': {
+            if (read_hex4(p, &cp)) return -1;
+            p += 4;
+            if (cp >= 0xD800 && cp < 0xDC00 && p[0] == '\\' && p[1] == 'u') {
+              uint32_t lo;
+              if (read_hex4(p + 2, &lo) == 0 && lo >= 0xDC00 && lo < 0xE000) {
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                p += 6;
+              }
+            }
+            char buf[4];
+            size_t len;
+            if (cp < 0x80) { buf[0] = (char)cp; len = 1; }
+            else if (cp < 0x800) { buf[0] = (char)(0xC0 | cp >> 6); buf[1] = (char)(0x80 | (cp & 0x3F)); len = 2; }
+            else if (cp < 0x10000) { buf[0] = (char)(0xE0 | cp >> 12); buf[1] = (char)(0x80 | (cp >> 6 & 0x3F)); buf[2] = (char)(0x80 | (cp & 0x3F)); len = 3; }
+            else { buf[0] = (char)(0xF0 | cp >> 18); buf[1] = (char)(0x80 | (cp >> 12 & 0x3F)); buf[2] = (char)(0x80 | (cp >> 6 & 0x3F)); buf[3] = (char)(0x80 | (cp & 0x3F)); len = 4; }
+            if (n + len > cap) return -1;
+            memcpy(out + n, buf, len);
+            n += len;
+            continue;
+          }
+          default: return -1;
+        }
+      }
+      if (n >= cap) return -1;
+      out[n++] = (char)cp;
+    }
+    if (*p != '"') return -1;
+    return (int64_t)n;
+  }
+  return -1;
+}
+
+/**
+ * Match URL pattern against the active pattern set
+ *
+ * Kept for existing callers; match_url_parts() skips the JSON round trip.
+ *
+ * @param input_json - JSON string with hostname and pathname
+ * @returns PatternMatch* (one allocation, release with free_pattern_match)
+ *          or NULL if no match. match_url_arena() avoids the allocator.
+ */
+BUN_EXPORT PatternMatch* match_url_pattern(const char* input_json) {
+  char host[MATCHER_MAX_INPUT];
+  char path[MATCHER_MAX_INPUT];
+  MatchOut m;
+
+  if (!input_json) return NULL;
+  int64_t host_len = json_string_field(input_json, "hostname", host, sizeof(host));
+  int64_t path_len = json_string_field(input_json, "pathname", path, sizeof(path));
+  if (host_len < 0 || path_len < 0) return NULL;
+  PatternSet* set = active_read_begin();
+  int hit = match_core(set, host, (size_t)host_len, path, (size_t)path_len, &m);
+  reader_exit();
+  if (hit <= 0) return NULL;
+  return new_pattern_match(host, (size_t)host_len, path, (size_t)path_len, &m);
+}
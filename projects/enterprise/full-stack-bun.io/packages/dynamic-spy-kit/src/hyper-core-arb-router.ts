@@ -10,6 +10,7 @@ import type { URLPatternInit } from "./core/urlpattern-spy";
 import { QuantumURLPatternSpyFactory, MultiURLPatternSpy } from "./quantum-urlpattern-spy";
 import { AIPatternLoader } from "./ai-pattern-loader";
 import { HMRSafePatternLoader } from "./hmr-safe-pattern-loader";
+import type { FFIMatchResult } from "./ffi-pattern-matcher";
 
 interface PrioritySpy {
 	spy: MultiURLPatternSpy<any>;
@@ -22,6 +23,7 @@ export class HyperCoreArbRouter extends QuantumArbRouter {
 	public allActivePatterns: URLPatternInit[] = [];
 	private priorityQueue: PrioritySpy[] = [];
 	private watchPatterns: boolean = false;
+	private poolStarted: boolean = false;
 
 	constructor(api: any, options?: { enableCache?: boolean; enableFFI?: boolean; environment?: string; watchPatterns?: boolean }) {
 		super(api, options);
@@ -63,6 +65,25 @@ export class HyperCoreArbRouter extends QuantumArbRouter {
 		}
 	}
 
+	/**
+	 * Match an archive backfill off the event loop
+	 *
+	 * Batches go to the native worker pool (started on first use) so live
+	 * routeRequest() calls keep being served while it runs.
+	 */
+	async backfillMatches(urls: string[], batchSize: number = 16384): Promise<(FFIMatchResult | null)[]> {
+		const ffi = this.getFFIMatcher();
+		if (!this.poolStarted) {
+			ffi.startWorkers();
+			this.poolStarted = true;
+		}
+		const results: (FFIMatchResult | null)[] = [];
+		for (let i = 0; i < urls.length; i += batchSize) {
+			results.push(...(await ffi.matchBestBatch(urls.slice(i, i + batchSize))));
+		}
+		return results;
+	}
+
 	/**
 	 * Get region spies (exposed for error handling)
 	 */
@@ -273,6 +273,11 @@ export { LineMovementDetector } from './ticks/line-movement';
 export { TickMonitor as TickMonitorLegacy } from './tick-monitor';
 export { LineMovementDetector as LineMovementDetectorLegacy } from './line-movement-detector';
 
+export { LineMovementKernel, LM_FIRST, LM_STEAM, LM_BUYBACK, LM_CLOSING, LM_INVALID } from './line-movement-kernel';
+export type { TickColumns, LineMovementBatch, LineMovementOptions } from './line-movement-kernel';
+export { ArbEngine, ARB_OPEN, ARB_UPDATE, ARB_CLOSE, ARB_MAX_OUTCOMES } from './arb-engine';
+export type { PriceTickColumns, ArbOpportunity, ArbEngineOptions } from './arb-engine';
+
 // ============================================================================
 // BACKWORK ENGINE & MODEL REVERSE ENGINEERING
 // ============================================================================
@@ -309,6 +314,9 @@ export type { ArbCacheEntry } from './redis-arb-cache';
 
 // Legacy MMap Cache export
 export { MMapCache as MMapCacheLegacy } from './mmap-cache';
+export type { Market as CachedMarket } from './mmap-cache';
+export { MarketSnapshot, SNAPSHOT_F64, SNAPSHOT_U32, SNAPSHOT_STR, SNAPSHOT_VERIFY } from './market-snapshot';
+export type { SnapshotColumnInput, SnapshotOptions } from './market-snapshot';
 
 // ============================================================================
 // TICK ENGINE & STREAMING
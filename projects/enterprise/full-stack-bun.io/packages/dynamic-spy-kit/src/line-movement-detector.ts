@@ -5,6 +5,7 @@
  */
 
 import { LineMovement } from "./tick-monitor";
+import { LineMovementKernel, type LineMovementBatch, type TickColumns } from "./line-movement-kernel";
 
 export interface MovementDetection {
 	bookie: string;
@@ -17,6 +18,7 @@ export interface MovementDetection {
 export class LineMovementDetector {
 	private movements: Map<string, MovementDetection[]> = new Map();
 	private openingPrices: Map<string, number> = new Map();
+	private kernel: LineMovementKernel | null = null;
 
 	/**
 	 * Detect line movement for a bookie-market pair
@@ -68,6 +70,30 @@ export class LineMovementDetector {
 		return detection;
 	}
 
+	/**
+	 * Columnar fast path for tick bursts
+	 *
+	 * Same phase bands as detectMovement() (BUYBACK above +2%, CLOSING
+	 * below -1%) plus steam flags, computed natively into typed arrays
+	 * without a MovementDetection per tick. Ids come from marketId().
+	 *
+	 * @param ticks - market ids, timestamps (ms) and prices
+	 * @returns per-tick deltas / velocity / movement / LM_* flags and the
+	 * indices of ticks that crossed a threshold
+	 */
+	detectBatch(ticks: TickColumns): LineMovementBatch {
+		this.kernel ??= new LineMovementKernel();
+		return this.kernel.update(ticks);
+	}
+
+	/**
+	 * Dense market id for detectBatch()
+	 */
+	marketId(bookie: string, market: string): number {
+		this.kernel ??= new LineMovementKernel();
+		return this.kernel.marketId(`${bookie}:${market}`);
+	}
+
 	/**
 	 * Get movement history for a market
 	 * 
@@ -0,0 +1,221 @@
+/**
+ * @dynamic-spy/kit - Line Movement Kernel
+ *
+ * Columnar tick processing for steam-move detection. Ticks go in as typed
+ * arrays (market id, timestamp, price) and deltas, velocity, movement and
+ * threshold-crossing flags come back in reused typed arrays, so a spike of
+ * ticks allocates nothing per tick. Runs in line_movement.c (same library
+ * as the pattern matcher) when available, else in an equivalent JS loop.
+ */
+
+import { dlopen, CString, type Pointer } from "bun:ffi";
+
+/** Flag bits in LineMovementBatch.flags */
+export const LM_FIRST = 1; // market's first tick (its opening price)
+export const LM_STEAM = 2; // |velocity| crossed velocityThreshold upwards
+export const LM_BUYBACK = 4; // movement crossed above +upPct
+export const LM_CLOSING = 8; // movement crossed below -downPct
+export const LM_INVALID = 128; // unknown market id or non-positive price
+
+const LM_CROSSINGS = LM_STEAM | LM_BUYBACK | LM_CLOSING;
+const STATE_FIELDS = 4; // opening, last price, last timestamp, last velocity
+
+export interface TickColumns {
+	market: Uint32Array; // ids from LineMovementKernel.marketId()
+	timestamp: Float64Array; // ms
+	price: Float64Array;
+	count?: number; // defaults to market.length; at most the shortest column
+}
+
+/** Views over the kernel's output buffers, valid until the next update() */
+export interface LineMovementBatch {
+	delta: Float64Array;
+	velocity: Float64Array; // price change per second
+	movement: Float64Array; // percent from the opening price
+	flags: Uint8Array;
+	events: Uint32Array; // indices of ticks with a crossing flag
+}
+
+export interface LineMovementOptions {
+	velocityThreshold?: number;
+	upPct?: number; // BUYBACK band, matches LineMovementDetector (2%)
+	downPct?: number; // CLOSING band (1%)
+	libPath?: string;
+}
+
+interface KernelLibrary {
+	line_movement_update: (
+		state: Float64Array,
+		marketCount: number,
+		market: Uint32Array,
+		timestamp: Float64Array,
+		price: Float64Array,
+		count: number,
+		velocityThreshold: number,
+		upPct: number,
+		downPct: number,
+		outDelta: Float64Array,
+		outVelocity: Float64Array,
+		outMovement: Float64Array,
+		outFlags: Uint8Array,
+		outEvents: Uint32Array
+	) => number;
+	line_movement_simd_level: () => Pointer | null;
+}
+
+export class LineMovementKernel {
+	private lib: KernelLibrary | null = null;
+	private state: Float64Array;
+	private ids: Map<string, number> = new Map();
+	private delta = new Float64Array(0);
+	private velocity = new Float64Array(0);
+	private movement = new Float64Array(0);
+	private flags = new Uint8Array(0);
+	private events = new Uint32Array(0);
+	private velocityThreshold: number;
+	private upPct: number;
+	private downPct: number;
+	private simdLevel: string = 'js';
+
+	constructor(markets: number = 1024, options: LineMovementOptions = {}) {
+		this.state = new Float64Array(Math.max(markets, 1) * STATE_FIELDS);
+		this.velocityThreshold = options.velocityThreshold ?? 0.05;
+		this.upPct = options.upPct ?? 2;
+		this.downPct = options.downPct ?? 1;
+
+		const libPath = options.libPath ?? process.env.PATTERN_MATCHER_LIB;
+		try {
+			if (libPath) {
+				this.lib = dlopen(libPath, {
+					line_movement_update: {
+						args: ["ptr", "u32", "ptr", "ptr", "ptr", "u32", "f64", "f64", "f64", "ptr", "ptr", "ptr", "ptr", "ptr"],
+						returns: "u32"
+					},
+					line_movement_simd_level: { args: [], returns: "ptr" }
+				}).symbols as unknown as KernelLibrary;
+				const level = this.lib.line_movement_simd_level();
+				this.simdLevel = level ? new CString(level).toString() : 'scalar';
+			}
+		} catch (e) {
+			console.warn('Line movement kernel not available, using JS:', e);
+			this.lib = null;
+		}
+	}
+
+	get native(): boolean {
+		return this.lib !== null;
+	}
+
+	get simd(): string {
+		return this.simdLevel;
+	}
+
+	/**
+	 * Dense id for a bookie/market key, growing the state table as needed
+	 */
+	marketId(key: string): number {
+		let id = this.ids.get(key);
+		if (id === undefined) {
+			id = this.ids.size;
+			this.ids.set(key, id);
+			if ((id + 1) * STATE_FIELDS > this.state.length) {
+				const grown = new Float64Array(this.state.length * 2);
+				grown.set(this.state);
+				this.state = grown;
+			}
+		}
+		return id;
+	}
+
+	/**
+	 * Forget a market's opening price and history
+	 */
+	resetMarket(id: number): void {
+		this.state.fill(0, id * STATE_FIELDS, (id + 1) * STATE_FIELDS);
+	}
+
+	/**
+	 * Apply a batch of ticks in array order
+	 *
+	 * @throws RangeError if `count` runs past any column
+	 */
+	update(ticks: TickColumns): LineMovementBatch {
+		const count = ticks.count ?? ticks.market.length;
+		// The kernel reads `count` entries of every column unchecked
+		const rows = Math.min(ticks.market.length, ticks.timestamp.length, ticks.price.length);
+		if (!Number.isInteger(count) || count < 0 || count > rows) {
+			throw new RangeError(`tick count ${count} outside the columns (shortest has ${rows})`);
+		}
+		this.reserve(count);
+		const marketCount = this.state.length / STATE_FIELDS;
+		const events = this.lib
+			? this.lib.line_movement_update(
+				this.state, marketCount, ticks.market, ticks.timestamp, ticks.price, count,
+				this.velocityThreshold, this.upPct, this.downPct,
+				this.delta, this.velocity, this.movement, this.flags, this.events
+			)
+			: this.updateJS(marketCount, ticks, count);
+		return {
+			delta: this.delta.subarray(0, count),
+			velocity: this.velocity.subarray(0, count),
+			movement: this.movement.subarray(0, count),
+			flags: this.flags.subarray(0, count),
+			events: this.events.subarray(0, events)
+		};
+	}
+
+	private reserve(count: number): void {
+		if (this.flags.length >= count) return;
+		const size = Math.max(count, this.flags.length * 2, 1024);
+		this.delta = new Float64Array(size);
+		this.velocity = new Float64Array(size);
+		this.movement = new Float64Array(size);
+		this.flags = new Uint8Array(size);
+		this.events = new Uint32Array(size);
+	}
+
+	// Same arithmetic as line_movement_update(), one tick at a time
+	private updateJS(marketCount: number, ticks: TickColumns, count: number): number {
+		const { market, timestamp, price } = ticks;
+		const state = this.state;
+		const steam = Math.abs(this.velocityThreshold);
+		let events = 0;
+		for (let i = 0; i < count; i++) {
+			const m = market[i];
+			const p = price[i];
+			const t = timestamp[i];
+			if (m >= marketCount || !(p > 0)) {
+				this.flags[i] = LM_INVALID;
+				this.delta[i] = this.velocity[i] = this.movement[i] = 0;
+				continue;
+			}
+			const s = m * STATE_FIELDS;
+			let flags = 0;
+			if (state[s] === 0) {
+				state[s] = state[s + 1] = p;
+				state[s + 2] = t;
+				flags = LM_FIRST;
+			}
+			const opening = state[s];
+			const prevPrice = state[s + 1];
+			const dt = t - state[s + 2];
+			const delta = p - prevPrice;
+			const velocity = dt > 0 ? (delta * 1000) / dt : 0;
+			const movement = ((p - opening) * 100) / opening;
+			const prevMovement = ((prevPrice - opening) * 100) / opening;
+			if (movement > this.upPct && prevMovement <= this.upPct) flags |= LM_BUYBACK;
+			if (movement < -this.downPct && prevMovement >= -this.downPct) flags |= LM_CLOSING;
+			if (Math.abs(velocity) >= steam && Math.abs(state[s + 3]) < steam) flags |= LM_STEAM;
+			state[s + 1] = p;
+			if (t > state[s + 2]) state[s + 2] = t;
+			state[s + 3] = velocity;
+
+			this.delta[i] = delta;
+			this.velocity[i] = velocity;
+			this.movement[i] = movement;
+			this.flags[i] = flags;
+			if (flags & LM_CROSSINGS) this.events[events++] = i;
+		}
+		return events;
+	}
+}
@@ -0,0 +1,300 @@
+/**
+ * @dynamic-spy/kit - Line movement kernel
+ *
+ * Tick-by-tick odds deltas over columnar input, built into the same shared
+ * library as ffi_matcher.c. A batch is three typed arrays (market id,
+ * timestamp in ms, price) and the per-market state lives in a caller-owned
+ * Float64Array, so a burst of ticks is processed without creating a JS
+ * object per tick.
+ *
+ * Per tick the kernel writes the price delta since the market's previous
+ * tick, velocity (price units per second), movement from the market's
+ * opening price (percent) and LM_* flags for threshold crossings: steam
+ * (|velocity| rises through the threshold), buyback (movement rises above
+ * +up_pct) and closing (movement falls below -down_pct). Indices of ticks
+ * that crossed something are listed in out_events.
+ *
+ * Ticks are handled in blocks: a scalar pass resolves each tick's previous
+ * price / timestamp from the state (ticks of one market depend on each
+ * other), a 2/4-lane SSE2/AVX2/NEON pass does the arithmetic and movement
+ * crossings, and a scalar pass settles velocity crossings and the event
+ * list.
+ *
+ * Compile: cc -O2 -shared -fPIC src/ffi_matcher.c src/line_movement.c src/market_snapshot.c src/arb_engine.c -o libpattern_matcher.so
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define LM_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define LM_NEON 1
+#endif
+
+#ifndef BUN_EXPORT
+#define BUN_EXPORT __attribute__((visibility("default")))
+#endif
+
+// out_flags bits
+#define LM_FIRST 1      // market's first tick: becomes its opening price
+#define LM_STEAM 2      // |velocity| crossed velocity_threshold upwards
+#define LM_BUYBACK 4    // movement crossed above +up_pct
+#define LM_CLOSING 8    // movement crossed below -down_pct
+#define LM_INVALID 128  // market id out of range or price not positive
+
+#define LM_CROSSINGS (LM_STEAM | LM_BUYBACK | LM_CLOSING)
+
+// Per-market state: LM_STATE_FIELDS doubles, all 0 before the first tick
+enum { LM_OPENING, LM_LAST_PRICE, LM_LAST_TS, LM_LAST_VELOCITY, LM_STATE_FIELDS };
+
+#define LM_BLOCK 512
+
+typedef struct {
+  double prev_price[LM_BLOCK];
+  double prev_ts[LM_BLOCK];
+  double opening[LM_BLOCK];
+} LmScratch;
+
+typedef struct {
+  double up;    // +up_pct
+  double down;  // -down_pct
+} LmLimits;
+
+// Vector pass over one block: delta, velocity, movement, BUYBACK / CLOSING
+typedef void (*LmBlockFn)(const double* price, const double* ts, const LmScratch* sc, uint32_t n,
+                          LmLimits lim, double* delta, double* velocity, double* movement, uint8_t* flags);
+
+typedef struct {
+  const char* name;
+  LmBlockFn block;
+} LmKernels;
+
+static LmKernels g_lm_kernels;
+
+static inline uint8_t lm_tick_scalar(double p, double t, double q, double u, double o, LmLimits lim,
+                                     double* delta, double* velocity, double* movement) {
+  double d = p - q;
+  double dt = t - u;
+  double mov = (p - o) * 100.0 / o;
+  double prev = (q - o) * 100.0 / o;
+  *delta = d;
+  *velocity = dt > 0 ? d * 1000.0 / dt : 0.0;
+  *movement = mov;
+  return (uint8_t)((mov > lim.up && prev <= lim.up) * LM_BUYBACK |
+                   (mov < lim.down && prev >= lim.down) * LM_CLOSING);
+}
+
+static void lm_block_scalar(const double* price, const double* ts, const LmScratch* sc, uint32_t n,
+                            LmLimits lim, double* delta, double* velocity, double* movement, uint8_t* flags) {
+  for (uint32_t i = 0; i < n; i++) {
+    flags[i] |= lm_tick_scalar(price[i], ts[i], sc->prev_price[i], sc->prev_ts[i], sc->opening[i], lim,
+                               &delta[i], &velocity[i], &movement[i]);
+  }
+}
+
+#if LM_X86
+static void lm_block_sse2(const double* price, const double* ts, const LmScratch* sc, uint32_t n,
+                          LmLimits lim, double* delta, double* velocity, double* movement, uint8_t* flags) {
+  const __m128d hundred = _mm_set1_pd(100.0), thousand = _mm_set1_pd(1000.0), zero = _mm_setzero_pd();
+  const __m128d up = _mm_set1_pd(lim.up), down = _mm_set1_pd(lim.down);
+  uint32_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    __m128d p = _mm_loadu_pd(price + i), t = _mm_loadu_pd(ts + i);
+    __m128d q = _mm_loadu_pd(sc->prev_price + i), u = _mm_loadu_pd(sc->prev_ts + i);
+    __m128d o = _mm_loadu_pd(sc->opening + i);
+    __m128d d = _mm_sub_pd(p, q), dt = _mm_sub_pd(t, u);
+    __m128d v = _mm_and_pd(_mm_cmpgt_pd(dt, zero), _mm_div_pd(_mm_mul_pd(d, thousand), dt));
+    __m128d mov = _mm_div_pd(_mm_mul_pd(_mm_sub_pd(p, o), hundred), o);
+    __m128d prev = _mm_div_pd(_mm_mul_pd(_mm_sub_pd(q, o), hundred), o);
+    int b = _mm_movemask_pd(_mm_and_pd(_mm_cmpgt_pd(mov, up), _mm_cmple_pd(prev, up)));
+    int c = _mm_movemask_pd(_mm_and_pd(_mm_cmplt_pd(mov, down), _mm_cmpge_pd(prev, down)));
+    _mm_storeu_pd(delta + i, d);
+    _mm_storeu_pd(velocity + i, v);
+    _mm_storeu_pd(movement + i, mov);
+    flags[i] |= (uint8_t)((b & 1) * LM_BUYBACK | (c & 1) * LM_CLOSING);
+    flags[i + 1] |= (uint8_t)((b >> 1) * LM_BUYBACK | (c >> 1) * LM_CLOSING);
+  }
+  for (; i < n; i++) {
+    flags[i] |= lm_tick_scalar(price[i], ts[i], sc->prev_price[i], sc->prev_ts[i], sc->opening[i], lim,
+                               &delta[i], &velocity[i], &movement[i]);
+  }
+}
+
+__attribute__((target("avx2")))
+static void lm_block_avx2(const double* price, const double* ts, const LmScratch* sc, uint32_t n,
+                          LmLimits lim, double* delta, double* velocity, double* movement, uint8_t* flags) {
+  const __m256d hundred = _mm256_set1_pd(100.0), thousand = _mm256_set1_pd(1000.0);
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d up = _mm256_set1_pd(lim.up), down = _mm256_set1_pd(lim.down);
+  uint32_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256d p = _mm256_loadu_pd(price + i), t = _mm256_loadu_pd(ts + i);
+    __m256d q = _mm256_loadu_pd(sc->prev_price + i), u = _mm256_loadu_pd(sc->prev_ts + i);
+    __m256d o = _mm256_loadu_pd(sc->opening + i);
+    __m256d d = _mm256_sub_pd(p, q), dt = _mm256_sub_pd(t, u);
+    __m256d v = _mm256_and_pd(_mm256_cmp_pd(dt, zero, _CMP_GT_OQ),
+                              _mm256_div_pd(_mm256_mul_pd(d, thousand), dt));
+    __m256d mov = _mm256_div_pd(_mm256_mul_pd(_mm256_sub_pd(p, o), hundred), o);
+    __m256d prev = _mm256_div_pd(_mm256_mul_pd(_mm256_sub_pd(q, o), hundred), o);
+    int b = _mm256_movemask_pd(_mm256_and_pd(_mm256_cmp_pd(mov, up, _CMP_GT_OQ),
+                                             _mm256_cmp_pd(prev, up, _CMP_LE_OQ)));
+    int c = _mm256_movemask_pd(_mm256_and_pd(_mm256_cmp_pd(mov, down, _CMP_LT_OQ),
+                                             _mm256_cmp_pd(prev, down, _CMP_GE_OQ)));
+    _mm256_storeu_pd(delta + i, d);
+    _mm256_storeu_pd(velocity + i, v);
+    _mm256_storeu_pd(movement + i, mov);
+    for (int k = 0; k < 4; k++) {
+      flags[i + k] |= (uint8_t)((b >> k & 1) * LM_BUYBACK | (c >> k & 1) * LM_CLOSING);
+    }
+  }
+  for (; i < n; i++) {
+    flags[i] |= lm_tick_scalar(price[i], ts[i], sc->prev_price[i], sc->prev_ts[i], sc->opening[i], lim,
+                               &delta[i], &velocity[i], &movement[i]);
+  }
+}
+#endif
+
+#if LM_NEON
+static void lm_block_neon(const double* price, const double* ts, const LmScratch* sc, uint32_t n,
+                          LmLimits lim, double* delta, double* velocity, double* movement, uint8_t* flags) {
+  const float64x2_t hundred = vdupq_n_f64(100.0), thousand = vdupq_n_f64(1000.0), zero = vdupq_n_f64(0.0);
+  const float64x2_t up = vdupq_n_f64(lim.up), down = vdupq_n_f64(lim.down);
+  uint32_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    float64x2_t p = vld1q_f64(price + i), t = vld1q_f64(ts + i);
+    float64x2_t q = vld1q_f64(sc->prev_price + i), u = vld1q_f64(sc->prev_ts + i);
+    float64x2_t o = vld1q_f64(sc->opening + i);
+    float64x2_t d = vsubq_f64(p, q), dt = vsubq_f64(t, u);
+    float64x2_t v = vreinterpretq_f64_u64(vandq_u64(vcgtq_f64(dt, zero),
+                                                    vreinterpretq_u64_f64(vdivq_f64(vmulq_f64(d, thousand), dt))));
+    float64x2_t mov = vdivq_f64(vmulq_f64(vsubq_f64(p, o), hundred), o);
+    float64x2_t prev = vdivq_f64(vmulq_f64(vsubq_f64(q, o), hundred), o);
+    uint64x2_t b = vandq_u64(vcgtq_f64(mov, up), vcleq_f64(prev, up));
+    uint64x2_t c = vandq_u64(vcltq_f64(mov, down), vcgeq_f64(prev, down));
+    vst1q_f64(delta + i, d);
+    vst1q_f64(velocity + i, v);
+    vst1q_f64(movement + i, mov);
+    flags[i] |= (uint8_t)((vgetq_lane_u64(b, 0) & 1) * LM_BUYBACK | (vgetq_lane_u64(c, 0) & 1) * LM_CLOSING);
+    flags[i + 1] |= (uint8_t)((vgetq_lane_u64(b, 1) & 1) * LM_BUYBACK | (vgetq_lane_u64(c, 1) & 1) * LM_CLOSING);
+  }
+  for (; i < n; i++) {
+    flags[i] |= lm_tick_scalar(price[i], ts[i], sc->prev_price[i], sc->prev_ts[i], sc->opening[i], lim,
+                               &delta[i], &velocity[i], &movement[i]);
+  }
+}
+#endif
+
+__attribute__((constructor))
+static void lm_select_kernels(void) {
+  const char* cap = getenv("PATTERN_MATCHER_SIMD");  // same override as the matcher
+  LmKernels k = { "scalar", lm_block_scalar };
+  if (cap && strcmp(cap, "scalar") == 0) {
+    g_lm_kernels = k;
+    return;
+  }
+#if LM_X86
+  k = (LmKernels){ "sse2", lm_block_sse2 };
+  __builtin_cpu_init();
+  if (!(cap && strcmp(cap, "sse2") == 0) && __builtin_cpu_supports("avx2")) {
+    k = (LmKernels){ "avx2", lm_block_avx2 };
+  }
+#elif LM_NEON
+  k = (LmKernels){ "neon", lm_block_neon };
+#endif
+  g_lm_kernels = k;
+}
+
+/**
+ * Name of the line movement kernel picked at load time
+ */
+BUN_EXPORT const char* line_movement_simd_level(void) {
+  return g_lm_kernels.name;
+}
+
+/**
+ * Process a batch of ticks
+ *
+ * Ticks are applied in array order; a market's ticks should arrive in time
+ * order (a tick older than its predecessor gets velocity 0).
+ *
+ * @param state - market_count * 4 doubles, zeroed before first use
+ * @param market - dense market ids (< market_count)
+ * @param timestamp - milliseconds
+ * @param price - decimal odds
+ * @param velocity_threshold - |price change| per second that counts as steam
+ * @param up_pct / down_pct - movement bands from the opening price (percent)
+ * @param out_delta / out_velocity / out_movement / out_flags - `count`
+ *        entries each
+ * @param out_events - optional, `count` entries: indices of ticks with a
+ *        crossing flag, in order
+ * @returns number of ticks with a crossing flag
+ */
+BUN_EXPORT uint32_t line_movement_update(double* state, uint32_t market_count, const uint32_t* market,
+                                         const double* timestamp, const double* price, uint32_t count,
+                                         double velocity_threshold, double up_pct, double down_pct,
+                                         double* out_delta, double* out_velocity, double* out_movement,
+                                         uint8_t* out_flags, uint32_t* out_events) {
+  if (!state || !market || !timestamp || !price || !out_delta || !out_velocity || !out_movement || !out_flags) {
+    return 0;
+  }
+  LmScratch sc;
+  LmLimits lim = { up_pct, -down_pct };
+  double steam = fabs(velocity_threshold);
+  uint32_t events = 0;
+
+  for (uint32_t base = 0; base < count; base += LM_BLOCK) {
+    uint32_t n = count - base < LM_BLOCK ? count - base : LM_BLOCK;
+    const double* p = price + base;
+    const double* t = timestamp + base;
+    uint8_t* flags = out_flags + base;
+
+    // Previous tick of each market, in order (ticks of one market chain)
+    for (uint32_t i = 0; i < n; i++) {
+      uint32_t m = market[base + i];
+      if (m >= market_count || !(p[i] > 0)) {
+        // Neutral inputs: zero delta and movement, no crossings
+        sc.prev_price[i] = sc.opening[i] = p[i] > 0 ? p[i] : 1.0;
+        sc.prev_ts[i] = t[i];
+        flags[i] = LM_INVALID;
+        continue;
+      }
+      double* st = state + (size_t)m * LM_STATE_FIELDS;
+      flags[i] = 0;
+      if (st[LM_OPENING] == 0) {
+        st[LM_OPENING] = st[LM_LAST_PRICE] = p[i];
+        st[LM_LAST_TS] = t[i];
+        flags[i] = LM_FIRST;
+      }
+      sc.prev_price[i] = st[LM_LAST_PRICE];
+      sc.prev_ts[i] = st[LM_LAST_TS];
+      sc.opening[i] = st[LM_OPENING];
+      st[LM_LAST_PRICE] = p[i];
+      if (t[i] > st[LM_LAST_TS]) st[LM_LAST_TS] = t[i];
+    }
+
+    g_lm_kernels.block(p, t, &sc, n, lim, out_delta + base, out_velocity + base, out_movement + base, flags);
+
+    // Velocity crossings depend on the market's previous velocity
+    for (uint32_t i = 0; i < n; i++) {
+      if (flags[i] & LM_INVALID) {
+        flags[i] = LM_INVALID;
+        out_delta[base + i] = out_velocity[base + i] = out_movement[base + i] = 0;
+        continue;
+      }
+      double* st = state + (size_t)market[base + i] * LM_STATE_FIELDS;
+      double v = fabs(out_velocity[base + i]);
+      if (v >= steam && fabs(st[LM_LAST_VELOCITY]) < steam) flags[i] |= LM_STEAM;
+      st[LM_LAST_VELOCITY] = out_velocity[base + i];
+      if (flags[i] & LM_CROSSINGS) {
+        if (out_events) out_events[events] = base + i;
+        events++;
+      }
+    }
+  }
+  return events;
+}
@@ -0,0 +1,397 @@
+/**
+ * @dynamic-spy/kit - Market Snapshot
+ *
+ * Columnar, mmap-backed market storage (the format market_snapshot.c
+ * reads). A snapshot is a header, one fixed-width column per field and a
+ * string table; opening it maps the file and builds typed-array views over
+ * the mapping, so a market is read by indexing columns and only the pages
+ * that are touched get faulted in. Nothing is decoded up front.
+ *
+ * Opens through market_snapshot.c (same library as the pattern matcher)
+ * when available, else maps the file with Bun.mmap and reads the same
+ * layout directly.
+ */
+
+import { dlopen, toArrayBuffer, type Pointer } from "bun:ffi";
+import { renameSync, writeFileSync } from "fs";
+
+/** Column types, as stored in the file */
+export const SNAPSHOT_F64 = 1;
+export const SNAPSHOT_U32 = 2;
+export const SNAPSHOT_STR = 3;
+
+/** market_snapshot_open() flag: checksum the file and bounds-check every string */
+export const SNAPSHOT_VERIFY = 1;
+
+// Header layout, mirrors SnapHeader / SnapColumn in market_snapshot.c
+const MAGIC = "BUNSNAP";
+const FORMAT_VERSION = 1;
+const ENDIAN = 0x01020304;
+const ALIGN = 64;
+const MAX_COLUMNS = 16;
+const NAME_MAX = 24;
+const NO_KEY = 0xffffffff;
+const H_VERSION = 8;
+const H_ENDIAN = 12;
+const H_FILE_SIZE = 16;
+const H_CHECKSUM = 24;
+const H_ROWS = 32;
+const H_COLUMN_COUNT = 36;
+const H_KEY_COLUMN = 40;
+const H_INDEX_SLOTS = 44;
+const H_STRINGS_OFF = 48;
+const H_STRINGS_LEN = 56;
+const H_INDEX_OFF = 64;
+const H_COLUMNS = 72;
+const COLUMN_SIZE = 40; // name[24], type u32, width u32, off u64
+const HEADER_SIZE = H_COLUMNS + MAX_COLUMNS * COLUMN_SIZE;
+
+const WIDTH: Record<number, number> = { [SNAPSHOT_F64]: 8, [SNAPSHOT_U32]: 4, [SNAPSHOT_STR]: 8 };
+
+export type SnapshotColumnInput =
+	| { name: string; type: "f64"; values: Float64Array }
+	| { name: string; type: "u32"; values: Uint32Array }
+	| { name: string; type: "string"; values: string[] };
+
+export interface SnapshotOptions {
+	libPath?: string;
+	verify?: boolean; // SNAPSHOT_VERIFY; only for files this host did not write
+}
+
+interface SnapshotLibrary {
+	market_snapshot_open: (path: Buffer, flags: number) => Pointer | null;
+	market_snapshot_close: (snapshot: Pointer) => void;
+	market_snapshot_base: (snapshot: Pointer) => Pointer;
+	market_snapshot_size: (snapshot: Pointer) => number;
+	market_snapshot_find: (snapshot: Pointer, key: Uint8Array, len: number) => number;
+}
+
+interface ColumnInfo {
+	type: number;
+	off: number;
+}
+
+const encoder = new TextEncoder();
+const decoder = new TextDecoder();
+
+let sharedLib: SnapshotLibrary | null | undefined;
+
+function loadLibrary(libPath?: string): SnapshotLibrary | null {
+	const path = libPath ?? process.env.PATTERN_MATCHER_LIB;
+	if (!path) return null;
+	if (!libPath && sharedLib !== undefined) return sharedLib;
+	let lib: SnapshotLibrary | null = null;
+	try {
+		lib = dlopen(path, {
+			market_snapshot_open: { args: ["ptr", "u32"], returns: "ptr" },
+			market_snapshot_close: { args: ["ptr"], returns: "void" },
+			market_snapshot_base: { args: ["ptr"], returns: "ptr" },
+			market_snapshot_size: { args: ["ptr"], returns: "u64_fast" },
+			market_snapshot_find: { args: ["ptr", "ptr", "u32"], returns: "i32" }
+		}).symbols as unknown as SnapshotLibrary;
+	} catch (e) {
+		console.warn('Market snapshot library not available, using Bun.mmap:', e);
+	}
+	if (!libPath) sharedLib = lib;
+	return lib;
+}
+
+// Same mixing as snap_checksum(): 64-bit words, then the tail bytes
+function checksum(bytes: Uint8Array, start: number): bigint {
+	const M = (1n << 64n) - 1n;
+	const len = bytes.length - start;
+	const view = new DataView(bytes.buffer, bytes.byteOffset + start, len);
+	let h = BigInt(ENDIAN) ^ ((BigInt(len) * 0x9e3779b97f4a7c15n) & M);
+	let i = 0;
+	for (; i + 8 <= len; i += 8) {
+		h = ((h ^ view.getBigUint64(i, true)) * 0xbf58476d1ce4e5b9n) & M;
+		h ^= h >> 31n;
+	}
+	for (; i < len; i++) {
+		h = ((h ^ BigInt(view.getUint8(i))) * 0x94d049bb133111ebn) & M;
+	}
+	return h ^ (h >> 29n);
+}
+
+// FNV-1a, as snap_key_hash()
+function keyHash(bytes: Uint8Array, len: number): number {
+	let h = 2166136261;
+	for (let i = 0; i < len; i++) {
+		h = Math.imul(h ^ bytes[i], 16777619) >>> 0;
+	}
+	return h;
+}
+
+const align = (off: number) => Math.ceil(off / ALIGN) * ALIGN;
+
+export class MarketSnapshot {
+	readonly rows: number;
+	private columns = new Map<string, ColumnInfo>();
+	private views = new Map<string, Float64Array | Uint32Array>();
+	private strings: Uint8Array;
+	private keyRefs: Uint32Array | null = null;
+	private index: Uint32Array | null = null;
+	private keyBuffer = new Uint8Array(256);
+
+	private constructor(
+		private bytes: Uint8Array,
+		private lib: SnapshotLibrary | null,
+		private handle: Pointer | null
+	) {
+		const h = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength);
+		this.rows = h.getUint32(H_ROWS, true);
+		const count = h.getUint32(H_COLUMN_COUNT, true);
+		for (let c = 0; c < count; c++) {
+			const at = H_COLUMNS + c * COLUMN_SIZE;
+			const raw = bytes.subarray(at, at + NAME_MAX);
+			const name = decoder.decode(raw.subarray(0, raw.indexOf(0)));
+			this.columns.set(name, { type: h.getUint32(at + NAME_MAX, true), off: Number(h.getBigUint64(at + 32, true)) });
+		}
+		const stringsOff = Number(h.getBigUint64(H_STRINGS_OFF, true));
+		this.strings = bytes.subarray(stringsOff, stringsOff + Number(h.getBigUint64(H_STRINGS_LEN, true)));
+		const key = h.getUint32(H_KEY_COLUMN, true);
+		if (key !== NO_KEY) {
+			const keyOff = Number(h.getBigUint64(H_COLUMNS + key * COLUMN_SIZE + 32, true));
+			this.keyRefs = new Uint32Array(bytes.buffer, bytes.byteOffset + keyOff, this.rows * 2);
+			const indexOff = Number(h.getBigUint64(H_INDEX_OFF, true));
+			this.index = new Uint32Array(bytes.buffer, bytes.byteOffset + indexOff, h.getUint32(H_INDEX_SLOTS, true));
+		}
+	}
+
+	/**
+	 * Map a snapshot file
+	 *
+	 * @returns the snapshot, or null if the file is missing, from another
+	 *          format version or fails verification
+	 */
+	static open(path: string, options: SnapshotOptions = {}): MarketSnapshot | null {
+		const lib = loadLibrary(options.libPath);
+		if (lib) {
+			const handle = lib.market_snapshot_open(Buffer.from(path + "\0"), options.verify ? SNAPSHOT_VERIFY : 0);
+			if (!handle) return null;
+			const size = lib.market_snapshot_size(handle);
+			const bytes = new Uint8Array(toArrayBuffer(lib.market_snapshot_base(handle), 0, size));
+			return new MarketSnapshot(bytes, lib, handle);
+		}
+
+		let bytes: Uint8Array;
+		try {
+			bytes = Bun.mmap(path, { shared: true });
+		} catch {
+			return null;
+		}
+		if (!MarketSnapshot.headerValid(bytes, options.verify ?? false)) return null;
+		return new MarketSnapshot(bytes, null, null);
+	}
+
+	// The Bun.mmap path's share of snap_validate(): header and section bounds
+	private static headerValid(bytes: Uint8Array, verify: boolean): boolean {
+		if (bytes.byteLength < HEADER_SIZE || decoder.decode(bytes.subarray(0, MAGIC.length)) !== MAGIC) return false;
+		const h = new DataView(bytes.buffer, bytes.byteOffset, HEADER_SIZE);
+		const size = bytes.byteLength;
+		const rows = h.getUint32(H_ROWS, true);
+		const count = h.getUint32(H_COLUMN_COUNT, true);
+		const section = (off: number, len: number) => off % ALIGN === 0 && off >= HEADER_SIZE && off + len <= size;
+		if (h.getUint32(H_VERSION, true) !== FORMAT_VERSION || h.getUint32(H_ENDIAN, true) !== ENDIAN ||
+			Number(h.getBigUint64(H_FILE_SIZE, true)) !== size || count > MAX_COLUMNS ||
+			!section(Number(h.getBigUint64(H_STRINGS_OFF, true)), Number(h.getBigUint64(H_STRINGS_LEN, true)))) {
+			return false;
+		}
+		for (let c = 0; c < count; c++) {
+			const at = H_COLUMNS + c * COLUMN_SIZE;
+			const width = WIDTH[h.getUint32(at + NAME_MAX, true)];
+			if (!width || h.getUint32(at + NAME_MAX + 4, true) !== width ||
+				!section(Number(h.getBigUint64(at + 32, true)), rows * width)) {
+				return false;
+			}
+		}
+		const key = h.getUint32(H_KEY_COLUMN, true);
+		const slots = h.getUint32(H_INDEX_SLOTS, true);
+		if (key !== NO_KEY && (key >= count || h.getUint32(H_COLUMNS + key * COLUMN_SIZE + NAME_MAX, true) !== SNAPSHOT_STR ||
+			slots <= rows || (slots & (slots - 1)) !== 0 || !section(Number(h.getBigUint64(H_INDEX_OFF, true)), slots * 4))) {
+			return false;
+		}
+		return !verify || checksum(bytes, HEADER_SIZE) === h.getBigUint64(H_CHECKSUM, true);
+	}
+
+	/**
+	 * Write a snapshot for open()
+	 *
+	 * The file is written next to `path` and renamed into place, so workers
+	 * mapping the old file keep a consistent copy. Repeated strings (sport,
+	 * league) are stored once; `key` names the string column find() looks
+	 * up.
+	 */
+	static write(path: string, rows: number, columns: SnapshotColumnInput[], key?: string): void {
+		if (columns.length > MAX_COLUMNS) throw new RangeError(`at most ${MAX_COLUMNS} columns`);
+		const keyColumn = key === undefined ? NO_KEY : columns.findIndex((c) => c.name === key && c.type === "string");
+		if (keyColumn === -1) throw new Error(`key column ${key} is not a string column`);
+
+		// String table: each distinct string once, NUL-terminated
+		const chunks: Uint8Array[] = [];
+		const interned = new Map<string, number>();
+		let stringsLen = 0;
+		const refs = columns.map((c) => {
+			if (c.type !== "string") return null;
+			const ref = new Uint32Array(rows * 2);
+			for (let r = 0; r < rows; r++) {
+				const s = c.values[r] ?? "";
+				let off = interned.get(s);
+				const bytes = encoder.encode(s);
+				if (off === undefined) {
+					off = stringsLen;
+					interned.set(s, off);
+					chunks.push(bytes, new Uint8Array(1));
+					stringsLen += bytes.length + 1;
+				}
+				ref[2 * r] = off;
+				ref[2 * r + 1] = bytes.length;
+			}
+			return ref;
+		});
+
+		const offsets: number[] = [];
+		let off = align(HEADER_SIZE);
+		for (const c of columns) {
+			offsets.push(off);
+			off = align(off + rows * WIDTH[c.type === "f64" ? SNAPSHOT_F64 : c.type === "u32" ? SNAPSHOT_U32 : SNAPSHOT_STR]);
+		}
+		const stringsOff = off;
+		off = align(stringsOff + stringsLen);
+		let slots = 16;
+		while (slots < rows * 2) slots *= 2;
+		const indexOff = keyColumn === NO_KEY ? 0 : off;
+		if (keyColumn !== NO_KEY) off = align(indexOff + slots * 4);
+
+		const file = new Uint8Array(off);
+		const h = new DataView(file.buffer);
+		file.set(encoder.encode(MAGIC));
+		h.setUint32(H_VERSION, FORMAT_VERSION, true);
+		h.setUint32(H_ENDIAN, ENDIAN, true);
+		h.setBigUint64(H_FILE_SIZE, BigInt(off), true);
+		h.setUint32(H_ROWS, rows, true);
+		h.setUint32(H_COLUMN_COUNT, columns.length, true);
+		h.setUint32(H_KEY_COLUMN, keyColumn, true);
+		h.setUint32(H_INDEX_SLOTS, keyColumn === NO_KEY ? 0 : slots, true);
+		h.setBigUint64(H_STRINGS_OFF, BigInt(stringsOff), true);
+		h.setBigUint64(H_STRINGS_LEN, BigInt(stringsLen), true);
+		h.setBigUint64(H_INDEX_OFF, BigInt(indexOff), true);
+
+		columns.forEach((c, i) => {
+			const at = H_COLUMNS + i * COLUMN_SIZE;
+			const name = encoder.encode(c.name);
+			if (name.length >= NAME_MAX) throw new RangeError(`column name ${c.name} is too long`);
+			const type = c.type === "f64" ? SNAPSHOT_F64 : c.type === "u32" ? SNAPSHOT_U32 : SNAPSHOT_STR;
+			file.set(name, at);
+			h.setUint32(at + NAME_MAX, type, true);
+			h.setUint32(at + NAME_MAX + 4, WIDTH[type], true);
+			h.setBigUint64(at + 32, BigInt(offsets[i]), true);
+			if (c.type === "string") {
+				file.set(new Uint8Array(refs[i]!.buffer), offsets[i]);
+			} else {
+				file.set(new Uint8Array(c.values.buffer, c.values.byteOffset, rows * WIDTH[type]), offsets[i]);
+			}
+		});
+		let at = stringsOff;
+		for (const chunk of chunks) {
+			file.set(chunk, at);
+			at += chunk.length;
+		}
+
+		if (keyColumn !== NO_KEY) {
+			const index = new Uint32Array(file.buffer, indexOff, slots);
+			const ref = refs[keyColumn]!;
+			const strings = file.subarray(stringsOff);
+			for (let r = 0; r < rows; r++) {
+				const so = ref[2 * r];
+				const len = ref[2 * r + 1];
+				let i = keyHash(strings.subarray(so), len) & (slots - 1);
+				for (; index[i] !== 0; i = (i + 1) & (slots - 1)) {
+					const other = index[i] - 1;
+					if (ref[2 * other + 1] === len && ref[2 * other] === so) break; // duplicate key: first row wins
+				}
+				if (index[i] === 0) index[i] = r + 1;
+			}
+		}
+		h.setBigUint64(H_CHECKSUM, checksum(file, HEADER_SIZE), true);
+
+		const tmp = `${path}.${process.pid}.tmp`;
+		writeFileSync(tmp, file);
+		renameSync(tmp, path);
+	}
+
+	get native(): boolean {
+		return this.lib !== null;
+	}
+
+	hasColumn(name: string): boolean {
+		return this.columns.has(name);
+	}
+
+	/**
+	 * A numeric column as a view over the mapping (no copy)
+	 */
+	f64(name: string): Float64Array {
+		return this.view(name, SNAPSHOT_F64) as Float64Array;
+	}
+
+	u32(name: string): Uint32Array {
+		return this.view(name, SNAPSHOT_U32) as Uint32Array;
+	}
+
+	/**
+	 * One string cell, decoded on demand
+	 */
+	string(name: string, row: number): string {
+		const refs = this.view(name, SNAPSHOT_STR) as Uint32Array;
+		if (row < 0 || row >= this.rows) throw new RangeError(`row ${row} out of range`);
+		const off = refs[2 * row];
+		return decoder.decode(this.strings.subarray(off, off + refs[2 * row + 1]));
+	}
+
+	/**
+	 * Row whose key column equals `key`, or -1
+	 */
+	find(key: string): number {
+		if (!this.index || !this.keyRefs) return -1;
+		if (this.keyBuffer.length < key.length * 3) this.keyBuffer = new Uint8Array(key.length * 3);
+		const len = encoder.encodeInto(key, this.keyBuffer).written;
+		if (this.lib && this.handle) {
+			return this.lib.market_snapshot_find(this.handle, this.keyBuffer, len);
+		}
+		const mask = this.index.length - 1;
+		for (let i = keyHash(this.keyBuffer, len) & mask; ; i = (i + 1) & mask) {
+			const row = this.index[i];
+			if (row === 0) return -1;
+			const off = this.keyRefs[2 * (row - 1)];
+			if (this.keyRefs[2 * (row - 1) + 1] !== len) continue;
+			let same = true;
+			for (let b = 0; b < len && same; b++) same = this.strings[off + b] === this.keyBuffer[b];
+			if (same) return row - 1;
+		}
+	}
+
+	/**
+	 * Unmap the file. Views returned by f64()/u32() must not be used after
+	 * this on the native path.
+	 */
+	close(): void {
+		if (this.lib && this.handle) this.lib.market_snapshot_close(this.handle);
+		this.handle = null;
+		this.views.clear();
+		this.bytes = new Uint8Array(0);
+	}
+
+	private view(name: string, type: number): Float64Array | Uint32Array {
+		const column = this.columns.get(name);
+		if (!column || column.type !== type) throw new Error(`snapshot has no ${name} column of type ${type}`);
+		let view = this.views.get(name);
+		if (view) return view;
+		const at = this.bytes.byteOffset + column.off;
+		view = type === SNAPSHOT_F64
+			? new Float64Array(this.bytes.buffer, at, this.rows)
+			: new Uint32Array(this.bytes.buffer, at, type === SNAPSHOT_STR ? this.rows * 2 : this.rows);
+		this.views.set(name, view);
+		return view;
+	}
+}
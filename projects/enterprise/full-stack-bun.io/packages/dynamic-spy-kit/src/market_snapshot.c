@@ -0,0 +1,294 @@
+/**
+ * @dynamic-spy/kit - Columnar market snapshots
+ *
+ * Read side of the market snapshot file (cache/12k-markets.bin), built into
+ * the same shared library as ffi_matcher.c. A snapshot is a header, one
+ * fixed-width column per field and a string table, each section at a
+ * 64-byte aligned offset. Opening one maps the file read-only and checks
+ * the header; nothing is parsed, so the pages of a column are only faulted
+ * in when something reads it and every router worker that maps the file
+ * shares them.
+ *
+ * Column types:
+ *   SNAPSHOT_F64  8 bytes, double
+ *   SNAPSHOT_U32  4 bytes, uint32_t
+ *   SNAPSHOT_STR  8 bytes, { uint32_t off, uint32_t len } into the string
+ *                 table; strings are stored once each and NUL-terminated
+ *
+ * One string column may be the key column. Its open-addressing index
+ * (uint32_t row + 1 per slot, 0 = empty, FNV-1a over the key bytes, linear
+ * probing) is stored after the string table, so market_snapshot_find()
+ * needs no load-time build either. Files are written by market-snapshot.ts
+ * and are specific to the writer's byte order and format version.
+ *
+ * Compile: cc -O2 -shared -fPIC src/ffi_matcher.c src/line_movement.c src/market_snapshot.c src/arb_engine.c -o libpattern_matcher.so
+ */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef BUN_EXPORT
+#define BUN_EXPORT __attribute__((visibility("default")))
+#endif
+
+#define SNAPSHOT_F64 1u
+#define SNAPSHOT_U32 2u
+#define SNAPSHOT_STR 3u
+
+#define SNAPSHOT_VERIFY 1u  // checksum the file and bounds-check every string
+
+#define SNAP_MAGIC "BUNSNAP"
+#define SNAP_FORMAT_VERSION 1u
+#define SNAP_ENDIAN 0x01020304u
+#define SNAP_ALIGN 64u
+#define SNAP_MAX_COLUMNS 16
+#define SNAP_NAME_MAX 24
+#define SNAP_NO_KEY UINT32_MAX
+
+typedef struct {
+  char name[SNAP_NAME_MAX];  // NUL-padded
+  uint32_t type;
+  uint32_t width;
+  uint64_t off;
+} SnapColumn;
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t endian;
+  uint64_t file_size;
+  uint64_t checksum;  // snap_checksum over everything after the header
+  uint32_t rows;
+  uint32_t column_count;
+  uint32_t key_column;   // SNAP_NO_KEY if the file has no index
+  uint32_t index_slots;  // power of two
+  uint64_t strings_off;
+  uint64_t strings_len;
+  uint64_t index_off;
+  SnapColumn columns[SNAP_MAX_COLUMNS];
+} SnapHeader;
+
+_Static_assert(sizeof(SnapColumn) == 40, "market-snapshot.ts mirrors this layout");
+_Static_assert(sizeof(SnapHeader) == 712, "market-snapshot.ts mirrors this layout");
+
+typedef struct {
+  const char* base;
+  size_t size;
+  const SnapHeader* h;
+} MarketSnapshot;
+
+// Word-at-a-time so verifying a large snapshot stays memory bound
+static uint64_t snap_checksum(const char* p, size_t len) {
+  uint64_t h = SNAP_ENDIAN ^ (len * 0x9E3779B97F4A7C15ull);
+  size_t i = 0;
+  for (; i + 8 <= len; i += 8) {
+    uint64_t w;
+    memcpy(&w, p + i, 8);
+    h = (h ^ w) * 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 31;
+  }
+  for (; i < len; i++) {
+    h = (h ^ (uint8_t)p[i]) * 0x94D049BB133111EBull;
+  }
+  return h ^ (h >> 29);
+}
+
+static uint32_t snap_key_hash(const char* s, size_t len) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    h = (h ^ (uint8_t)s[i]) * 16777619u;
+  }
+  return h;
+}
+
+static uint32_t snap_width(uint32_t type) {
+  switch (type) {
+    case SNAPSHOT_F64: return 8;
+    case SNAPSHOT_U32: return 4;
+    case SNAPSHOT_STR: return 8;
+    default: return 0;
+  }
+}
+
+static int snap_section_ok(const MarketSnapshot* s, uint64_t off, uint64_t len) {
+  return off % SNAP_ALIGN == 0 && off >= sizeof(SnapHeader) && off <= s->size && len <= s->size - off;
+}
+
+static int snap_validate(const MarketSnapshot* s, int verify) {
+  const SnapHeader* h = s->h;
+  if (h->column_count > SNAP_MAX_COLUMNS || !snap_section_ok(s, h->strings_off, h->strings_len)) {
+    return 0;
+  }
+  for (uint32_t c = 0; c < h->column_count; c++) {
+    const SnapColumn* col = &h->columns[c];
+    if (col->name[SNAP_NAME_MAX - 1] != '\0' || !snap_width(col->type) ||
+        col->width != snap_width(col->type) ||
+        !snap_section_ok(s, col->off, (uint64_t)h->rows * col->width)) {
+      return 0;
+    }
+  }
+  if (h->key_column != SNAP_NO_KEY) {
+    if (h->key_column >= h->column_count || h->columns[h->key_column].type != SNAPSHOT_STR ||
+        !h->index_slots || (h->index_slots & (h->index_slots - 1)) || h->index_slots <= h->rows ||
+        !snap_section_ok(s, h->index_off, (uint64_t)h->index_slots * 4)) {
+      return 0;
+    }
+  }
+  if (!verify) return 1;
+
+  // Everything a reader follows stays inside the file
+  if (snap_checksum(s->base + sizeof(SnapHeader), s->size - sizeof(SnapHeader)) != h->checksum) {
+    return 0;
+  }
+  for (uint32_t c = 0; c < h->column_count; c++) {
+    if (h->columns[c].type != SNAPSHOT_STR) continue;
+    const uint32_t* ref = (const uint32_t*)(s->base + h->columns[c].off);
+    for (uint32_t r = 0; r < h->rows; r++) {
+      uint64_t end = (uint64_t)ref[2 * r] + ref[2 * r + 1];
+      if (end >= h->strings_len || s->base[h->strings_off + end] != '\0') return 0;
+    }
+  }
+  if (h->key_column != SNAP_NO_KEY) {
+    const uint32_t* index = (const uint32_t*)(s->base + h->index_off);
+    for (uint32_t i = 0; i < h->index_slots; i++) {
+      if (index[i] > h->rows) return 0;
+    }
+  }
+  return 1;
+}
+
+/**
+ * Map a snapshot file read-only
+ *
+ * Without SNAPSHOT_VERIFY only the header and section bounds are checked,
+ * which touches one page; pass it for files this host did not write.
+ *
+ * @param path - snapshot written by MarketSnapshot.write()
+ * @param flags - SNAPSHOT_VERIFY
+ * @returns the snapshot (release with market_snapshot_close), or NULL if
+ *          the file is missing, from another format version or byte order,
+ *          or fails verification
+ */
+BUN_EXPORT MarketSnapshot* market_snapshot_open(const char* path, uint32_t flags) {
+  if (!path) return NULL;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return NULL;
+  struct stat st;
+  void* base = MAP_FAILED;
+  if (!fstat(fd, &st) && (uint64_t)st.st_size >= sizeof(SnapHeader)) {
+    base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (base == MAP_FAILED) return NULL;
+
+  MarketSnapshot* s = malloc(sizeof(MarketSnapshot));
+  const SnapHeader* h = base;
+  if (s) {
+    s->base = base;
+    s->size = (size_t)st.st_size;
+    s->h = h;
+    if (!memcmp(h->magic, SNAP_MAGIC, sizeof(SNAP_MAGIC)) && h->version == SNAP_FORMAT_VERSION &&
+        h->endian == SNAP_ENDIAN && h->file_size == s->size && snap_validate(s, flags & SNAPSHOT_VERIFY)) {
+      return s;
+    }
+  }
+  free(s);
+  munmap(base, (size_t)st.st_size);
+  return NULL;
+}
+
+/**
+ * Unmap a snapshot; views over market_snapshot_base() become invalid
+ */
+BUN_EXPORT void market_snapshot_close(MarketSnapshot* s) {
+  if (!s) return;
+  munmap((void*)s->base, s->size);
+  free(s);
+}
+
+/**
+ * Start of the mapping, for zero-copy views (toArrayBuffer) over the file
+ */
+BUN_EXPORT const void* market_snapshot_base(const MarketSnapshot* s) {
+  return s ? s->base : NULL;
+}
+
+BUN_EXPORT uint64_t market_snapshot_size(const MarketSnapshot* s) {
+  return s ? s->size : 0;
+}
+
+BUN_EXPORT uint32_t market_snapshot_rows(const MarketSnapshot* s) {
+  return s ? s->h->rows : 0;
+}
+
+/**
+ * Column index by name
+ *
+ * @returns the index, or -1 if the snapshot has no such column
+ */
+BUN_EXPORT int32_t market_snapshot_column(const MarketSnapshot* s, const char* name) {
+  if (!s || !name) return -1;
+  for (uint32_t c = 0; c < s->h->column_count; c++) {
+    if (!strncmp(s->h->columns[c].name, name, SNAP_NAME_MAX)) return (int32_t)c;
+  }
+  return -1;
+}
+
+/**
+ * @returns SNAPSHOT_F64 / SNAPSHOT_U32 / SNAPSHOT_STR, or 0 for a bad index
+ */
+BUN_EXPORT uint32_t market_snapshot_column_type(const MarketSnapshot* s, uint32_t column) {
+  return s && column < s->h->column_count ? s->h->columns[column].type : 0;
+}
+
+/**
+ * A column's rows as a packed array inside the mapping (string columns
+ * hold off/len pairs into the string table)
+ */
+BUN_EXPORT const void* market_snapshot_column_data(const MarketSnapshot* s, uint32_t column) {
+  return s && column < s->h->column_count ? s->base + s->h->columns[column].off : NULL;
+}
+
+/**
+ * One string cell
+ *
+ * @param out_len - receives the length in bytes (may be NULL)
+ * @returns the NUL-terminated string inside the mapping, or NULL if the
+ *          column is not a string column or the row is out of range
+ */
+BUN_EXPORT const char* market_snapshot_string(const MarketSnapshot* s, uint32_t column, uint32_t row,
+                                              uint32_t* out_len) {
+  if (!s || column >= s->h->column_count || s->h->columns[column].type != SNAPSHOT_STR ||
+      row >= s->h->rows) {
+    return NULL;
+  }
+  const uint32_t* ref = (const uint32_t*)(s->base + s->h->columns[column].off) + 2 * (size_t)row;
+  if (out_len) *out_len = ref[1];
+  return s->base + s->h->strings_off + ref[0];
+}
+
+/**
+ * Row whose key column equals `key`
+ *
+ * @returns the row, or -1 if it is not present or the file has no index
+ */
+BUN_EXPORT int32_t market_snapshot_find(const MarketSnapshot* s, const char* key, uint32_t len) {
+  if (!s || !key || s->h->key_column == SNAP_NO_KEY) return -1;
+  const SnapHeader* h = s->h;
+  const uint32_t* index = (const uint32_t*)(s->base + h->index_off);
+  const uint32_t* refs = (const uint32_t*)(s->base + h->columns[h->key_column].off);
+  const char* strings = s->base + h->strings_off;
+  uint32_t mask = h->index_slots - 1;
+  // The index always has a free slot, so the probe ends
+  for (uint32_t i = snap_key_hash(key, len) & mask;; i = (i + 1) & mask) {
+    uint32_t row = index[i];
+    if (!row) return -1;
+    const uint32_t* ref = refs + 2 * (size_t)(row - 1);
+    if (ref[1] == len && !memcmp(strings + ref[0], key, len)) return (int32_t)(row - 1);
+  }
+}
@@ -2,74 +2,117 @@
  * @dynamic-spy/kit v3.4 - MMap Cache
  * 
  * FIXED: Non-numeric validation for Bun.mmap
- * Production-ready memory-mapped cache for 12K markets
+ * Production-ready memory-mapped cache for 12K markets, stored as a
+ * columnar snapshot (see market-snapshot.ts) and read lazily
  */
 
+import { mkdirSync } from 'fs';
+import { MarketSnapshot, type SnapshotOptions } from './market-snapshot';
+
+export interface Market {
+	id: string;
+	sport: string;
+	league: string;
+	odds: number;
+}
+
 export class MMapCache {
-	private cacheFile = Bun.file('cache/12k-markets.bin');
+	private cachePath = 'cache/12k-markets.bin';
+	private snapshot: MarketSnapshot | null = null;
+
+	constructor(private options: SnapshotOptions = {}) {}
 
 	/**
-	 * Load markets from memory-mapped cache
-	 * 
-	 * ✅ FIXED: Validates offset/size are numbers
-	 * 
-	 * @returns Decoded market data as string
+	 * Map the columnar market snapshot, rebuilding it if it is missing or
+	 * unreadable. Only the header is read here; columns are faulted in as
+	 * markets are accessed.
 	 */
-	async loadMarkets(): Promise<string> {
-		try {
-			const buffer = await this.cacheFile.arrayBuffer();
-			const view = new Uint8Array(buffer);
-
-			// ✅ FIXED: Validates offset/size are numbers
-			if (typeof view.length !== 'number' || view.length < 0) {
-				throw new Error('Invalid buffer size');
-			}
-
-			const markets = Bun.mmap(view.buffer, {
-				offset: 0, // Number validated
-				size: view.length // Number validated
-			});
-
-			return new TextDecoder().decode(markets);
-		} catch (e: any) {
-			if (e.message?.includes('non-numeric') || e.message?.includes('Invalid')) {
-				console.log('Cache corrupted - rebuilding');
-				await this.rebuildCache();
-				// Retry after rebuild
-				return this.loadMarkets();
-			}
-			throw e;
+	async open(): Promise<MarketSnapshot> {
+		if (this.snapshot) return this.snapshot;
+		let snapshot = MarketSnapshot.open(this.cachePath, this.options);
+		if (!snapshot) {
+			console.log('Cache missing or corrupted - rebuilding');
+			await this.rebuildCache();
+			snapshot = MarketSnapshot.open(this.cachePath, this.options);
+			if (!snapshot) throw new Error(`Invalid market snapshot ${this.cachePath}`);
+		}
+		this.snapshot = snapshot;
+		return snapshot;
+	}
+
+	get count(): number {
+		return this.snapshot?.rows ?? 0;
+	}
+
+	/**
+	 * One market by row, decoded from the mapped columns
+	 */
+	market(row: number): Market {
+		const s = this.snapshot;
+		if (!s) throw new Error('MMapCache.open() has not been called');
+		return {
+			id: s.string('id', row),
+			sport: s.string('sport', row),
+			league: s.string('league', row),
+			odds: s.f64('odds')[row]
+		};
+	}
+
+	/**
+	 * One market by id through the snapshot's key index
+	 */
+	findMarket(id: string): Market | null {
+		const row = this.snapshot?.find(id) ?? -1;
+		return row < 0 ? null : this.market(row);
+	}
+
+	/**
+	 * Markets [offset, offset + limit) as objects
+	 */
+	markets(offset: number = 0, limit: number = Infinity): Market[] {
+		const end = Math.min(this.count, offset + limit);
+		const out: Market[] = [];
+		for (let row = Math.max(offset, 0); row < end; row++) {
+			out.push(this.market(row));
 		}
+		return out;
+	}
+
+	/**
+	 * Load all markets as JSON text
+	 *
+	 * Decodes every market; prefer market()/findMarket() for lookups.
+	 */
+	async loadMarkets(): Promise<string> {
+		await this.open();
+		return JSON.stringify(this.markets());
 	}
 
 	/**
 	 * Rebuild cache from source
 	 */
 	private async rebuildCache(): Promise<void> {
-		// Create cache directory if it doesn't exist
-		try {
-			const fs = require('fs');
-			fs.mkdirSync('cache', { recursive: true });
-		} catch (e: any) {
-			if (e.code !== 'EEXIST') {
-				throw e;
-			}
-		}
+		mkdirSync('cache', { recursive: true });
 
 		// Generate sample market data (12K markets)
-		const markets = Array.from({ length: 12000 }, (_, i) => ({
-			id: `MARKET-${i}`,
-			sport: 'FOOTBALL',
-			league: `LEAGUE-${i % 10}`,
-			odds: Math.random() * 10 + 1
-		}));
-
-		const marketData = JSON.stringify(markets);
-		const encoder = new TextEncoder();
-		const buffer = encoder.encode(marketData);
-
-		// Write to cache file
-		await Bun.write(this.cacheFile, buffer);
+		const rows = 12000;
+		const ids: string[] = new Array(rows);
+		const sports: string[] = new Array(rows);
+		const leagues: string[] = new Array(rows);
+		const odds = new Float64Array(rows);
+		for (let i = 0; i < rows; i++) {
+			ids[i] = `MARKET-${i}`;
+			sports[i] = 'FOOTBALL';
+			leagues[i] = `LEAGUE-${i % 10}`;
+			odds[i] = Math.random() * 10 + 1;
+		}
+
+		MarketSnapshot.write(this.cachePath, rows, [
+			{ name: 'id', type: 'string', values: ids },
+			{ name: 'sport', type: 'string', values: sports },
+			{ name: 'league', type: 'string', values: leagues },
+			{ name: 'odds', type: 'f64', values: odds }
+		], 'id');
 	}
 
 	/**
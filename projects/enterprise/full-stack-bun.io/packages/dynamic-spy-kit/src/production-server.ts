@@ -23,6 +23,21 @@ const BOOKIE_KEYS: Record<string, string> = {
 	// ... 75+ more bookies
 };
 
+// Largest page /markets serves for an explicit ?limit=; without one the
+// whole list is returned, as before paging existed
+const MAX_MARKETS_PER_PAGE = 1000;
+
+/**
+ * Parse a non-negative integer query parameter.
+ * Returns the fallback when absent and null when malformed.
+ */
+function parseCount(value: string | null, fallback: number): number | null {
+	if (value === null) return fallback;
+	if (!/^\d+$/.test(value)) return null;
+	const n = Number(value);
+	return Number.isSafeInteger(n) ? n : null;
+}
+
 // Initialize caches
 const cache = new MMapCache();
 const redisCache = new RedisArbCache();
@@ -60,9 +75,16 @@ const server = Bun.serve({
 
 				// Markets endpoint - mmap cache + Redis + Glob config
 				if (url.pathname === '/markets') {
+					const offset = parseCount(url.searchParams.get('offset'), 0);
+					const limit = parseCount(url.searchParams.get('limit'), Infinity);
+					if (offset === null || limit === null) {
+						return Response.json({
+							error: 'offset and limit must be non-negative integers'
+						}, { status: 400 });
+					}
 					try {
-						// 1. Load markets from mmap cache
-						const markets = await cache.loadMarkets();
+						// 1. Map the market snapshot; only the requested rows are read
+						await cache.open();
 
 						// 2. Scan config files with Glob
 						const configFiles = await configLoader.scanConfigFiles('config/sports/**/*', {
@@ -74,7 +96,8 @@ const server = Bun.serve({
 						const cachedArbs = await redisCache.getAllArbs();
 
 						return Response.json({
-							markets: JSON.parse(markets),
+							markets: cache.markets(offset, limit === Infinity ? limit : Math.min(limit, MAX_MARKETS_PER_PAGE)),
+							total: cache.count,
 							configFiles: configFiles.length,
 							cachedArbs: cachedArbs.length,
 							timestamp: Date.now()
@@ -150,7 +173,7 @@ const server = Bun.serve({
 console.log(`🚀 Arbitrage Server running on http://localhost:${server.port}`);
 console.log(`📊 Endpoints:`);
 console.log(`  GET /health - Health check`);
-console.log(`  GET /markets - Load 12K markets (mmap + Redis + Glob)`);
+console.log(`  GET /markets?offset=&limit= - Page through markets, ${MAX_MARKETS_PER_PAGE} max (mmap + Redis + Glob)`);
 console.log(`  GET /arbs - Get arbitrage opportunities`);
 console.log(`  GET /config - List config files`);
 console.log(`🛡️  Fuzzer-proof: ✅ All components integrated`);
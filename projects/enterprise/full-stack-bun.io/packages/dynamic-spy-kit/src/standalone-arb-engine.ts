@@ -11,6 +11,8 @@ const CONFIG = {
 	port: 3000,
 	bookies: ['pinnacle', 'bet365', 'betmgm'],
 	markets: 25000,
+	outcomes: 2,
+	maxTicksPerRequest: 65536,
 	compression: 'zstd' as const
 } as const;
 
@@ -24,6 +26,80 @@ console.log('');
 
 // Import compression utilities
 import { generateNBAMarketsStream, compressStream } from './utils/compression-stream';
+import { ArbEngine, ARB_CLOSE, type ArbOpportunity } from './arb-engine';
+
+// Best-price tables, updated per tick (native when PATTERN_MATCHER_LIB is set)
+const arbEngine = new ArbEngine({ markets: CONFIG.markets, outcomes: CONFIG.outcomes, bookies: CONFIG.bookies.length });
+CONFIG.bookies.forEach((b) => arbEngine.bookieId(b));
+const openArbs = new Map<number, ArbOpportunity>();
+const marketKeys: string[] = [];
+const knownMarkets = new Set<string>();
+const bookies = new Set<string>(CONFIG.bookies);
+
+interface PriceTick {
+	market: string;
+	outcome: number;
+	bookie: string;
+	odds: number;
+}
+
+/**
+ * Check a /ticks body before any of it is applied
+ *
+ * @returns the ticks, or why the batch was rejected
+ */
+function parseTicks(body: unknown): PriceTick[] | string {
+	if (!Array.isArray(body)) return 'body must be an array of ticks';
+	if (body.length > CONFIG.maxTicksPerRequest) return `at most ${CONFIG.maxTicksPerRequest} ticks per request`;
+	const fresh = new Set<string>();
+	for (let i = 0; i < body.length; i++) {
+		const t = body[i];
+		if (typeof t !== 'object' || t === null) return `tick ${i}: not an object`;
+		if (typeof t.market !== 'string' || t.market === '') return `tick ${i}: market must be a non-empty string`;
+		if (!Number.isInteger(t.outcome) || t.outcome < 0 || t.outcome >= CONFIG.outcomes) {
+			return `tick ${i}: outcome must be an integer below ${CONFIG.outcomes}`;
+		}
+		if (typeof t.bookie !== 'string' || !bookies.has(t.bookie)) return `tick ${i}: unknown bookie`;
+		if (typeof t.odds !== 'number' || !Number.isFinite(t.odds)) return `tick ${i}: odds must be a finite number`;
+		if (!knownMarkets.has(t.market)) fresh.add(t.market);
+	}
+	if (knownMarkets.size + fresh.size > CONFIG.markets) return `market table is full (${CONFIG.markets})`;
+	return body as PriceTick[];
+}
+
+function applyTicks(ticks: PriceTick[]): ArbOpportunity[] {
+	const n = ticks.length;
+	const columns = {
+		market: new Uint32Array(n),
+		outcome: new Uint8Array(n),
+		bookie: new Uint16Array(n),
+		odds: new Float64Array(n)
+	};
+	ticks.forEach((t, i) => {
+		const id = arbEngine.marketId(t.market);
+		marketKeys[id] = t.market;
+		knownMarkets.add(t.market);
+		columns.market[i] = id;
+		columns.outcome[i] = t.outcome;
+		columns.bookie[i] = arbEngine.bookieId(t.bookie);
+		columns.odds[i] = t.odds;
+	});
+	const events = arbEngine.update(columns) > 0 ? arbEngine.events() : [];
+	for (const ev of events) {
+		if (ev.kind === ARB_CLOSE) openArbs.delete(ev.market);
+		else openArbs.set(ev.market, ev);
+	}
+	return events;
+}
+
+function describeArb(ev: ArbOpportunity) {
+	return {
+		market: marketKeys[ev.market],
+		kind: ev.kind,
+		profit: ev.profit,
+		legs: ev.odds.map((odds, outcome) => ({ outcome, odds, bookie: arbEngine.bookieName(ev.bookies[outcome]) }))
+	};
+}
 
 // Start server
 Bun.serve({
@@ -44,6 +120,23 @@ Bun.serve({
 			});
 		}
 		
+		// POST /ticks [{ market, outcome, bookie, odds }] -> arb transitions
+		if (url.pathname === '/ticks' && req.method === 'POST') {
+			let body: unknown;
+			try {
+				body = await req.json();
+			} catch {
+				return Response.json({ error: 'body is not valid JSON' }, { status: 400 });
+			}
+			const ticks = parseTicks(body);
+			if (typeof ticks === 'string') return Response.json({ error: ticks }, { status: 400 });
+			return Response.json({ events: applyTicks(ticks).map(describeArb) });
+		}
+
+		if (url.pathname === '/arbs') {
+			return Response.json({ arbs: [...openArbs.values()].map(describeArb), stats: arbEngine.stats() });
+		}
+
 		if (url.pathname === '/health') {
 			return Response.json({
 				status: 'live',
@@ -59,6 +152,8 @@ Bun.serve({
 
 console.log(`✅ Server running on port ${CONFIG.port}`);
 console.log(`📊 Markets: http://localhost:${CONFIG.port}/markets`);
+console.log(`⚡ Ticks: POST http://localhost:${CONFIG.port}/ticks`);
+console.log(`💰 Arbs: http://localhost:${CONFIG.port}/arbs`);
 console.log(`💚 Health: http://localhost:${CONFIG.port}/health`);
 
 
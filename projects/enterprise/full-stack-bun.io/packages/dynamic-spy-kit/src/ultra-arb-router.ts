@@ -166,7 +166,7 @@ export class UltraArbRouter<T = any> {
 			const totalTime = performance.now() - startTime;
 			const ffiStats = this.ffiMatcher.getStats();
 			const throughput = Math.floor(ffiStats.matchesPerSec / 1000);
-			console.log(`🚀 HMR COMPLETE: ${afterCount} patterns | ${throughput + 3}K matches/sec ⚡`);
+			console.log(`🚀 HMR COMPLETE: ${afterCount} patterns | ${throughput}K matches/sec ⚡`);
 		} catch (e) {
 			console.error('HMR adaptive pattern reload failed:', e);
 		}
@@ -246,17 +246,16 @@ export class UltraArbRouter<T = any> {
 				
 				// Register FFI patterns
 				aiPatterns.forEach(pattern => {
-					if (this.ffiMatcher && pattern.id) {
-						(this.ffiMatcher as any).registerPattern?.(pattern.id, {
-							priority: pattern.priority || 50,
-							patternId: pattern.id,
-							bookie: pattern.bookie || this.extractBookie(pattern.hostname || '')
-						});
+					if (this.ffiMatcher && pattern.hostname && pattern.pathname) {
+						this.ffiMatcher.registerPattern(pattern.hostname, pattern.pathname, pattern.priority ?? 50);
 					}
 					
 					// Log pattern activation
 					console.log(`🌐 ${pattern.hostname}:${pattern.pathname} → ACTIVE`);
 				});
+				// Build and publish the new native set here, not on the next match;
+				// matches already in flight finish on the old one
+				this.ffiMatcher.compile();
 				
 				const totalTime = performance.now() - startTime;
 				console.log(`✅ Region 'ai-live' updated with confidence ${aiPatterns[0]?.confidence || 0.992}`);
@@ -269,7 +268,7 @@ export class UltraArbRouter<T = any> {
 				console.log(`└── Patterns: ${afterCount} | Throughput: ${throughput}K matches/sec ⚡`);
 				
 				if (isBatch) {
-					console.log(`🚀 Patterns evolved: ${afterCount} total | ${throughput + 5}K matches/sec ⚡`);
+					console.log(`🚀 Patterns evolved: ${afterCount} total | ${throughput}K matches/sec ⚡`);
 				}
 			}
 		} catch (e) {
@@ -0,0 +1,69 @@
+import { describe, expect, test } from "bun:test";
+import { ARB_CLOSE, ARB_OPEN, ARB_UPDATE, ArbEngine, type PriceTickColumns } from "../src/arb-engine";
+import { nativeLib } from "./native-lib";
+
+function columns(rows: [market: number, outcome: number, bookie: number, odds: number][]): PriceTickColumns {
+	return {
+		market: Uint32Array.from(rows, (r) => r[0]),
+		outcome: Uint8Array.from(rows, (r) => r[1]),
+		bookie: Uint16Array.from(rows, (r) => r[2]),
+		odds: Float64Array.from(rows, (r) => r[3])
+	};
+}
+
+// Deterministic 3-way prices from 16 bookies over 200 markets, with pulls
+function ticks(count: number, seed: number): PriceTickColumns {
+	let s = seed;
+	const rand = () => (s = (Math.imul(s, 1103515245) + 12345) >>> 0) / 2 ** 32;
+	const rows: [number, number, number, number][] = [];
+	for (let i = 0; i < count; i++) {
+		const odds = rand() < 0.05 ? 1 : 2.4 + rand() * 1.4;
+		rows.push([Math.floor(rand() * 200), Math.floor(rand() * 3), Math.floor(rand() * 16), odds]);
+	}
+	return columns(rows);
+}
+
+describe("ArbEngine", () => {
+	test("opens, updates and closes an arb across bookies", () => {
+		const e = new ArbEngine({ markets: 4, bookies: 4, libPath: "" });
+		expect(e.update(columns([[0, 0, 0, 2.1], [0, 1, 1, 1.8]]))).toBe(0);
+
+		expect(e.update(columns([[0, 1, 2, 2.1]]))).toBe(1);
+		expect(e.event(0)).toMatchObject({ kind: ARB_OPEN, market: 0, odds: [2.1, 2.1], bookies: [0, 2] });
+		expect(e.event(0).profit).toBeCloseTo(0.05);
+
+		expect(e.update(columns([[0, 0, 3, 2.2]]))).toBe(1);
+		expect(e.event(0)).toMatchObject({ kind: ARB_UPDATE, bookies: [3, 2] });
+
+		// Pulling bookie 2 leaves 1.8 as the best second line
+		expect(e.update(columns([[0, 1, 2, 1]]))).toBe(1);
+		expect(e.event(0)).toMatchObject({ kind: ARB_CLOSE, market: 0 });
+		expect(e.market(0)?.kind).not.toBe(ARB_OPEN);
+	});
+
+	test("rejects counts that run past a column", () => {
+		const e = new ArbEngine({ markets: 4, libPath: "" });
+		const t = columns([[0, 0, 0, 2.1], [0, 1, 1, 2.1]]);
+		expect(() => e.update({ ...t, odds: t.odds.subarray(0, 1) })).toThrow(RangeError);
+		expect(() => e.update({ ...t, count: 5 })).toThrow(RangeError);
+		expect(() => e.update({ ...t, count: -1 })).toThrow(RangeError);
+		expect(e.update(t)).toBe(1);
+	});
+
+	test.skipIf(!nativeLib)("native engine agrees with the JS loop", () => {
+		const options = { markets: 200, outcomes: 3, bookies: 16, minProfit: 0.005 };
+		const native = new ArbEngine({ ...options, libPath: nativeLib! });
+		const js = new ArbEngine({ ...options, libPath: "" });
+		expect(native.native).toBe(true);
+		expect(js.native).toBe(false);
+		let events = 0;
+		for (let round = 0; round < 4; round++) {
+			const batch = ticks(20000, round + 1);
+			expect(native.update(batch)).toBe(js.update(batch));
+			expect(native.events()).toEqual(js.events());
+			events += native.events().length;
+		}
+		expect(events).toBeGreaterThan(0);
+		for (let m = 0; m < 200; m++) expect(native.market(m)).toEqual(js.market(m));
+	});
+});
@@ -0,0 +1,484 @@
+import { afterEach, describe, expect, test } from "bun:test";
+import { dlopen } from "bun:ffi";
+import { readFileSync, rmSync, writeFileSync } from "fs";
+import { join } from "path";
+import { FFIPatternMatcher } from "../src/ffi-pattern-matcher";
+import { FFIMatcher, type StreamPatternMatch } from "../src/ffi-wrapper";
+import { nativeLib, scratchDir } from "./native-lib";
+
+const encoder = new TextEncoder();
+const decoder = new TextDecoder();
+const cstr = (s: string) => Buffer.from(`${s}\0`);
+const span = (url: Uint8Array, [off, len]: [number, number]) => decoder.decode(url.subarray(off, off + len));
+
+describe.skipIf(!nativeLib)("FFIMatcher (native)", () => {
+	const open: FFIMatcher[] = [];
+	const matcher = () => {
+		const m = new FFIMatcher(nativeLib!);
+		open.push(m);
+		return m;
+	};
+	afterEach(() => {
+		for (const m of open.splice(0)) m.close();
+	});
+
+	test("compiles templates and matches host and path segments", () => {
+		const m = matcher();
+		expect(m.registerPattern("a.com", "/x/:id")).toBe(0);
+		expect(m.registerPattern("*.b.com", "/y/:sport/:league")).toBe(1);
+		expect(m.compile()).toBe(true);
+
+		expect(m.match("https://a.com/x/42")).toMatchObject({ patternId: 0, hostname: "a.com", groups: { id: "42" } });
+		expect(m.match("https://www.b.com/y/soccer/epl")).toMatchObject({ patternId: 1, groups: { sport: "soccer", league: "epl" } });
+		expect(m.match("https://a.com/x/42/more")).toBeNull();
+		expect(m.match("https://c.com/x/42")).toBeNull();
+	});
+
+	test("registering after compile() republishes on the next match", () => {
+		const m = matcher();
+		m.registerPattern("a.com", "/x/:id");
+		expect(m.match("https://a.com/x/1")?.patternId).toBe(0);
+		expect(m.registerPattern("a.com", "/z")).toBe(1);
+		expect(m.match("https://a.com/z")?.patternId).toBe(1);
+		expect(m.match("https://a.com/x/1")?.patternId).toBe(0);
+	});
+
+	test("matchBatch() returns what match() does for every URL", () => {
+		const m = matcher();
+		m.registerPattern("a.com", "/x/:id");
+		m.registerPattern("b.com", "/y/:sport/:league");
+		const urls = ["https://a.com/x/1", "https://c.com/x/2", "https://b.com/y/tennis/atp", "https://a.com/x/caf%C3%A9"];
+		const batch = m.matchBatch(urls);
+		expect(batch).toHaveLength(urls.length);
+		urls.forEach((url, i) => {
+			const one = m.match(url);
+			expect(batch[i]?.patternId ?? null).toBe(one?.patternId ?? null);
+			if (one) expect(batch[i]).toMatchObject({ url, groups: one.groups, confidence: one.confidence });
+		});
+		expect(m.matchBatch([])).toEqual([]);
+	});
+
+	test("matchBatch() keeps at most maxGroups groups per URL", () => {
+		const m = matcher();
+		m.registerPattern("b.com", "/y/:sport/:league");
+		const [r] = m.matchBatch(["https://b.com/y/tennis/atp"], 1);
+		expect(r).toMatchObject({ patternId: 0, groups: { sport: "tennis" } });
+		expect(r?.groups.league).toBeUndefined();
+	});
+
+	test("matchSpans() returns byte spans into the URL", () => {
+		const m = matcher();
+		m.registerPattern("b.com", "/y/:sport/:league");
+		const url = encoder.encode("https://user@B.com:8443/y/tennis/atp");
+		const r = m.matchSpans(url)!;
+		expect(r.patternId).toBe(0);
+		expect(span(url, r.host)).toBe("B.com"); // hosts match case-insensitively
+		expect(span(url, r.path)).toBe("/y/tennis/atp");
+		expect(span(url, r.groups.sport)).toBe("tennis");
+		expect(span(url, r.groups.league)).toBe("atp");
+		expect(m.matchSpans(encoder.encode("https://c.com/y/a/b"))).toBeNull();
+	});
+
+	test("matchSpans() resets a full arena and keeps matching", () => {
+		const m = matcher();
+		m.registerPattern("a.com", "/x/:id");
+		for (let i = 0; i < 5000; i++) {
+			const url = encoder.encode(`https://a.com/x/${i}`);
+			expect(span(url, m.matchSpans(url)!.groups.id)).toBe(String(i));
+		}
+	});
+
+	test("match_url_arena() reports ARENA_FULL until the arena is reset", () => {
+		const lib = dlopen(nativeLib!, {
+			pattern_set_create: { args: [], returns: "ptr" },
+			pattern_set_add: { args: ["ptr", "ptr", "ptr"], returns: "i32" },
+			pattern_set_compile: { args: ["ptr"], returns: "i32" },
+			pattern_set_destroy: { args: ["ptr"], returns: "void" },
+			match_arena_reset: { args: ["ptr", "u32"], returns: "i32" },
+			match_url_arena: { args: ["ptr", "ptr", "ptr", "u32"], returns: "i64_fast" }
+		}).symbols;
+		const set = lib.pattern_set_create()!;
+		expect(lib.pattern_set_add(set, cstr("a.com"), cstr("/x/:id"))).toBe(0);
+		expect(lib.pattern_set_compile(set)).toBe(0);
+		const arena = new Uint8Array(512);
+		expect(lib.match_arena_reset(arena, 8)).toBe(-1); // smaller than the header
+		expect(lib.match_arena_reset(arena, arena.byteLength)).toBe(0);
+		const url = encoder.encode("https://a.com/x/1");
+		let stored = 0;
+		let at: number;
+		while ((at = Number(lib.match_url_arena(set, arena, url, url.byteLength))) >= 0) stored++;
+		expect(at).toBe(-2);
+		expect(stored).toBeGreaterThan(0);
+		expect(Number(lib.match_url_arena(set, arena, encoder.encode("https://c.com/"), 14))).toBe(-1);
+		lib.match_arena_reset(arena, arena.byteLength);
+		expect(Number(lib.match_url_arena(set, arena, url, url.byteLength))).toBeGreaterThanOrEqual(0);
+		lib.pattern_set_destroy(set);
+	});
+
+	test("literal compares are exact on both sides of the vector widths", () => {
+		const m = matcher();
+		const lengths = [1, 7, 8, 15, 16, 17, 31, 32, 33, 64, 100];
+		lengths.forEach((n, i) => expect(m.registerPattern("a.com", `/lit/${"s".repeat(n)}/:id`)).toBe(i));
+		lengths.forEach((n, i) => {
+			const seg = "s".repeat(n);
+			expect(m.match(`https://a.com/lit/${seg}/1`)?.patternId).toBe(i);
+			for (const at of [0, n >> 1, n - 1]) {
+				const off = seg.slice(0, at) + "t" + seg.slice(at + 1);
+				expect(m.match(`https://a.com/lit/${off}/1`)).toBeNull();
+			}
+		});
+	});
+
+	test("finds every literal host through the host index", () => {
+		const m = matcher();
+		for (let i = 0; i < 500; i++) {
+			expect(m.registerPattern(`book${i}.example.com`, "/odds/:id")).toBe(i);
+		}
+		m.registerPattern("*.example.com", "/odds/:id");
+		for (let i = 0; i < 500; i++) {
+			expect(m.match(`https://BOOK${i}.example.com/odds/${i}`)?.patternId).toBe(i);
+		}
+		// Misses in the index fall through to the wildcard host
+		expect(m.match("https://book500.example.com/odds/1")?.patternId).toBe(500);
+		expect(m.match("https://example.com/odds/1")).toBeNull();
+		expect(m.match("https://book1.example.org/odds/1")).toBeNull();
+	});
+
+	test("highest priority wins, then the earliest registered", () => {
+		const m = matcher();
+		expect(m.registerPattern("a.com", "/x/:id")).toBe(0);
+		expect(m.registerPattern("a.com", "/x/special", 5)).toBe(1);
+		expect(m.registerPattern("a.com", "/y/:id")).toBe(2);
+		expect(m.registerPattern("a.com", "/y/:slug")).toBe(3);
+		expect(m.registerPattern("a.com", "/y/:other", -1)).toBe(4);
+
+		expect(m.match("https://a.com/x/special")?.patternId).toBe(1);
+		expect(m.match("https://a.com/x/42")).toMatchObject({ patternId: 0, groups: { id: "42" } });
+		expect(m.match("https://a.com/y/z")?.patternId).toBe(2);
+		expect(m.matchBatch(["https://a.com/x/special", "https://a.com/y/z"]).map((r) => r?.patternId)).toEqual([1, 2]);
+	});
+
+	test("matchAll() returns every match, highest priority first", () => {
+		const m = matcher();
+		m.registerPattern("a.com", "/x/:id");
+		m.registerPattern("a.com", "/x/special", 5);
+		m.registerPattern("a.com", "/:section/special", 1);
+		const url = encoder.encode("https://a.com/x/special");
+		const all = m.matchAll(url);
+		expect(all.map((r) => r.patternId)).toEqual([1, 2, 0]);
+		expect(span(url, all[1].groups.section)).toBe("x");
+		expect(m.matchAll(encoder.encode("https://a.com/z"))).toEqual([]);
+	});
+	test("matchers in one process keep their own patterns", () => {
+		const a = matcher();
+		const b = matcher();
+		a.registerPattern("a.com", "/x/:id");
+		b.registerPattern("b.com", "/y/:id");
+		expect(a.match("https://a.com/x/1")?.groups).toEqual({ id: "1" });
+		expect(a.match("https://b.com/y/1")).toBeNull();
+		expect(b.match("https://b.com/y/2")?.groups).toEqual({ id: "2" });
+		a.close();
+		expect(a.match("https://a.com/x/1")).toBeNull();
+		expect(b.match("https://b.com/y/2")?.patternId).toBe(0);
+	});
+
+	test("close() inside a read section neither waits nor frees the set in use", () => {
+		const a = matcher();
+		const b = matcher();
+		a.registerPattern("a.com", "/x/:id");
+		b.registerPattern("a.com", "/x/:id");
+		expect(a.match("https://a.com/x/1")?.patternId).toBe(0);
+		const stream = b.createStream()!;
+		const seen: string[] = [];
+		stream.push(encoder.encode("https://a.com/x/1\nhttps://a.com/x/2\n"), (r) => {
+			a.close(); // another matcher's slot, while this thread reads b's
+			b.close(); // our own, from its own onMatch
+			const [off, len] = r.groups.id;
+			seen.push(decoder.decode(r.url.subarray(off, off + len)));
+		});
+		stream.close();
+		expect(seen).toEqual(["1", "2"]);
+		expect(b.match("https://a.com/x/1")).toBeNull(); // closed: callers fall back to URLPattern
+	});
+
+	test("saveCompiled() round-trips and verified loads reject corruption", () => {
+		const dir = scratchDir();
+		try {
+			const path = join(dir, "patterns.bin");
+			const m = matcher();
+			m.registerPattern("a.com", "/x/:id");
+			m.registerPattern("*.b.com", "/y/:slug", 3);
+			expect(m.saveCompiled(path)).toBe(true);
+
+			const loaded = matcher();
+			expect(loaded.loadCompiled(path, true)).toBe(true);
+			expect(loaded.match("https://a.com/x/7")).toMatchObject({ patternId: 0, groups: { id: "7" } });
+			expect(loaded.match("https://www.b.com/y/z")).toMatchObject({ patternId: 1, groups: { slug: "z" } });
+			expect(loaded.registerPattern("c.com", "/")).toBeLessThan(0); // frozen: reload() only
+
+			const bytes = readFileSync(path);
+			bytes[bytes.length - 1] ^= 0xff;
+			const corrupt = join(dir, "corrupt.bin");
+			writeFileSync(corrupt, bytes);
+			expect(matcher().loadCompiled(corrupt, true)).toBe(false);
+			expect(matcher().loadCompiled(join(dir, "missing.bin"))).toBe(false);
+		} finally {
+			rmSync(dir, { recursive: true, force: true });
+		}
+	});
+
+	test("parses :name(\\d+) groups natively and drops values that overflow", () => {
+		const m = matcher();
+		m.registerPattern("a.com", "/x/:id(\\d+)/:slug");
+		expect(m.match("https://a.com/x/42/z")).toMatchObject({ groups: { id: "42", slug: "z" }, ints: { id: 42 } });
+		expect(m.match("https://a.com/x/9007199254740993/z")?.ints.id).toBe(9007199254740993n);
+		expect(m.match("https://a.com/x/abc/z")).toBeNull(); // not digits
+		const over = m.match("https://a.com/x/184467440737095516150/z")!; // > UINT64_MAX
+		expect(over.groups.id).toBe("184467440737095516150");
+		expect(over.ints.id).toBeUndefined();
+		expect(m.matchBatch(["https://a.com/x/7/z"])[0]?.ints).toEqual({ id: 7 });
+		expect(m.matchSpans(encoder.encode("https://a.com/x/8/z"))?.ints).toEqual({ id: 8 });
+	});
+
+	test("streams carry records across chunk boundaries", () => {
+		const m = matcher();
+		m.registerPattern("a.com", "/x/:id");
+		const stream = m.createStream()!;
+		const seen: string[] = [];
+		const onMatch = (r: StreamPatternMatch) => seen.push(`${r.offset}:${span(r.url, r.groups.id)}`);
+		const input = encoder.encode("https://a.com/x/1\nhttps://c.com/x/2\nhttps://a.com/x/3");
+		for (let i = 0; i < input.length; i++) stream.push(input.subarray(i, i + 1), onMatch);
+		stream.end(onMatch);
+		stream.close();
+		expect(seen).toEqual(["0:1", "36:3"]);
+	});
+
+	test("streams skip over-long records and keep going", () => {
+		const m = matcher();
+		m.registerPattern("a.com", "/x/:id");
+		const stream = m.createStream()!;
+		let matched = 0;
+		const long = `https://a.com/x/${"a".repeat(10000)}\n`;
+		stream.push(encoder.encode(`${long}https://a.com/x/1\n`), () => matched++);
+		stream.end(() => matched++);
+		expect(matched).toBe(1);
+		expect(stream.stats).toEqual({ records: 2, matched: 1, skipped: 1 });
+		stream.close();
+	});
+
+	test("NDJSON streams read only the top-level key", () => {
+		const m = matcher();
+		m.registerPattern("a.com", "/x/:id");
+		const stream = m.createStream({ format: "ndjson" })!;
+		const ids: string[] = [];
+		const line = JSON.stringify({ meta: { url: "https://a.com/x/nested" }, url: "https://a.com/x/top" });
+		stream.push(encoder.encode(`${line}\n`), (r) => ids.push(span(r.url, r.groups.id)));
+		stream.close();
+		expect(ids).toEqual(["top"]);
+	});
+
+	test("matchBatchAsync() on the pool agrees with matchBatch()", async () => {
+		const m = matcher();
+		m.registerPattern("a.com", "/x/:id(\\d+)");
+		m.registerPattern("b.com", "/y/:slug");
+		expect(m.startPool(2, false)).toBe(2);
+		const urls = Array.from({ length: 2000 }, (_, i) =>
+			i % 3 === 0 ? `https://a.com/x/${i}` : i % 3 === 1 ? `https://b.com/y/s${i}` : `https://c.com/${i}`);
+		const [pooled, again] = await Promise.all([m.matchBatchAsync(urls), m.matchBatchAsync(urls.slice(0, 10))]);
+		expect(pooled).toEqual(m.matchBatch(urls));
+		expect(again).toEqual(m.matchBatch(urls.slice(0, 10)));
+		expect(pooled.filter((r) => r !== null)).toHaveLength(1334);
+	});
+
+	test("close() while a pool batch is in flight still resolves it", async () => {
+		const m = matcher();
+		m.registerPattern("a.com", "/x/:id");
+		m.startPool(2, false);
+		const urls = Array.from({ length: 5000 }, (_, i) => `https://a.com/x/${i}`);
+		const pending = m.matchBatchAsync(urls);
+		m.close();
+		const results = await pending;
+		expect(results).toHaveLength(urls.length);
+		expect(results[4999]?.groups).toEqual({ id: "4999" });
+	});
+
+	test("cached results equal fresh ones and respect the current limits", () => {
+		const dir = scratchDir();
+		try {
+			const m = matcher();
+			m.registerPattern("a.com", "/:a/:b/:c/:d");
+			m.registerPattern("*.b.com", "/y/:slug");
+			expect(m.openCache(join(dir, "cache.bin"), 1024)).toBe(true);
+			const urls = ["https://a.com/1/2/3/4", "https://www.b.com/y/z", "https://c.com/", `https://a.com/${"x".repeat(300)}/2/3/4`];
+			const fresh = m.matchBatch(urls);
+			expect(m.cacheStats()).toMatchObject({ hits: 0, stores: 4 });
+			expect(m.matchBatch(urls)).toEqual(fresh);
+			expect(m.cacheStats()?.hits).toBe(4);
+
+			// Entries stored without limits must not answer for a bounded set
+			expect(m.setLimits({ maxSteps: 2 })).toBe(true);
+			expect(m.matchBatch(urls.slice(0, 1))[0]?.rejected).toBe("budget");
+			expect(m.setLimits({ maxBytes: 100 })).toBe(true);
+			expect(m.matchBatch(urls)[3]?.rejected).toBe("limit");
+			expect(m.matchSpans(encoder.encode(urls[3]))?.rejected).toBe("limit");
+			expect(m.setLimits({})).toBe(true);
+			expect(m.matchBatch(urls)).toEqual(fresh); // bounded stores took over some entries
+			const hits = m.cacheStats()!.hits;
+			expect(m.matchBatch(urls)).toEqual(fresh);
+			expect(m.cacheStats()!.hits - hits).toBe(4);
+		} finally {
+			rmSync(dir, { recursive: true, force: true });
+		}
+	});
+
+	test("cache entries a dead writer left claimed are taken over", () => {
+		const dir = scratchDir();
+		try {
+			const path = join(dir, "cache.bin");
+			const m = matcher();
+			m.registerPattern("a.com", "/x/:id");
+			expect(m.openCache(path, 1024)).toBe(true);
+			// Every entry odd with a claim from boot time: writers that died mid-store
+			const file = readFileSync(path);
+			const entrySize = (file.byteLength - 64) / 1024;
+			for (let at = 64; at < file.byteLength; at += entrySize) file.writeBigUInt64LE(1n, at);
+			writeFileSync(path, file);
+
+			const urls = ["https://a.com/x/1", "https://a.com/x/2"];
+			const fresh = m.matchBatch(urls);
+			expect(fresh.map((r) => r?.groups.id)).toEqual(["1", "2"]);
+			expect(m.cacheStats()).toMatchObject({ hits: 0, stores: 2 });
+			expect(m.matchBatch(urls)).toEqual(fresh);
+			expect(m.cacheStats()?.hits).toBe(2);
+		} finally {
+			rmSync(dir, { recursive: true, force: true });
+		}
+	});
+
+	test("profiles evaluations and hits per pattern in native slabs", () => {
+		const m = matcher();
+		m.registerPattern("a.com", "/x/:id");
+		m.registerPattern("a.com", "/y");
+		m.registerPattern("b.com", "/z");
+		expect(m.profileSnapshot()).toBeNull();
+		expect(m.setProfiling(true)).toBe(true);
+		for (const url of ["https://a.com/x/1", "https://a.com/x/2", "https://a.com/y", "https://b.com/z", "https://a.com/w"]) {
+			m.matchSpans(encoder.encode(url));
+		}
+
+		const profile = m.profileSnapshot()!;
+		expect(profile.urls).toBe(5);
+		expect(profile.threads).toBe(1);
+		expect(profile.patterns.map((p) => p.hits)).toEqual([2, 1, 1]);
+		expect(profile.patterns.map((p) => p.evaluations)).toEqual([4, 4, 1]);
+		expect(profile.patterns[0].hostGroup).toBe(profile.patterns[1].hostGroup);
+		expect(profile.patterns[0].totalNs).toBe(profile.patterns[1].totalNs);
+		expect(profile.patterns[0].totalNs).toBeGreaterThan(0);
+		expect(m.getStats()).toMatchObject({ totalMatches: 5, ffiHitRate: 4 / 5 });
+	});
+
+	test("FFIPatternMatcher takes latency from the native profile only", () => {
+		const m = new FFIPatternMatcher(nativeLib!);
+		try {
+			m.registerPattern("x", { priority: 50, patternId: "x", bookie: "a", hostname: "a.com", pathname: "/x/:id" });
+			const result = m.matchBest("https://a.com/x/1");
+			expect(result).toEqual({ matched: true, patternId: "x", confidence: result!.confidence, groups: { id: "1" }, ints: {} });
+			expect(m.getStats().ffiMatchLatencyAvgMs).toBe(0);
+
+			expect(m.setProfiling(true)).toBe(true);
+			m.matchBest("https://a.com/x/2");
+			expect(m.patternProfile()).toMatchObject([{ patternId: "x", bookie: "a", hits: 1, evaluations: 1 }]);
+			expect(m.getStats().ffiMatchLatencyAvgMs).toBeGreaterThan(0);
+		} finally {
+			m.close();
+		}
+	});
+
+	test("cc()-specialized sets answer exactly what the tables do", () => {
+		const patterns: [string, string][] = [
+			["a.com", "/x/:id(\\d+)"],
+			["a.com", "/x/:sport(soccer|tennis)/:slug"],
+			["a.com", "/static/page"],
+			["b.com", "/y/:slug"],
+			["*.c.com", "/z/:id"], // wildcard host: tables only
+			["d.com", "/files/*"]
+		];
+		const urls = [
+			"https://a.com/x/42", "https://a.com/x/4a", "https://a.com/x/184467440737095516150",
+			"https://a.com/x/soccer/epl", "https://a.com/x/golf/open", "https://a.com/static/page",
+			"https://a.com/static/page/2", "https://b.com/y/z", "https://b.com/y/", "https://b.com/y/a?q=1",
+			"https://www.c.com/z/9", "https://d.com/files/a/b", "https://e.com/x/1", "https://a.com/"
+		];
+		const tables = matcher();
+		const jit = matcher();
+		for (const [host, path] of patterns) {
+			tables.registerPattern(host, path);
+			jit.registerPattern(host, path);
+		}
+		expect(jit.compile()).toBe(true);
+		expect(jit.setSpecialize(true)).toBe(true); // republishes the same patterns
+		expect(jit.getStats().specialized).toBe(true);
+
+		const expected = urls.map((url) => tables.match(url));
+		expect(urls.map((url) => jit.match(url))).toEqual(expected);
+		expect(jit.matchBatch(urls)).toEqual(tables.matchBatch(urls));
+		expect(urls.map((url) => jit.matchSpans(encoder.encode(url)))).toEqual(urls.map((url) => tables.matchSpans(encoder.encode(url))));
+
+		// Lookups the generated code settles never reach the profiled tables
+		expect(jit.setProfiling(true)).toBe(true);
+		jit.matchSpans(encoder.encode("https://b.com/y/z"));
+		jit.matchSpans(encoder.encode("https://www.c.com/z/9"));
+		expect(jit.profileSnapshot()?.urls).toBe(1);
+
+		expect(jit.setSpecialize(false)).toBe(false);
+		expect(urls.map((url) => jit.match(url))).toEqual(expected);
+	});
+
+	test("setLimits() refuses long URLs and deep walks and counts both", () => {
+		const m = matcher();
+		m.registerPattern("a.com", "/:a/:b/:c/:d");
+		const deep = "https://a.com/1/2/3/4";
+		const long = `https://a.com/${"x".repeat(200)}/2/3/4`;
+		expect(m.matchSpans(encoder.encode(long))?.rejected).toBeUndefined();
+		expect(m.setLimits({ maxBytes: 100, maxSteps: 3 })).toBe(true);
+
+		expect(m.matchSpans(encoder.encode(long))?.rejected).toBe("limit");
+		expect(m.matchSpans(encoder.encode(deep))?.rejected).toBe("budget");
+		expect(m.matchBatch([deep, long, "https://b.com/"]).map((r) => r?.rejected ?? r)).toEqual(["budget", "limit", null]);
+		expect(m.matchAll(encoder.encode(deep))).toEqual([]);
+		expect(m.limitStats()).toEqual({ overLimit: 2, overBudget: 3 });
+
+		// Sets published later keep the bounds
+		m.registerPattern("a.com", "/x");
+		expect(m.matchSpans(encoder.encode(long))?.rejected).toBe("limit");
+		expect(m.matchSpans(encoder.encode("https://a.com/x"))?.patternId).toBe(1);
+
+		expect(m.setLimits({})).toBe(true);
+		expect(m.matchSpans(encoder.encode(deep))?.groups).toEqual({ a: [14, 1], b: [16, 1], c: [18, 1], d: [20, 1] });
+		expect(m.matchBatch([long])[0]?.rejected).toBeUndefined();
+	});
+
+	test("FFIPatternMatcher reports refused URLs instead of falling back", async () => {
+		const m = new FFIPatternMatcher(nativeLib!);
+		try {
+			m.registerPattern("deep", { priority: 50, patternId: "deep", bookie: "a", hostname: "a.com", pathname: "/:a/:b/:c/:d" });
+			expect(m.setLimits({ maxBytes: 64, maxSteps: 3 })).toBe(true);
+			expect(m.matchBest("https://a.com/1/2/3/4")).toMatchObject({ matched: false, rejected: "budget" });
+			expect(m.matchWithFFI(`https://a.com/${"x".repeat(64)}`, "deep")).toMatchObject({ matched: false, rejected: "limit" });
+			const batch = await m.matchBestBatch(["https://a.com/1/2/3/4", `https://a.com/${"x".repeat(64)}`]);
+			expect(batch.map((r) => r?.rejected)).toEqual(["budget", "limit"]);
+			expect(m.getStats()).toMatchObject({ ffiRejected: 4, ffiFallbacksToJS: 0, totalCalls: 4 });
+		} finally {
+			m.close();
+		}
+	});
+});
+
+describe("FFIMatcher (no library)", () => {
+	test("reports itself unavailable so callers use URLPattern", () => {
+		const m = new FFIMatcher();
+		expect(m.registerPattern("a.com", "/x/:id")).toBeLessThan(0);
+		expect(m.match("https://a.com/x/1")).toBeNull();
+		expect(m.createStream()).toBeNull();
+	});
+});
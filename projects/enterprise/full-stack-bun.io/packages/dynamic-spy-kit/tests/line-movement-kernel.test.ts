@@ -0,0 +1,65 @@
+import { describe, expect, test } from "bun:test";
+import { LM_BUYBACK, LM_CLOSING, LM_FIRST, LM_INVALID, LineMovementKernel, type TickColumns } from "../src/line-movement-kernel";
+import { nativeLib } from "./native-lib";
+
+// Deterministic ticks walking 64 markets' prices, with a few bad rows
+function ticks(count: number, seed: number): TickColumns {
+	let s = seed;
+	const rand = () => (s = (Math.imul(s, 1103515245) + 12345) >>> 0) / 2 ** 32;
+	const market = new Uint32Array(count);
+	const timestamp = new Float64Array(count);
+	const price = new Float64Array(count);
+	const last = new Float64Array(64).fill(2);
+	for (let i = 0; i < count; i++) {
+		const m = Math.floor(rand() * 64);
+		last[m] = Math.max(1.01, last[m] * (1 + (rand() - 0.5) * 0.08));
+		market[i] = i % 97 === 0 ? 1000 : m; // unknown id
+		timestamp[i] = 1_700_000_000_000 + i * 250;
+		price[i] = i % 89 === 0 ? 0 : last[m]; // pulled price
+	}
+	return { market, timestamp, price };
+}
+
+const copy = (batch: ReturnType<LineMovementKernel["update"]>) => ({
+	delta: Array.from(batch.delta),
+	velocity: Array.from(batch.velocity),
+	movement: Array.from(batch.movement),
+	flags: Array.from(batch.flags),
+	events: Array.from(batch.events)
+});
+
+describe("LineMovementKernel", () => {
+	test("flags the opening tick, bands and bad rows", () => {
+		const k = new LineMovementKernel(4, { libPath: "", velocityThreshold: 1 });
+		const batch = k.update({
+			market: new Uint32Array([0, 0, 0, 9, 1]),
+			timestamp: new Float64Array([0, 1000, 2000, 3000, 4000]),
+			price: new Float64Array([2, 2.1, 1.9, 2, -1])
+		});
+		expect(Array.from(batch.flags)).toEqual([LM_FIRST, LM_BUYBACK, LM_CLOSING, LM_INVALID, LM_INVALID]);
+		expect(batch.movement[1]).toBeCloseTo(5);
+		expect(Array.from(batch.events)).toEqual([1, 2]);
+	});
+
+	test("rejects counts that run past a column", () => {
+		const k = new LineMovementKernel(4, { libPath: "" });
+		const market = new Uint32Array(2);
+		const timestamp = new Float64Array([1, 2]);
+		const price = new Float64Array([2, 2.1]);
+		expect(() => k.update({ market, timestamp: timestamp.subarray(0, 1), price })).toThrow(RangeError);
+		expect(() => k.update({ market, timestamp, price, count: 3 })).toThrow(RangeError);
+		expect(() => k.update({ market, timestamp, price, count: 1.5 })).toThrow(RangeError);
+		expect(k.update({ market, timestamp, price, count: 1 }).flags).toHaveLength(1);
+	});
+
+	test.skipIf(!nativeLib)("native kernel agrees with the JS loop", () => {
+		const native = new LineMovementKernel(64, { libPath: nativeLib!, velocityThreshold: 0.02 });
+		const js = new LineMovementKernel(64, { libPath: "", velocityThreshold: 0.02 });
+		expect(native.native).toBe(true);
+		expect(js.native).toBe(false);
+		for (let round = 0; round < 4; round++) {
+			const batch = ticks(5000, round + 1);
+			expect(copy(native.update(batch))).toEqual(copy(js.update(batch)));
+		}
+	});
+});
@@ -0,0 +1,62 @@
+import { afterAll, beforeAll, describe, expect, test } from "bun:test";
+import { readFileSync, rmSync, writeFileSync } from "fs";
+import { join } from "path";
+import { MarketSnapshot } from "../src/market-snapshot";
+import { nativeLib, scratchDir } from "./native-lib";
+
+const ROWS = 3000;
+const SPORTS = ["soccer", "basketball", "tennis"];
+
+let dir: string;
+let path: string;
+
+beforeAll(() => {
+	dir = scratchDir();
+	path = join(dir, "markets.snap");
+	MarketSnapshot.write(path, ROWS, [
+		{ name: "id", type: "string", values: Array.from({ length: ROWS }, (_, r) => `m-${r}`) },
+		{ name: "sport", type: "string", values: Array.from({ length: ROWS }, (_, r) => SPORTS[r % 3]) },
+		{ name: "odds", type: "f64", values: Float64Array.from({ length: ROWS }, (_, r) => 1.5 + r / 1000) },
+		{ name: "bookies", type: "u32", values: Uint32Array.from({ length: ROWS }, (_, r) => r % 17) }
+	], "id");
+});
+
+afterAll(() => {
+	rmSync(dir, { recursive: true, force: true });
+});
+
+const backends: [string, string][] = [["Bun.mmap", ""]];
+if (nativeLib) backends.push(["native", nativeLib]);
+
+for (const [name, libPath] of backends) {
+	describe(`MarketSnapshot (${name})`, () => {
+		test("reads back every column", () => {
+			const snap = MarketSnapshot.open(path, { libPath, verify: true })!;
+			expect(snap.native).toBe(libPath !== "");
+			expect(snap.rows).toBe(ROWS);
+			expect(snap.f64("odds")[2500]).toBe(1.5 + 2500 / 1000);
+			expect(snap.u32("bookies")[35]).toBe(1);
+			expect(snap.string("sport", 4)).toBe("basketball");
+			expect(snap.hasColumn("league")).toBe(false);
+			expect(() => snap.f64("bookies")).toThrow();
+			snap.close();
+		});
+
+		test("find() looks up rows by key", () => {
+			const snap = MarketSnapshot.open(path, { libPath })!;
+			for (let r = 0; r < ROWS; r += 7) expect(snap.find(`m-${r}`)).toBe(r);
+			expect(snap.find("m-3000")).toBe(-1);
+			expect(snap.find("")).toBe(-1);
+			snap.close();
+		});
+
+		test("verified opens reject a corrupted file", () => {
+			const bytes = readFileSync(path);
+			bytes[bytes.length - 1] ^= 0xff;
+			const corrupt = join(dir, `corrupt-${name}.snap`);
+			writeFileSync(corrupt, bytes);
+			expect(MarketSnapshot.open(corrupt, { libPath, verify: true })).toBeNull();
+			expect(MarketSnapshot.open(join(dir, "missing.snap"), { libPath })).toBeNull();
+		});
+	});
+}
@@ -0,0 +1,36 @@
+/**
+ * Native library for the FFI suites
+ *
+ * PATTERN_MATCHER_LIB when set, else src/*.c built once per run with the
+ * system compiler (the same command as bench/native-bench.c). null when
+ * neither works; the native suites skip and the JS fallbacks still run.
+ */
+
+import { spawnSync } from "bun";
+import { mkdtempSync, rmSync } from "fs";
+import { tmpdir } from "os";
+import { join } from "path";
+import { fileURLToPath } from "url";
+
+const SOURCES = ["ffi_matcher.c", "line_movement.c", "market_snapshot.c", "arb_engine.c"];
+
+function build(): string | null {
+	if (process.env.PATTERN_MATCHER_LIB) return process.env.PATTERN_MATCHER_LIB;
+	const src = fileURLToPath(new URL("../src/", import.meta.url));
+	const dir = mkdtempSync(join(tmpdir(), "dynamic-spy-test-"));
+	process.on("exit", () => rmSync(dir, { recursive: true, force: true }));
+	const out = join(dir, "libffi_matcher.so");
+	try {
+		const result = spawnSync(["cc", "-O2", "-shared", "-fPIC", "-o", out, ...SOURCES.map((f) => join(src, f)), "-lpthread"]);
+		return result.exitCode === 0 ? out : null;
+	} catch {
+		return null; // no compiler
+	}
+}
+
+export const nativeLib = build();
+
+/** Scratch directory under the OS temp dir */
+export function scratchDir(): string {
+	return mkdtempSync(join(tmpdir(), "dynamic-spy-test-"));
+}